@@ -0,0 +1,525 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "imgui.h"
+#include "Hash.h"
+#include "MemoryTracker.h"
+#include "MeshBVH.h"
+#include "Profiler.h"
+#include "shader.h"
+#include "stb_image.h"
+#include "VirtualFileSystem.h"
+
+enum class AssetType { Mesh, Texture, Shader, Count };
+
+static const char* assetTypeNames[] = { "Mesh", "Texture", "Shader" };
+
+// Typed handle into the asset manager. generation == 0 is the null handle, and a handle
+// whose generation no longer matches its slot refers to an asset that has been evicted.
+template<AssetType Type>
+struct AssetHandle {
+	uint32_t index = 0;
+	uint32_t generation = 0;
+
+	bool valid() const { return generation != 0; }
+	bool operator==(const AssetHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+};
+
+using MeshHandle = AssetHandle<AssetType::Mesh>;
+using TextureHandle = AssetHandle<AssetType::Texture>;
+using ShaderHandle = AssetHandle<AssetType::Shader>;
+
+struct MeshAsset {
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLenum primitive = GL_TRIANGLES;
+	int vertexCount = 0;
+	std::vector<float> positions; // CPU copy, kept for picking and collision
+	MeshBVH bvh; // over positions for exact ray hits; empty unless primitive is GL_TRIANGLES
+};
+
+struct TextureAsset {
+	GLuint ID = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels; // only filled when the caller asks to keep a CPU copy
+};
+
+struct ShaderAsset {
+	std::unique_ptr<Shader> program; // heap allocated so Shader& stays valid while the pool grows
+};
+
+// Central owner of GPU/CPU resources. Loads are deduplicated by path and by content hash,
+// assets are reference counted through retain/release, and assets nobody references stay
+// cached until the memory budget is exceeded, at which point the least recently used ones
+// are evicted. Victim selection runs on a background thread; the GL objects themselves are
+// destroyed in update() on the thread that owns the context.
+//
+// load*, retain, release, get* and update must be called from the render thread.
+class AssetManager {
+public:
+	static AssetManager& get() {
+		static AssetManager instance;
+		return instance;
+	}
+
+	~AssetManager() {
+		stopEvictionThread();
+	}
+
+	// --- loading ----------------------------------------------------------------------
+	// Loads are charged to MemTag::Assets. GL calls run under General: drivers may allocate
+	// through our operator new and keep that memory past the asset's lifetime.
+	MeshHandle loadMesh(const std::string& name, const float* positions, size_t floatCount, GLenum primitive = GL_TRIANGLES) {
+		MemTagScope memTag(MemTag::Assets);
+		uint64_t pathKey = keyFor(AssetType::Mesh, hashString(name));
+		uint64_t contentKey = keyFor(AssetType::Mesh, hashBytes(positions, floatCount * sizeof(float), primitive));
+		int existing = findCached(pathKey, contentKey);
+		if (existing >= 0) return acquire<AssetType::Mesh>(existing, pathKey);
+
+		uint64_t loadStartNs = profilerNowNs();
+		MeshAsset mesh;
+		mesh.primitive = primitive;
+		mesh.vertexCount = static_cast<int>(floatCount / 3);
+		mesh.positions.assign(positions, positions + floatCount);
+		if (primitive == GL_TRIANGLES) mesh.bvh.build(positions, floatCount / 9);
+
+		{
+			MemTagScope driver(MemTag::General);
+			glGenVertexArrays(1, &mesh.VAO);
+			glGenBuffers(1, &mesh.VBO);
+			glBindVertexArray(mesh.VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+			glBufferData(GL_ARRAY_BUFFER, floatCount * sizeof(float), positions, GL_STATIC_DRAW);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(0);
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		size_t bytes = floatCount * sizeof(float), cpuBytes = bytes + mesh.bvh.memoryBytes();
+		uint32_t slot = meshes.insert(std::move(mesh));
+		return createRecord<AssetType::Mesh>(slot, name, pathKey, contentKey, bytes, cpuBytes, loadStartNs);
+	}
+
+	TextureHandle loadTexture(const std::string& path, bool keepCpuCopy = false) {
+		MemTagScope memTag(MemTag::Assets);
+		uint64_t pathKey = keyFor(AssetType::Texture, hashString(path));
+		int existing = findCached(pathKey, 0);
+		if (existing >= 0) return acquire<AssetType::Texture>(existing, pathKey);
+
+		uint64_t loadStartNs = profilerNowNs();
+		int width = 0, height = 0, channels = 0;
+		FileData file = VirtualFileSystem::get().read(path);
+		unsigned char* data = file ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()), &width, &height, &channels, 4) : nullptr;
+		if (!data) {
+			std::cout << "ERROR::ASSET::TEXTURE_NOT_LOADED: " << path << std::endl;
+			return TextureHandle();
+		}
+		size_t pixelBytes = static_cast<size_t>(width) * height * 4;
+		uint64_t contentKey = keyFor(AssetType::Texture, hashBytes(data, pixelBytes));
+		existing = findCached(0, contentKey);
+		if (existing >= 0) {
+			stbi_image_free(data);
+			return acquire<AssetType::Texture>(existing, pathKey);
+		}
+
+		TextureAsset texture;
+		texture.width = width;
+		texture.height = height;
+		{
+			MemTagScope driver(MemTag::General);
+			glGenTextures(1, &texture.ID);
+			glBindTexture(GL_TEXTURE_2D, texture.ID);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		if (keepCpuCopy) texture.pixels.assign(data, data + pixelBytes);
+		stbi_image_free(data);
+
+		size_t cpuBytes = texture.pixels.size();
+		size_t gpuBytes = pixelBytes + pixelBytes / 3; // full mip chain
+		uint32_t slot = textures.insert(std::move(texture));
+		return createRecord<AssetType::Texture>(slot, path, pathKey, contentKey, gpuBytes, cpuBytes, loadStartNs);
+	}
+
+	ShaderHandle loadShader(const std::string& vertexPath, const std::string& fragmentPath) {
+		MemTagScope memTag(MemTag::Assets);
+		uint64_t pathKey = keyFor(AssetType::Shader, hashString(fragmentPath, hashString(vertexPath)));
+		int existing = findCached(pathKey, 0);
+		if (existing >= 0) return acquire<AssetType::Shader>(existing, pathKey);
+
+		uint64_t loadStartNs = profilerNowNs();
+		std::string vertexCode = readFile(vertexPath);
+		std::string fragmentCode = readFile(fragmentPath);
+		if (vertexCode.empty() || fragmentCode.empty())
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << (vertexCode.empty() ? vertexPath : fragmentPath) << std::endl;
+		uint64_t contentKey = keyFor(AssetType::Shader, hashString(fragmentCode, hashString(vertexCode)));
+		existing = findCached(0, contentKey);
+		if (existing >= 0) return acquire<AssetType::Shader>(existing, pathKey);
+
+		ShaderAsset shader;
+		{
+			MemTagScope driver(MemTag::General);
+			// from the source already read for the content key, not from the files again
+			shader.program = Shader::fromSource(vertexCode, fragmentCode);
+		}
+		uint32_t slot = shaders.insert(std::move(shader));
+		// drivers don't report program sizes in 3.3, so the source size stands in as an estimate
+		size_t gpuBytes = vertexCode.size() + fragmentCode.size();
+		return createRecord<AssetType::Shader>(slot, vertexPath + " + " + fragmentPath, pathKey, contentKey, gpuBytes, 0, loadStartNs);
+	}
+
+	// --- reference counting -----------------------------------------------------------
+	template<AssetType Type>
+	void retain(AssetHandle<Type> handle) {
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetRecord* record = recordFor(Type, handle.index, handle.generation);
+		if (record) {
+			record->refCount++;
+			record->lastUsed = ++tick;
+		}
+	}
+
+	template<AssetType Type>
+	void release(AssetHandle<Type> handle) {
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetRecord* record = recordFor(Type, handle.index, handle.generation);
+		if (record && record->refCount > 0) {
+			record->refCount--;
+			record->lastUsed = ++tick;
+			if (record->refCount == 0) evictionWake.notify_one();
+		}
+	}
+
+	// --- access -----------------------------------------------------------------------
+	// Returned pointers are valid until the next load of the same asset type.
+	const MeshAsset* getMesh(MeshHandle handle) const {
+		int slot = slotFor(AssetType::Mesh, handle.index, handle.generation);
+		return slot >= 0 ? &meshes.items[slot] : nullptr;
+	}
+	const TextureAsset* getTexture(TextureHandle handle) const {
+		int slot = slotFor(AssetType::Texture, handle.index, handle.generation);
+		return slot >= 0 ? &textures.items[slot] : nullptr;
+	}
+	Shader* getShader(ShaderHandle handle) const {
+		int slot = slotFor(AssetType::Shader, handle.index, handle.generation);
+		return slot >= 0 ? shaders.items[slot].program.get() : nullptr;
+	}
+
+	// --- budget and eviction ----------------------------------------------------------
+	void setMemoryBudget(size_t bytes) {
+		budgetBytes = bytes;
+		evictionWake.notify_one();
+	}
+	size_t getMemoryBudget() const { return budgetBytes; }
+
+	size_t gpuBytes(AssetType type) const { return stats[static_cast<int>(type)].gpuBytes; }
+	size_t cpuBytes(AssetType type) const { return stats[static_cast<int>(type)].cpuBytes; }
+	int liveCount(AssetType type) const { return stats[static_cast<int>(type)].count; }
+
+	size_t totalBytes() const {
+		size_t total = 0;
+		for (const TypeStats& s : stats) total += s.gpuBytes + s.cpuBytes;
+		return total;
+	}
+
+	// Destroys the assets the background thread picked for eviction. Call once per frame.
+	void update() {
+		std::vector<uint32_t> victims;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			victims.swap(pendingEvictions);
+		}
+		for (uint32_t recordIndex : victims) {
+			std::lock_guard<std::mutex> lock(mutex);
+			AssetRecord& record = records[recordIndex];
+			// the asset may have been picked up again since it was selected
+			if (!record.alive || record.refCount > 0) continue;
+			destroy(recordIndex);
+		}
+	}
+
+	// Frees every asset regardless of reference count. Must run before the GL context goes away.
+	void shutdown() {
+		stopEvictionThread();
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < records.size(); i++) {
+			if (records[i].alive) destroy(i);
+		}
+		// give the bookkeeping back too, so the leak report only shows real leaks
+		meshes = Pool<MeshAsset>();
+		textures = Pool<TextureAsset>();
+		shaders = Pool<ShaderAsset>();
+		records = std::vector<AssetRecord>();
+		freeRecords = std::vector<uint32_t>();
+		pendingEvictions = std::vector<uint32_t>();
+		byKey = std::unordered_map<uint64_t, uint32_t>();
+	}
+
+	void drawImGuiPanel() {
+		ImGui::Begin("Assets");
+		float budgetMB = budgetBytes / (1024.0f * 1024.0f);
+		if (ImGui::SliderFloat("Budget (MB)", &budgetMB, 1.0f, 4096.0f, "%.0f"))
+			setMemoryBudget(static_cast<size_t>(budgetMB * 1024.0f * 1024.0f));
+		ImGui::ProgressBar(budgetBytes ? (float)totalBytes() / budgetBytes : 0.0f);
+
+		if (ImGui::BeginTable("assetMemory", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Type");
+			ImGui::TableSetupColumn("Live");
+			ImGui::TableSetupColumn("GPU (KB)");
+			ImGui::TableSetupColumn("CPU (KB)");
+			ImGui::TableHeadersRow();
+			for (int t = 0; t < static_cast<int>(AssetType::Count); t++) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", assetTypeNames[t]);
+				ImGui::TableNextColumn(); ImGui::Text("%d", (int)stats[t].count);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", stats[t].gpuBytes / 1024.0f);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", stats[t].cpuBytes / 1024.0f);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+
+private:
+	struct AssetRecord {
+		AssetType type = AssetType::Mesh;
+		uint32_t slot = 0;        // index into the typed pool
+		uint32_t generation = 1;  // bumped every time the record is freed
+		bool alive = false;
+		uint32_t refCount = 0;
+		uint64_t lastUsed = 0;
+		uint64_t pathKey = 0;
+		uint64_t contentKey = 0;
+		size_t gpuBytes = 0;
+		size_t cpuBytes = 0;
+		std::string name;
+	};
+
+	struct TypeStats {
+		std::atomic<size_t> gpuBytes{ 0 };
+		std::atomic<size_t> cpuBytes{ 0 };
+		std::atomic<int> count{ 0 };
+	};
+
+	// Dense storage for one asset type with slot reuse
+	template<typename T>
+	struct Pool {
+		std::vector<T> items;
+		std::vector<uint32_t> freeSlots;
+
+		uint32_t insert(T&& item) {
+			if (!freeSlots.empty()) {
+				uint32_t slot = freeSlots.back();
+				freeSlots.pop_back();
+				items[slot] = std::move(item);
+				return slot;
+			}
+			items.push_back(std::move(item));
+			return static_cast<uint32_t>(items.size() - 1);
+		}
+		void erase(uint32_t slot) {
+			items[slot] = T();
+			freeSlots.push_back(slot);
+		}
+	};
+
+	Pool<MeshAsset> meshes;
+	Pool<TextureAsset> textures;
+	Pool<ShaderAsset> shaders;
+
+	// handle.index refers to a record; the record points at the typed slot
+	std::vector<AssetRecord> records;
+	std::vector<uint32_t> freeRecords;
+	std::unordered_map<uint64_t, uint32_t> byKey; // path and content keys -> record index
+	TypeStats stats[static_cast<int>(AssetType::Count)];
+
+	mutable std::mutex mutex;
+	std::condition_variable evictionWake;
+	std::vector<uint32_t> pendingEvictions;
+	std::thread evictionThread;
+	std::atomic<bool> running{ false };
+	std::atomic<size_t> budgetBytes{ 256ull * 1024 * 1024 };
+	uint64_t tick = 0;
+
+	AssetManager() {
+		running = true;
+		evictionThread = std::thread([this] { evictionLoop(); });
+	}
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	static uint64_t keyFor(AssetType type, uint64_t hash) {
+		return hash ^ (static_cast<uint64_t>(type) + 1) * 0x9E3779B97F4A7C15ull;
+	}
+
+	static std::string readFile(const std::string& path) {
+		return VirtualFileSystem::get().readText(path);
+	}
+
+	// Returns the record index of a cached asset matching either key, or -1
+	int findCached(uint64_t pathKey, uint64_t contentKey) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = pathKey ? byKey.find(pathKey) : byKey.end();
+		if (it == byKey.end() && contentKey) it = byKey.find(contentKey);
+		if (it == byKey.end()) return -1;
+		return static_cast<int>(it->second);
+	}
+
+	template<AssetType Type>
+	AssetHandle<Type> acquire(int recordIndex, uint64_t pathKey) {
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetRecord& record = records[recordIndex];
+		record.refCount++;
+		record.lastUsed = ++tick;
+		// remember the alias so the next load by this path skips the content hash
+		if (pathKey) byKey[pathKey] = static_cast<uint32_t>(recordIndex);
+		return AssetHandle<Type>{ static_cast<uint32_t>(recordIndex), record.generation };
+	}
+
+	template<AssetType Type>
+	AssetHandle<Type> createRecord(uint32_t slot, const std::string& name, uint64_t pathKey, uint64_t contentKey, size_t gpuBytes, size_t cpuBytes, uint64_t loadStartNs) {
+		Profiler::get().annotate("asset", assetTypeNames[static_cast<int>(Type)], name.c_str(), loadStartNs, profilerNowNs());
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t recordIndex;
+		if (!freeRecords.empty()) {
+			recordIndex = freeRecords.back();
+			freeRecords.pop_back();
+		}
+		else {
+			recordIndex = static_cast<uint32_t>(records.size());
+			records.emplace_back();
+		}
+		AssetRecord& record = records[recordIndex];
+		record.type = Type;
+		record.slot = slot;
+		record.alive = true;
+		record.refCount = 1;
+		record.lastUsed = ++tick;
+		record.pathKey = pathKey;
+		record.contentKey = contentKey;
+		record.gpuBytes = gpuBytes;
+		record.cpuBytes = cpuBytes;
+		record.name = name;
+		if (pathKey) byKey[pathKey] = recordIndex;
+		if (contentKey) byKey[contentKey] = recordIndex;
+
+		TypeStats& s = stats[static_cast<int>(Type)];
+		s.gpuBytes += gpuBytes;
+		s.cpuBytes += cpuBytes;
+		s.count++;
+		evictionWake.notify_one();
+		return AssetHandle<Type>{ recordIndex, record.generation };
+	}
+
+	AssetRecord* recordFor(AssetType type, uint32_t index, uint32_t generation) {
+		if (index >= records.size()) return nullptr;
+		AssetRecord& record = records[index];
+		if (!record.alive || record.generation != generation || record.type != type) return nullptr;
+		return &record;
+	}
+
+	int slotFor(AssetType type, uint32_t index, uint32_t generation) const {
+		if (index >= records.size()) return -1;
+		const AssetRecord& record = records[index];
+		if (!record.alive || record.generation != generation || record.type != type) return -1;
+		return static_cast<int>(record.slot);
+	}
+
+	// Frees the GL/CPU data behind a record. Caller holds the mutex.
+	void destroy(uint32_t recordIndex) {
+		AssetRecord& record = records[recordIndex];
+		switch (record.type) {
+		case AssetType::Mesh: {
+			MeshAsset& mesh = meshes.items[record.slot];
+			glDeleteVertexArrays(1, &mesh.VAO);
+			glDeleteBuffers(1, &mesh.VBO);
+			meshes.erase(record.slot);
+			break;
+		}
+		case AssetType::Texture:
+			glDeleteTextures(1, &textures.items[record.slot].ID);
+			textures.erase(record.slot);
+			break;
+		case AssetType::Shader:
+			glDeleteProgram(shaders.items[record.slot].program->ID);
+			shaders.erase(record.slot);
+			break;
+		default:
+			break;
+		}
+
+		TypeStats& s = stats[static_cast<int>(record.type)];
+		s.gpuBytes -= record.gpuBytes;
+		s.cpuBytes -= record.cpuBytes;
+		s.count--;
+
+		// drops the path and content keys along with any aliases added by acquire()
+		for (auto it = byKey.begin(); it != byKey.end();) {
+			if (it->second == recordIndex) it = byKey.erase(it);
+			else ++it;
+		}
+
+		uint32_t nextGeneration = record.generation + 1;
+		record = AssetRecord();
+		record.generation = nextGeneration ? nextGeneration : 1;
+		freeRecords.push_back(recordIndex);
+	}
+
+	void evictionLoop() {
+		MemoryTracker::threadTag() = MemTag::Assets;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (running) {
+			evictionWake.wait_for(lock, std::chrono::milliseconds(250));
+			if (!running) break;
+
+			size_t total = totalBytes();
+			if (total <= budgetBytes) continue;
+
+			// least recently used first among assets nobody is holding
+			std::vector<uint32_t> candidates;
+			for (uint32_t i = 0; i < records.size(); i++) {
+				const AssetRecord& record = records[i];
+				if (record.alive && record.refCount == 0 &&
+					std::find(pendingEvictions.begin(), pendingEvictions.end(), i) == pendingEvictions.end())
+					candidates.push_back(i);
+			}
+			std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+				return records[a].lastUsed < records[b].lastUsed;
+			});
+			for (uint32_t i : candidates) {
+				if (total <= budgetBytes) break;
+				total -= records[i].gpuBytes + records[i].cpuBytes;
+				pendingEvictions.push_back(i);
+			}
+		}
+	}
+
+	void stopEvictionThread() {
+		if (!running.exchange(false)) return;
+		evictionWake.notify_one();
+		if (evictionThread.joinable()) evictionThread.join();
+	}
+};
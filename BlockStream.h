@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef ENGINE_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef ENGINE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "JobSystem.h"
+
+// Container for large payloads (scenes, meshes, archives) split into independently
+// compressed blocks, so a loader can hand each block to a worker as soon as it has been read.
+//
+//   Header | BlockEntry[blockCount] | block data...
+namespace blockstream {
+	static const uint32_t Magic = 0x314B4C42; // "BLK1"
+	static const uint32_t Version = 1;
+	static const size_t DefaultBlockSize = 256 * 1024;
+
+	enum class Codec : uint32_t { Raw = 0, LZ4 = 1, Zstd = 2 };
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		Codec codec;
+		uint32_t blockSize;  // uncompressed bytes per block, the last block may be shorter
+		uint64_t rawSize;
+		uint64_t blockCount;
+	};
+
+	struct BlockEntry {
+		uint64_t offset;     // from the start of the file
+		uint32_t storedSize;
+		uint32_t rawSize;
+	};
+
+	inline const char* codecName(Codec codec) {
+		switch (codec) {
+		case Codec::Raw: return "raw";
+		case Codec::LZ4: return "lz4";
+		case Codec::Zstd: return "zstd";
+		}
+		return "unknown";
+	}
+
+	inline bool codecAvailable(Codec codec) {
+		switch (codec) {
+		case Codec::Raw: return true;
+#ifdef ENGINE_HAVE_LZ4
+		case Codec::LZ4: return true;
+#endif
+#ifdef ENGINE_HAVE_ZSTD
+		case Codec::Zstd: return true;
+#endif
+		default: return false;
+		}
+	}
+
+	// Compresses one block into out. Falls back to a raw copy (storedSize == rawSize) when
+	// the codec can't shrink it, which the reader detects by comparing the two sizes.
+	inline void compressBlock(Codec codec, const char* src, size_t size, std::vector<char>& out, int level) {
+		switch (codec) {
+#ifdef ENGINE_HAVE_LZ4
+		case Codec::LZ4: {
+			out.resize(LZ4_compressBound(static_cast<int>(size)));
+			int written = LZ4_compress_default(src, out.data(), static_cast<int>(size), static_cast<int>(out.size()));
+			if (written > 0 && static_cast<size_t>(written) < size) {
+				out.resize(written);
+				return;
+			}
+			break;
+		}
+#endif
+#ifdef ENGINE_HAVE_ZSTD
+		case Codec::Zstd: {
+			out.resize(ZSTD_compressBound(size));
+			size_t written = ZSTD_compress(out.data(), out.size(), src, size, level);
+			if (!ZSTD_isError(written) && written < size) {
+				out.resize(written);
+				return;
+			}
+			break;
+		}
+#endif
+		default:
+			break;
+		}
+		(void)level;
+		out.assign(src, src + size);
+	}
+
+	inline bool decompressBlock(Codec codec, const char* src, size_t storedSize, char* dst, size_t rawSize) {
+		if (storedSize == rawSize) {
+			std::memcpy(dst, src, rawSize);
+			return true;
+		}
+		switch (codec) {
+#ifdef ENGINE_HAVE_LZ4
+		case Codec::LZ4:
+			return LZ4_decompress_safe(src, dst, static_cast<int>(storedSize), static_cast<int>(rawSize)) == static_cast<int>(rawSize);
+#endif
+#ifdef ENGINE_HAVE_ZSTD
+		case Codec::Zstd:
+			return ZSTD_decompress(dst, rawSize, src, storedSize) == rawSize;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	// Compresses data block by block on the job system and writes the container in one pass.
+	inline bool write(const std::string& path, const void* data, size_t size, Codec codec,
+		size_t blockSize = DefaultBlockSize, int level = 3, JobSystem& jobs = JobSystem::get()) {
+		if (!codecAvailable(codec)) {
+			std::cout << "ERROR::BLOCKSTREAM::CODEC_NOT_AVAILABLE: " << codecName(codec) << std::endl;
+			return false;
+		}
+		const char* bytes = static_cast<const char*>(data);
+		size_t blockCount = (size + blockSize - 1) / blockSize;
+		std::vector<std::vector<char>> blocks(blockCount);
+		jobs.parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				size_t offset = i * blockSize;
+				compressBlock(codec, bytes + offset, std::min(blockSize, size - offset), blocks[i], level);
+			}
+		});
+
+		Header header = {};
+		header.magic = Magic;
+		header.version = Version;
+		header.codec = codec;
+		header.blockSize = static_cast<uint32_t>(blockSize);
+		header.rawSize = size;
+		header.blockCount = blockCount;
+
+		std::vector<BlockEntry> table(blockCount);
+		uint64_t offset = sizeof(Header) + blockCount * sizeof(BlockEntry);
+		for (size_t i = 0; i < blockCount; i++) {
+			table[i].offset = offset;
+			table[i].storedSize = static_cast<uint32_t>(blocks[i].size());
+			table[i].rawSize = static_cast<uint32_t>(std::min(blockSize, size - i * blockSize));
+			offset += blocks[i].size();
+		}
+
+		std::ofstream out(path, std::ios::binary);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(BlockEntry));
+		for (const std::vector<char>& block : blocks) out.write(block.data(), block.size());
+		return out.good();
+	}
+
+	// A header read() can trust: the block count is the one rawSize and blockSize give, and
+	// the block table fits in the file
+	inline bool validHeader(const Header& header, uint64_t fileSize) {
+		if (header.magic != Magic || header.version != Version || header.blockSize == 0) return false;
+		uint64_t blockCount = header.rawSize / header.blockSize + (header.rawSize % header.blockSize != 0);
+		return header.blockCount == blockCount && blockCount <= (fileSize - sizeof(Header)) / sizeof(BlockEntry);
+	}
+
+	// Each block has the size write() gives it, the blocks fit in the file, and none is
+	// stored bigger than it is raw: write() keeps a block raw when the codec can't shrink it,
+	// which is a tighter cap than the codecs' compress bounds
+	inline bool validTable(const Header& header, const std::vector<BlockEntry>& table, uint64_t fileSize) {
+		uint64_t stored = sizeof(Header) + table.size() * sizeof(BlockEntry);
+		for (size_t i = 0; i < table.size(); i++) {
+			const BlockEntry& block = table[i];
+			uint64_t rawSize = std::min<uint64_t>(header.blockSize, header.rawSize - i * header.blockSize);
+			if (block.rawSize != rawSize || block.storedSize > block.rawSize || block.storedSize == 0) return false;
+			if (header.codec == Codec::Raw && block.storedSize != block.rawSize) return false;
+			stored += block.storedSize;
+			if (stored > fileSize) return false;
+		}
+		return true;
+	}
+
+	// Streams the container front to back on the calling thread and decompresses each block
+	// on a worker as soon as it has been read, so I/O on block N+1 overlaps decode of block N.
+	// Raw blocks are read straight into the destination. The header and block table are
+	// checked before anything is allocated from them or written through them.
+	inline bool read(const std::string& path, std::vector<char>& out, JobSystem& jobs = JobSystem::get()) {
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in) return false;
+		uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+		in.seekg(0);
+		Header header;
+		in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!in || !validHeader(header, fileSize)) {
+			std::cout << "ERROR::BLOCKSTREAM::INVALID_FILE: " << path << std::endl;
+			return false;
+		}
+		std::vector<BlockEntry> table(static_cast<size_t>(header.blockCount));
+		in.read(reinterpret_cast<char*>(table.data()), table.size() * sizeof(BlockEntry));
+		if (!in || !validTable(header, table, fileSize)) {
+			std::cout << "ERROR::BLOCKSTREAM::INVALID_FILE: " << path << std::endl;
+			return false;
+		}
+		out.resize(static_cast<size_t>(header.rawSize));
+
+		std::vector<std::unique_ptr<char[]>> staging(table.size());
+		std::atomic<bool> ok{ true };
+		JobCounter counter;
+		for (size_t i = 0; i < table.size() && in; i++) {
+			const BlockEntry& block = table[i];
+			char* dst = out.data() + i * header.blockSize;
+			if (block.storedSize == block.rawSize) {
+				in.read(dst, block.rawSize);
+				continue;
+			}
+			staging[i].reset(new char[block.storedSize]);
+			in.read(staging[i].get(), block.storedSize);
+			char* src = staging[i].get();
+			jobs.submit([&ok, &staging, i, src, dst, block, codec = header.codec] {
+				if (!decompressBlock(codec, src, block.storedSize, dst, block.rawSize)) ok = false;
+				staging[i].reset(); // drop the compressed copy as soon as it's decoded
+			}, &counter);
+		}
+		jobs.wait(counter);
+		if (!in) ok = false;
+		if (!ok) std::cout << "ERROR::BLOCKSTREAM::CORRUPT_FILE: " << path << std::endl;
+		return ok;
+	}
+}
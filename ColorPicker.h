@@ -11,6 +11,11 @@
 #include "Scene.h"
 #include "Objects.h"
 #include "constants.h"
+#include "Frustum.h"
+#include "GpuProfiler.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ReverseZ.h"
 
 // settings
 const unsigned int width = 800; 
@@ -23,6 +28,8 @@ public:
 	}
 
 	void renderPickingPass() {
+		PROFILE_SCOPE("ColorPicker::renderPickingPass");
+		GPU_PROFILE_SCOPE("GPU picking");
 		glBindFramebuffer(GL_FRAMEBUFFER, pickingFBO);
 		glViewport(0, 0, width, height);
 		glClearColor(0, 0, 0, 1);
@@ -30,22 +37,31 @@ public:
 
 		shader.use();
 
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
+		glm::mat4 projection = ReverseZ::get().perspective(glm::radians(camera.Zoom), (float)width / (float)height);
 		glm::mat4 view = camera.GetViewMatrix();
 		shader.setMat4("projection", projection);
 		shader.setMat4("view", view);
 
-		for (auto* obj : scene.getObjs()) {
-			int id = obj->ID;
-			// We encode an RGB color based on the object's ID
-			glm::vec3 color = glm::vec3(
-				((id >> 16) & 0xFF) / 255.0f,
-				((id >> 8) & 0xFF) / 255.0f,
-				(id & 0xFF) / 255.0f
-			);
-			
-			obj->backDraw(shader, color);
-		}
+		// off-screen objects can't be under the cursor
+		scene.updateTransforms();
+		const SceneGraph& graph = scene.getGraph();
+		Frustum frustum = Frustum::fromMatrix(projection * view);
+		scene.getWorld().forEachChunk<const HierarchyNode, const PickID, const RenderMesh, const Selection>(
+			[&](const Entity*, size_t count, const HierarchyNode* nodes, const PickID* ids, const RenderMesh* meshes, const Selection* selection) {
+				for (size_t i = 0; i < count; i++) {
+					const glm::mat4* model = graph.world(nodes[i].node);
+					if (!model || !frustum.intersectsSphere(glm::vec3((*model)[3]), boundingRadius(*model))) continue;
+					int id = static_cast<int>(ids[i].id);
+					// We encode an RGB color based on the object's ID
+					glm::vec3 color = glm::vec3(
+						((id >> 16) & 0xFF) / 255.0f,
+						((id >> 8) & 0xFF) / 255.0f,
+						(id & 0xFF) / 255.0f
+					);
+
+					backDraw(*model, color, meshes[i], selection[i].selected);
+				}
+			});
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
@@ -66,6 +82,10 @@ public:
 		return pickedID;
 	}
 
+	// PickID is the entity's table slot + 1; the 24-bit color has no room for the generation,
+	// so it is looked up again here. Null if the slot has been emptied.
+	Entity objectForID(int id) const { return id > 0 ? scene.getWorld().entityAt(static_cast<uint32_t>(id - 1)) : Entity(); }
+
 private:
 	static GLuint pickingFBO, pickingTexture, pickingDepth;
 	static bool initialized;
@@ -73,6 +93,52 @@ private:
 	Shader& shader;
 	Camera& camera;
 
+	// the object in its ID color, plus the outline and gizmo axes in theirs when selected
+	void backDraw(const glm::mat4& model, const glm::vec3& color, const RenderMesh& meshes, bool selected) {
+		AssetManager& assets = AssetManager::get();
+		RenderStats& stats = RenderStats::frame();
+		shader.setMat4("model", model);
+		shader.setVec3("pickingColor", color);
+
+		const MeshAsset* fill = assets.getMesh(meshes.fill);
+		glBindVertexArray(fill->VAO);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glDrawArrays(fill->primitive, 0, fill->vertexCount);
+		glBindVertexArray(0);
+		stats.drawCalls++;
+		stats.triangles += fill->vertexCount / 3;
+
+		if (selected) {
+			shader.setVec3("pickingColor", glm::vec3(0.47f, 0.87f, 0.9f));
+			glLineWidth(4.0f);
+
+			const MeshAsset* edges = assets.getMesh(meshes.edges);
+			glBindVertexArray(edges->VAO);
+			glDrawArrays(edges->primitive, 0, edges->vertexCount);
+			glBindVertexArray(0);
+			stats.drawCalls++;
+
+			// draw transform lines
+			glLineWidth(20.0f);
+			glBindVertexArray(assets.getMesh(meshes.gizmo)->VAO);
+
+			// Set color red for X axis lines
+			shader.setVec3("pickingColor", glm::vec3(1.0f, 0.0f, 0.0f));
+			glDrawArrays(GL_LINES, 0, 4);
+
+			// Set color green for Y axis lines
+			shader.setVec3("pickingColor", glm::vec3(0.0f, 1.0f, 0.0f));
+			glDrawArrays(GL_LINES, 4, 4);
+
+			// Set color blue for Z axis lines
+			shader.setVec3("pickingColor", glm::vec3(0.0f, 0.0f, 1.0f));
+			glDrawArrays(GL_LINES, 8, 4);
+
+			glBindVertexArray(0);
+			stats.drawCalls += 3;
+		}
+	}
+
 	static void initSharedBuffers() {
 		if (initialized) return;
 
@@ -88,7 +154,8 @@ private:
 
 		glGenRenderbuffers(1, &pickingDepth);
 		glBindRenderbuffer(GL_RENDERBUFFER, pickingDepth);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		// the same float depth as the main pass, so objects sort the same under the cursor
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pickingDepth);
 
 		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "ObjectPool.h"
+
+// Archetype entity-component-system. An entity is a generational handle; its components
+// are plain structs stored with every other entity that has exactly the same set of
+// component types (its archetype). Each archetype keeps its rows in 16 KB chunks holding
+// one column per component, so a system that needs a Transform and a Visibility walks two
+// flat arrays per chunk instead of chasing a pointer and a vtable per object.
+//
+// Rows are kept dense: destroying an entity moves the archetype's last row into the hole.
+// Components are moved with memcpy and must be trivially copyable. Chunk and entity table
+// memory is charged to MemTag::Scene.
+
+struct EntityLocation {
+	uint32_t archetype;
+	uint32_t row; // across the archetype's chunks; all chunks are full except the last
+};
+
+using Entity = PoolHandle<EntityLocation>;
+using ComponentMask = uint64_t;
+
+static const uint32_t MaxComponentTypes = 64;
+
+struct ComponentInfo {
+	uint32_t size;
+	uint32_t alignment;
+};
+
+// Component type ids, handed out on first use
+class ComponentTypes {
+public:
+	template<typename T>
+	static uint32_t id() {
+		static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+		static const uint32_t value = add(ComponentInfo{ sizeof(T), alignof(T) });
+		return value;
+	}
+
+	template<typename T>
+	static ComponentMask bit() { return ComponentMask(1) << id<T>(); }
+
+	static const ComponentInfo& info(uint32_t id) { return table()[id]; }
+
+private:
+	static ComponentInfo* table() {
+		static ComponentInfo infos[MaxComponentTypes];
+		return infos;
+	}
+
+	static uint32_t add(ComponentInfo info) {
+		static std::atomic<uint32_t> count{ 0 };
+		uint32_t id = count.fetch_add(1);
+		if (id >= MaxComponentTypes) {
+			std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES: " << MaxComponentTypes << std::endl;
+			std::abort();
+		}
+		table()[id] = info;
+		return id;
+	}
+};
+
+template<typename... Cs>
+ComponentMask componentMask() { return (ComponentMask(0) | ... | ComponentTypes::bit<std::remove_const_t<Cs>>()); }
+
+class Archetype {
+public:
+	static const size_t ChunkBytes = 16 * 1024;
+
+	ComponentMask mask = 0;
+	uint32_t capacity = 0; // rows per chunk
+	uint32_t count = 0;
+	TaggedVector<char*, MemTag::Scene> chunks;
+
+	explicit Archetype(ComponentMask mask) : mask(mask) {
+		// the largest row count whose columns, each aligned, still fit in a chunk
+		size_t rowBytes = sizeof(Entity);
+		forEachComponent([&](uint32_t id) { rowBytes += ComponentTypes::info(id).size; });
+		capacity = std::max<uint32_t>(1, static_cast<uint32_t>(ChunkBytes / rowBytes));
+		while (capacity > 1 && layout(capacity) > ChunkBytes) capacity--;
+		layout(capacity);
+	}
+
+	~Archetype() { release(); }
+	Archetype(const Archetype&) = delete;
+	Archetype& operator=(const Archetype&) = delete;
+
+	Entity* entities(size_t chunk) const { return reinterpret_cast<Entity*>(chunks[chunk]); }
+
+	template<typename T>
+	T* column(size_t chunk) const { return reinterpret_cast<T*>(chunks[chunk] + offsets[ComponentTypes::id<std::remove_const_t<T>>()]); }
+
+	uint32_t rowsIn(size_t chunk) const { return std::min<uint32_t>(capacity, count - static_cast<uint32_t>(chunk) * capacity); }
+	size_t chunksInUse() const { return (count + capacity - 1) / capacity; }
+
+	char* component(uint32_t id, uint32_t row) const {
+		return chunks[row / capacity] + offsets[id] + static_cast<size_t>(row % capacity) * ComponentTypes::info(id).size;
+	}
+	Entity& entity(uint32_t row) const { return entities(row / capacity)[row % capacity]; }
+
+	// Appends an uninitialized row
+	uint32_t addRow() {
+		if (count == chunks.size() * capacity) {
+			void* memory = MemoryTracker::allocate(ChunkBytes, MemTag::Scene, 64);
+			if (!memory) throw std::bad_alloc();
+			chunks.push_back(static_cast<char*>(memory));
+		}
+		return count++;
+	}
+
+	// Moves the last row into row and drops the last; returns the entity that moved, or a
+	// null handle when row was the last
+	Entity removeRow(uint32_t row) {
+		uint32_t last = count - 1;
+		Entity moved;
+		if (row != last) {
+			forEachComponent([&](uint32_t id) { std::memcpy(component(id, row), component(id, last), ComponentTypes::info(id).size); });
+			moved = entity(last);
+			entity(row) = moved;
+		}
+		count--;
+		return moved;
+	}
+
+	void release() {
+		for (char* chunk : chunks) MemoryTracker::release(chunk);
+		chunks = decltype(chunks)();
+		count = 0;
+	}
+
+	template<typename Fn>
+	void forEachComponent(Fn&& fn) const {
+		for (ComponentMask bits = mask; bits; bits &= bits - 1) {
+			fn(static_cast<uint32_t>(countTrailingZeros(bits)));
+		}
+	}
+
+private:
+	uint32_t offsets[MaxComponentTypes] = {};
+
+	static int countTrailingZeros(ComponentMask bits) {
+		int n = 0;
+		while (!(bits & 1)) {
+			bits >>= 1;
+			n++;
+		}
+		return n;
+	}
+
+	// Lays the columns out for rows per chunk and returns the bytes used
+	size_t layout(uint32_t rows) {
+		size_t offset = sizeof(Entity) * rows;
+		forEachComponent([&](uint32_t id) {
+			const ComponentInfo& info = ComponentTypes::info(id);
+			offset = (offset + info.alignment - 1) / info.alignment * info.alignment;
+			offsets[id] = static_cast<uint32_t>(offset);
+			offset += static_cast<size_t>(info.size) * rows;
+		});
+		return offset;
+	}
+};
+
+class World {
+public:
+	World() = default;
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+	~World() { clear(); }
+
+	template<typename... Cs>
+	Entity create(const Cs&... components) {
+		uint32_t index = archetypeFor(componentMask<Cs...>());
+		Archetype& archetype = *archetypes[index];
+		uint32_t row = archetype.addRow();
+		Entity entity = entities.create(EntityLocation{ index, row });
+		if (!entity.valid()) {
+			archetype.count--;
+			return entity;
+		}
+		archetype.entity(row) = entity;
+		(std::memcpy(archetype.component(ComponentTypes::id<Cs>(), row), &components, sizeof(Cs)), ...);
+		return entity;
+	}
+
+	// Returns false for a stale or null handle
+	bool destroy(Entity entity) {
+		EntityLocation* location = entities.get(entity);
+		if (!location) return false;
+		Archetype& archetype = *archetypes[location->archetype];
+		Entity moved = archetype.removeRow(location->row);
+		if (moved.valid()) entities.get(moved)->row = location->row;
+		entities.destroy(entity);
+		return true;
+	}
+
+	bool alive(Entity entity) const { return entities.contains(entity); }
+
+	// nullptr if the entity is gone or has no T
+	template<typename T>
+	T* get(Entity entity) const {
+		const EntityLocation* location = entities.get(entity);
+		if (!location) return nullptr;
+		const Archetype& archetype = *archetypes[location->archetype];
+		uint32_t id = ComponentTypes::id<std::remove_const_t<T>>();
+		if (!(archetype.mask & (ComponentMask(1) << id))) return nullptr;
+		return reinterpret_cast<T*>(archetype.component(id, location->row));
+	}
+
+	// Current handle of entity table slot index, or null; for ids that only carry the index
+	Entity entityAt(uint32_t index) const { return entities.handleAt(index); }
+
+	size_t size() const { return entities.size(); }
+
+	// fn(const Entity*, size_t count, Cs*...) for every chunk of every archetype with all of Cs
+	template<typename... Cs, typename Fn>
+	void forEachChunk(Fn&& fn) const {
+		ComponentMask required = componentMask<Cs...>();
+		for (const auto& archetype : archetypes) {
+			if ((archetype->mask & required) != required) continue;
+			for (size_t c = 0; c < archetype->chunksInUse(); c++) {
+				fn(static_cast<const Entity*>(archetype->entities(c)), static_cast<size_t>(archetype->rowsIn(c)), archetype->template column<Cs>(c)...);
+			}
+		}
+	}
+
+	// fn(Entity, Cs&...) for every entity with all of Cs
+	template<typename... Cs, typename Fn>
+	void each(Fn&& fn) const {
+		forEachChunk<Cs...>([&](const Entity* ids, size_t count, Cs*... columns) {
+			for (size_t i = 0; i < count; i++) fn(ids[i], columns[i]...);
+		});
+	}
+
+	// Number of chunks forEachChunk<Cs...> visits
+	template<typename... Cs>
+	size_t chunkCount() const {
+		ComponentMask required = componentMask<Cs...>();
+		size_t total = 0;
+		for (const auto& archetype : archetypes) {
+			if ((archetype->mask & required) == required) total += archetype->chunksInUse();
+		}
+		return total;
+	}
+
+	// forEachChunk spread over the job system; returns once every chunk is done.
+	// fn(size_t chunkIndex, const Entity*, size_t count, Cs*...), where chunkIndex counts
+	// from 0 to chunkCount<Cs...>() so jobs can write per-chunk results without locking.
+	// Chunks are processed concurrently: fn may only write to its own chunk's rows.
+	template<typename... Cs, typename Fn>
+	void parallelForEachChunk(JobSystem& jobs, Fn&& fn) const {
+		struct ChunkRef {
+			const Archetype* archetype;
+			uint32_t chunk;
+		};
+		FrameVector<ChunkRef> refs;
+		refs.reserve(chunkCount<Cs...>());
+		ComponentMask required = componentMask<Cs...>();
+		for (const auto& archetype : archetypes) {
+			if ((archetype->mask & required) != required) continue;
+			for (size_t c = 0; c < archetype->chunksInUse(); c++) refs.push_back(ChunkRef{ archetype.get(), static_cast<uint32_t>(c) });
+		}
+		// a few batches per thread so an uneven chunk doesn't leave the others idle
+		size_t batch = std::max<size_t>(1, refs.size() / (4 * (jobs.workerCount() + 1)));
+		jobs.parallelFor(refs.size(), batch, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				const Archetype& archetype = *refs[i].archetype;
+				uint32_t c = refs[i].chunk;
+				fn(i, static_cast<const Entity*>(archetype.entities(c)), static_cast<size_t>(archetype.rowsIn(c)), archetype.template column<Cs>(c)...);
+			}
+		});
+	}
+
+	// Destroys every entity and frees all storage. Generations start over, so handles from
+	// before can alias new entities; only call it when none are kept.
+	void clear() {
+		archetypes = decltype(archetypes)();
+		entities.clear();
+		entities.shrink();
+	}
+
+private:
+	TaggedVector<std::unique_ptr<Archetype>, MemTag::Scene> archetypes;
+	ObjectPool<EntityLocation, MemTag::Scene> entities;
+
+	uint32_t archetypeFor(ComponentMask mask) {
+		for (size_t i = 0; i < archetypes.size(); i++) {
+			if (archetypes[i]->mask == mask) return static_cast<uint32_t>(i);
+		}
+		MemTagScope memTag(MemTag::Scene);
+		archetypes.push_back(std::make_unique<Archetype>(mask));
+		return static_cast<uint32_t>(archetypes.size() - 1);
+	}
+};
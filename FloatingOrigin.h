@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#define ENGINE_ORIGIN_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_ORIGIN_SSE 1
+#include <emmintrin.h>
+#endif
+
+// A float holds 24 bits, so 10,000 km from the origin it is good to a meter, and a scene
+// placed there jitters by that much. Scene keeps every root object's position in double
+// precision and everything else it works in - transforms, the scene graph, the octree,
+// broadphase, physics and the camera - in floats relative to a floating origin, which it
+// moves to the camera whenever the camera strays far enough for floats to start losing
+// millimeters. Moving it converts every double position to a float relative to the new
+// origin afresh, so no error builds up however often it moves.
+//
+// toRelative() does that conversion for a whole array: 4 positions per step with AVX, 2
+// with SSE2, scalar otherwise, all with the same results, since each subtraction is exact
+// in double and the one rounding to float is the same everywhere.
+namespace floatingorigin {
+	inline void toRelativeScalar(const glm::dvec3* absolute, size_t count, const glm::dvec3& origin, glm::vec3* out) {
+		for (size_t i = 0; i < count; i++) out[i] = glm::vec3(absolute[i] - origin);
+	}
+
+	// out[i] = absolute[i] - origin, rounded to float
+	inline void toRelative(const glm::dvec3* absolute, size_t count, const glm::dvec3& origin, glm::vec3* out) {
+		static_assert(sizeof(glm::dvec3) == 3 * sizeof(double) && sizeof(glm::vec3) == 3 * sizeof(float), "positions must be packed");
+		size_t i = 0;
+		const double* from = &absolute[0].x;
+		float* to = &out[0].x;
+		// the origin repeats every 3 lanes, so a block is as many positions as fill whole registers
+#if defined(ENGINE_ORIGIN_AVX)
+		__m256d o0 = _mm256_setr_pd(origin.x, origin.y, origin.z, origin.x);
+		__m256d o1 = _mm256_setr_pd(origin.y, origin.z, origin.x, origin.y);
+		__m256d o2 = _mm256_setr_pd(origin.z, origin.x, origin.y, origin.z);
+		for (; i + 4 <= count; i += 4) {
+			const double* src = from + 3 * i;
+			float* dst = to + 3 * i;
+			_mm_storeu_ps(dst, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src), o0)));
+			_mm_storeu_ps(dst + 4, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 4), o1)));
+			_mm_storeu_ps(dst + 8, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(src + 8), o2)));
+		}
+#elif defined(ENGINE_ORIGIN_SSE)
+		__m128d o0 = _mm_setr_pd(origin.x, origin.y);
+		__m128d o1 = _mm_setr_pd(origin.z, origin.x);
+		__m128d o2 = _mm_setr_pd(origin.y, origin.z);
+		for (; i + 2 <= count; i += 2) {
+			const double* src = from + 3 * i;
+			float* dst = to + 3 * i;
+			__m128 xy = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src), o0));
+			__m128 zx = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 2), o1));
+			__m128 yz = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(src + 4), o2));
+			_mm_storeu_ps(dst, _mm_movelh_ps(xy, zx));
+			_mm_storel_pi(reinterpret_cast<__m64*>(dst + 4), yz);
+		}
+#endif
+		toRelativeScalar(absolute + i, count - i, origin, out + i);
+	}
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+// Bump allocator: allocate() moves a cursor, nothing is freed individually, reset() rewinds
+// everything at once. When a chunk runs out a bigger one is chained on; the next reset()
+// merges the chunks into one of the combined size, so after a frame or two of the same
+// shape the arena stops allocating altogether. Chunk memory is charged to MemTag::Frame.
+class LinearArena {
+public:
+	explicit LinearArena(size_t firstChunkBytes = 64 * 1024) : firstChunkBytes(firstChunkBytes) {}
+	~LinearArena() { release(); }
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+		uintptr_t p = (cursor + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		if (p + bytes > end || !cursor) return allocateSlow(bytes, alignment);
+		cursor = p + bytes;
+		return reinterpret_cast<void*>(p);
+	}
+
+	template<typename T>
+	T* allocateArray(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+	// Everything allocated so far becomes invalid
+	void reset() {
+		if (chunks.size() > 1) {
+			size_t total = capacity();
+			release();
+			addChunk(total);
+		}
+		if (!chunks.empty()) {
+			cursor = reinterpret_cast<uintptr_t>(chunks[0].memory);
+			end = cursor + chunks[0].bytes;
+		}
+		usedBeforeCurrent = 0;
+	}
+
+	// Frees the chunks; the arena starts over small on its next allocation
+	void release() {
+		for (const Chunk& chunk : chunks) MemoryTracker::release(chunk.memory);
+		chunks = decltype(chunks)();
+		cursor = end = 0;
+		usedBeforeCurrent = 0;
+	}
+
+	// Bytes handed out since the last reset, counting the tails of full chunks
+	size_t bytesUsed() const {
+		if (chunks.empty()) return 0;
+		return usedBeforeCurrent + (cursor - reinterpret_cast<uintptr_t>(chunks.back().memory));
+	}
+
+	size_t capacity() const {
+		size_t total = 0;
+		for (const Chunk& chunk : chunks) total += chunk.bytes;
+		return total;
+	}
+
+private:
+	struct Chunk {
+		char* memory;
+		size_t bytes;
+	};
+
+	TaggedVector<Chunk, MemTag::Frame> chunks;
+	uintptr_t cursor = 0;
+	uintptr_t end = 0;
+	size_t usedBeforeCurrent = 0;
+	size_t firstChunkBytes;
+
+	void* allocateSlow(size_t bytes, size_t alignment) {
+		size_t next = chunks.empty() ? firstChunkBytes : chunks.back().bytes * 2;
+		if (!chunks.empty()) usedBeforeCurrent += chunks.back().bytes;
+		addChunk(std::max(next, bytes + alignment));
+		return allocate(bytes, alignment);
+	}
+
+	void addChunk(size_t bytes) {
+		if (chunks.capacity() == 0) chunks.reserve(16);
+		char* memory = static_cast<char*>(MemoryTracker::allocate(bytes, MemTag::Frame, 64));
+		if (!memory) throw std::bad_alloc();
+		chunks.push_back(Chunk{ memory, bytes });
+		cursor = reinterpret_cast<uintptr_t>(memory);
+		end = cursor + bytes;
+	}
+};
+
+// Per-frame scratch memory for each thread. Each thread has two arenas used on alternate
+// frames, and an arena is only rewound the first time its thread touches it two frames
+// later. Whatever a thread allocates during frame N therefore stays valid until the end of
+// frame N+1, long enough for a consumer running a frame behind (the render submission, the
+// picking readback) to read it without copying.
+//
+// endFrame() must not run while other threads are allocating; in the engine workers only
+// run inside the frame's parallelFor calls, which have all returned by then.
+class FrameArena {
+public:
+	struct Stats {
+		size_t lastFrameBytes = 0; // all threads, in the frame that just ended
+		size_t peakFrameBytes = 0;
+		size_t capacityBytes = 0;  // reserved by every thread's arenas
+		size_t threads = 0;
+	};
+
+	// Never destroyed: job system workers can exit after static destructors have run
+	static FrameArena& get() {
+		static FrameArena* instance = [] {
+			MemTagScope memTag(MemTag::General);
+			return new FrameArena();
+		}();
+		return *instance;
+	}
+
+	// The calling thread's arena for the current frame
+	static LinearArena& local() {
+		ThreadArenas& arenas = threadArenas();
+		uint64_t frame = get().frame.load(std::memory_order_acquire);
+		int buffer = static_cast<int>(frame & 1);
+		if (arenas.frames[buffer] != frame) {
+			arenas.arenas[buffer].reset();
+			arenas.frames[buffer] = frame;
+		}
+		return arenas.arenas[buffer];
+	}
+
+	static void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+		return local().allocate(bytes, alignment);
+	}
+
+	// Call once per frame from the main loop, after the last per-frame allocation
+	void endFrame() {
+		uint64_t ending = frame.load(std::memory_order_relaxed);
+		int buffer = static_cast<int>(ending & 1);
+		Stats s;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (ThreadArenas* arenas : threads) {
+				if (arenas->frames[buffer] == ending) s.lastFrameBytes += arenas->arenas[buffer].bytesUsed();
+				s.capacityBytes += arenas->arenas[0].capacity() + arenas->arenas[1].capacity();
+			}
+			s.threads = threads.size();
+		}
+		s.peakFrameBytes = std::max(stats.peakFrameBytes, s.lastFrameBytes);
+		stats = s;
+		frame.store(ending + 1, std::memory_order_release);
+	}
+
+	const Stats& lastFrame() const { return stats; }
+
+	// Frees every thread's arenas, for shutdown before the leak report. Nothing handed out
+	// in the last two frames may be used afterwards.
+	void releaseAll() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (ThreadArenas* arenas : threads) {
+			arenas->arenas[0].release();
+			arenas->arenas[1].release();
+		}
+	}
+
+private:
+	struct ThreadArenas {
+		LinearArena arenas[2];
+		uint64_t frames[2] = { ~0ull, ~0ull };
+
+		ThreadArenas() { FrameArena::get().add(this); }
+		~ThreadArenas() { FrameArena::get().remove(this); }
+	};
+
+	std::atomic<uint64_t> frame{ 0 };
+	std::mutex mutex;
+	std::vector<ThreadArenas*> threads;
+	Stats stats;
+
+	FrameArena() { threads.reserve(64); }
+
+	static ThreadArenas& threadArenas() {
+		static thread_local ThreadArenas arenas;
+		return arenas;
+	}
+
+	void add(ThreadArenas* arenas) {
+		MemTagScope memTag(MemTag::General);
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.push_back(arenas);
+	}
+
+	void remove(ThreadArenas* arenas) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.erase(std::remove(threads.begin(), threads.end(), arenas), threads.end());
+	}
+};
+
+// STL allocator over the calling thread's frame arena. deallocate() is a no-op, so a
+// container that grows leaves its old buffers behind until the arena is rewound: reserve
+// up front. A FrameVector must not outlive the frame after the one it was filled in.
+template<typename T>
+struct FrameAllocator {
+	using value_type = T;
+
+	FrameAllocator() = default;
+	template<typename U> FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t n) { return FrameArena::local().allocateArray<T>(n); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U> bool operator==(const FrameAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance), extracted from a
+// projection * view matrix.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrix(const glm::mat4& viewProjection) {
+		// glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		auto row = [&](int i) {
+			return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		};
+		Frustum f;
+		f.planes[0] = row(3) + row(0); // left
+		f.planes[1] = row(3) - row(0); // right
+		f.planes[2] = row(3) + row(1); // bottom
+		f.planes[3] = row(3) - row(1); // top
+		// depth is reversed (ReverseZ.h), so row(3) - row(2) is the near plane and
+		// row(3) + row(2) the far side, which the infinite projection leaves open
+		f.planes[4] = row(3) + row(2); // far side
+		f.planes[5] = row(3) - row(2); // near
+		// Without glClipControl the far side comes out with no normal and is replaced by one
+		// that passes everything. With GL_ZERO_TO_ONE it is a loose plane through z = +near in
+		// view space, behind the camera, so it only culls what the near plane already does.
+		for (glm::vec4& p : f.planes) {
+			float length = glm::length(glm::vec3(p));
+			p = length > 0.0f ? p / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		return f;
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const {
+		for (const glm::vec4& p : planes) {
+			if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+		}
+		return true;
+	}
+
+	bool intersectsAABB(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+		for (const glm::vec4& p : planes) {
+			// corner furthest along the plane normal
+			glm::vec3 v(p.x >= 0 ? boxMax.x : boxMin.x, p.y >= 0 ? boxMax.y : boxMin.y, p.z >= 0 ? boxMax.z : boxMin.z);
+			if (glm::dot(glm::vec3(p), v) + p.w < 0) return false;
+		}
+		return true;
+	}
+
+	// true only if the whole box is inside
+	bool containsAABB(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+		for (const glm::vec4& p : planes) {
+			// corner least far along the plane normal
+			glm::vec3 v(p.x >= 0 ? boxMin.x : boxMax.x, p.y >= 0 ? boxMin.y : boxMax.y, p.z >= 0 ? boxMin.z : boxMax.z);
+			if (glm::dot(glm::vec3(p), v) + p.w < 0) return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+
+#include "Profiler.h"
+
+// GPU pass timing with GL_TIMESTAMP queries (core since GL 3.3, also on Mesa llvmpipe).
+//
+//   GPU_PROFILE_SCOPE("GPU opaque");
+//
+// Each frame writes its queries into one slot of a small ring and reads a slot back only
+// once its last query reports GL_QUERY_RESULT_AVAILABLE, several frames later, so reading
+// results never stalls the pipeline. Timestamps are moved onto the CPU clock with an offset
+// sampled from glGetInteger64v(GL_TIMESTAMP) when the frame started, and handed to the CPU
+// profiler on a "GPU" lane.
+class GpuProfiler {
+public:
+	static const int FrameLatency = 4;       // slots in flight
+	static const int MaxZonesPerFrame = 32;
+
+	static GpuProfiler& get() {
+		static GpuProfiler instance;
+		return instance;
+	}
+
+	// Needs a current GL context
+	void init() {
+		if (initialized) return;
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		if (bits == 0) {
+			std::cout << "GPU profiler disabled: GL_TIMESTAMP has no counter bits" << std::endl;
+			return;
+		}
+		for (FrameSlot& slot : slots)
+			glGenQueries(MaxZonesPerFrame * 2, slot.queries);
+		lane = Profiler::get().addLane("GPU");
+		Profiler::get().setDisplayLatency(FrameLatency);
+		initialized = true;
+	}
+
+	void shutdown() {
+		if (!initialized) return;
+		for (FrameSlot& slot : slots)
+			glDeleteQueries(MaxZonesPerFrame * 2, slot.queries);
+		initialized = false;
+	}
+
+	bool available() const { return initialized; }
+	uint32_t missedFrames() const { return missed; }
+
+	// Reads back every finished slot, then claims the next one for this frame
+	void beginFrame() {
+		if (!initialized) return;
+		for (int back = FrameLatency - 1; back >= 1; back--)
+			resolve(slots[(current + FrameLatency - back) % FrameLatency]);
+
+		current = (current + 1) % FrameLatency;
+		FrameSlot& slot = slots[current];
+		if (slot.pending && !resolve(slot)) missed++; // GPU is more than FrameLatency behind
+		slot.pending = false;
+		slot.zoneCount = 0;
+		depth = 0;
+
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		slot.cpuMinusGpuNs = static_cast<int64_t>(profilerNowNs()) - gpuNow;
+		recording = Profiler::get().enabled.load(std::memory_order_relaxed);
+	}
+
+	int beginZone(const char* name) {
+		if (!initialized || !recording) return -1;
+		FrameSlot& slot = slots[current];
+		if (slot.zoneCount == MaxZonesPerFrame) return -1;
+		int zone = slot.zoneCount++;
+		slot.names[zone] = name;
+		slot.depths[zone] = depth++;
+		slot.pending = true;
+		slot.lastQuery = slot.queries[zone * 2];
+		glQueryCounter(slot.lastQuery, GL_TIMESTAMP);
+		return zone;
+	}
+
+	void endZone(int zone) {
+		if (zone < 0) return;
+		depth--;
+		FrameSlot& slot = slots[current];
+		slot.lastQuery = slot.queries[zone * 2 + 1];
+		glQueryCounter(slot.lastQuery, GL_TIMESTAMP);
+	}
+
+private:
+	struct FrameSlot {
+		GLuint queries[MaxZonesPerFrame * 2] = {}; // begin/end pairs
+		const char* names[MaxZonesPerFrame] = {};
+		uint32_t depths[MaxZonesPerFrame] = {};
+		GLuint lastQuery = 0;  // queries finish in order, so this one landing means all have
+		int zoneCount = 0;
+		int64_t cpuMinusGpuNs = 0;
+		bool pending = false;
+	};
+
+	FrameSlot slots[FrameLatency];
+	int current = 0;
+	uint32_t depth = 0;
+	uint32_t lane = 0;
+	uint32_t missed = 0;
+	bool initialized = false;
+	bool recording = false;
+
+	GpuProfiler() = default;
+
+	// Returns false without blocking when the slot's queries haven't landed yet
+	bool resolve(FrameSlot& slot) {
+		if (!slot.pending) return true;
+		GLint ready = 0;
+		glGetQueryObjectiv(slot.lastQuery, GL_QUERY_RESULT_AVAILABLE, &ready);
+		if (!ready) return false;
+
+		ProfileRing& ring = Profiler::get().lane(lane);
+		for (int zone = 0; zone < slot.zoneCount; zone++) {
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(slot.queries[zone * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(slot.queries[zone * 2 + 1], GL_QUERY_RESULT, &end);
+			ProfileEvent event;
+			event.name = slot.names[zone];
+			event.startNs = static_cast<uint64_t>(static_cast<int64_t>(begin) + slot.cpuMinusGpuNs);
+			event.endNs = static_cast<uint64_t>(static_cast<int64_t>(end) + slot.cpuMinusGpuNs);
+			event.threadIndex = lane;
+			event.depth = slot.depths[zone];
+			ring.push(event);
+		}
+		slot.pending = false;
+		return true;
+	}
+};
+
+class GpuProfileScope {
+public:
+	explicit GpuProfileScope(const char* name) : zone(GpuProfiler::get().beginZone(name)) {}
+	~GpuProfileScope() { GpuProfiler::get().endZone(zone); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	int zone;
+};
+
+#ifdef ENGINE_DISABLE_PROFILER
+#define GPU_PROFILE_SCOPE(name)
+#else
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope_, __LINE__)(name)
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a, used for asset keys and archive tables of contents
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 1469598103934665603ull) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline uint64_t hashString(const std::string& str, uint64_t seed = 1469598103934665603ull) {
+	return hashBytes(str.data(), str.size(), seed);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+// Counts outstanding jobs so a caller can wait for a batch it submitted
+struct JobCounter {
+	std::atomic<int> pending{ 0 };
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Fixed pool of worker threads pulling from a shared queue. Threads that wait on a counter
+// run queued jobs instead of blocking, so nested waits can't deadlock the pool.
+// The queue is a ring that only grows, and parallelFor's jobs fit in std::function's
+// inline storage, so per-frame parallel work doesn't touch the heap once warmed up.
+class JobSystem {
+public:
+	static JobSystem& get() {
+		static JobSystem instance;
+		return instance;
+	}
+
+	explicit JobSystem(unsigned workers = std::max(2u, std::thread::hardware_concurrency()) - 1) {
+		MemTagScope memTag(MemTag::General); // may be first used from inside a subsystem's scope
+		ring.resize(256);
+		for (unsigned i = 0; i < workers; i++)
+			threads.emplace_back([this] { workerLoop(); });
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_all();
+		for (std::thread& t : threads) t.join();
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	unsigned workerCount() const { return static_cast<unsigned>(threads.size()); }
+
+	void submit(std::function<void()> job, JobCounter* counter = nullptr) {
+		if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			push(Job{ std::move(job), counter });
+		}
+		wake.notify_one();
+	}
+
+	// Runs queued jobs on the calling thread until the counter drains
+	void wait(JobCounter& counter) {
+		while (!counter.done()) {
+			Job job;
+			if (tryPop(job)) run(job);
+			else std::this_thread::yield();
+		}
+	}
+
+	// Splits [0, count) into batches and calls fn(begin, end) for each, in parallel.
+	// Returns once every batch has finished.
+	template<typename F>
+	void parallelFor(size_t count, size_t batchSize, F&& fn) {
+		if (count == 0) return;
+		batchSize = std::max<size_t>(1, batchSize);
+		if (count <= batchSize || threads.empty()) {
+			fn(size_t(0), count);
+			return;
+		}
+		// the job captures 16 bytes so std::function keeps it inline
+		struct Batches {
+			F& fn;
+			size_t count;
+			size_t batchSize;
+		} batches{ fn, count, batchSize };
+		JobCounter counter;
+		for (size_t begin = batchSize; begin < count; begin += batchSize) {
+			submit([&batches, begin] { batches.fn(begin, std::min(batches.count, begin + batches.batchSize)); }, &counter);
+		}
+		fn(size_t(0), batchSize); // the caller takes the first batch itself
+		wait(counter);
+	}
+
+private:
+	struct Job {
+		std::function<void()> fn;
+		JobCounter* counter = nullptr;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<Job> ring; // the queued jobs start at ring[head] and wrap around
+	size_t head = 0;
+	size_t queued = 0;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool running = true;
+
+	// callers hold the mutex
+	void push(Job job) {
+		if (queued == ring.size()) {
+			MemTagScope memTag(MemTag::General);
+			std::vector<Job> grown(ring.size() * 2);
+			for (size_t i = 0; i < queued; i++) grown[i] = std::move(ring[(head + i) % ring.size()]);
+			ring.swap(grown);
+			head = 0;
+		}
+		ring[(head + queued) % ring.size()] = std::move(job);
+		queued++;
+	}
+
+	Job pop() {
+		Job job = std::move(ring[head]);
+		ring[head] = Job();
+		head = (head + 1) % ring.size();
+		queued--;
+		return job;
+	}
+
+	bool tryPop(Job& job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queued == 0) return false;
+		job = pop();
+		return true;
+	}
+
+	static void run(Job& job) {
+		job.fn();
+		if (job.counter) job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	void workerLoop() {
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return !running || queued != 0; });
+				if (!running && queued == 0) return;
+				job = pop();
+			}
+			run(job);
+		}
+	}
+};
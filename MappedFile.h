@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path) { open(path); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			bytes = other.bytes;
+			length = other.length;
+			valid = other.valid;
+#ifdef _WIN32
+			fileHandle = other.fileHandle;
+			mappingHandle = other.mappingHandle;
+			other.fileHandle = INVALID_HANDLE_VALUE;
+			other.mappingHandle = NULL;
+#endif
+			other.bytes = nullptr;
+			other.length = 0;
+			other.valid = false;
+		}
+		return *this;
+	}
+
+	bool open(const std::string& path) {
+		close();
+#ifdef _WIN32
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length == 0) return valid = true;
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mappingHandle) { close(); return false; }
+		bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (!bytes) { close(); return false; }
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0) { ::close(fd); return false; }
+		length = static_cast<size_t>(info.st_size);
+		if (length == 0) { ::close(fd); return valid = true; }
+		void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping keeps its own reference to the file
+		if (mapping == MAP_FAILED) { length = 0; return false; }
+		bytes = static_cast<const char*>(mapping);
+#endif
+		return valid = true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (bytes) UnmapViewOfFile(bytes);
+		if (mappingHandle) CloseHandle(mappingHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+		mappingHandle = NULL;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+		bytes = nullptr;
+		length = 0;
+		valid = false;
+	}
+
+	// hint that the whole file is about to be read front to back
+	void adviseSequential() const {
+#ifndef _WIN32
+		if (!bytes) return;
+		madvise(const_cast<char*>(bytes), length, MADV_SEQUENTIAL);
+		madvise(const_cast<char*>(bytes), length, MADV_WILLNEED);
+#endif
+	}
+
+	bool isOpen() const { return valid; }
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+	bool valid = false;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = NULL;
+#endif
+};
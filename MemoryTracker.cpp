@@ -0,0 +1,39 @@
+// Global operator new/delete routed through MemoryTracker, charged to the calling thread's
+// MemTag. Compiled once per executable; see MemoryTracker.h.
+#include "MemoryTracker.h"
+
+#ifndef ENGINE_DISABLE_MEMORY_TRACKING
+
+static void* trackedNew(size_t bytes, size_t alignment) {
+	void* p = MemoryTracker::allocate(bytes ? bytes : 1, MemoryTracker::threadTag(), alignment);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+static void* trackedNewNoThrow(size_t bytes, size_t alignment) noexcept {
+	return MemoryTracker::allocate(bytes ? bytes : 1, MemoryTracker::threadTag(), alignment);
+}
+
+void* operator new(size_t bytes) { return trackedNew(bytes, alignof(std::max_align_t)); }
+void* operator new[](size_t bytes) { return trackedNew(bytes, alignof(std::max_align_t)); }
+void* operator new(size_t bytes, std::align_val_t alignment) { return trackedNew(bytes, static_cast<size_t>(alignment)); }
+void* operator new[](size_t bytes, std::align_val_t alignment) { return trackedNew(bytes, static_cast<size_t>(alignment)); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept { return trackedNewNoThrow(bytes, alignof(std::max_align_t)); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return trackedNewNoThrow(bytes, alignof(std::max_align_t)); }
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedNewNoThrow(bytes, static_cast<size_t>(alignment)); }
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedNewNoThrow(bytes, static_cast<size_t>(alignment)); }
+
+void operator delete(void* p) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p) noexcept { MemoryTracker::release(p); }
+void operator delete(void* p, size_t) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p, size_t) noexcept { MemoryTracker::release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { MemoryTracker::release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { MemoryTracker::release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { MemoryTracker::release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { MemoryTracker::release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { MemoryTracker::release(p); }
+
+#endif
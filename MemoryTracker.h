@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "imgui.h"
+
+// Heap accounting per subsystem. Every allocation is charged to a tag: containers name it
+// through TaggedAllocator, anything else (operator new, third-party code) is charged to
+// the calling thread's current tag, set with MemTagScope. MemoryTracker.cpp replaces the
+// global operator new/delete so untagged allocations are counted too; build with
+// ENGINE_DISABLE_MEMORY_TRACKING to keep the runtime's own.
+//
+// The counters are plain atomics that are constant-initialized, so allocations made
+// during static initialization are counted safely before anything else runs.
+
+enum class MemTag : uint8_t { General, Scene, Render, Assets, UI, Frame, Count };
+
+static const char* memTagNames[] = { "General", "Scene", "Render", "Assets", "UI", "Frame" };
+
+struct MemTagCounters {
+	std::atomic<int64_t> liveBytes{ 0 };
+	std::atomic<int64_t> peakBytes{ 0 };
+	std::atomic<int64_t> liveAllocations{ 0 };
+	std::atomic<uint64_t> totalAllocations{ 0 };
+	std::atomic<uint64_t> frameAllocations{ 0 }; // since the last endFrame()
+};
+
+class MemoryTracker {
+public:
+	static const int TagCount = static_cast<int>(MemTag::Count);
+
+	static MemoryTracker& get() {
+		static MemoryTracker instance;
+		return instance;
+	}
+
+	// Tag charged for untagged allocations made by this thread
+	static MemTag& threadTag() {
+		static thread_local MemTag tag = MemTag::General;
+		return tag;
+	}
+
+	static void onAlloc(MemTag tag, size_t bytes) {
+		MemTagCounters& c = counters[static_cast<int>(tag)];
+		int64_t live = c.liveBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+		int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+		c.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		c.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		c.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void onFree(MemTag tag, size_t bytes) {
+		MemTagCounters& c = counters[static_cast<int>(tag)];
+		c.liveBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+		c.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// malloc with a small header recording size and tag, so free needs neither
+	static void* allocate(size_t bytes, MemTag tag, size_t alignment = alignof(std::max_align_t)) {
+		if (alignment < alignof(Header)) alignment = alignof(Header);
+		size_t headerSpace = sizeof(Header) > alignment ? sizeof(Header) : alignment;
+		size_t padding = alignment > alignof(std::max_align_t) ? alignment : 0;
+		char* raw = static_cast<char*>(std::malloc(bytes + headerSpace + padding));
+		if (!raw) return nullptr;
+		uintptr_t user = (reinterpret_cast<uintptr_t>(raw) + headerSpace + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		Header* header = reinterpret_cast<Header*>(user) - 1;
+		header->bytes = bytes;
+		header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(raw));
+		header->tag = tag;
+		onAlloc(tag, bytes);
+		return reinterpret_cast<void*>(user);
+	}
+
+	static void release(void* ptr) {
+		if (!ptr) return;
+		Header* header = static_cast<Header*>(ptr) - 1;
+		onFree(header->tag, header->bytes);
+		std::free(static_cast<char*>(ptr) - header->offset);
+	}
+
+	static const MemTagCounters& tagCounters(MemTag tag) { return counters[static_cast<int>(tag)]; }
+
+	// Allocations of the frame that just ended, all threads and tags
+	uint64_t lastFrameAllocations() const {
+		uint64_t total = 0;
+		for (int t = 0; t < TagCount; t++) total += lastFrame[t];
+		return total;
+	}
+	uint64_t lastFrameAllocations(MemTag tag) const { return lastFrame[static_cast<int>(tag)]; }
+
+	// 0 means no budget; going over is reported once per crossing
+	void setBudget(MemTag tag, size_t bytes) { budgets[static_cast<int>(tag)] = bytes; }
+
+	// Closes the frame's allocation counts; call once per frame from the main loop
+	void endFrame() {
+		for (int t = 0; t < TagCount; t++) {
+			lastFrame[t] = counters[t].frameAllocations.exchange(0, std::memory_order_relaxed);
+			int64_t live = counters[t].liveBytes.load(std::memory_order_relaxed);
+			bool over = budgets[t] != 0 && live > static_cast<int64_t>(budgets[t]);
+			if (over && !overBudget[t]) {
+				std::cout << "WARNING::MEMORY::OVER_BUDGET: " << memTagNames[t] << " uses " << live / 1024 << " KB of "
+					<< budgets[t] / 1024 << " KB" << std::endl;
+			}
+			overBudget[t] = over;
+		}
+		allocationHistory[historyHead] = static_cast<float>(lastFrameAllocations());
+		historyHead = (historyHead + 1) % HistorySize;
+	}
+
+	// Prints what each subsystem still holds. Call after the subsystems have shut down;
+	// General also holds engine singletons that live until exit, so it is only listed.
+	bool reportLeaks(std::ostream& out = std::cout) const {
+		bool leaked = false;
+		for (int t = 0; t < TagCount; t++) {
+			int64_t live = counters[t].liveBytes.load();
+			int64_t count = counters[t].liveAllocations.load();
+			if (count == 0) continue;
+			bool isLeak = t != static_cast<int>(MemTag::General);
+			leaked |= isLeak;
+			out << (isLeak ? "ERROR::MEMORY::LEAK: " : "memory still held by ") << memTagNames[t] << ": " << live << " bytes in "
+				<< count << " allocations" << std::endl;
+		}
+		return !leaked;
+	}
+
+	void drawImGuiWindow() {
+		ImGui::Begin("Memory");
+		ImGui::PlotLines("Allocs/frame", allocationHistory, HistorySize, historyHead, nullptr, 0.0f, 64.0f, ImVec2(0, 40));
+		ImGui::Text("heap allocations last frame: %llu", static_cast<unsigned long long>(lastFrameAllocations()));
+		if (ImGui::BeginTable("memoryTags", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Tag");
+			ImGui::TableSetupColumn("Live (KB)");
+			ImGui::TableSetupColumn("Peak (KB)");
+			ImGui::TableSetupColumn("Blocks");
+			ImGui::TableSetupColumn("Allocs/frame");
+			ImGui::TableSetupColumn("Budget");
+			ImGui::TableHeadersRow();
+			for (int t = 0; t < TagCount; t++) {
+				const MemTagCounters& c = counters[t];
+				int64_t live = c.liveBytes.load(std::memory_order_relaxed);
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", memTagNames[t]);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", live / 1024.0);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", c.peakBytes.load(std::memory_order_relaxed) / 1024.0);
+				ImGui::TableNextColumn(); ImGui::Text("%lld", static_cast<long long>(c.liveAllocations.load(std::memory_order_relaxed)));
+				ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(lastFrame[t]));
+				ImGui::TableNextColumn();
+				if (budgets[t]) ImGui::ProgressBar(static_cast<float>(live) / budgets[t], ImVec2(-1, 0));
+				else ImGui::Text("-");
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+
+private:
+	static const int HistorySize = 120;
+
+	struct alignas(16) Header {
+		size_t bytes;
+		uint32_t offset; // from the malloc'd block to the user pointer
+		MemTag tag;
+	};
+
+	static inline MemTagCounters counters[TagCount];
+
+	uint64_t lastFrame[TagCount] = {};
+	size_t budgets[TagCount] = {};
+	bool overBudget[TagCount] = {};
+	float allocationHistory[HistorySize] = {};
+	int historyHead = 0;
+
+	MemoryTracker() = default;
+};
+
+// Charges untagged allocations on this thread to tag until the end of the scope
+class MemTagScope {
+public:
+	explicit MemTagScope(MemTag tag) : previous(MemoryTracker::threadTag()) { MemoryTracker::threadTag() = tag; }
+	~MemTagScope() { MemoryTracker::threadTag() = previous; }
+	MemTagScope(const MemTagScope&) = delete;
+	MemTagScope& operator=(const MemTagScope&) = delete;
+
+private:
+	MemTag previous;
+};
+
+// STL allocator charging a fixed tag: std::vector<T, TaggedAllocator<T, MemTag::Scene>>
+template<typename T, MemTag Tag>
+struct TaggedAllocator {
+	using value_type = T;
+	template<typename U> struct rebind { using other = TaggedAllocator<U, Tag>; };
+
+	TaggedAllocator() = default;
+	template<typename U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+	T* allocate(size_t n) {
+		void* p = MemoryTracker::allocate(n * sizeof(T), Tag, alignof(T));
+		if (!p) throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, size_t) { MemoryTracker::release(p); }
+
+	template<typename U> bool operator==(const TaggedAllocator<U, Tag>&) const { return true; }
+	template<typename U> bool operator!=(const TaggedAllocator<U, Tag>&) const { return false; }
+};
+
+template<typename T, MemTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
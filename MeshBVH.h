@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MemoryTracker.h"
+#include "Ray.h"
+
+// Where a ray meets a mesh. The hit point is (1 - u - v) * a + u * b + v * c for the
+// triangle's vertices in the order they were given.
+struct MeshHit {
+	float distance = std::numeric_limits<float>::max(); // along the ray, in units of its direction
+	uint32_t triangle = 0; // index in the mesh's positions / 9
+	float u = 0.0f;
+	float v = 0.0f;
+};
+
+// Four-wide bounding volume hierarchy over a triangle mesh, for exact ray hits. Each node
+// holds its children's boxes as an AABB4, so one rayAABB4 call tests all of them; children
+// are visited nearest first and dropped once they start past the best hit. Leaves hold up
+// to four triangles, copied into leaf order so a leaf reads one contiguous run.
+//
+// Triangles use the watertight test of Woop, Benthin and Wald (2013): the ray is sheared
+// onto the +Z axis and the edge functions are evaluated in 2D, falling back to double
+// precision when one comes out exactly zero, so a ray through a shared edge or vertex hits
+// at least one of the triangles around it. Hits are two-sided.
+//
+// The tree is built with binned surface area heuristic splits, two binary levels per node.
+class MeshBVH {
+public:
+	static const int MaxDepth = 64;
+
+	MeshBVH() = default;
+
+	// positions: xyz per vertex, three vertices per triangle
+	void build(const float* positions, size_t triangleCount) {
+		clear();
+		if (triangleCount == 0) return;
+		std::vector<BuildTriangle> build(triangleCount);
+		for (size_t i = 0; i < triangleCount; i++) {
+			const float* p = positions + i * 9;
+			glm::vec3 a(p[0], p[1], p[2]), b(p[3], p[4], p[5]), c(p[6], p[7], p[8]);
+			build[i].boxMin = glm::min(a, glm::min(b, c));
+			build[i].boxMax = glm::max(a, glm::max(b, c));
+			build[i].centroid = (build[i].boxMin + build[i].boxMax) * 0.5f;
+			build[i].index = static_cast<uint32_t>(i);
+		}
+		Bounds all = boundsOf(build.data(), 0, build.size());
+		rootMin = all.boxMin;
+		rootMax = all.boxMax;
+		nodes.reserve(triangleCount / 3 + 1);
+		triangles.reserve(triangleCount);
+		triangleIndices.reserve(triangleCount);
+		if (triangleCount <= LeafSize) {
+			// a lone leaf still goes under a node, so traversal always starts at nodes[0]
+			nodes.emplace_back();
+			nodes[0].children[0] = makeLeaf(build, positions, 0, triangleCount);
+			nodes[0].bounds.set(0, rootMin, rootMax);
+		}
+		else buildNode(build, positions, 0, triangleCount, 0);
+	}
+
+	// Nearest hit with distance in [0, ray.tMax]; hit is left alone on a miss
+	bool raycast(const Ray& ray, MeshHit& hit) const {
+		if (nodes.empty() || !ray.valid()) return false;
+		Shear shear = shearFor(ray);
+		float best = ray.tMax;
+		bool found = false;
+		Ray bounded = ray;
+		struct Entry {
+			uint32_t node;
+			float t;
+		};
+		Entry stack[MaxDepth * 3 + 1];
+		int top = 0;
+		stack[top++] = Entry{ 0, 0.0f };
+		float t[4];
+		while (top > 0) {
+			Entry entry = stack[--top];
+			if (entry.t > best) continue;
+			const Node& node = nodes[entry.node];
+			bounded.tMax = best;
+			int mask = rayAABB4(bounded, node.bounds, t);
+			int first = top;
+			for (int i = 0; i < 4; i++) {
+				if (!(mask >> i & 1)) continue;
+				uint32_t child = node.children[i];
+				if (child & LeafBit) {
+					uint32_t start = (child & ~LeafBit) >> 2, count = (child & 3) + 1;
+					for (uint32_t k = start; k < start + count; k++) {
+						float distance, u, v;
+						if (intersect(shear, triangles[k], best, distance, u, v) && (!found || distance < best)) {
+							best = distance;
+							hit.distance = distance;
+							hit.triangle = triangleIndices[k];
+							hit.u = u;
+							hit.v = v;
+							found = true;
+						}
+					}
+					continue;
+				}
+				// pushed farthest first, so the nearest comes off the stack next
+				int j = top++;
+				for (; j > first && stack[j - 1].t < t[i]; j--) stack[j] = stack[j - 1];
+				stack[j] = Entry{ child, t[i] };
+			}
+		}
+		return found;
+	}
+
+	bool empty() const { return nodes.empty(); }
+	size_t triangleCount() const { return triangles.size(); }
+	size_t nodeCount() const { return nodes.size(); }
+	size_t memoryBytes() const { return nodes.capacity() * sizeof(Node) + triangles.capacity() * sizeof(Triangle) + triangleIndices.capacity() * sizeof(uint32_t); }
+	// Bounds of the whole mesh, in its own space
+	const glm::vec3& boundsMin() const { return rootMin; }
+	const glm::vec3& boundsMax() const { return rootMax; }
+
+	void clear() {
+		nodes = decltype(nodes)();
+		triangles = decltype(triangles)();
+		triangleIndices = decltype(triangleIndices)();
+		rootMin = rootMax = glm::vec3(0.0f);
+	}
+
+private:
+	static const size_t LeafSize = 4;
+	static const uint32_t LeafBit = 0x80000000u; // then first triangle << 2 | count - 1
+	static const int Bins = 16;
+
+	struct Node {
+		AABB4 bounds; // unused slots hold the empty box
+		uint32_t children[4] = {};
+	};
+
+	struct Triangle {
+		glm::vec3 a, b, c;
+	};
+
+	struct BuildTriangle {
+		glm::vec3 boxMin, boxMax, centroid;
+		uint32_t index;
+	};
+
+	struct Bounds {
+		glm::vec3 boxMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boxMax = glm::vec3(-std::numeric_limits<float>::max());
+		void grow(const glm::vec3& lo, const glm::vec3& hi) {
+			boxMin = glm::min(boxMin, lo);
+			boxMax = glm::max(boxMax, hi);
+		}
+		float area() const {
+			glm::vec3 d = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+			return d.x * d.y + d.y * d.z + d.z * d.x;
+		}
+	};
+
+	// per ray: the axis the direction is longest along becomes z, and the shear that maps
+	// the direction onto it
+	struct Shear {
+		int kx, ky, kz;
+		float sx, sy, sz;
+		glm::vec3 origin;
+	};
+
+	TaggedVector<Node, MemTag::Assets> nodes;
+	TaggedVector<Triangle, MemTag::Assets> triangles; // in leaf order
+	TaggedVector<uint32_t, MemTag::Assets> triangleIndices; // original index of each
+	glm::vec3 rootMin = glm::vec3(0.0f);
+	glm::vec3 rootMax = glm::vec3(0.0f);
+
+	static Bounds boundsOf(const BuildTriangle* build, size_t begin, size_t end) {
+		Bounds bounds;
+		for (size_t i = begin; i < end; i++) bounds.grow(build[i].boxMin, build[i].boxMax);
+		return bounds;
+	}
+
+	uint32_t makeLeaf(const std::vector<BuildTriangle>& build, const float* positions, size_t begin, size_t end) {
+		uint32_t first = static_cast<uint32_t>(triangles.size());
+		for (size_t i = begin; i < end; i++) {
+			const float* p = positions + static_cast<size_t>(build[i].index) * 9;
+			triangles.push_back(Triangle{ glm::vec3(p[0], p[1], p[2]), glm::vec3(p[3], p[4], p[5]), glm::vec3(p[6], p[7], p[8]) });
+			triangleIndices.push_back(build[i].index);
+		}
+		return LeafBit | first << 2 | static_cast<uint32_t>(end - begin - 1);
+	}
+
+	// Splits [begin, end) in two and returns where the second half starts. Binned SAH on
+	// the centroids' widest axis; a median split when the centroids coincide or the tree is
+	// getting too deep for the traversal stack.
+	static size_t split(std::vector<BuildTriangle>& build, size_t begin, size_t end, bool median) {
+		Bounds centroids;
+		for (size_t i = begin; i < end; i++) centroids.grow(build[i].centroid, build[i].centroid);
+		glm::vec3 extent = centroids.boxMax - centroids.boxMin;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		size_t middle = begin + (end - begin) / 2;
+		if (median || !(extent[axis] > 0.0f)) {
+			std::nth_element(build.begin() + begin, build.begin() + middle, build.begin() + end,
+				[axis](const BuildTriangle& a, const BuildTriangle& b) { return a.centroid[axis] < b.centroid[axis]; });
+			return middle;
+		}
+
+		float scale = Bins / extent[axis], low = centroids.boxMin[axis];
+		auto binOf = [&](const BuildTriangle& tri) { return std::min(Bins - 1, static_cast<int>((tri.centroid[axis] - low) * scale)); };
+		Bounds bins[Bins];
+		size_t counts[Bins] = {};
+		for (size_t i = begin; i < end; i++) {
+			int bin = binOf(build[i]);
+			bins[bin].grow(build[i].boxMin, build[i].boxMax);
+			counts[bin]++;
+		}
+		// sweep from the right to get every split's right-hand area, then from the left
+		float rightArea[Bins];
+		size_t rightCount[Bins];
+		Bounds sweep;
+		size_t count = 0;
+		for (int b = Bins - 1; b > 0; b--) {
+			sweep.grow(bins[b].boxMin, bins[b].boxMax);
+			count += counts[b];
+			rightArea[b] = sweep.area();
+			rightCount[b] = count;
+		}
+		sweep = Bounds();
+		count = 0;
+		int bestBin = -1;
+		float bestCost = std::numeric_limits<float>::max();
+		for (int b = 1; b < Bins; b++) {
+			sweep.grow(bins[b - 1].boxMin, bins[b - 1].boxMax);
+			count += counts[b - 1];
+			if (count == 0 || rightCount[b] == 0) continue;
+			float cost = sweep.area() * count + rightArea[b] * rightCount[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestBin = b;
+			}
+		}
+		if (bestBin < 0) return split(build, begin, end, true);
+		auto pivot = std::partition(build.begin() + begin, build.begin() + end, [&](const BuildTriangle& tri) { return binOf(tri) < bestBin; });
+		return static_cast<size_t>(pivot - build.begin());
+	}
+
+	uint32_t buildNode(std::vector<BuildTriangle>& build, const float* positions, size_t begin, size_t end, int depth) {
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		bool median = depth >= MaxDepth - 16;
+		// two binary levels make the four children; a side small enough stays whole
+		size_t middle = split(build, begin, end, median);
+		size_t left = middle - begin > LeafSize ? split(build, begin, middle, median) : begin;
+		size_t right = end - middle > LeafSize ? split(build, middle, end, median) : middle;
+		size_t cuts[5] = { begin, left, middle, right, end };
+		int slot = 0;
+		for (int r = 0; r < 4; r++) {
+			size_t from = cuts[r], to = cuts[r + 1];
+			if (from == to) continue;
+			Bounds bounds = boundsOf(build.data(), from, to);
+			uint32_t child = to - from <= LeafSize ? makeLeaf(build, positions, from, to) : buildNode(build, positions, from, to, depth + 1);
+			nodes[index].bounds.set(slot, bounds.boxMin, bounds.boxMax);
+			nodes[index].children[slot] = child;
+			slot++;
+		}
+		return index;
+	}
+
+	static Shear shearFor(const Ray& ray) {
+		Shear s;
+		glm::vec3 d = ray.direction, absolute = glm::abs(d);
+		s.kz = absolute.x > absolute.y ? (absolute.x > absolute.z ? 0 : 2) : (absolute.y > absolute.z ? 1 : 2);
+		s.kx = (s.kz + 1) % 3;
+		s.ky = (s.kx + 1) % 3;
+		// keep the winding of the sheared triangle the same
+		if (d[s.kz] < 0.0f) std::swap(s.kx, s.ky);
+		s.sx = d[s.kx] / d[s.kz];
+		s.sy = d[s.ky] / d[s.kz];
+		s.sz = 1.0f / d[s.kz];
+		s.origin = ray.origin;
+		return s;
+	}
+
+	static bool intersect(const Shear& s, const Triangle& tri, float tMax, float& distance, float& u, float& v) {
+		glm::vec3 A = tri.a - s.origin, B = tri.b - s.origin, C = tri.c - s.origin;
+		float ax = A[s.kx] - s.sx * A[s.kz], ay = A[s.ky] - s.sy * A[s.kz];
+		float bx = B[s.kx] - s.sx * B[s.kz], by = B[s.ky] - s.sy * B[s.kz];
+		float cx = C[s.kx] - s.sx * C[s.kz], cy = C[s.ky] - s.sy * C[s.kz];
+		float U = cx * by - cy * bx;
+		float V = ax * cy - ay * cx;
+		float W = bx * ay - by * ax;
+		if (U == 0.0f || V == 0.0f || W == 0.0f) {
+			U = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+			V = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+			W = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+		}
+		if ((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f)) return false;
+		float det = U + V + W;
+		if (det == 0.0f) return false;
+		float T = U * (s.sz * A[s.kz]) + V * (s.sz * B[s.kz]) + W * (s.sz * C[s.kz]);
+		// distance = T / det must land in [0, tMax], compared without dividing
+		if (det > 0.0f ? (T < 0.0f || T > tMax * det) : (T > 0.0f || T < tMax * det)) return false;
+		float inverseDet = 1.0f / det;
+		distance = T * inverseDet;
+		u = V * inverseDet;
+		v = W * inverseDet;
+		return true;
+	}
+};
+
+// A world-space ray against a mesh placed by model: the mesh's bounds as a box oriented by
+// model first, then the triangles. Both run in the mesh's own space, where the ray keeps
+// its parameter, so hit.distance is measured along the world ray. Only hits closer than
+// ray.tMax count.
+inline bool raycastMesh(const Ray& ray, const glm::mat4& model, const MeshBVH& bvh, MeshHit& hit) {
+	if (bvh.empty()) return false;
+	glm::mat4 toLocal = glm::inverse(model);
+	Ray local(glm::vec3(toLocal * glm::vec4(ray.origin, 1.0f)), glm::vec3(toLocal * glm::vec4(ray.direction, 0.0f)), ray.tMax);
+	float entry;
+	if (!rayAABB(local, bvh.boundsMin(), bvh.boundsMax(), entry)) return false;
+	return bvh.raycast(local, hit);
+}
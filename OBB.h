@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+// Oriented box: a center, three unit axes and the half extents along them
+struct OBB {
+	glm::vec3 center;
+	glm::vec3 axes[3];
+	glm::vec3 halfExtents;
+
+	// The unit cube under a world matrix, which is how cubes are drawn. A parent's
+	// non-uniform scale can shear the box, and then the axes are only roughly perpendicular.
+	static OBB fromMatrix(const glm::mat4& model) {
+		OBB box;
+		box.center = glm::vec3(model[3]);
+		for (int i = 0; i < 3; i++) {
+			glm::vec3 column(model[i]);
+			float length = glm::length(column);
+			box.axes[i] = length > 0.0f ? column / length : glm::vec3(i == 0, i == 1, i == 2);
+			box.halfExtents[i] = 0.5f * length;
+		}
+		return box;
+	}
+
+	void bounds(glm::vec3& boxMin, glm::vec3& boxMax) const {
+		glm::vec3 half = glm::abs(axes[0]) * halfExtents.x + glm::abs(axes[1]) * halfExtents.y + glm::abs(axes[2]) * halfExtents.z;
+		boxMin = center - half;
+		boxMax = center + half;
+	}
+};
+
+// Separating axis test between two oriented boxes (Gottschalk, Lin and Manocha 1996, as
+// laid out in Ericson's Real-Time Collision Detection 4.4.1). The 15 candidate axes are the
+// six face normals and the nine edge cross products, all expressed in a's frame so each
+// projection is a few multiply-adds. Touching boxes overlap.
+//
+// The absolute rotation terms carry a small epsilon: when two edges are nearly parallel
+// their cross product is close to zero and rounding alone could report a separation.
+inline bool obbOverlap(const OBB& a, const OBB& b) {
+	const float Epsilon = 1e-6f;
+	float r[3][3], absR[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			r[i][j] = glm::dot(a.axes[i], b.axes[j]);
+			absR[i][j] = std::abs(r[i][j]) + Epsilon;
+		}
+	}
+	glm::vec3 offset = b.center - a.center;
+	float t[3] = { glm::dot(offset, a.axes[0]), glm::dot(offset, a.axes[1]), glm::dot(offset, a.axes[2]) };
+	const glm::vec3& ea = a.halfExtents;
+	const glm::vec3& eb = b.halfExtents;
+
+	// a's face normals
+	for (int i = 0; i < 3; i++) {
+		if (std::abs(t[i]) > ea[i] + eb[0] * absR[i][0] + eb[1] * absR[i][1] + eb[2] * absR[i][2]) return false;
+	}
+	// b's face normals
+	for (int j = 0; j < 3; j++) {
+		float distance = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+		if (std::abs(distance) > ea[0] * absR[0][j] + ea[1] * absR[1][j] + ea[2] * absR[2][j] + eb[j]) return false;
+	}
+	// a's axis i crossed with b's axis j
+	for (int i = 0; i < 3; i++) {
+		int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++) {
+			int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+			float distance = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+			float ra = ea[i1] * absR[i2][j] + ea[i2] * absR[i1][j];
+			float rb = eb[j1] * absR[i][j2] + eb[j2] * absR[i][j1];
+			if (std::abs(distance) > ra + rb) return false;
+		}
+	}
+	return true;
+}
+
+// A point where two boxes touch. separation is along the manifold normal, negative while
+// the boxes overlap.
+struct ContactPoint {
+	glm::vec3 position;
+	float separation;
+};
+
+// Up to four points sharing one normal, which points from the first box to the second
+struct ContactManifold {
+	glm::vec3 normal;
+	ContactPoint points[4];
+	int count = 0;
+};
+
+namespace obb_detail {
+	// Keeps the points reaching furthest toward the reference face's four corners. They
+	// span close to the whole contact area, and unlike picking by depth the choice doesn't
+	// flicker between steps while a box rests flat, which would lose the warm start.
+	inline void reduceToFour(const glm::vec3& u, const glm::vec3& v, const ContactPoint* points, int count, ContactManifold& manifold) {
+		const glm::vec3 corners[4] = { u + v, u - v, -u - v, -u + v };
+		manifold.count = 0;
+		for (const glm::vec3& corner : corners) {
+			int best = 0;
+			for (int i = 1; i < count; i++) {
+				if (glm::dot(points[i].position, corner) > glm::dot(points[best].position, corner)) best = i;
+			}
+			bool repeated = false;
+			for (int k = 0; k < manifold.count; k++) repeated |= manifold.points[k].position == points[best].position;
+			if (!repeated) manifold.points[manifold.count++] = points[best];
+		}
+	}
+
+	// Sutherland-Hodgman step: the part of the polygon where dot(p, axis) <= limit
+	inline int clip(const glm::vec3* in, int count, const glm::vec3& axis, float limit, glm::vec3* out) {
+		int written = 0;
+		for (int i = 0; i < count; i++) {
+			const glm::vec3& a = in[i];
+			const glm::vec3& b = in[(i + 1) % count];
+			float da = glm::dot(a, axis) - limit, db = glm::dot(b, axis) - limit;
+			if (da <= 0.0f) out[written++] = a;
+			if ((da < 0.0f && db > 0.0f) || (da > 0.0f && db < 0.0f)) out[written++] = a + (b - a) * (da / (da - db));
+		}
+		return written;
+	}
+
+	// The face of reference pointing along normal clips the face of incident turned most
+	// against it; every clipped point within margin of the reference face is a contact
+	inline void clipFaces(const OBB& reference, int axis, const glm::vec3& normal, const OBB& incident, float margin, ContactManifold& manifold) {
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		glm::vec3 faceCenter = reference.center + normal * reference.halfExtents[axis];
+
+		int k = 0;
+		float best = -1.0f;
+		for (int i = 0; i < 3; i++) {
+			float alignment = std::abs(glm::dot(incident.axes[i], normal));
+			if (alignment > best) { best = alignment; k = i; }
+		}
+		int ku = (k + 1) % 3, kv = (k + 2) % 3;
+		glm::vec3 faceNormal = glm::dot(incident.axes[k], normal) > 0.0f ? -incident.axes[k] : incident.axes[k];
+		glm::vec3 center = incident.center + faceNormal * incident.halfExtents[k];
+		glm::vec3 su = incident.axes[ku] * incident.halfExtents[ku], sv = incident.axes[kv] * incident.halfExtents[kv];
+
+		// a quad clipped by four planes has at most eight corners
+		glm::vec3 polygon[8] = { center + su + sv, center - su + sv, center - su - sv, center + su - sv };
+		glm::vec3 scratch[8];
+		int count = 4;
+		const glm::vec3 sides[4] = { reference.axes[u], -reference.axes[u], reference.axes[v], -reference.axes[v] };
+		const float limits[4] = { reference.halfExtents[u], reference.halfExtents[u], reference.halfExtents[v], reference.halfExtents[v] };
+		for (int side = 0; side < 4 && count > 0; side++) {
+			count = clip(polygon, count, sides[side], glm::dot(reference.center, sides[side]) + limits[side], scratch);
+			std::copy(scratch, scratch + count, polygon);
+		}
+
+		ContactPoint points[8];
+		int kept = 0;
+		for (int i = 0; i < count; i++) {
+			float separation = glm::dot(polygon[i] - faceCenter, normal);
+			// halfway between the incident point and the reference face
+			if (separation <= margin) points[kept++] = ContactPoint{ polygon[i] - normal * (0.5f * separation), separation };
+		}
+		if (kept <= 4) {
+			manifold.count = kept;
+			std::copy(points, points + kept, manifold.points);
+		}
+		else reduceToFour(reference.axes[u], reference.axes[v], points, kept, manifold);
+	}
+}
+
+// Contact points between two oriented boxes that overlap or are less than margin apart;
+// false otherwise. The separating axis test above picks the axis of least penetration,
+// favoring face normals over edge crosses so resting contacts keep a steady normal. A face
+// axis clips the other box's most opposed face against the reference face and keeps up
+// to four points; an edge axis gives the closest points of the two edges.
+inline bool collideOBBs(const OBB& a, const OBB& b, float margin, ContactManifold& manifold) {
+	const float Epsilon = 1e-6f;
+	// an edge or a face of b has to beat a's face by this much to be chosen
+	const float RelativeTolerance = 0.95f, AbsoluteTolerance = 0.01f;
+	float r[3][3], absR[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			r[i][j] = glm::dot(a.axes[i], b.axes[j]);
+			absR[i][j] = std::abs(r[i][j]) + Epsilon;
+		}
+	}
+	glm::vec3 offset = b.center - a.center;
+	float t[3] = { glm::dot(offset, a.axes[0]), glm::dot(offset, a.axes[1]), glm::dot(offset, a.axes[2]) };
+	const glm::vec3& ea = a.halfExtents;
+	const glm::vec3& eb = b.halfExtents;
+
+	float faceA = -std::numeric_limits<float>::max(), faceB = faceA, edge = faceA;
+	int axisA = 0, axisB = 0, edgeA = 0, edgeB = 0;
+	glm::vec3 edgeNormal(0.0f);
+	for (int i = 0; i < 3; i++) {
+		float separation = std::abs(t[i]) - (ea[i] + eb[0] * absR[i][0] + eb[1] * absR[i][1] + eb[2] * absR[i][2]);
+		if (separation > margin) return false;
+		if (separation > faceA) { faceA = separation; axisA = i; }
+	}
+	for (int j = 0; j < 3; j++) {
+		float distance = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+		float separation = std::abs(distance) - (ea[0] * absR[0][j] + ea[1] * absR[1][j] + ea[2] * absR[2][j] + eb[j]);
+		if (separation > margin) return false;
+		if (separation > faceB) { faceB = separation; axisB = j; }
+	}
+	for (int i = 0; i < 3; i++) {
+		int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; j++) {
+			int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+			glm::vec3 axis = glm::cross(a.axes[i], b.axes[j]);
+			float length = glm::length(axis);
+			// nearly parallel edges: the face axes already cover them
+			if (length < 1e-4f) continue;
+			float distance = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+			float ra = ea[i1] * absR[i2][j] + ea[i2] * absR[i1][j];
+			float rb = eb[j1] * absR[i][j2] + eb[j2] * absR[i][j1];
+			float separation = (std::abs(distance) - (ra + rb)) / length;
+			if (separation > margin) return false;
+			if (separation > edge) {
+				edge = separation;
+				edgeA = i;
+				edgeB = j;
+				edgeNormal = axis / length;
+			}
+		}
+	}
+
+	float face = faceA;
+	bool referenceIsA = true;
+	if (faceB > RelativeTolerance * faceA + AbsoluteTolerance) {
+		face = faceB;
+		referenceIsA = false;
+	}
+	if (edge > RelativeTolerance * face + AbsoluteTolerance) {
+		glm::vec3 normal = glm::dot(edgeNormal, offset) < 0.0f ? -edgeNormal : edgeNormal;
+		// the edge of each box that reaches furthest toward the other
+		glm::vec3 pointA = a.center, pointB = b.center;
+		for (int k = 0; k < 3; k++) {
+			if (k != edgeA) pointA += a.axes[k] * (glm::dot(a.axes[k], normal) > 0.0f ? ea[k] : -ea[k]);
+			if (k != edgeB) pointB += b.axes[k] * (glm::dot(b.axes[k], normal) > 0.0f ? -eb[k] : eb[k]);
+		}
+		const glm::vec3& da = a.axes[edgeA];
+		const glm::vec3& db = b.axes[edgeB];
+		glm::vec3 between = pointA - pointB;
+		float cosine = glm::dot(da, db), c = glm::dot(da, between), f = glm::dot(db, between);
+		float denominator = std::max(1.0f - cosine * cosine, Epsilon);
+		float s = glm::clamp((cosine * f - c) / denominator, -ea[edgeA], ea[edgeA]);
+		float u = glm::clamp((f - cosine * c) / denominator, -eb[edgeB], eb[edgeB]);
+		glm::vec3 closestA = pointA + da * s, closestB = pointB + db * u;
+		manifold.normal = normal;
+		manifold.points[0] = ContactPoint{ (closestA + closestB) * 0.5f, glm::dot(closestB - closestA, normal) };
+		manifold.count = 1;
+		return true;
+	}
+	if (referenceIsA) {
+		manifold.normal = t[axisA] < 0.0f ? -a.axes[axisA] : a.axes[axisA];
+		obb_detail::clipFaces(a, axisA, manifold.normal, b, margin, manifold);
+	}
+	else {
+		float distance = glm::dot(offset, b.axes[axisB]);
+		manifold.normal = distance < 0.0f ? -b.axes[axisB] : b.axes[axisB];
+		obb_detail::clipFaces(b, axisB, -manifold.normal, a, margin, manifold);
+	}
+	return manifold.count > 0;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <utility>
+
+#include "MemoryTracker.h"
+
+// Generational handle into an ObjectPool, packed into 32 bits: the low IndexBits are the
+// slot, the rest its generation. Generation 0 is never handed out, so the zero handle is
+// null. Destroying an object bumps its slot's generation, and every handle still pointing
+// at the old one resolves to nullptr instead of whatever reuses the slot.
+template<typename T>
+struct PoolHandle {
+	static const uint32_t IndexBits = 22;
+	static const uint32_t IndexMask = (1u << IndexBits) - 1;
+	static const uint32_t GenerationMask = (1u << (32 - IndexBits)) - 1;
+
+	uint32_t value = 0;
+
+	PoolHandle() = default;
+	PoolHandle(uint32_t index, uint32_t generation) : value((generation << IndexBits) | index) {}
+
+	uint32_t index() const { return value & IndexMask; }
+	uint32_t generation() const { return value >> IndexBits; }
+	bool valid() const { return value != 0; }
+	bool operator==(const PoolHandle& other) const { return value == other.value; }
+	bool operator!=(const PoolHandle& other) const { return value != other.value; }
+};
+
+// Typed pool with stable addresses. Objects live in fixed-size slabs that are never moved
+// or freed until shrink(), so iteration walks contiguous memory and pointers stay valid
+// until their object is destroyed. Freed slots go on an intrusive free list and are reused
+// last-in first-out; create and destroy are O(1) and only allocate when the pool grows.
+template<typename T, MemTag Tag = MemTag::General>
+class ObjectPool {
+public:
+	using Handle = PoolHandle<T>;
+	static const uint32_t SlabSize = 1024;
+	static const uint32_t MaxObjects = Handle::IndexMask + 1;
+
+	ObjectPool() = default;
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+	~ObjectPool() {
+		clear();
+		shrink();
+	}
+
+	template<typename... Args>
+	Handle create(Args&&... args) {
+		uint32_t index;
+		if (freeHead != NoSlot) {
+			index = freeHead;
+			freeHead = slots[index].nextFree;
+		}
+		else {
+			if (slots.size() == MaxObjects) {
+				std::cout << "ERROR::OBJECT_POOL::FULL: " << MaxObjects << " objects" << std::endl;
+				return Handle();
+			}
+			index = static_cast<uint32_t>(slots.size());
+			// reserve() may already have added the slab
+			if (index / SlabSize >= slabs.size()) addSlab();
+			slots.push_back(Slot{ 1, NoSlot, false });
+		}
+		new (address(index)) T(std::forward<Args>(args)...);
+		Slot& slot = slots[index];
+		slot.alive = true;
+		liveCount++;
+		return Handle(index, slot.generation);
+	}
+
+	// Returns false for a stale or null handle
+	bool destroy(Handle handle) {
+		T* obj = get(handle);
+		if (!obj) return false;
+		obj->~T();
+		uint32_t index = handle.index();
+		Slot& slot = slots[index];
+		slot.alive = false;
+		slot.generation = nextGeneration(slot.generation);
+		slot.nextFree = freeHead;
+		freeHead = index;
+		liveCount--;
+		return true;
+	}
+
+	T* get(Handle handle) {
+		uint32_t index = handle.index();
+		if (index >= slots.size()) return nullptr;
+		const Slot& slot = slots[index];
+		if (!slot.alive || slot.generation != handle.generation()) return nullptr;
+		return address(index);
+	}
+	const T* get(Handle handle) const { return const_cast<ObjectPool*>(this)->get(handle); }
+
+	bool contains(Handle handle) const { return get(handle) != nullptr; }
+
+	// Current handle of a live slot, or null; for ids that only carry the index
+	Handle handleAt(uint32_t index) const {
+		if (index >= slots.size() || !slots[index].alive) return Handle();
+		return Handle(index, slots[index].generation);
+	}
+
+	// fn(Handle, T&) for every live object in slot order
+	template<typename Fn>
+	void forEach(Fn&& fn) {
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].alive) fn(Handle(i, slots[i].generation), *address(i));
+		}
+	}
+	template<typename Fn>
+	void forEach(Fn&& fn) const {
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].alive) fn(Handle(i, slots[i].generation), static_cast<const T&>(*address(i)));
+		}
+	}
+
+	size_t size() const { return liveCount; }
+	bool empty() const { return liveCount == 0; }
+	size_t capacity() const { return slabs.size() * SlabSize; }
+
+	// Room for count objects without allocating in create()
+	void reserve(size_t count) {
+		slots.reserve(count);
+		while (capacity() < count) addSlab();
+	}
+
+	// Destroys every object but keeps the memory. Every slot's generation moves on, so
+	// handles from before stay stale even when their slot is reused.
+	void clear() {
+		freeHead = NoSlot;
+		for (uint32_t i = static_cast<uint32_t>(slots.size()); i-- > 0;) {
+			Slot& slot = slots[i];
+			if (slot.alive) {
+				address(i)->~T();
+				slot.alive = false;
+				slot.generation = nextGeneration(slot.generation);
+			}
+			slot.nextFree = freeHead;
+			freeHead = i;
+		}
+		liveCount = 0;
+	}
+
+	// Frees the slabs of an empty pool. Generations start over, so only call it when no
+	// handles into the pool are kept around.
+	void shrink() {
+		if (liveCount != 0) return;
+		for (T* slab : slabs) MemoryTracker::release(slab);
+		slabs = decltype(slabs)();
+		slots = decltype(slots)();
+		freeHead = NoSlot;
+	}
+
+private:
+	static const uint32_t NoSlot = 0xFFFFFFFFu;
+
+	struct Slot {
+		uint32_t generation;
+		uint32_t nextFree; // next slot on the free list while dead
+		bool alive;
+	};
+
+	TaggedVector<T*, Tag> slabs;
+	TaggedVector<Slot, Tag> slots;
+	uint32_t freeHead = NoSlot;
+	size_t liveCount = 0;
+
+	// skips 0 when it wraps, which would read as the null handle
+	static uint32_t nextGeneration(uint32_t generation) {
+		generation = (generation + 1) & Handle::GenerationMask;
+		return generation ? generation : 1;
+	}
+
+	T* address(uint32_t index) const { return slabs[index / SlabSize] + index % SlabSize; }
+
+	void addSlab() {
+		void* memory = MemoryTracker::allocate(sizeof(T) * SlabSize, Tag, alignof(T));
+		if (!memory) throw std::bad_alloc();
+		slabs.push_back(static_cast<T*>(memory));
+	}
+};
@@ -5,56 +5,16 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader.h"
-
-// Ray intersection function
-bool rayIntersectsAABB(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& boxMin, const glm::vec3& boxMax, float& t) // output: distance along ray to intersection
-{
-    float tmin = (boxMin.x - rayOrigin.x) / rayDir.x;
-    float tmax = (boxMax.x - rayOrigin.x) / rayDir.x;
-
-    if (tmin > tmax) std::swap(tmin, tmax);
-
-    float tymin = (boxMin.y - rayOrigin.y) / rayDir.y;
-    float tymax = (boxMax.y - rayOrigin.y) / rayDir.y;
-
-    if (tymin > tymax) std::swap(tymin, tymax);
-
-    if ((tmin > tymax) || (tymin > tmax))
-        return false;
-
-    if (tymin > tmin)
-        tmin = tymin;
-
-    if (tymax < tmax)
-        tmax = tymax;
-
-    float tzmin = (boxMin.z - rayOrigin.z) / rayDir.z;
-    float tzmax = (boxMax.z - rayOrigin.z) / rayDir.z;
-
-    if (tzmin > tzmax) std::swap(tzmin, tzmax);
-
-    if ((tmin > tzmax) || (tzmin > tmax))
-        return false;
-
-    if (tzmin > tmin)
-        tmin = tzmin;
-
-    if (tzmax < tmax)
-        tmax = tzmax;
-
-    t = tmin;
-
-    if (t < 0) {
-        t = tmax;
-        if (t < 0)
-            return false;
-    }
-
-    return true;
-}
+#include "AssetManager.h"
+#include "ECS.h"
+#include "Octree.h"
+#include "Physics.h"
+#include "SceneGraph.h"
+#include "SweepAndPrune.h"
 
 // normal vectors
 static float cubeNormals[] = {
@@ -139,217 +99,171 @@ float cubeEdges[] = { // edges for drawing border
 };
 
 
-// Base object class
-class Object {
-public:
-    glm::vec3 position;
+// Components shared by everything the editor places in the scene. Systems in Scene and
+// ColorPicker iterate them chunk by chunk; see ECS.h.
+struct Transform {
+    glm::vec3 position; // relative to the parent, if any
     glm::vec3 size;
-    glm::vec3 rotation;
-    bool selected;
-    int ID;
-
-    Object(glm::vec3 pos = glm::vec3(0.0f),
-        glm::vec3 sze = glm::vec3(1.0f),
-        glm::vec3 rot = glm::vec3(0.0f))
-        : position(pos), size(sze), rotation(rot), selected(false) {
-    }
-
-    virtual ~Object() = default;
-    virtual void draw(Shader& shader) const = 0;
-    virtual void backDraw(Shader& shader, glm::vec3 color) const = 0;
-    virtual bool intersectsRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& distance) const = 0;
-    bool isSelected() const { return selected; }
-    void toggleSelected() { selected = !selected; }
-};
-
-// Cube class with shared VAO/VBO
-class Cube : public Object {
-public:
-
-    Cube(glm::vec3 pos = glm::vec3(0.0f),
-        glm::vec3 sze = glm::vec3(1.0f),
-        glm::vec3 rot = glm::vec3(0.0f))
-        : Object(pos, sze, rot) {
-        initSharedBuffers();
-    }
-
-    void draw(Shader& shader) const override {
-        shader.use();
+    glm::vec3 rotation; // degrees
 
-        // --- Draw filled cube ---
+    glm::mat4 modelMatrix() const {
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, position);
         model = glm::scale(model, size);
         model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1, 0, 0));
         model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0, 1, 0));
         model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0, 0, 1));
-        shader.setMat4("model", model);
-        shader.setVec3("inColor", glm::vec3(0.9f, 0.3f, 0.3f));
-
-        glBindVertexArray(sharedVAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        // draw border if selected
-        if (selected) {
-            shader.setVec3("inColor", glm::vec3(0.47f, 0.87f, 0.9f));
-            shader.setMat4("model", model);
-            
-            glLineWidth(4.0f);
-
-            glBindVertexArray(edgeVAO);
-            glDrawArrays(GL_LINES, 0, 24);
-            glBindVertexArray(0);
-
-            // draw transform lines
-            shader.setMat4("model", model); // or your transform
-            glLineWidth(20.0f);
-            glBindVertexArray(normalVAO);
-
-            // Set color red for X axis lines
-            shader.setVec3("inColor", glm::vec3(1.0f, 0.0f, 0.0f));
-            glDrawArrays(GL_LINES, 0, 4);
-
-            // Set color green for Y axis lines
-            shader.setVec3("inColor", glm::vec3(0.0f, 1.0f, 0.0f));
-            glDrawArrays(GL_LINES, 4, 4);
-
-            // Set color blue for Z axis lines
-            shader.setVec3("inColor", glm::vec3(0.0f, 0.0f, 1.0f));
-            glDrawArrays(GL_LINES, 8, 4);
-
-            glBindVertexArray(0);
-        }
+        return model;
     }
 
-    void backDraw(Shader& shader, glm::vec3 color) const override {
-        shader.use();
-
-        // --- Draw filled cube ---
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, position);
-        model = glm::scale(model, size);
-        model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1, 0, 0));
-        model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0, 1, 0));
-        model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0, 0, 1));
-        shader.setMat4("model", model);
-        shader.setVec3("pickingColor", color);
-
-        glBindVertexArray(sharedVAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        if (selected) {
-            shader.setVec3("pickingColor", glm::vec3(0.47f, 0.87f, 0.9f));
-            shader.setMat4("model", model);
-
-            glLineWidth(4.0f);
-
-            glBindVertexArray(edgeVAO);
-            glDrawArrays(GL_LINES, 0, 24);
-            glBindVertexArray(0);
-
-            // draw transform lines
-            shader.setMat4("model", model); // or your transform
-            glLineWidth(20.0f);
-            glBindVertexArray(normalVAO);
-
-            // Set color red for X axis lines
-            shader.setVec3("pickingColor", glm::vec3(1.0f, 0.0f, 0.0f));
-            glDrawArrays(GL_LINES, 0, 4);
-
-            // Set color green for Y axis lines
-            shader.setVec3("pickingColor", glm::vec3(0.0f, 1.0f, 0.0f));
-            glDrawArrays(GL_LINES, 4, 4);
-
-            // Set color blue for Z axis lines
-            shader.setVec3("pickingColor", glm::vec3(0.0f, 0.0f, 1.0f));
-            glDrawArrays(GL_LINES, 8, 4);
+    // Scaled along the object's own axes, then turned: the box a rigid body simulates.
+    // modelMatrix() scales after turning, which shears a turned box with unequal sides.
+    glm::mat4 boxMatrix() const {
+        glm::mat4 model = glm::mat4_cast(orientation());
+        model[3] = glm::vec4(position, 1.0f);
+        return glm::scale(model, size);
+    }
 
-            glBindVertexArray(0);
-        }
+    // the same rotation as a quaternion
+    glm::quat orientation() const {
+        return glm::angleAxis(glm::radians(rotation.x), glm::vec3(1, 0, 0)) *
+            glm::angleAxis(glm::radians(rotation.y), glm::vec3(0, 1, 0)) *
+            glm::angleAxis(glm::radians(rotation.z), glm::vec3(0, 0, 1));
     }
 
-    static void cleanupSharedBuffers() {
-        if (initialized) {
-            glDeleteVertexArrays(1, &sharedVAO);
-            glDeleteBuffers(1, &sharedVBO);
-            initialized = false;
+    // Back to x, y, z angles. Past 90 degrees about y the x and z turns are the same axis,
+    // and z is left at 0.
+    void setOrientation(const glm::quat& q) {
+        glm::mat3 m = glm::mat3_cast(q);
+        float y = std::asin(glm::clamp(m[2][0], -1.0f, 1.0f));
+        float x, z;
+        if (std::abs(m[2][0]) < 0.9999f) {
+            x = std::atan2(-m[2][1], m[2][2]);
+            z = std::atan2(-m[1][0], m[0][0]);
+        }
+        else {
+            x = std::atan2(m[1][2], m[1][1]);
+            z = 0.0f;
         }
+        rotation = glm::degrees(glm::vec3(x, y, z));
     }
 
-    bool intersectsRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& distance) const override {
-        glm::vec3 boxMin = position - size * 0.5f;
-        glm::vec3 boxMax = position + size * 0.5f;
-        return rayIntersectsAABB(rayOrigin, rayDir, boxMin, boxMax, distance);
-    }
+};
 
-private:
-    static GLuint edgeVAO;
-    static GLuint edgeVBO;
-    static GLuint normalVAO;
-    static GLuint normalVBO;
-    static unsigned int sharedVAO;
-    static unsigned int sharedVBO;
-    static bool initialized;
+// Bounds of the unit cube under a world matrix. The sphere is centered on the translation
+// and reaches the farthest corner, which also holds when a parent's scale shears the box.
+inline float boundingRadius(const glm::mat4& model) {
+    glm::vec3 x = glm::vec3(model[0]), y = glm::vec3(model[1]), z = glm::vec3(model[2]);
+    float corner = glm::max(glm::max(glm::dot(x + y + z, x + y + z), glm::dot(x + y - z, x + y - z)),
+        glm::max(glm::dot(x - y + z, x - y + z), glm::dot(x - y - z, x - y - z)));
+    return 0.5f * std::sqrt(corner);
+}
 
-    static void initSharedBuffers() {
-        if (initialized) return;
+inline void worldAABB(const glm::mat4& model, glm::vec3& boxMin, glm::vec3& boxMax) {
+    glm::vec3 center = glm::vec3(model[3]);
+    glm::vec3 half = 0.5f * (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2])));
+    boxMin = center - half;
+    boxMax = center + half;
+}
 
-        // initialize cube VAO and VBO
-        glGenVertexArrays(1, &sharedVAO);
-        glGenBuffers(1, &sharedVBO);
+// the entity's node in the scene graph, which holds its world matrix
+struct HierarchyNode {
+    SceneNode node;
+};
 
-        glBindVertexArray(sharedVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, sharedVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+// the entity's box in the scene's octree and collision broadphase, kept up to date with
+// its world matrix
+struct SpatialEntry {
+    OctreeHandle item;
+    SapHandle proxy;
+};
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+// the entity's rigid body, or a null handle when physics leaves it alone
+struct PhysicsBody {
+    BodyHandle body;
+};
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+// a root's position in double precision, absolute rather than relative to the scene's
+// floating origin (see FloatingOrigin.h); children leave it alone
+struct WorldPosition {
+    glm::dvec3 position;
+};
 
-        // initialize cube edge VAO and VBO
-        glGenVertexArrays(1, &edgeVAO);
-        glGenBuffers(1, &edgeVBO);
+// model matrix of a visible object, copied from the scene graph by the culling system
+struct WorldMatrix {
+    glm::mat4 model;
+};
 
-        glBindVertexArray(edgeVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, edgeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeEdges), cubeEdges, GL_STATIC_DRAW);
+// filled mesh, edge outline and transform gizmo lines, all drawn with the object's model
+struct RenderMesh {
+    MeshHandle fill;
+    MeshHandle edges;
+    MeshHandle gizmo;
+};
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+struct Color {
+    glm::vec3 rgb;
+};
 
-        glBindVertexArray(0);
+struct Selection {
+    bool selected;
+};
 
+// color-picking ID: the entity's table slot + 1, since 0 is the background
+struct PickID {
+    uint32_t id;
+};
 
-        // Normal VAO and VBO
-        glGenVertexArrays(1, &normalVAO);
-        glGenBuffers(1, &normalVBO);
+// written by the culling system each frame
+struct Visibility {
+    bool visible;
+};
 
-        glBindVertexArray(normalVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeNormals), cubeNormals, GL_STATIC_DRAW);
+// ID saved in scene files
+struct SceneID {
+    int32_t id;
+};
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        
-        glBindVertexArray(0);
+// key into the scene file type table
+struct TypeName {
+    const char* name;
+};
 
-        initialized = true;
+// The cube archetype: a box drawn from meshes shared through the asset manager
+namespace cube {
+    inline RenderMesh& sharedMeshes() {
+        static RenderMesh meshes;
+        return meshes;
     }
-};
 
-// Static member definitions
-GLuint Cube::edgeVAO = 0;
-GLuint Cube::edgeVBO = 0;
-GLuint Cube::normalVAO = 0;
-GLuint Cube::normalVBO = 0;
-unsigned int Cube::sharedVAO = 0;
-unsigned int Cube::sharedVBO = 0;
-bool Cube::initialized = false;
+    inline const RenderMesh& meshes() {
+        RenderMesh& shared = sharedMeshes();
+        if (!shared.fill.valid()) {
+            AssetManager& assets = AssetManager::get();
+            shared.fill = assets.loadMesh("cube.fill", cubeVertices, sizeof(cubeVertices) / sizeof(float), GL_TRIANGLES);
+            shared.edges = assets.loadMesh("cube.edges", cubeEdges, sizeof(cubeEdges) / sizeof(float), GL_LINES);
+            shared.gizmo = assets.loadMesh("cube.normals", cubeNormals, sizeof(cubeNormals) / sizeof(float), GL_LINES);
+        }
+        return shared;
+    }
 
+    // drops the cubes' references; the asset manager frees the buffers once they age out
+    inline void releaseMeshes() {
+        RenderMesh& shared = sharedMeshes();
+        if (!shared.fill.valid()) return;
+        AssetManager& assets = AssetManager::get();
+        assets.release(shared.fill);
+        assets.release(shared.edges);
+        assets.release(shared.gizmo);
+        shared = RenderMesh();
+    }
 
+    // node and spatial entry are filled in once the entity has been added to the scene graph,
+    // octree and broadphase
+    inline Entity create(World& world, const Transform& transform, int32_t sceneID, bool selected = false) {
+        Entity entity = world.create(transform, HierarchyNode{ SceneNode() }, SpatialEntry{ OctreeHandle(), SapHandle() }, PhysicsBody{ BodyHandle() }, WorldPosition{ glm::dvec3(0.0) }, WorldMatrix{ glm::mat4(1.0f) }, meshes(), Color{ glm::vec3(0.9f, 0.3f, 0.3f) },
+            Selection{ selected }, PickID{ 0 }, Visibility{ false }, SceneID{ sceneID }, TypeName{ "Cube" });
+        if (PickID* pick = world.get<PickID>(entity)) pick->id = entity.index() + 1;
+        return entity;
+    }
+}
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ECS.h"
+#include "Frustum.h"
+#include "MemoryTracker.h"
+#include "ObjectPool.h"
+#include "Ray.h"
+
+// Loose octree over axis-aligned boxes, for range queries the scene can't answer without
+// walking every object. Every cell's bounds are stretched to twice its size, so a box fits
+// in the cell holding its center on the deepest level whose cells are at least as big as
+// the box. The level and cell follow straight from the box: insert and update descend at
+// most MaxDepth levels whatever the object count, and a move that stays in its cell only
+// rewrites the box. Items are linked into their cell with intrusive lists and empty leaf
+// cells are freed, so once storage has grown nothing allocates.
+//
+// Boxes outside the root's bounds go on an overflow list that every query checks.
+struct OctreeItem {
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	Entity entity;
+	uint32_t node;
+	PoolHandle<OctreeItem> prev;
+	PoolHandle<OctreeItem> next;
+};
+
+using OctreeHandle = PoolHandle<OctreeItem>;
+
+class LooseOctree {
+public:
+	static const int MaxDepth = 12;
+
+	// The root cell spans center +- halfSize; the deepest cells are halfSize / 2^MaxDepth
+	explicit LooseOctree(const glm::vec3& center = glm::vec3(0.0f), float halfSize = 2048.0f) : rootCenter(center), rootHalfSize(halfSize) {
+		addRoot();
+	}
+	LooseOctree(const LooseOctree&) = delete;
+	LooseOctree& operator=(const LooseOctree&) = delete;
+
+	OctreeHandle insert(Entity entity, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		OctreeHandle handle = items.create(OctreeItem{ boxMin, boxMax, entity, NoNode, OctreeHandle(), OctreeHandle() });
+		if (handle.valid()) link(handle, *items.get(handle), findOrCreate(locate(boxMin, boxMax)));
+		return handle;
+	}
+
+	// Room for count boxes, and as many cells, before anything has to grow
+	void reserve(size_t count) {
+		items.reserve(count);
+		nodes.reserve(count);
+	}
+
+	// Returns false for a stale handle
+	bool update(OctreeHandle handle, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		OctreeItem* item = items.get(handle);
+		if (!item) return false;
+		item->boxMin = boxMin;
+		item->boxMax = boxMax;
+		Cell cell = locate(boxMin, boxMax);
+		if (item->node != Overflow && cell.matches(nodes[item->node])) return true;
+		if (item->node == Overflow && cell.level < 0) return true;
+		uint32_t old = unlink(handle, *item);
+		link(handle, *item, findOrCreate(cell));
+		prune(old);
+		return true;
+	}
+
+	// Moves the whole tree by -offset, boxes and cells alike, for the scene's floating origin.
+	// No box changes cell, so this is one pass over the cells and one over the boxes.
+	void rebase(const glm::vec3& offset) {
+		rootCenter -= offset;
+		for (Node& node : nodes) node.center -= offset;
+		items.forEach([&](OctreeHandle, OctreeItem& item) {
+			item.boxMin -= offset;
+			item.boxMax -= offset;
+		});
+	}
+
+	// Rebuilds the tree around a new root center, every box filed afresh. For when the
+	// boxes have moved off the root, as a tree shifted by rebase() ends up doing.
+	void recenter(const glm::vec3& center) {
+		rootCenter = center;
+		nodes.clear();
+		freeNodes.clear();
+		overflowFirst = OctreeHandle();
+		overflowCount = 0;
+		addRoot();
+		items.forEach([&](OctreeHandle handle, OctreeItem& item) {
+			link(handle, item, findOrCreate(locate(item.boxMin, item.boxMax)));
+		});
+	}
+
+	// Boxes outside the root's bounds, which every query goes through one by one
+	size_t overflowSize() const { return overflowCount; }
+
+	bool remove(OctreeHandle handle) {
+		OctreeItem* item = items.get(handle);
+		if (!item) return false;
+		prune(unlink(handle, *item));
+		items.destroy(handle);
+		return true;
+	}
+
+	// Every query writes the entities of the matching boxes to out, up to capacity, and
+	// returns how many matched in total; a result larger than capacity means out is cut short.
+	size_t querySphere(const glm::vec3& center, float radius, Entity* out, size_t capacity) const {
+		return query(SphereShape{ center, radius * radius }, out, capacity);
+	}
+
+	size_t queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, Entity* out, size_t capacity) const {
+		return query(BoxShape{ boxMin, boxMax }, out, capacity);
+	}
+
+	size_t queryFrustum(const Frustum& frustum, Entity* out, size_t capacity) const {
+		return query(FrustumShape{ frustum }, out, capacity);
+	}
+
+	// The nearest box along the ray, or a null entity; distance gets where the ray enters it,
+	// 0 if it starts inside. Cells are visited nearest first and dropped once they start past
+	// the best hit so far; children and items are tested eight at a time.
+	Entity raycast(const Ray& ray, float& distance) const {
+		return raycast(ray, distance, [](Entity, float boxDistance, float& hitDistance) {
+			hitDistance = boxDistance;
+			return true;
+		});
+	}
+
+	// The same walk with an exact test behind the boxes: exact(entity, boxDistance, hit) is
+	// called for each box the ray reaches before the best hit so far, with hit holding that
+	// best, and returns true after lowering hit if the object itself is hit closer.
+	template<typename Exact>
+	Entity raycast(const Ray& ray, float& distance, Exact&& exact) const {
+		Ray bounded = ray;
+		Entity hit;
+		bool found = false;
+		AABB8 batch;
+		Entity batchEntities[8];
+		int batchCount = 0;
+		float t[8];
+		auto testItems = [&](OctreeHandle h) {
+			while (h.valid()) {
+				const OctreeItem& item = *items.get(h);
+				batch.set(batchCount, item.boxMin, item.boxMax);
+				batchEntities[batchCount++] = item.entity;
+				h = item.next;
+				if (batchCount < 8 && h.valid()) continue;
+				int mask = rayAABB8(bounded, batch, t);
+				for (int i = 0; i < batchCount; i++) {
+					if (!(mask >> i & 1) || (found ? t[i] >= bounded.tMax : t[i] > bounded.tMax)) continue;
+					float hitDistance = bounded.tMax;
+					if (!exact(batchEntities[i], t[i], hitDistance)) continue;
+					hit = batchEntities[i];
+					bounded.tMax = hitDistance;
+					found = true;
+				}
+				batch.clear();
+				batchCount = 0;
+			}
+		};
+		if (!ray.valid()) return Entity();
+		testItems(overflowFirst);
+
+		struct Entry {
+			uint32_t node;
+			float t;
+		};
+		Entry stack[(MaxDepth + 1) * 7 + 1];
+		int top = 0;
+		glm::vec3 rootLoose(nodes[0].halfSize * 2.0f);
+		if (rayAABB(bounded, nodes[0].center - rootLoose, nodes[0].center + rootLoose, t[0])) stack[top++] = Entry{ 0, t[0] };
+		while (top > 0) {
+			Entry entry = stack[--top];
+			if (entry.t > bounded.tMax) continue;
+			const Node& node = nodes[entry.node];
+			testItems(node.first);
+			if (node.childCount == 0) continue;
+			AABB8 cells;
+			uint32_t children[8];
+			int count = 0;
+			for (uint32_t child : node.children) {
+				if (child == NoNode) continue;
+				glm::vec3 loose(nodes[child].halfSize * 2.0f);
+				cells.set(count, nodes[child].center - loose, nodes[child].center + loose);
+				children[count++] = child;
+			}
+			int mask = rayAABB8(bounded, cells, t);
+			// pushed farthest first, so the nearest comes off the stack next
+			int first = top;
+			for (int i = 0; i < count; i++) {
+				if (!(mask >> i & 1)) continue;
+				int j = top++;
+				for (; j > first && stack[j - 1].t < t[i]; j--) stack[j] = stack[j - 1];
+				stack[j] = Entry{ children[i], t[i] };
+			}
+		}
+		if (found) distance = bounded.tMax;
+		return hit;
+	}
+
+	size_t size() const { return items.size(); }
+	size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+
+	// Removes every item and frees all storage
+	void clear() {
+		items.clear();
+		items.shrink();
+		nodes = decltype(nodes)();
+		freeNodes = decltype(freeNodes)();
+		overflowFirst = OctreeHandle();
+		overflowCount = 0;
+		addRoot();
+	}
+
+private:
+	static const uint32_t NoNode = ~0u;
+	static const uint32_t Overflow = ~0u - 1;
+
+	struct Node {
+		glm::vec3 center;
+		float halfSize; // of the cell; the loose bounds are twice that
+		uint32_t parent;
+		uint32_t children[8];
+		OctreeHandle first;
+		uint32_t itemCount;
+		uint16_t x, y, z; // cell coordinates on its level
+		uint8_t level;
+		uint8_t childCount;
+	};
+
+	// where a box belongs: a cell on a level, or level -1 for the overflow list
+	struct Cell {
+		int level;
+		uint32_t x, y, z;
+		bool matches(const Node& node) const { return node.level == level && node.x == x && node.y == y && node.z == z; }
+	};
+
+	enum Overlap { Outside, Partial, Inside };
+
+	// test() classifies a cell's loose bounds, overlaps() is the cheaper check for an item
+	struct SphereShape {
+		glm::vec3 center;
+		float radiusSquared;
+		bool overlaps(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+			glm::vec3 nearest = glm::clamp(center, boxMin, boxMax) - center;
+			return glm::dot(nearest, nearest) <= radiusSquared;
+		}
+		Overlap test(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+			glm::vec3 nearest = glm::clamp(center, boxMin, boxMax) - center;
+			if (glm::dot(nearest, nearest) > radiusSquared) return Outside;
+			glm::vec3 farthest = glm::max(glm::abs(boxMin - center), glm::abs(boxMax - center));
+			return glm::dot(farthest, farthest) <= radiusSquared ? Inside : Partial;
+		}
+	};
+
+	struct BoxShape {
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		bool overlaps(const glm::vec3& otherMin, const glm::vec3& otherMax) const {
+			return otherMin.x <= boxMax.x && otherMin.y <= boxMax.y && otherMin.z <= boxMax.z &&
+				otherMax.x >= boxMin.x && otherMax.y >= boxMin.y && otherMax.z >= boxMin.z;
+		}
+		Overlap test(const glm::vec3& otherMin, const glm::vec3& otherMax) const {
+			if (!overlaps(otherMin, otherMax)) return Outside;
+			bool inside = otherMin.x >= boxMin.x && otherMin.y >= boxMin.y && otherMin.z >= boxMin.z &&
+				otherMax.x <= boxMax.x && otherMax.y <= boxMax.y && otherMax.z <= boxMax.z;
+			return inside ? Inside : Partial;
+		}
+	};
+
+	struct FrustumShape {
+		const Frustum& frustum;
+		bool overlaps(const glm::vec3& boxMin, const glm::vec3& boxMax) const { return frustum.intersectsAABB(boxMin, boxMax); }
+		Overlap test(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+			if (!frustum.intersectsAABB(boxMin, boxMax)) return Outside;
+			return frustum.containsAABB(boxMin, boxMax) ? Inside : Partial;
+		}
+	};
+
+	glm::vec3 rootCenter;
+	float rootHalfSize;
+	TaggedVector<Node, MemTag::Scene> nodes;
+	TaggedVector<uint32_t, MemTag::Scene> freeNodes;
+	ObjectPool<OctreeItem, MemTag::Scene> items;
+	OctreeHandle overflowFirst;
+	uint32_t overflowCount = 0;
+
+	void addRoot() {
+		Node root = {};
+		root.center = rootCenter;
+		root.halfSize = rootHalfSize;
+		root.parent = NoNode;
+		std::fill(std::begin(root.children), std::end(root.children), NoNode);
+		nodes.push_back(root);
+	}
+
+	Cell locate(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		glm::vec3 half = (boxMax - boxMin) * 0.5f;
+		float extent = std::max(half.x, std::max(half.y, half.z));
+		glm::vec3 offset = center - rootCenter;
+		if (!(extent <= rootHalfSize) || !(std::abs(offset.x) <= rootHalfSize && std::abs(offset.y) <= rootHalfSize && std::abs(offset.z) <= rootHalfSize))
+			return Cell{ -1, 0, 0, 0 };
+		int level = 0;
+		float cellHalf = rootHalfSize;
+		while (level < MaxDepth && extent <= cellHalf * 0.5f) {
+			cellHalf *= 0.5f;
+			level++;
+		}
+		float cells = static_cast<float>(1u << level);
+		glm::vec3 cell = (offset + rootHalfSize) / (2.0f * cellHalf);
+		auto coordinate = [&](float c) { return static_cast<uint32_t>(std::min(std::max(c, 0.0f), cells - 1.0f)); };
+		return Cell{ level, coordinate(cell.x), coordinate(cell.y), coordinate(cell.z) };
+	}
+
+	uint32_t findOrCreate(const Cell& cell) {
+		if (cell.level < 0) return Overflow;
+		uint32_t index = 0;
+		for (int level = 1; level <= cell.level; level++) {
+			int shift = cell.level - level;
+			uint32_t bx = (cell.x >> shift) & 1, by = (cell.y >> shift) & 1, bz = (cell.z >> shift) & 1;
+			uint32_t slot = bx | (by << 1) | (bz << 2);
+			uint32_t child = nodes[index].children[slot];
+			if (child == NoNode) {
+				child = addChild(index, slot);
+				nodes[child].x = static_cast<uint16_t>(cell.x >> shift);
+				nodes[child].y = static_cast<uint16_t>(cell.y >> shift);
+				nodes[child].z = static_cast<uint16_t>(cell.z >> shift);
+			}
+			index = child;
+		}
+		return index;
+	}
+
+	uint32_t addChild(uint32_t parent, uint32_t slot) {
+		Node child = {};
+		float half = nodes[parent].halfSize * 0.5f;
+		child.center = nodes[parent].center + glm::vec3((slot & 1) ? half : -half, (slot & 2) ? half : -half, (slot & 4) ? half : -half);
+		child.halfSize = half;
+		child.parent = parent;
+		child.level = static_cast<uint8_t>(nodes[parent].level + 1);
+		std::fill(std::begin(child.children), std::end(child.children), NoNode);
+		uint32_t index;
+		if (!freeNodes.empty()) {
+			index = freeNodes.back();
+			freeNodes.pop_back();
+			nodes[index] = child;
+		}
+		else {
+			index = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(child);
+		}
+		nodes[parent].children[slot] = index;
+		nodes[parent].childCount++;
+		return index;
+	}
+
+	void link(OctreeHandle handle, OctreeItem& item, uint32_t node) {
+		OctreeHandle& first = node == Overflow ? overflowFirst : nodes[node].first;
+		item.node = node;
+		item.prev = OctreeHandle();
+		item.next = first;
+		if (OctreeItem* next = items.get(first)) next->prev = handle;
+		first = handle;
+		if (node == Overflow) overflowCount++;
+		else nodes[node].itemCount++;
+	}
+
+	// Returns the node the item was in
+	uint32_t unlink(OctreeHandle handle, OctreeItem& item) {
+		OctreeHandle& first = item.node == Overflow ? overflowFirst : nodes[item.node].first;
+		if (OctreeItem* prev = items.get(item.prev)) prev->next = item.next;
+		else first = item.next;
+		if (OctreeItem* next = items.get(item.next)) next->prev = item.prev;
+		if (item.node == Overflow) overflowCount--;
+		else nodes[item.node].itemCount--;
+		return item.node;
+	}
+
+	// Frees node and its ancestors for as long as they are empty leaves
+	void prune(uint32_t node) {
+		while (node != Overflow && node != 0 && nodes[node].itemCount == 0 && nodes[node].childCount == 0) {
+			uint32_t parent = nodes[node].parent;
+			for (uint32_t& child : nodes[parent].children) {
+				if (child == node) child = NoNode;
+			}
+			nodes[parent].childCount--;
+			freeNodes.push_back(node);
+			node = parent;
+		}
+	}
+
+	template<typename Shape>
+	static void emit(const OctreeItem& item, const Shape& shape, bool inside, Entity* out, size_t capacity, size_t& count) {
+		if (!inside && !shape.overlaps(item.boxMin, item.boxMax)) return;
+		if (count < capacity) out[count] = item.entity;
+		count++;
+	}
+
+	template<typename Shape>
+	size_t query(const Shape& shape, Entity* out, size_t capacity) const {
+		size_t count = 0;
+		for (OctreeHandle h = overflowFirst; h.valid();) {
+			const OctreeItem& item = *items.get(h);
+			emit(item, shape, false, out, capacity, count);
+			h = item.next;
+		}
+		// depth-first with an explicit stack; a node whose loose bounds are wholly inside
+		// the shape takes its whole subtree without testing each box
+		struct Entry {
+			uint32_t node;
+			bool inside;
+		};
+		Entry stack[(MaxDepth + 1) * 7 + 1];
+		int top = 0;
+		stack[top++] = Entry{ 0, false };
+		while (top > 0) {
+			Entry entry = stack[--top];
+			const Node& node = nodes[entry.node];
+			bool inside = entry.inside;
+			if (!inside) {
+				glm::vec3 loose(node.halfSize * 2.0f);
+				Overlap overlap = shape.test(node.center - loose, node.center + loose);
+				if (overlap == Outside) continue;
+				inside = overlap == Inside;
+			}
+			for (OctreeHandle h = node.first; h.valid();) {
+				const OctreeItem& item = *items.get(h);
+				emit(item, shape, inside, out, capacity, count);
+				h = item.next;
+			}
+			if (node.childCount == 0) continue;
+			for (uint32_t child : node.children) {
+				if (child != NoNode) stack[top++] = Entry{ child, inside };
+			}
+		}
+		return count;
+	}
+};
@@ -0,0 +1,696 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ECS.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "OBB.h"
+#include "ObjectPool.h"
+#include "SweepAndPrune.h"
+
+// Rigid boxes under gravity. update() runs whole steps of FixedStep seconds however long
+// the frame was, and a body's drawn pose is blended between its last two steps so motion
+// stays smooth when frames and steps don't line up.
+//
+// A step: the awake bodies' boxes go through the sweep-and-prune broadphase, each pair with
+// an awake body gets its contact points from collideOBBs() in parallel, and the bodies the
+// contacts connect are grouped into islands with a union-find. Each island is solved by
+// sequential impulses (Catto, "Iterative Dynamics with Temporal Coherence", GDC 2005) on
+// whichever worker picks it up: non-penetration and friction at every contact, warm started
+// with last step's impulses, then the island's bodies are moved. Nothing is shared between
+// islands; a contact with a static body goes to a zero-velocity slot of the island's own.
+//
+// An island that has been nearly still for TimeToSleep seconds goes to sleep and costs
+// nothing but its place in the broadphase until an awake body touches it or it is moved.
+struct RigidBody {
+	glm::vec3 position;
+	glm::quat orientation;
+	glm::vec3 linearVelocity;
+	glm::vec3 angularVelocity; // radians per second, in world space
+	glm::vec3 halfExtents;
+	float inverseMass; // 0 for a static body
+	glm::vec3 inverseInertia; // about the body's own axes
+	Entity owner;
+	// the pose before the last step, for blending
+	glm::vec3 previousPosition;
+	glm::quat previousOrientation;
+	SapHandle proxy;
+	float restingTime; // seconds spent nearly still
+	bool awake; // static bodies never are
+	uint32_t slot; // scratch: its solver slot during a step
+};
+
+using BodyHandle = PoolHandle<RigidBody>;
+
+// Counts from the last step
+struct PhysicsStats {
+	size_t bodies = 0;
+	size_t awake = 0; // after the step; the ones that fell asleep in it were still stepped
+	size_t islands = 0;
+	size_t manifolds = 0;
+	size_t contacts = 0;
+};
+
+class PhysicsWorld {
+public:
+	static constexpr float FixedStep = 1.0f / 60.0f;
+	// a slow frame runs at most this many steps and lets the simulation fall behind
+	static const int MaxStepsPerUpdate = 4;
+
+	glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+	float friction = 0.6f;
+	int iterations = 10;
+
+	PhysicsWorld() = default;
+	PhysicsWorld(const PhysicsWorld&) = delete;
+	PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+	// A box of the given half extents; mass 0 makes it static. owner is handed back by
+	// forEachMoved().
+	BodyHandle createBody(Entity owner, const glm::vec3& position, const glm::quat& orientation, const glm::vec3& halfExtents, float mass) {
+		RigidBody body{};
+		body.position = body.previousPosition = position;
+		body.orientation = body.previousOrientation = glm::normalize(orientation);
+		body.owner = owner;
+		body.inverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+		setShape(body, halfExtents);
+		body.awake = mass > 0.0f;
+		BodyHandle handle = bodies.create(body);
+		if (!handle.valid()) return handle;
+		RigidBody* created = bodies.get(handle);
+		glm::vec3 boxMin, boxMax;
+		bounds(*created, boxMin, boxMax);
+		created->proxy = broadphase.insert(toEntity(handle), boxMin, boxMax);
+		return handle;
+	}
+
+	// Returns false for a stale handle. The bodies it touched as of the last step wake, in
+	// case they rested on it, and the next step wakes the rest of their islands.
+	bool destroyBody(BodyHandle handle) {
+		RigidBody* body = bodies.get(handle);
+		if (!body) return false;
+		wakeTouching(handle);
+		broadphase.remove(body->proxy);
+		bodies.destroy(handle);
+		return true;
+	}
+
+	// nullptr once the body has been destroyed
+	const RigidBody* getBody(BodyHandle handle) const { return bodies.get(handle); }
+
+	// Puts the body somewhere else, at rest. Moving a static body wakes everything, since
+	// whatever rested on it may now have to fall.
+	bool setPose(BodyHandle handle, const glm::vec3& position, const glm::quat& orientation, const glm::vec3& halfExtents) {
+		RigidBody* body = bodies.get(handle);
+		if (!body) return false;
+		body->position = body->previousPosition = position;
+		body->orientation = body->previousOrientation = glm::normalize(orientation);
+		setShape(*body, halfExtents);
+		body->linearVelocity = body->angularVelocity = glm::vec3(0.0f);
+		glm::vec3 boxMin, boxMax;
+		bounds(*body, boxMin, boxMax);
+		broadphase.update(body->proxy, boxMin, boxMax);
+		if (body->inverseMass > 0.0f) wake(*body);
+		else wakeAll();
+		return true;
+	}
+
+	// Moves every body by -offset, keeping its motion, for the scene's floating origin
+	void rebase(const glm::vec3& offset) {
+		bodies.forEach([&](BodyHandle, RigidBody& body) {
+			body.position -= offset;
+			body.previousPosition -= offset;
+		});
+		broadphase.rebase(offset);
+	}
+
+	// Puts a body at position with its motion kept, unlike setPose(). For the scene's
+	// floating origin, which places bodies afresh from exact positions after rebase().
+	bool placeBody(BodyHandle handle, const glm::vec3& position) {
+		RigidBody* body = bodies.get(handle);
+		if (!body) return false;
+		body->previousPosition += position - body->position;
+		body->position = position;
+		return true;
+	}
+
+	bool setVelocity(BodyHandle handle, const glm::vec3& linear, const glm::vec3& angular) {
+		RigidBody* body = bodies.get(handle);
+		if (!body || body->inverseMass == 0.0f) return false;
+		body->linearVelocity = linear;
+		body->angularVelocity = angular;
+		wake(*body);
+		return true;
+	}
+
+	// Runs as many steps as the time since the last call covers and returns how many
+	int update(float deltaTime) {
+		accumulator += std::max(deltaTime, 0.0f);
+		int steps = 0;
+		for (; accumulator >= FixedStep && steps < MaxStepsPerUpdate; steps++) {
+			if (steps == 0) moved.clear();
+			step();
+			moved.insert(moved.end(), stepped.begin(), stepped.end());
+			accumulator -= FixedStep;
+		}
+		// a body stepped more than once is listed once
+		if (steps > 1) {
+			std::sort(moved.begin(), moved.end(), [](BodyHandle a, BodyHandle b) { return a.value < b.value; });
+			moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+		}
+		// too far behind to catch up: drop the backlog rather than spiral
+		if (steps == MaxStepsPerUpdate) accumulator = std::fmod(accumulator, FixedStep);
+		return steps;
+	}
+
+	// How far the time update() has been given is past the last step, in steps
+	float interpolation() const { return accumulator / FixedStep; }
+
+	// fn(owner, position, orientation) for every body the steps of the last update() that
+	// ran any moved, blended between its last step and the one before. A body that went to
+	// sleep in any of them gets its final pose.
+	template<typename Fn>
+	void forEachMoved(Fn&& fn) const {
+		float alpha = interpolation();
+		for (BodyHandle handle : moved) {
+			const RigidBody* body = bodies.get(handle);
+			if (!body) continue;
+			if (!body->awake) {
+				fn(body->owner, body->position, body->orientation);
+				continue;
+			}
+			glm::quat from = body->previousOrientation;
+			if (glm::dot(from, body->orientation) < 0.0f) from = -from;
+			glm::quat blended = glm::normalize(from * (1.0f - alpha) + body->orientation * alpha);
+			fn(body->owner, glm::mix(body->previousPosition, body->position, alpha), blended);
+		}
+	}
+
+	// One step of FixedStep seconds
+	void step() {
+		JobSystem& jobs = JobSystem::get();
+		stepped.clear();
+		bodies.forEach([&](BodyHandle handle, RigidBody& body) {
+			if (!body.awake) return;
+			body.previousPosition = body.position;
+			body.previousOrientation = body.orientation;
+			stepped.push_back(handle);
+			glm::vec3 boxMin, boxMax;
+			bounds(body, boxMin, boxMax);
+			broadphase.update(body.proxy, boxMin, boxMax);
+		});
+
+		// A sleeping body an awake one has reached wakes now, along with everything resting
+		// on it, so their contacts are in this step too. Two sleeping or static bodies don't
+		// need their contact. It keeps its resting time, so one that was only brushed by the
+		// bounds goes straight back to sleep instead of waking its neighbours in turn.
+		const TaggedVector<OverlapPair, MemTag::Scene>& overlaps = broadphase.findPairs();
+		for (bool woke = true; woke;) {
+			woke = false;
+			for (const OverlapPair& pair : overlaps) {
+				RigidBody* a = bodies.get(toBody(pair.a));
+				RigidBody* b = bodies.get(toBody(pair.b));
+				if (a->awake == b->awake) continue;
+				RigidBody* sleeping = a->awake ? b : a;
+				if (sleeping->inverseMass == 0.0f) continue;
+				stepped.push_back(toBody(a->awake ? pair.b : pair.a));
+				wake(*sleeping);
+				sleeping->restingTime = TimeToSleep;
+				sleeping->previousPosition = sleeping->position;
+				sleeping->previousOrientation = sleeping->orientation;
+				woke = true;
+			}
+		}
+		candidates.clear();
+		for (const OverlapPair& pair : overlaps) {
+			BodyHandle a = toBody(pair.a), b = toBody(pair.b);
+			RigidBody* bodyA = bodies.get(a);
+			RigidBody* bodyB = bodies.get(b);
+			if (!bodyA->awake && !bodyB->awake) continue;
+			if (b.value < a.value) {
+				std::swap(a, b);
+				std::swap(bodyA, bodyB);
+			}
+			Manifold manifold;
+			manifold.a = a;
+			manifold.b = b;
+			manifold.bodyA = bodyA;
+			manifold.bodyB = bodyB;
+			candidates.push_back(manifold);
+		}
+
+		jobs.parallelFor(candidates.size(), 256, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) collide(candidates[i]);
+		});
+		manifolds.clear();
+		for (const Manifold& manifold : candidates) {
+			if (manifold.count > 0) manifolds.push_back(manifold);
+		}
+
+		buildIslands();
+		jobs.parallelFor(islands.size(), 32, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) solveIsland(islands[i]);
+		});
+		remember();
+
+		lastStats.bodies = bodies.size();
+		lastStats.awake = 0;
+		for (BodyHandle handle : stepped) lastStats.awake += bodies.get(handle)->awake;
+		lastStats.islands = islands.size();
+		lastStats.manifolds = manifolds.size();
+		lastStats.contacts = 0;
+		for (const Manifold& manifold : manifolds) lastStats.contacts += manifold.count;
+	}
+
+	const PhysicsStats& stats() const { return lastStats; }
+	size_t size() const { return bodies.size(); }
+
+	// Removes every body and frees all storage
+	void clear() {
+		bodies.clear();
+		bodies.shrink();
+		broadphase.clear();
+		for (auto* list : { &candidates, &manifolds }) *list = TaggedVector<Manifold, MemTag::Scene>();
+		stepped = decltype(stepped)();
+		moved = decltype(moved)();
+		cache = decltype(cache)();
+		cacheTable = decltype(cacheTable)();
+		accumulator = 0.0f;
+		lastStats = PhysicsStats();
+	}
+
+private:
+	// boxes closer than this already get contacts, so the solver sees them coming
+	static constexpr float ContactMargin = 0.02f;
+	// penetration left alone, and the fraction of the rest pushed out per step
+	static constexpr float Slop = 0.005f;
+	static constexpr float Baumgarte = 0.2f;
+	static constexpr float LinearDamping = 0.01f;
+	static constexpr float AngularDamping = 0.05f;
+	static constexpr float SleepLinearSpeed = 0.05f;
+	static constexpr float SleepAngularSpeed = 0.05f;
+	static constexpr float TimeToSleep = 0.5f;
+	static constexpr float FrictionWarmStart = 0.85f;
+
+	struct Contact {
+		glm::vec3 local; // on a, in a's frame, for matching next step's contacts
+		glm::vec3 rA, rB; // from each center
+		float separation;
+		float normalMass;
+		float tangentMass[2];
+		float target; // normal speed the solver aims for
+		float push; // separating speed that corrects the overlap, moving the bodies without keeping it
+		float pushImpulse;
+		float normalImpulse;
+		float tangentImpulse[2];
+	};
+
+	struct Manifold {
+		BodyHandle a, b; // a's handle is the lower
+		RigidBody* bodyA;
+		RigidBody* bodyB;
+		uint32_t slotA = 0, slotB = 0;
+		uint32_t island = 0;
+		glm::vec3 normal; // from a to b
+		glm::vec3 tangents[2];
+		int count = 0;
+		ContactPoint points[4];
+		Contact contacts[4];
+	};
+
+	// last step's impulses, found again by pair and by nearby point
+	struct CachedManifold {
+		uint64_t key;
+		int count;
+		glm::vec3 local[4];
+		float normalImpulse[4];
+		glm::vec3 frictionImpulse[4]; // world space, since the tangents turn
+	};
+
+	// a box with one of these per island, then the island's bodies
+	struct SolverBody {
+		glm::vec3 linearVelocity;
+		glm::vec3 angularVelocity;
+		// the split impulses' part, which only moves the body this step
+		glm::vec3 pushVelocity;
+		glm::vec3 turnVelocity;
+		glm::mat3 inverseInertia;
+		float inverseMass;
+	};
+
+	struct Island {
+		uint32_t slotBegin, slotEnd;
+		uint32_t manifoldBegin, manifoldEnd;
+	};
+
+	ObjectPool<RigidBody, MemTag::Scene> bodies;
+	SweepAndPrune broadphase;
+	TaggedVector<BodyHandle, MemTag::Scene> stepped; // the bodies the last step moved
+	TaggedVector<BodyHandle, MemTag::Scene> moved; // and the ones the last update() moved
+	TaggedVector<Manifold, MemTag::Scene> candidates, manifolds;
+	TaggedVector<CachedManifold, MemTag::Scene> cache;
+	TaggedVector<uint32_t, MemTag::Scene> cacheTable; // open addressing into cache, index + 1
+	TaggedVector<uint32_t, MemTag::Scene> parents, islandOf, islandManifolds;
+	TaggedVector<Island, MemTag::Scene> islands;
+	TaggedVector<RigidBody*, MemTag::Scene> slotBodies; // nullptr for the static slots
+	TaggedVector<SolverBody, MemTag::Scene> solverBodies;
+	float accumulator = 0.0f;
+	PhysicsStats lastStats;
+
+	// The broadphase files bodies under entity values carrying their own handle
+	static Entity toEntity(BodyHandle handle) { return Entity(handle.index(), handle.generation()); }
+	static BodyHandle toBody(Entity entity) { return BodyHandle(entity.index(), entity.generation()); }
+
+	static uint64_t keyOf(BodyHandle a, BodyHandle b) { return (uint64_t(a.value) << 32) | b.value; }
+
+	static OBB boxOf(const RigidBody& body) {
+		OBB box;
+		box.center = body.position;
+		glm::mat3 rotation = glm::mat3_cast(body.orientation);
+		for (int i = 0; i < 3; i++) box.axes[i] = rotation[i];
+		box.halfExtents = body.halfExtents;
+		return box;
+	}
+
+	static void bounds(const RigidBody& body, glm::vec3& boxMin, glm::vec3& boxMax) {
+		boxOf(body).bounds(boxMin, boxMax);
+		boxMin -= glm::vec3(ContactMargin);
+		boxMax += glm::vec3(ContactMargin);
+	}
+
+	// a solid box of the body's mass
+	static void setShape(RigidBody& body, const glm::vec3& halfExtents) {
+		body.halfExtents = halfExtents;
+		body.inverseInertia = glm::vec3(0.0f);
+		if (body.inverseMass == 0.0f) return;
+		glm::vec3 e = halfExtents * halfExtents;
+		glm::vec3 inertia = 1.0f / (3.0f * body.inverseMass) * glm::vec3(e.y + e.z, e.x + e.z, e.x + e.y);
+		for (int i = 0; i < 3; i++) body.inverseInertia[i] = inertia[i] > 0.0f ? 1.0f / inertia[i] : 0.0f;
+	}
+
+	void wakeAll() {
+		bodies.forEach([](BodyHandle, RigidBody& body) { if (body.inverseMass > 0.0f) wake(body); });
+	}
+
+	// Every dynamic body in the last step's overlaps with handle's
+	void wakeTouching(BodyHandle handle) {
+		Entity entity = toEntity(handle);
+		for (const OverlapPair& pair : broadphase.lastPairs()) {
+			if (pair.a != entity && pair.b != entity) continue;
+			RigidBody* other = bodies.get(toBody(pair.a == entity ? pair.b : pair.a));
+			if (other && other->inverseMass > 0.0f) wake(*other);
+		}
+	}
+
+	static void wake(RigidBody& body) {
+		body.awake = true;
+		body.restingTime = 0.0f;
+	}
+
+	void collide(Manifold& manifold) const {
+		ContactManifold contact;
+		if (!collideOBBs(boxOf(*manifold.bodyA), boxOf(*manifold.bodyB), ContactMargin, contact)) return;
+		manifold.normal = contact.normal;
+		manifold.count = contact.count;
+		std::copy(contact.points, contact.points + contact.count, manifold.points);
+	}
+
+	uint32_t findRoot(uint32_t i) {
+		while (parents[i] != i) {
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+
+	// Groups the stepped bodies by the contacts between them and lays out the solver slots
+	// and manifolds island by island
+	void buildIslands() {
+		uint32_t count = static_cast<uint32_t>(stepped.size());
+		parents.resize(count);
+		std::iota(parents.begin(), parents.end(), 0u);
+		for (uint32_t i = 0; i < count; i++) bodies.get(stepped[i])->slot = i;
+		for (const Manifold& manifold : manifolds) {
+			if (manifold.bodyA->inverseMass == 0.0f || manifold.bodyB->inverseMass == 0.0f) continue;
+			uint32_t a = findRoot(manifold.bodyA->slot), b = findRoot(manifold.bodyB->slot);
+			if (a != b) parents[a] = b;
+		}
+
+		islands.clear();
+		islandOf.assign(count, ~0u);
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t root = findRoot(i);
+			if (islandOf[root] == ~0u) {
+				islandOf[root] = static_cast<uint32_t>(islands.size());
+				islands.push_back(Island{ 0, 1, 0, 0 }); // the static slot
+			}
+			islandOf[i] = islandOf[root];
+			islands[islandOf[i]].slotEnd++;
+		}
+		for (Manifold& manifold : manifolds) {
+			const RigidBody* moving = manifold.bodyA->inverseMass > 0.0f ? manifold.bodyA : manifold.bodyB;
+			manifold.island = islandOf[moving->slot];
+			islands[manifold.island].manifoldEnd++;
+		}
+		uint32_t slots = 0, placed = 0;
+		for (Island& island : islands) {
+			uint32_t size = island.slotEnd, manifoldCount = island.manifoldEnd;
+			island.slotBegin = island.slotEnd = slots;
+			island.manifoldBegin = island.manifoldEnd = placed;
+			slots += size;
+			placed += manifoldCount;
+		}
+
+		slotBodies.resize(slots);
+		solverBodies.resize(slots);
+		for (Island& island : islands) slotBodies[island.slotEnd++] = nullptr;
+		for (uint32_t i = 0; i < count; i++) {
+			RigidBody* body = bodies.get(stepped[i]);
+			Island& island = islands[islandOf[i]];
+			body->slot = island.slotEnd;
+			slotBodies[island.slotEnd++] = body;
+		}
+		islandManifolds.resize(manifolds.size());
+		for (uint32_t m = 0; m < manifolds.size(); m++) {
+			Manifold& manifold = manifolds[m];
+			Island& island = islands[manifold.island];
+			manifold.slotA = manifold.bodyA->inverseMass > 0.0f ? manifold.bodyA->slot : island.slotBegin;
+			manifold.slotB = manifold.bodyB->inverseMass > 0.0f ? manifold.bodyB->slot : island.slotBegin;
+			islandManifolds[island.manifoldEnd++] = m;
+		}
+	}
+
+	const CachedManifold* findCached(uint64_t key) const {
+		if (cacheTable.empty()) return nullptr;
+		size_t mask = cacheTable.size() - 1;
+		for (size_t at = hashOf(key) & mask;; at = (at + 1) & mask) {
+			uint32_t entry = cacheTable[at];
+			if (entry == 0) return nullptr;
+			if (cache[entry - 1].key == key) return &cache[entry - 1];
+		}
+	}
+
+	static size_t hashOf(uint64_t key) {
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDull;
+		key ^= key >> 33;
+		return static_cast<size_t>(key);
+	}
+
+	// Contact offsets, effective masses and target speeds, plus last step's impulses for
+	// the points that are still about where they were
+	void prepare(Manifold& manifold, const CachedManifold* cached) {
+		const RigidBody& a = *manifold.bodyA;
+		const RigidBody& b = *manifold.bodyB;
+		const SolverBody& sa = solverBodies[manifold.slotA];
+		const SolverBody& sb = solverBodies[manifold.slotB];
+		glm::vec3 n = manifold.normal;
+		glm::vec3 t0 = std::abs(n.x) >= 0.57735f ? glm::vec3(n.y, -n.x, 0.0f) : glm::vec3(0.0f, n.z, -n.y);
+		t0 = glm::normalize(t0);
+		manifold.tangents[0] = t0;
+		manifold.tangents[1] = glm::cross(n, t0);
+		glm::quat toLocal = glm::conjugate(a.orientation);
+		float matchDistance = 0.1f * std::min(std::min(a.halfExtents.x, a.halfExtents.y), a.halfExtents.z);
+		auto effectiveMass = [&](const glm::vec3& rA, const glm::vec3& rB, const glm::vec3& direction) {
+			glm::vec3 ra = glm::cross(rA, direction), rb = glm::cross(rB, direction);
+			float k = sa.inverseMass + sb.inverseMass + glm::dot(ra, sa.inverseInertia * ra) + glm::dot(rb, sb.inverseInertia * rb);
+			return k > 0.0f ? 1.0f / k : 0.0f;
+		};
+		for (int i = 0; i < manifold.count; i++) {
+			Contact& contact = manifold.contacts[i];
+			const ContactPoint& point = manifold.points[i];
+			contact.rA = point.position - a.position;
+			contact.rB = point.position - b.position;
+			contact.local = toLocal * contact.rA;
+			contact.separation = point.separation;
+			contact.normalMass = effectiveMass(contact.rA, contact.rB, n);
+			contact.tangentMass[0] = effectiveMass(contact.rA, contact.rB, manifold.tangents[0]);
+			contact.tangentMass[1] = effectiveMass(contact.rA, contact.rB, manifold.tangents[1]);
+			// a gap may close this step; an overlap past the slop is pushed out a bit at a time
+			contact.target = point.separation > 0.0f ? -point.separation / FixedStep : 0.0f;
+			contact.push = Baumgarte / FixedStep * std::max(0.0f, -point.separation - Slop);
+			contact.normalImpulse = contact.tangentImpulse[0] = contact.tangentImpulse[1] = contact.pushImpulse = 0.0f;
+			if (!cached) continue;
+			for (int k = 0; k < cached->count; k++) {
+				glm::vec3 offset = cached->local[k] - contact.local;
+				if (glm::dot(offset, offset) > matchDistance * matchDistance) continue;
+				// friction comes back scaled down, as Bullet's warm starting factor does: all of
+				// it acts like a spring and keeps tall stacks swaying, none lets them creep
+				contact.normalImpulse = cached->normalImpulse[k];
+				contact.tangentImpulse[0] = FrictionWarmStart * glm::dot(cached->frictionImpulse[k], manifold.tangents[0]);
+				contact.tangentImpulse[1] = FrictionWarmStart * glm::dot(cached->frictionImpulse[k], manifold.tangents[1]);
+				break;
+			}
+		}
+	}
+
+	static void applyImpulse(SolverBody& a, SolverBody& b, const glm::vec3& rA, const glm::vec3& rB, const glm::vec3& impulse) {
+		a.linearVelocity -= impulse * a.inverseMass;
+		a.angularVelocity -= a.inverseInertia * glm::cross(rA, impulse);
+		b.linearVelocity += impulse * b.inverseMass;
+		b.angularVelocity += b.inverseInertia * glm::cross(rB, impulse);
+	}
+
+	static glm::vec3 relativeVelocity(const SolverBody& a, const SolverBody& b, const Contact& contact) {
+		return b.linearVelocity + glm::cross(b.angularVelocity, contact.rB) - a.linearVelocity - glm::cross(a.angularVelocity, contact.rA);
+	}
+
+	// One pass over the manifold's contacts: friction within the cone the current normal
+	// impulse allows, then the normal, each impulse clamped as a running total. The overlap
+	// is corrected by separate push impulses (split impulses, as Bullet has them), so the
+	// speed that corrects it isn't kept and resting stacks don't jitter awake.
+	void solve(Manifold& manifold, bool backward) {
+		SolverBody& a = solverBodies[manifold.slotA];
+		SolverBody& b = solverBodies[manifold.slotB];
+		for (int n = 0; n < manifold.count; n++) {
+			Contact& contact = manifold.contacts[backward ? manifold.count - 1 - n : n];
+			float limit = friction * contact.normalImpulse;
+			for (int k = 0; k < 2; k++) {
+				float speed = glm::dot(relativeVelocity(a, b, contact), manifold.tangents[k]);
+				float total = glm::clamp(contact.tangentImpulse[k] - contact.tangentMass[k] * speed, -limit, limit);
+				float change = total - contact.tangentImpulse[k];
+				contact.tangentImpulse[k] = total;
+				applyImpulse(a, b, contact.rA, contact.rB, manifold.tangents[k] * change);
+			}
+			float speed = glm::dot(relativeVelocity(a, b, contact), manifold.normal);
+			float total = std::max(contact.normalImpulse + contact.normalMass * (contact.target - speed), 0.0f);
+			float change = total - contact.normalImpulse;
+			contact.normalImpulse = total;
+			applyImpulse(a, b, contact.rA, contact.rB, manifold.normal * change);
+
+			if (contact.push == 0.0f) continue;
+			glm::vec3 pushSpeed = b.pushVelocity + glm::cross(b.turnVelocity, contact.rB) - a.pushVelocity - glm::cross(a.turnVelocity, contact.rA);
+			total = std::max(contact.pushImpulse + contact.normalMass * (contact.push - glm::dot(pushSpeed, manifold.normal)), 0.0f);
+			glm::vec3 push = manifold.normal * (total - contact.pushImpulse);
+			contact.pushImpulse = total;
+			a.pushVelocity -= push * a.inverseMass;
+			a.turnVelocity -= a.inverseInertia * glm::cross(contact.rA, push);
+			b.pushVelocity += push * b.inverseMass;
+			b.turnVelocity += b.inverseInertia * glm::cross(contact.rB, push);
+		}
+	}
+
+	void solveIsland(const Island& island) {
+		const float dt = FixedStep;
+		for (uint32_t s = island.slotBegin; s < island.slotEnd; s++) {
+			const RigidBody* body = slotBodies[s];
+			SolverBody& solver = solverBodies[s];
+			if (!body) {
+				solver = SolverBody{ glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::mat3(0.0f), 0.0f };
+				continue;
+			}
+			glm::mat3 rotation = glm::mat3_cast(body->orientation);
+			glm::mat3 scaled = rotation;
+			for (int i = 0; i < 3; i++) scaled[i] *= body->inverseInertia[i];
+			solver.linearVelocity = body->linearVelocity + gravity * dt;
+			solver.angularVelocity = body->angularVelocity;
+			solver.pushVelocity = solver.turnVelocity = glm::vec3(0.0f);
+			solver.inverseInertia = scaled * glm::transpose(rotation);
+			solver.inverseMass = body->inverseMass;
+		}
+		// contacts nearest the ground first, so a stack's weight reaches its base within one
+		// pass (Guendelman, Bridson and Fedkiw 2003 order contacts the same way)
+		auto height = [this](const Manifold& manifold) {
+			float a = manifold.bodyA->inverseMass > 0.0f ? -glm::dot(manifold.bodyA->position, gravity) : -std::numeric_limits<float>::max();
+			float b = manifold.bodyB->inverseMass > 0.0f ? -glm::dot(manifold.bodyB->position, gravity) : -std::numeric_limits<float>::max();
+			return std::min(a, b);
+		};
+		std::sort(islandManifolds.begin() + island.manifoldBegin, islandManifolds.begin() + island.manifoldEnd,
+			[&](uint32_t x, uint32_t y) { return height(manifolds[x]) < height(manifolds[y]); });
+		for (uint32_t m = island.manifoldBegin; m < island.manifoldEnd; m++) {
+			Manifold& manifold = manifolds[islandManifolds[m]];
+			prepare(manifold, findCached(keyOf(manifold.a, manifold.b)));
+			SolverBody& a = solverBodies[manifold.slotA];
+			SolverBody& b = solverBodies[manifold.slotB];
+			for (int i = 0; i < manifold.count; i++) {
+				const Contact& contact = manifold.contacts[i];
+				glm::vec3 impulse = manifold.normal * contact.normalImpulse + manifold.tangents[0] * contact.tangentImpulse[0] + manifold.tangents[1] * contact.tangentImpulse[1];
+				applyImpulse(a, b, contact.rA, contact.rB, impulse);
+			}
+		}
+		// every other pass runs backward, so no contact is always solved last and favored
+		for (int iteration = 0; iteration < iterations; iteration++) {
+			if (iteration % 2 == 0) {
+				for (uint32_t m = island.manifoldBegin; m < island.manifoldEnd; m++) solve(manifolds[islandManifolds[m]], false);
+			}
+			else {
+				for (uint32_t m = island.manifoldEnd; m-- > island.manifoldBegin;) solve(manifolds[islandManifolds[m]], true);
+			}
+		}
+
+		float resting = std::numeric_limits<float>::max();
+		for (uint32_t s = island.slotBegin; s < island.slotEnd; s++) {
+			RigidBody* body = slotBodies[s];
+			if (!body) continue;
+			const SolverBody& solver = solverBodies[s];
+			body->linearVelocity = solver.linearVelocity / (1.0f + dt * LinearDamping);
+			body->angularVelocity = solver.angularVelocity / (1.0f + dt * AngularDamping);
+			body->position += (body->linearVelocity + solver.pushVelocity) * dt;
+			glm::vec3 turn = body->angularVelocity + solver.turnVelocity;
+			body->orientation = glm::normalize(body->orientation + glm::quat(0.0f, turn.x, turn.y, turn.z) * body->orientation * (0.5f * dt));
+			const glm::vec3& w = body->angularVelocity;
+			bool still = glm::dot(body->linearVelocity, body->linearVelocity) < SleepLinearSpeed * SleepLinearSpeed &&
+				glm::dot(w, w) < SleepAngularSpeed * SleepAngularSpeed;
+			body->restingTime = still ? body->restingTime + dt : 0.0f;
+			resting = std::min(resting, body->restingTime);
+		}
+		if (resting < TimeToSleep) return;
+		for (uint32_t s = island.slotBegin; s < island.slotEnd; s++) {
+			RigidBody* body = slotBodies[s];
+			if (!body) continue;
+			body->awake = false;
+			body->linearVelocity = body->angularVelocity = glm::vec3(0.0f);
+		}
+	}
+
+	// Keeps this step's impulses for warm starting the next
+	void remember() {
+		cache.resize(manifolds.size());
+		size_t tableSize = 16;
+		while (tableSize < cache.size() * 2) tableSize *= 2;
+		cacheTable.assign(tableSize, 0u);
+		for (size_t m = 0; m < manifolds.size(); m++) {
+			const Manifold& manifold = manifolds[m];
+			CachedManifold& cached = cache[m];
+			cached.key = keyOf(manifold.a, manifold.b);
+			cached.count = manifold.count;
+			for (int i = 0; i < manifold.count; i++) {
+				const Contact& contact = manifold.contacts[i];
+				cached.local[i] = contact.local;
+				cached.normalImpulse[i] = contact.normalImpulse;
+				cached.frictionImpulse[i] = manifold.tangents[0] * contact.tangentImpulse[0] + manifold.tangents[1] * contact.tangentImpulse[1];
+			}
+			size_t at = hashOf(cached.key) & (tableSize - 1);
+			while (cacheTable[at] != 0) at = (at + 1) & (tableSize - 1);
+			cacheTable[at] = static_cast<uint32_t>(m + 1);
+		}
+	}
+};
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "imgui.h"
+#include "MemoryTracker.h"
+
+// Scoped CPU zones recorded into per-thread lock-free rings and collected once per frame.
+//
+//   PROFILE_SCOPE("Scene::draw");
+//
+// An enabled zone costs two clock reads and one ring write, so it is dominated by
+// steady_clock::now(): about 2x a clock read (see benchmarks/profiler_overhead_bench.cpp).
+// A disabled zone is a single relaxed load. Define ENGINE_DISABLE_PROFILER to compile zones
+// out entirely.
+
+struct ProfileEvent {
+	const char* name;   // must be a string literal or otherwise outlive the profiler
+	uint64_t startNs;
+	uint64_t endNs;
+	uint32_t threadIndex;
+	uint32_t depth;
+};
+
+inline uint64_t profilerNowNs() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Single-producer single-consumer ring: the owning thread pushes, the frame collector pops.
+class ProfileRing {
+public:
+	static const uint32_t Capacity = 1 << 14; // power of two
+
+	bool push(const ProfileEvent& event) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		events[h & (Capacity - 1)] = event;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename F>
+	void drain(F&& fn) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		uint32_t h = head.load(std::memory_order_acquire);
+		for (; t != h; t++) fn(events[t & (Capacity - 1)]);
+		tail.store(t, std::memory_order_release);
+	}
+
+	uint32_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+private:
+	ProfileEvent events[Capacity];
+	alignas(64) std::atomic<uint32_t> head{ 0 };
+	alignas(64) std::atomic<uint32_t> tail{ 0 };
+	std::atomic<uint32_t> dropped{ 0 };
+};
+
+// Receives everything the profiler collects, for exporters. zone/counter/frame are called
+// from Profiler::endFrame on the main thread; annotation is called from the thread that
+// recorded it.
+class ProfileSink {
+public:
+	virtual ~ProfileSink() = default;
+	virtual void zone(const ProfileEvent& event, const char* laneName) = 0;
+	virtual void counter(const char* name, uint64_t timeNs, double value) = 0;
+	virtual void annotation(const char* category, const char* name, const char* detail, uint64_t startNs, uint64_t endNs, uint32_t lane) = 0;
+	virtual void frame(uint64_t index, uint64_t startNs, uint64_t endNs) = 0; // last call of each frame
+};
+
+// Rolling timing statistics for one zone name
+struct ZoneStats {
+	static const int Window = 240; // frames kept for percentiles
+
+	const char* name = nullptr;
+	float averageMs = 0.0f;     // exponential moving average of per-frame total
+	float samples[Window] = {};
+	int sampleCount = 0;
+	int nextSample = 0;
+	uint32_t callsLastFrame = 0;
+	float frameTotalMs = 0.0f;  // accumulated during the current frame
+
+	void commitFrame() {
+		averageMs = sampleCount == 0 ? frameTotalMs : averageMs + (frameTotalMs - averageMs) * 0.05f;
+		samples[nextSample] = frameTotalMs;
+		nextSample = (nextSample + 1) % Window;
+		if (sampleCount < Window) sampleCount++;
+	}
+
+	// sorted is scratch space of at least Window floats
+	float percentile(float p, float* sorted) const {
+		if (sampleCount == 0) return 0.0f;
+		std::copy(samples, samples + sampleCount, sorted);
+		int index = std::min(sampleCount - 1, static_cast<int>(p * sampleCount));
+		std::nth_element(sorted, sorted + index, sorted + sampleCount);
+		return sorted[index];
+	}
+};
+
+class Profiler {
+public:
+	static Profiler& get() {
+		static Profiler instance;
+		return instance;
+	}
+
+	std::atomic<bool> enabled{ true };
+
+	static const int MaxCounters = 16;
+
+	// Exporter that sees every zone, counter and annotation; nullptr to detach
+	void setSink(ProfileSink* newSink) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		sink = newSink;
+	}
+
+	// Per-frame value such as draw calls; main thread, sampled at endFrame
+	void counter(const char* name, double value) {
+		for (int i = 0; i < counterCount; i++) {
+			if (counters[i].name == name) {
+				counters[i].value = value;
+				return;
+			}
+		}
+		if (counterCount < MaxCounters) counters[counterCount++] = Counter{ name, value };
+	}
+
+	// One-off timed event with a dynamic detail string (e.g. the path of a loaded asset).
+	// Only exporters see these; nothing is stored when no sink is attached.
+	void annotate(const char* category, const char* name, const char* detail, uint64_t startNs, uint64_t endNs) {
+		if (!enabled.load(std::memory_order_relaxed)) return;
+		uint32_t laneIndex;
+		threadRing(laneIndex);
+		std::lock_guard<std::mutex> lock(registryMutex);
+		if (sink) sink->annotation(category, name, detail, startNs, endNs, laneIndex);
+	}
+
+	ProfileRing& threadRing(uint32_t& threadIndex) {
+		thread_local ProfileRing* ring = nullptr;
+		thread_local uint32_t index = 0;
+		if (!ring) ring = addRing(nullptr, index);
+		threadIndex = index;
+		return *ring;
+	}
+
+	// Extra timeline lane for events that don't come from a CPU thread (GPU timestamps).
+	// The lane's ring has a single producer, like a thread's.
+	uint32_t addLane(const char* name) {
+		uint32_t index;
+		addRing(name, index);
+		return index;
+	}
+
+	ProfileRing& lane(uint32_t index) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		return *rings[index];
+	}
+
+	// Show the frame this many frames back, so lanes whose events arrive late are complete
+	void setDisplayLatency(int frames) {
+		displayLatency = std::max(0, std::min(frames, HistorySize - 1));
+	}
+
+	static uint32_t& threadDepth() {
+		thread_local uint32_t depth = 0;
+		return depth;
+	}
+
+	void beginFrame() {
+		frameStartNs = profilerNowNs();
+	}
+
+	// Drains every thread's ring into the frame record and updates zone statistics.
+	// Call on the main thread after the frame's work (including swap) is done.
+	void endFrame() {
+		uint64_t frameEndNs = profilerNowNs();
+		FrameRecord& frame = history[historyHead];
+		frame.startNs = frameStartNs;
+		frame.endNs = frameEndNs;
+		frame.events.clear();
+
+		for (auto& entry : zones) {
+			entry.second.frameTotalMs = 0.0f;
+			entry.second.callsLastFrame = 0;
+		}
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			for (std::unique_ptr<ProfileRing>& ring : rings) {
+				ring->drain([&](const ProfileEvent& event) {
+					recordContaining(event.startNs).events.push_back(event);
+					if (sink) sink->zone(event, laneNames[event.threadIndex]);
+					ZoneStats& zone = zones[event.name];
+					zone.name = event.name;
+					zone.frameTotalMs += (event.endNs - event.startNs) / 1e6f;
+					zone.callsLastFrame++;
+				});
+				droppedEvents += ring->takeDropped();
+			}
+		}
+		for (auto& entry : zones) entry.second.commitFrame();
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			if (sink) {
+				for (int i = 0; i < counterCount; i++) sink->counter(counters[i].name, frameEndNs, counters[i].value);
+				sink->frame(frameIndex, frameStartNs, frameEndNs);
+			}
+		}
+		frameIndex++;
+
+		frameMs[historyHead] = (frameEndNs - frameStartNs) / 1e6f;
+		displayedFrame = (historyHead + HistorySize - displayLatency) % HistorySize;
+		historyHead = (historyHead + 1) % HistorySize;
+	}
+
+	uint64_t frameCount() const { return frameIndex; }
+	const std::vector<ProfileEvent>& lastFrameEvents() const { return history[displayedFrame].events; }
+	uint64_t lastFrameStartNs() const { return history[displayedFrame].startNs; }
+	uint64_t lastFrameEndNs() const { return history[displayedFrame].endNs; }
+	const std::unordered_map<const char*, ZoneStats>& zoneStats() const { return zones; }
+
+	void drawImGuiWindow() {
+		ImGui::Begin("Profiler");
+		bool on = enabled;
+		if (ImGui::Checkbox("Enabled", &on)) enabled = on;
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &paused);
+		ImGui::SameLine();
+		ImGui::Text("dropped: %u", droppedEvents);
+
+		float lastMs = frameMs[(historyHead + HistorySize - 1) % HistorySize];
+		ImGui::PlotLines("Frame ms", frameMs, HistorySize, historyHead, nullptr, 0.0f, 33.3f, ImVec2(0, 40));
+		ImGui::Text("frame: %.2f ms", lastMs);
+		for (int i = 0; i < counterCount; i++) {
+			if (i > 0) ImGui::SameLine();
+			ImGui::Text("%s: %.0f", counters[i].name, counters[i].value);
+		}
+
+		if (!paused) frozen = history[displayedFrame]; // copy so pausing survives history wrap-around
+		drawFlameGraph(frozen);
+		drawZoneTable();
+		ImGui::End();
+	}
+
+private:
+	static const int HistorySize = 120;
+
+	struct FrameRecord {
+		uint64_t startNs = 0;
+		uint64_t endNs = 0;
+		std::vector<ProfileEvent> events; // capacity is kept between frames
+	};
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ProfileRing>> rings;
+	std::vector<const char*> laneNames;  // nullptr for thread lanes
+	FrameRecord history[HistorySize];
+	float frameMs[HistorySize] = {};
+	int historyHead = 0;
+	int displayedFrame = 0;
+	int displayLatency = 0;
+	FrameRecord frozen;
+	bool paused = false;
+	uint32_t droppedEvents = 0;
+	uint64_t frameStartNs = 0;
+	uint64_t frameIndex = 0;
+	ProfileSink* sink = nullptr;
+
+	struct Counter {
+		const char* name;
+		double value;
+	};
+	Counter counters[MaxCounters];
+	int counterCount = 0;
+	std::unordered_map<const char*, ZoneStats> zones;
+	std::vector<float> scratch;
+
+	// records start with room for a typical frame, so filling the history doesn't allocate
+	Profiler() {
+		MemTagScope memTag(MemTag::General); // may be first used from inside a subsystem's scope
+		for (FrameRecord& record : history) record.events.reserve(256);
+		scratch.resize(ZoneStats::Window);
+	}
+
+	// The ring is taken while the lock is held, since another thread's first scope may grow
+	// rings right after
+	ProfileRing* addRing(const char* name, uint32_t& index) {
+		MemTagScope memTag(MemTag::General);
+		std::lock_guard<std::mutex> lock(registryMutex);
+		rings.push_back(std::unique_ptr<ProfileRing>(new ProfileRing()));
+		laneNames.push_back(name);
+		index = static_cast<uint32_t>(rings.size() - 1);
+		return rings.back().get();
+	}
+
+	// Late events (GPU timestamps) go back into the frame they happened in
+	FrameRecord& recordContaining(uint64_t timeNs) {
+		for (int back = 0; back < HistorySize; back++) {
+			FrameRecord& record = history[(historyHead + HistorySize - back) % HistorySize];
+			if (record.startNs <= timeNs || record.startNs == 0) return record;
+		}
+		return history[historyHead];
+	}
+
+	static ImU32 colorFor(const char* name) {
+		// stable per-zone color from the name pointer
+		uintptr_t h = reinterpret_cast<uintptr_t>(name) * 2654435761u;
+		return IM_COL32(80 + (h >> 8) % 140, 80 + (h >> 16) % 140, 80 + (h >> 24) % 140, 255);
+	}
+
+	// One lane per thread, nested zones stacked downwards, x axis is time within the frame
+	void drawFlameGraph(const FrameRecord& frame) {
+		const float rowHeight = 18.0f;
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		float width = std::max(100.0f, ImGui::GetContentRegionAvail().x);
+		uint32_t maxDepth = 0, maxThread = 0;
+		for (const ProfileEvent& e : frame.events) {
+			maxDepth = std::max(maxDepth, e.depth);
+			maxThread = std::max(maxThread, e.threadIndex);
+		}
+		float laneHeight = (maxDepth + 1) * rowHeight + 4.0f;
+		float height = laneHeight * (maxThread + 1);
+		double span = frame.endNs > frame.startNs ? static_cast<double>(frame.endNs - frame.startNs) : 1.0;
+
+		ImDrawList* draw = ImGui::GetWindowDrawList();
+		for (const ProfileEvent& e : frame.events) {
+			double start = e.startNs > frame.startNs ? static_cast<double>(e.startNs - frame.startNs) : 0.0;
+			double end = e.endNs > frame.startNs ? static_cast<double>(e.endNs - frame.startNs) : 0.0;
+			ImVec2 a(origin.x + static_cast<float>(start / span) * width, origin.y + e.threadIndex * laneHeight + e.depth * rowHeight);
+			ImVec2 b(origin.x + static_cast<float>(std::min(end, span) / span) * width, a.y + rowHeight - 1.0f);
+			if (b.x - a.x < 1.0f) b.x = a.x + 1.0f;
+			draw->AddRectFilled(a, b, colorFor(e.name));
+			if (b.x - a.x > 40.0f) {
+				draw->PushClipRect(a, b, true);
+				draw->AddText(ImVec2(a.x + 2.0f, a.y + 2.0f), IM_COL32(0, 0, 0, 255), e.name);
+				draw->PopClipRect();
+			}
+			if (ImGui::IsMouseHoveringRect(a, b))
+				ImGui::SetTooltip("%s\n%.3f ms", e.name, (e.endNs - e.startNs) / 1e6);
+		}
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (uint32_t lane = 0; lane <= maxThread && lane < laneNames.size(); lane++) {
+			if (laneNames[lane])
+				draw->AddText(ImVec2(origin.x + width - 40.0f, origin.y + lane * laneHeight), IM_COL32(255, 255, 255, 255), laneNames[lane]);
+		}
+		ImGui::Dummy(ImVec2(width, height));
+	}
+
+	void drawZoneTable() {
+		if (!ImGui::BeginTable("zones", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+		ImGui::TableSetupColumn("Zone");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("Max");
+		ImGui::TableHeadersRow();
+		for (const auto& entry : zones) {
+			const ZoneStats& zone = entry.second;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", zone.name);
+			ImGui::TableNextColumn(); ImGui::Text("%u", zone.callsLastFrame);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", zone.averageMs);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", zone.percentile(0.50f, scratch.data()));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", zone.percentile(0.95f, scratch.data()));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", zone.percentile(0.99f, scratch.data()));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", zone.percentile(1.0f, scratch.data()));
+		}
+		ImGui::EndTable();
+	}
+};
+
+// RAII zone; the name pointer is stored, not copied
+class ProfileScope {
+public:
+	explicit ProfileScope(const char* name) {
+		if (!Profiler::get().enabled.load(std::memory_order_relaxed)) return;
+		event.name = name;
+		event.depth = Profiler::threadDepth()++;
+		event.startNs = profilerNowNs();
+		active = true;
+	}
+
+	~ProfileScope() {
+		if (!active) return;
+		event.endNs = profilerNowNs();
+		Profiler::threadDepth()--;
+		Profiler::get().threadRing(event.threadIndex).push(event);
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	ProfileEvent event;
+	bool active = false;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENGINE_DISABLE_PROFILER
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#endif
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#define ENGINE_RAY_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_RAY_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Ray against axis-aligned box slab tests: one ray against 4 or 8 boxes, and 8 rays against
+// one box. Boxes go in structure-of-arrays packets so one SIMD instruction handles a whole
+// coordinate; SSE2 builds run 4 lanes at a time, AVX builds (ENGINE_AVX2 in CMake) 8, and
+// anything else falls back to the scalar rayAABB(), which gives bit-identical results.
+//
+// Each axis takes the slab plane facing the ray as its near plane, chosen from the sign of
+// the inverse direction, so there is no swap. A zero direction component has an infinite
+// inverse and an origin on that slab's plane gives 0 * inf = NaN; the min/max below drop a
+// NaN operand, so such an axis imposes no limit and a ray along a face counts as hitting.
+// A ray with a non-finite origin or direction, or a zero direction, never hits anything,
+// and neither does a box packed with NaN or min > max.
+//
+// The far distance is widened by a few ulps before the final compare (Ize, "Robust BVH Ray
+// Traversal", 2013), so rounding in the inverse direction can't make a ray that touches a
+// box at an edge or corner miss it; a hierarchy would otherwise lose the triangle there.
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection;
+	float tMax; // hits farther along than this are ignored; -1 for an invalid ray
+
+	Ray() : origin(0.0f), direction(0.0f), inverseDirection(0.0f), tMax(-1.0f) {}
+
+	// direction needn't be normalized; distances are in units of its length
+	Ray(const glm::vec3& origin, const glm::vec3& direction, float tMax = std::numeric_limits<float>::max())
+		: origin(origin), direction(direction), inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z), tMax(tMax) {
+		bool finiteOrigin = std::isfinite(origin.x) && std::isfinite(origin.y) && std::isfinite(origin.z);
+		bool finiteDirection = std::isfinite(direction.x) && std::isfinite(direction.y) && std::isfinite(direction.z);
+		bool usableDirection = finiteDirection && (direction.x != 0.0f || direction.y != 0.0f || direction.z != 0.0f);
+		if (!finiteOrigin || !usableDirection || std::isnan(tMax)) this->tMax = -1.0f;
+	}
+
+	bool valid() const { return tMax >= 0.0f; }
+	glm::vec3 at(float t) const { return origin + direction * t; }
+};
+
+namespace ray_detail {
+	// 1 + 2 * gamma(3), the bound on the relative error of the slab distances
+	const float FarWidening = 1.0f + 3.0f * std::numeric_limits<float>::epsilon();
+
+	// Same operand order as SSE minps/maxps: a NaN in t leaves the running value alone
+	inline float minDropNaN(float t, float current) { return t < current ? t : current; }
+	inline float maxDropNaN(float t, float current) { return t > current ? t : current; }
+
+	inline bool emptyBox(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		return !(boxMin.x <= boxMax.x && boxMin.y <= boxMax.y && boxMin.z <= boxMax.z);
+	}
+}
+
+// Scalar reference. On a hit, tNear is where the ray enters the box, or 0 if it starts inside.
+inline bool rayAABB(const Ray& ray, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tNear) {
+	if (ray_detail::emptyBox(boxMin, boxMax)) return false;
+	float nearT = 0.0f, farT = std::numeric_limits<float>::infinity();
+	for (int axis = 0; axis < 3; axis++) {
+		float inverse = ray.inverseDirection[axis];
+		bool negative = std::signbit(inverse);
+		float nearPlane = negative ? boxMax[axis] : boxMin[axis];
+		float farPlane = negative ? boxMin[axis] : boxMax[axis];
+		nearT = ray_detail::maxDropNaN((nearPlane - ray.origin[axis]) * inverse, nearT);
+		farT = ray_detail::minDropNaN((farPlane - ray.origin[axis]) * inverse, farT);
+	}
+	tNear = nearT;
+	return nearT <= ray_detail::minDropNaN(farT * ray_detail::FarWidening, ray.tMax);
+}
+
+// N boxes laid out coordinate by coordinate. Unused lanes hold an empty box that no ray hits.
+template<int N>
+struct alignas(32) AABBPacket {
+	static const int Width = N;
+	float minX[N], minY[N], minZ[N];
+	float maxX[N], maxY[N], maxZ[N];
+
+	AABBPacket() { clear(); }
+
+	void clear() {
+		for (int i = 0; i < N; i++) setEmpty(i);
+	}
+
+	// A box with NaN or min > max is stored as the empty box
+	void set(int lane, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		if (ray_detail::emptyBox(boxMin, boxMax)) {
+			setEmpty(lane);
+			return;
+		}
+		minX[lane] = boxMin.x; minY[lane] = boxMin.y; minZ[lane] = boxMin.z;
+		maxX[lane] = boxMax.x; maxY[lane] = boxMax.y; maxZ[lane] = boxMax.z;
+	}
+
+	// +inf to -inf: the near plane is at +inf whichever way the ray points
+	void setEmpty(int lane) {
+		const float inf = std::numeric_limits<float>::infinity();
+		minX[lane] = minY[lane] = minZ[lane] = inf;
+		maxX[lane] = maxY[lane] = maxZ[lane] = -inf;
+	}
+
+	glm::vec3 boxMin(int lane) const { return glm::vec3(minX[lane], minY[lane], minZ[lane]); }
+	glm::vec3 boxMax(int lane) const { return glm::vec3(maxX[lane], maxY[lane], maxZ[lane]); }
+};
+
+using AABB4 = AABBPacket<4>;
+using AABB8 = AABBPacket<8>;
+
+// 8 rays side by side, for testing a bundle (a pixel block, a shotgun of picking rays)
+// against one box at a time
+struct alignas(32) RayPacket8 {
+	float originX[8], originY[8], originZ[8];
+	float inverseX[8], inverseY[8], inverseZ[8];
+	float tMax[8];
+
+	RayPacket8() {
+		for (int i = 0; i < 8; i++) set(i, Ray());
+	}
+
+	void set(int lane, const Ray& ray) {
+		originX[lane] = ray.origin.x; originY[lane] = ray.origin.y; originZ[lane] = ray.origin.z;
+		inverseX[lane] = ray.inverseDirection.x; inverseY[lane] = ray.inverseDirection.y; inverseZ[lane] = ray.inverseDirection.z;
+		tMax[lane] = ray.tMax;
+	}
+
+	Ray ray(int lane) const {
+		Ray r;
+		r.origin = glm::vec3(originX[lane], originY[lane], originZ[lane]);
+		r.inverseDirection = glm::vec3(inverseX[lane], inverseY[lane], inverseZ[lane]);
+		r.direction = 1.0f / r.inverseDirection;
+		r.tMax = tMax[lane];
+		return r;
+	}
+};
+
+// Each returns a bit mask of the lanes hit and writes every lane's entry distance to tNear;
+// only the lanes in the mask mean anything.
+
+#if defined(ENGINE_RAY_SSE)
+namespace ray_detail {
+	// 4 boxes from packet arrays starting at the given lanes (16-byte aligned)
+	inline int slabs4(const Ray& ray, const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ, float* tNear) {
+		// the ray's direction picks which of min and max is the near plane on each axis
+		bool nx = std::signbit(ray.inverseDirection.x), ny = std::signbit(ray.inverseDirection.y), nz = std::signbit(ray.inverseDirection.z);
+		__m128 nearT = _mm_setzero_ps(), farT = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		__m128 origin = _mm_set1_ps(ray.origin.x), inverse = _mm_set1_ps(ray.inverseDirection.x);
+		nearT = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nx ? maxX : minX), origin), inverse), nearT);
+		farT = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nx ? minX : maxX), origin), inverse), farT);
+		origin = _mm_set1_ps(ray.origin.y);
+		inverse = _mm_set1_ps(ray.inverseDirection.y);
+		nearT = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(ny ? maxY : minY), origin), inverse), nearT);
+		farT = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(ny ? minY : maxY), origin), inverse), farT);
+		origin = _mm_set1_ps(ray.origin.z);
+		inverse = _mm_set1_ps(ray.inverseDirection.z);
+		nearT = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nz ? maxZ : minZ), origin), inverse), nearT);
+		farT = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nz ? minZ : maxZ), origin), inverse), farT);
+		_mm_storeu_ps(tNear, nearT);
+		return _mm_movemask_ps(_mm_cmple_ps(nearT, _mm_min_ps(_mm_mul_ps(farT, _mm_set1_ps(ray_detail::FarWidening)), _mm_set1_ps(ray.tMax))));
+	}
+}
+#endif
+
+inline int rayAABB4(const Ray& ray, const AABB4& boxes, float* tNear) {
+#if defined(ENGINE_RAY_SSE)
+	return ray_detail::slabs4(ray, boxes.minX, boxes.minY, boxes.minZ, boxes.maxX, boxes.maxY, boxes.maxZ, tNear);
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; i++) mask |= rayAABB(ray, boxes.boxMin(i), boxes.boxMax(i), tNear[i]) ? 1 << i : 0;
+	return mask;
+#endif
+}
+
+inline int rayAABB8(const Ray& ray, const AABB8& boxes, float* tNear) {
+#if defined(ENGINE_RAY_AVX)
+	bool nx = std::signbit(ray.inverseDirection.x), ny = std::signbit(ray.inverseDirection.y), nz = std::signbit(ray.inverseDirection.z);
+	__m256 nearT = _mm256_setzero_ps(), farT = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	__m256 origin = _mm256_set1_ps(ray.origin.x), inverse = _mm256_set1_ps(ray.inverseDirection.x);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nx ? boxes.maxX : boxes.minX), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nx ? boxes.minX : boxes.maxX), origin), inverse), farT);
+	origin = _mm256_set1_ps(ray.origin.y);
+	inverse = _mm256_set1_ps(ray.inverseDirection.y);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(ny ? boxes.maxY : boxes.minY), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(ny ? boxes.minY : boxes.maxY), origin), inverse), farT);
+	origin = _mm256_set1_ps(ray.origin.z);
+	inverse = _mm256_set1_ps(ray.inverseDirection.z);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nz ? boxes.maxZ : boxes.minZ), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nz ? boxes.minZ : boxes.maxZ), origin), inverse), farT);
+	_mm256_storeu_ps(tNear, nearT);
+	return _mm256_movemask_ps(_mm256_cmp_ps(nearT, _mm256_min_ps(_mm256_mul_ps(farT, _mm256_set1_ps(ray_detail::FarWidening)), _mm256_set1_ps(ray.tMax)), _CMP_LE_OQ));
+#elif defined(ENGINE_RAY_SSE)
+	return ray_detail::slabs4(ray, boxes.minX, boxes.minY, boxes.minZ, boxes.maxX, boxes.maxY, boxes.maxZ, tNear) |
+		ray_detail::slabs4(ray, boxes.minX + 4, boxes.minY + 4, boxes.minZ + 4, boxes.maxX + 4, boxes.maxY + 4, boxes.maxZ + 4, tNear + 4) << 4;
+#else
+	int mask = 0;
+	for (int i = 0; i < 8; i++) mask |= rayAABB(ray, boxes.boxMin(i), boxes.boxMax(i), tNear[i]) ? 1 << i : 0;
+	return mask;
+#endif
+}
+
+// 8 rays against one box; each lane uses its own ray's tMax
+inline int rayPacketAABB(const RayPacket8& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear) {
+	if (ray_detail::emptyBox(boxMin, boxMax)) {
+		for (int i = 0; i < 8; i++) tNear[i] = std::numeric_limits<float>::infinity();
+		return 0;
+	}
+#if defined(ENGINE_RAY_AVX)
+	// blendv takes max where the inverse direction's sign bit is set
+	__m256 nearT = _mm256_setzero_ps(), farT = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	__m256 lo = _mm256_set1_ps(boxMin.x), hi = _mm256_set1_ps(boxMax.x);
+	__m256 origin = _mm256_load_ps(rays.originX), inverse = _mm256_load_ps(rays.inverseX);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(lo, hi, inverse), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(hi, lo, inverse), origin), inverse), farT);
+	lo = _mm256_set1_ps(boxMin.y);
+	hi = _mm256_set1_ps(boxMax.y);
+	origin = _mm256_load_ps(rays.originY);
+	inverse = _mm256_load_ps(rays.inverseY);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(lo, hi, inverse), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(hi, lo, inverse), origin), inverse), farT);
+	lo = _mm256_set1_ps(boxMin.z);
+	hi = _mm256_set1_ps(boxMax.z);
+	origin = _mm256_load_ps(rays.originZ);
+	inverse = _mm256_load_ps(rays.inverseZ);
+	nearT = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(lo, hi, inverse), origin), inverse), nearT);
+	farT = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(hi, lo, inverse), origin), inverse), farT);
+	_mm256_storeu_ps(tNear, nearT);
+	return _mm256_movemask_ps(_mm256_cmp_ps(nearT, _mm256_min_ps(_mm256_mul_ps(farT, _mm256_set1_ps(ray_detail::FarWidening)), _mm256_load_ps(rays.tMax)), _CMP_LE_OQ));
+#elif defined(ENGINE_RAY_SSE)
+	// SSE2 has no blendv: select with the sign bit spread over the lane
+	auto select = [](__m128 lo, __m128 hi, __m128 inverse) {
+		__m128 negative = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(inverse), 31));
+		return _mm_or_ps(_mm_and_ps(negative, hi), _mm_andnot_ps(negative, lo));
+	};
+	int mask = 0;
+	for (int half = 0; half < 8; half += 4) {
+		__m128 nearT = _mm_setzero_ps(), farT = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		const float* origins[3] = { rays.originX + half, rays.originY + half, rays.originZ + half };
+		const float* inverses[3] = { rays.inverseX + half, rays.inverseY + half, rays.inverseZ + half };
+		for (int axis = 0; axis < 3; axis++) {
+			__m128 lo = _mm_set1_ps(boxMin[axis]), hi = _mm_set1_ps(boxMax[axis]);
+			__m128 origin = _mm_load_ps(origins[axis]), inverse = _mm_load_ps(inverses[axis]);
+			nearT = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(select(lo, hi, inverse), origin), inverse), nearT);
+			farT = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(select(hi, lo, inverse), origin), inverse), farT);
+		}
+		_mm_storeu_ps(tNear + half, nearT);
+		mask |= _mm_movemask_ps(_mm_cmple_ps(nearT, _mm_min_ps(_mm_mul_ps(farT, _mm_set1_ps(ray_detail::FarWidening)), _mm_load_ps(rays.tMax + half)))) << half;
+	}
+	return mask;
+#else
+	int mask = 0;
+	for (int i = 0; i < 8; i++) mask |= rayAABB(rays.ray(i), boxMin, boxMax, tNear[i]) ? 1 << i : 0;
+	return mask;
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Work submitted to GL during the current frame; the main loop reports and resets it
+struct RenderStats {
+	uint32_t drawCalls = 0;
+	uint64_t triangles = 0;
+	uint32_t objectsCulled = 0;
+
+	static RenderStats& frame() {
+		static RenderStats stats;
+		return stats;
+	}
+
+	void reset() { *this = RenderStats(); }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include <glm/glm.hpp>
+
+// GL 4.5 / ARB_clip_control, which a 3.3 loader doesn't know
+#ifndef GL_LOWER_LEFT
+#define GL_LOWER_LEFT 0x8CA1
+#endif
+#ifndef GL_ZERO_TO_ONE
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+
+// Reverse-Z depth with an infinite far plane. The projection puts depth 1 at the near plane
+// and lets it fall towards 0 with distance, so nothing is ever too far to draw. A float's
+// exponent spends most of its precision near 0, and 1/distance needs it most far away, so
+// with a 32-bit float depth buffer the two cancel out and depth is about as precise at
+// 10 km as at 10 m. Every pass that tests depth uses perspective() below, clears depth to
+// 0 and keeps fragments that are greater.
+//
+// That only works when depth goes through to the buffer untouched, which needs
+// glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE). Without it GL maps [-1, 1] to [0, 1], and
+// the + 1 that takes rounds away most of the precision reverse-Z gains; the projection then
+// still reverses depth and has no far plane, just with no more precision than before.
+class ReverseZ {
+public:
+	static constexpr float NearPlane = 0.1f;
+
+	static ReverseZ& get() {
+		static ReverseZ instance;
+		return instance;
+	}
+
+	// Needs a current GL context; load is the loader glad was given. Sets the depth state
+	// every pass draws with.
+	void init(GLADloadproc load) {
+		using ClipControlProc = void (APIENTRY*)(GLenum origin, GLenum depth);
+		ClipControlProc clipControl = supportsClipControl() ? reinterpret_cast<ClipControlProc>(load("glClipControl")) : nullptr;
+		zeroToOne = clipControl != nullptr;
+		if (zeroToOne) clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+		else std::cout << "no glClipControl: reverse-Z depth keeps GL's [-1, 1] range and its precision" << std::endl;
+		glClearDepth(0.0);
+		glDepthFunc(GL_GREATER);
+	}
+
+	bool hasClipControl() const { return zeroToOne; }
+
+	// Like glm::perspective with the far plane at infinity and depth reversed
+	glm::mat4 perspective(float fovy, float aspect, float zNear = NearPlane) const {
+		float f = 1.0f / std::tan(fovy * 0.5f);
+		glm::mat4 m(0.0f);
+		m[0][0] = f / aspect;
+		m[1][1] = f;
+		m[2][3] = -1.0f;
+		if (zeroToOne) {
+			m[3][2] = zNear;        // depth = near / distance
+		} else {
+			m[2][2] = 1.0f;         // depth = 2 near / distance - 1
+			m[3][2] = 2.0f * zNear;
+		}
+		return m;
+	}
+
+	// World-space direction of the view ray through a point in normalized device coordinates.
+	// Only the projection's x and y scales come into it, so it holds for any depth mapping.
+	static glm::vec3 viewRay(const glm::mat4& projection, const glm::mat4& view, float ndcX, float ndcY) {
+		glm::vec4 eye(ndcX / projection[0][0], ndcY / projection[1][1], -1.0f, 0.0f);
+		return glm::normalize(glm::vec3(glm::inverse(view) * eye));
+	}
+
+private:
+	bool zeroToOne = false;
+
+	static bool supportsClipControl() {
+		GLint major = 0, minor = 0, count = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major > 4 || (major == 4 && minor >= 5)) return true;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const GLubyte* name = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+			if (name && std::string(reinterpret_cast<const char*>(name)) == "GL_ARB_clip_control") return true;
+		}
+		return false;
+	}
+};
+
+// Color plus a 32-bit float depth buffer for the main pass to draw into, copied to the
+// window afterwards. A window's own depth buffer is 24-bit fixed point, which has nothing
+// for reverse-Z to gain.
+class SceneTarget {
+public:
+	SceneTarget() = default;
+	SceneTarget(const SceneTarget&) = delete;
+	SceneTarget& operator=(const SceneTarget&) = delete;
+	~SceneTarget() { release(); }
+
+	// Binds the target with its viewport, reallocating it when the size has changed
+	void bind(int width, int height) {
+		width = width > 0 ? width : 1;
+		height = height > 0 ? height : 1;
+		if (width != targetWidth || height != targetHeight) allocate(width, height);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, targetWidth, targetHeight);
+	}
+
+	// Copies the color to the window's framebuffer, which is left bound
+	void present() {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, targetWidth, targetHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	GLuint id() const { return framebuffer; }
+
+private:
+	GLuint framebuffer = 0, color = 0, depth = 0;
+	int targetWidth = 0, targetHeight = 0;
+
+	void allocate(int width, int height) {
+		release();
+		targetWidth = width;
+		targetHeight = height;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glGenRenderbuffers(1, &color);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::SCENETARGET::INCOMPLETE: " << width << "x" << height << std::endl;
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void release() {
+		if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+		if (color) glDeleteRenderbuffers(1, &color);
+		if (depth) glDeleteRenderbuffers(1, &depth);
+		framebuffer = color = depth = 0;
+		targetWidth = targetHeight = 0;
+	}
+};
@@ -1,7 +1,26 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include "shader.h"
 #include "Objects.h"
+#include "SceneFile.h"
+#include "SceneText.h"
+#include "FrameArena.h"
+#include "FloatingOrigin.h"
+#include "Frustum.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
+#include "Octree.h"
+#include "MemoryTracker.h"
+#include "MeshBVH.h"
+#include "OBB.h"
+#include "Physics.h"
+#include "Profiler.h"
+#include "Ray.h"
+#include "RenderStats.h"
+#include "SceneGraph.h"
+#include "SweepAndPrune.h"
+#include "VoxelWorld.h"
 #include <iostream>
 
 enum class MoveAxis { None, X, Y, Z };
@@ -14,64 +33,578 @@ struct GizmoState {
 
 class Scene {
 private:
-	Object* selectedObject = nullptr;
+	World world;
+	SceneGraph graph;
+	LooseOctree octree;
+	SweepAndPrune broadphase;
+	PhysicsWorld physics;
+	VoxelWorld voxels;
+	Entity selected;
 	int numObjects = 0;
-	std::vector<Object*> objs;
-public:
-	void addObj(Object *obj) { 
-		objs.push_back(obj); 
-		obj->ID = ++numObjects;
+	glm::dvec3 origin = glm::dvec3(0.0); // where every float position is measured from
+
+	SceneNode nodeOf(Entity entity) const {
+		const HierarchyNode* node = world.get<const HierarchyNode>(entity);
+		return node ? node->node : SceneNode();
 	}
 
-	std::vector<Object*> getObjs() { return objs; }
+	// An object with a rigid body is drawn as the box it simulates
+	glm::mat4 localMatrix(Entity entity, const Transform& transform) const {
+		const PhysicsBody* body = world.get<const PhysicsBody>(entity);
+		return body && body->body.valid() ? transform.boxMatrix() : transform.modelMatrix();
+	}
 
-	Object* getSelectedObj() { return selectedObject; }
+	// Everything but the scene graph node, which the caller is removing
+	void release(Entity entity) {
+		if (entity == selected) selected = Entity();
+		if (const SpatialEntry* entry = world.get<const SpatialEntry>(entity)) {
+			octree.remove(entry->item);
+			broadphase.remove(entry->proxy);
+		}
+		if (const PhysicsBody* body = world.get<const PhysicsBody>(entity)) physics.destroyBody(body->body);
+		world.destroy(entity);
+	}
 
-	void draw(Shader& shader) {
-		for (const Object* obj : objs) {
-			obj->draw(shader);
+	// The cube's entity plus its scene graph node, under parentNode if that's not null
+	Entity addCube(const Transform& transform, int32_t sceneID, bool isSelected, SceneNode parentNode) {
+		Entity entity = cube::create(world, transform, sceneID, isSelected);
+		if (!entity.valid()) return entity;
+		glm::mat4 model = transform.modelMatrix();
+		SceneNode node = graph.create(model, parentNode, entity);
+		if (!node.valid()) {
+			world.destroy(entity);
+			return Entity();
 		}
+		world.get<HierarchyNode>(entity)->node = node;
+		if (!parentNode.valid()) world.get<WorldPosition>(entity)->position = origin + glm::dvec3(transform.position);
+		// a child's box is corrected by the next transform update
+		glm::vec3 boxMin, boxMax;
+		worldAABB(model, boxMin, boxMax);
+		SpatialEntry* entry = world.get<SpatialEntry>(entity);
+		entry->item = octree.insert(entity, boxMin, boxMax);
+		entry->proxy = broadphase.insert(entity, boxMin, boxMax);
+		return entity;
 	}
 
-	void selectObject(Object* obj) {
-		selectedObject = obj;
+public:
+	// How far the camera goes from the origin before followCamera() moves it. A float this
+	// size is good to about a tenth of a millimeter.
+	static constexpr float RebaseDistance = 1024.0f;
+
+	// pos, size and rot are relative to parent when one is given
+	Entity createCube(glm::vec3 pos = glm::vec3(0.0f), glm::vec3 size = glm::vec3(1.0f), glm::vec3 rot = glm::vec3(0.0f), Entity parent = Entity()) {
+		MemTagScope memTag(MemTag::Scene);
+		return addCube(Transform{ pos, size, rot }, ++numObjects, false, nodeOf(parent));
 	}
 
-	void selectObjectFromRay(const glm::vec3 &rayOrigin, const glm::vec3 &rayDir) {
-		
-		// if an object is already selected we want to first check if we're clicking the object's move arrows
-		if (selectedObject) {
-			selectLineFromRay(rayOrigin, rayDir);
+	// Destroys entity and everything parented under it. Returns false if the handle is
+	// stale; destroying the selection clears it.
+	bool destroyObj(Entity entity) {
+		return graph.destroy(nodeOf(entity), [&](Entity destroyed) { release(destroyed); });
+	}
+
+	// destroyObj() on each entity, but the scene graph closes up once for the lot, so this
+	// is far cheaper for many objects. Returns how many objects went, children included.
+	size_t destroyObjects(const Entity* entities, size_t count) {
+		TaggedVector<SceneNode, MemTag::Scene> nodes;
+		nodes.reserve(count);
+		for (size_t i = 0; i < count; i++) nodes.push_back(nodeOf(entities[i]));
+		return graph.destroyMany(nodes.data(), nodes.size(), [&](Entity destroyed) { release(destroyed); });
+	}
+
+	// Makes entity the last child of parent, or a root for a null parent. Its transform is
+	// kept and is now relative to the new parent. Fails if parent is entity's descendant.
+	// A child loses its rigid body.
+	bool setParent(Entity entity, Entity parent) {
+		SceneNode parentNode = nodeOf(parent);
+		if (parent.valid() && !parentNode.valid()) return false;
+		if (!graph.setParent(nodeOf(entity), parentNode)) return false;
+		if (parent.valid()) removeRigidBody(entity);
+		else world.get<WorldPosition>(entity)->position = origin + glm::dvec3(getTransform(entity)->position);
+		return true;
+	}
+
+	// Null for a root
+	Entity getParent(Entity entity) const {
+		SceneNode parent = graph.parent(nodeOf(entity));
+		return parent.valid() ? graph.entityAt(graph.indexOf(parent)) : Entity();
+	}
+
+	// nullptr once the entity has been destroyed. Changes go through setTransform so the
+	// scene graph sees them.
+	const Transform* getTransform(Entity entity) const { return world.get<const Transform>(entity); }
+
+	// A rigid body is put at the new transform, at rest.
+	bool setTransform(Entity entity, const Transform& transform) {
+		Transform* current = world.get<Transform>(entity);
+		if (!current || !graph.setLocal(nodeOf(entity), localMatrix(entity, transform))) return false;
+		*current = transform;
+		if (!graph.parent(nodeOf(entity)).valid()) world.get<WorldPosition>(entity)->position = origin + glm::dvec3(transform.position);
+		if (const PhysicsBody* body = world.get<const PhysicsBody>(entity)) {
+			physics.setPose(body->body, transform.position, transform.orientation(), 0.5f * transform.size);
 		}
-		
-		float closestDistance = std::numeric_limits<float>::max();
-		Object* closestObject = nullptr;
-
-		for (auto& obj : objs) {
-			float distance = 0.0f;
-			if (obj->intersectsRay(rayOrigin, rayDir, distance)) {
-				if (distance < closestDistance) {
-					closestDistance = distance;
-					closestObject = obj;
+		return true;
+	}
+
+	// Moves entity by an offset in world space; its children move with it
+	void moveBy(Entity entity, const glm::vec3& offset) {
+		const Transform* transform = getTransform(entity);
+		if (!transform) return;
+		Transform moved = *transform;
+		const glm::mat4* parentWorld = graph.world(graph.parent(nodeOf(entity)));
+		moved.position += parentWorld ? glm::vec3(glm::inverse(*parentWorld) * glm::vec4(offset, 0.0f)) : offset;
+		setTransform(entity, moved);
+	}
+
+	// Takes the transform as it is now, but the parent's world matrix as of the last update
+	glm::vec3 worldPosition(Entity entity) const {
+		const Transform* transform = getTransform(entity);
+		if (!transform) return glm::vec3(0.0f);
+		const glm::mat4* parentWorld = graph.world(graph.parent(nodeOf(entity)));
+		return parentWorld ? glm::vec3(*parentWorld * glm::vec4(transform->position, 1.0f)) : transform->position;
+	}
+
+	// Every float position in the scene, the camera's included, is relative to this;
+	// see FloatingOrigin.h
+	const glm::dvec3& getOrigin() const { return origin; }
+
+	// In double precision and absolute: exact for a root, from the float world matrix as of
+	// the last update for a child
+	glm::dvec3 absolutePosition(Entity entity) const {
+		const WorldPosition* position = world.get<const WorldPosition>(entity);
+		if (!position) return origin;
+		return graph.parent(nodeOf(entity)).valid() ? origin + glm::dvec3(worldPosition(entity)) : position->position;
+	}
+
+	// Puts a root object at an absolute position, which is kept in double precision however
+	// far it is from the origin. Fails for a child.
+	bool setAbsolutePosition(Entity entity, const glm::dvec3& position) {
+		const Transform* transform = getTransform(entity);
+		if (!transform || graph.parent(nodeOf(entity)).valid()) return false;
+		Transform moved = *transform;
+		moved.position = glm::vec3(position - origin);
+		setTransform(entity, moved);
+		world.get<WorldPosition>(entity)->position = position;
+		return true;
+	}
+
+	// Once a frame: if the camera has strayed more than RebaseDistance from the origin along
+	// any axis, the origin moves to it and cameraPosition moves back by as much. Returns
+	// whether it moved.
+	bool followCamera(glm::vec3& cameraPosition) {
+		if (glm::all(glm::lessThanEqual(glm::abs(cameraPosition), glm::vec3(RebaseDistance)))) return false;
+		glm::dvec3 before = origin;
+		rebase(origin + glm::dvec3(cameraPosition));
+		cameraPosition -= glm::vec3(origin - before);
+		return true;
+	}
+
+	// Moves the origin to newOrigin, rounded to whole voxel chunks, and every float position
+	// in the scene by as much the other way. Roots are converted afresh from their double
+	// positions rather than shifted, so however often the origin moves nothing drifts.
+	void rebase(const glm::dvec3& newOrigin) {
+		PROFILE_SCOPE("rebase");
+		static_assert(sizeof(WorldPosition) == sizeof(glm::dvec3), "WorldPosition columns are read as dvec3 arrays");
+		const double chunk = VoxelWorld::ChunkSize;
+		// a multiple of the chunk size stays one as a float, so everything moves the same
+		glm::vec3 offset = glm::vec3(glm::round((newOrigin - origin) / chunk) * chunk);
+		if (offset == glm::vec3(0.0f)) return;
+		origin += glm::dvec3(offset);
+		// the octree moves with the scene, and is only rebuilt around the origin once most of
+		// the objects have fallen outside it, objects streamed in around the camera say
+		octree.rebase(offset);
+		if (octree.overflowSize() > octree.size() / 2) octree.recenter(glm::vec3(0.0f));
+		broadphase.rebase(offset);
+		physics.rebase(offset);
+		voxels.rebase(glm::ivec3(glm::dvec3(offset) / chunk));
+		// every root, its subtree and its body go back to exact positions; the double to float
+		// conversion runs in blocks that stay in cache
+		world.parallelForEachChunk<const HierarchyNode, Transform, const WorldPosition, const PhysicsBody>(JobSystem::get(),
+			[&](size_t, const Entity*, size_t count, const HierarchyNode* nodes, Transform* transforms, const WorldPosition* positions, const PhysicsBody* bodies) {
+				glm::vec3 relative[256];
+				for (size_t begin = 0; begin < count; begin += 256) {
+					size_t n = std::min<size_t>(256, count - begin);
+					floatingorigin::toRelative(&positions[begin].position, n, origin, relative);
+					for (size_t i = begin; i < begin + n; i++) {
+						if (!graph.placeRoot(nodes[i].node, relative[i - begin])) continue;
+						transforms[i].position = relative[i - begin];
+						physics.placeBody(bodies[i].body, relative[i - begin]);
+					}
 				}
-			}
+			});
+	}
+
+	// Gives a root object a rigid box the shape of its transform; mass 0 makes it static, so
+	// others collide with it but it never moves. From then on it is drawn as that box, see
+	// Transform::boxMatrix(). A child just follows its parent and can't have one.
+	bool addRigidBody(Entity entity, float mass) {
+		PhysicsBody* body = world.get<PhysicsBody>(entity);
+		const Transform* transform = getTransform(entity);
+		if (!body || !transform || graph.parent(nodeOf(entity)).valid()) return false;
+		physics.destroyBody(body->body);
+		body->body = physics.createBody(entity, transform->position, transform->orientation(), 0.5f * transform->size, mass);
+		graph.setLocal(nodeOf(entity), localMatrix(entity, *transform));
+		return body->body.valid();
+	}
+
+	// Leaves the object where it is, outside the simulation and drawn by modelMatrix() again
+	void removeRigidBody(Entity entity) {
+		PhysicsBody* body = world.get<PhysicsBody>(entity);
+		if (!body || !body->body.valid()) return;
+		physics.destroyBody(body->body);
+		body->body = BodyHandle();
+		graph.setLocal(nodeOf(entity), getTransform(entity)->modelMatrix());
+	}
+
+	const RigidBody* getRigidBody(Entity entity) const {
+		const PhysicsBody* body = world.get<const PhysicsBody>(entity);
+		return body ? physics.getBody(body->body) : nullptr;
+	}
+
+	PhysicsWorld& getPhysics() { return physics; }
+
+	// Runs the fixed physics steps the frame's time covers, then moves the objects. Their
+	// poses are blended between the last two steps, so motion stays smooth when the frame
+	// rate and the step don't line up.
+	void stepPhysics(float deltaTime) {
+		PROFILE_SCOPE("physics");
+		physics.update(deltaTime);
+		physics.forEachMoved([&](Entity owner, const glm::vec3& position, const glm::quat& orientation) {
+			Transform* transform = world.get<Transform>(owner);
+			if (!transform) return;
+			transform->position = position;
+			transform->setOrientation(orientation);
+			world.get<WorldPosition>(owner)->position = origin + glm::dvec3(position);
+			// Transform::boxMatrix(), straight from the quaternion
+			glm::mat4 model = glm::mat4_cast(orientation);
+			model[3] = glm::vec4(position, 1.0f);
+			graph.setLocal(nodeOf(owner), glm::scale(model, transform->size));
+		});
+	}
+
+	// Blocks drawn along with the objects; see VoxelWorld.h
+	VoxelWorld& getVoxels() { return voxels; }
+	const VoxelWorld& getVoxels() const { return voxels; }
+
+	// Turns every root cube that sits on the block grid, unit sized and unturned, with no
+	// children, into a block of the given type. Returns how many were replaced. Neither
+	// scene format saves blocks yet, so the cubes are gone from the next save.
+	size_t bakeCubesToVoxels(BlockID block) {
+		TaggedVector<Entity, MemTag::Scene> baked;
+		for (uint32_t i = 0; i < graph.size(); i++) {
+			if (graph.parentAt(i) != SceneGraph::NoParent || graph.subtreeSizeAt(i) != 1) continue;
+			const Transform* t = getTransform(graph.entityAt(i));
+			if (!t) continue;
+			glm::vec3 cell = glm::round(t->position);
+			bool onGrid = glm::all(glm::lessThan(glm::abs(t->position - cell), glm::vec3(1e-3f))) &&
+				glm::all(glm::lessThan(glm::abs(t->size - 1.0f), glm::vec3(1e-3f))) &&
+				glm::all(glm::lessThan(glm::abs(t->rotation), glm::vec3(1e-3f)));
+			if (onGrid) baked.push_back(graph.entityAt(i));
 		}
+		for (Entity entity : baked) voxels.setBlock(glm::ivec3(glm::round(getTransform(entity)->position)), block);
+		destroyObjects(baked.data(), baked.size());
+		return baked.size();
+	}
 
-		selectedObject = closestObject;
-		if (selectedObject) {
-			if (!selectedObject->isSelected()) selectedObject->toggleSelected();
+	World& getWorld() { return world; }
+	const World& getWorld() const { return world; }
+	const SceneGraph& getGraph() const { return graph; }
+
+	// Sphere, box and frustum queries over the objects' world boxes, as of the last
+	// updateTransforms()
+	const LooseOctree& getOctree() const { return octree; }
+
+	Entity getSelected() const { return selected; }
+
+	// Brings world matrices, the octree and the broadphase up to date; only subtrees changed
+	// since the last call are redone
+	void updateTransforms() {
+		PROFILE_SCOPE("transform");
+		graph.update(JobSystem::get());
+		graph.forEachUpdated([&](uint32_t i) {
+			const SpatialEntry* entry = world.get<const SpatialEntry>(graph.entityAt(i));
+			if (!entry) return;
+			glm::vec3 boxMin, boxMax;
+			worldAABB(graph.worldAt(i), boxMin, boxMax);
+			octree.update(entry->item, boxMin, boxMax);
+			broadphase.update(entry->proxy, boxMin, boxMax);
+		});
+	}
+
+	// fn(a, b) once for every pair of objects whose boxes, oriented by their world matrices,
+	// overlap or touch. The sweep-and-prune broadphase pairs up overlapping world boxes, then
+	// each pair goes through the separating axis test.
+	template<typename Fn>
+	void forEachOverlap(Fn&& fn) {
+		updateTransforms();
+		PROFILE_SCOPE("collision");
+		for (const OverlapPair& pair : broadphase.findPairs()) {
+			const glm::mat4* a = graph.world(nodeOf(pair.a));
+			const glm::mat4* b = graph.world(nodeOf(pair.b));
+			if (a && b && obbOverlap(OBB::fromMatrix(*a), OBB::fromMatrix(*b))) fn(pair.a, pair.b);
+		}
+	}
+
+	// Objects whose bounding sphere is outside the view frustum are skipped and counted.
+	// Runs as three profiled phases: the transform update and culling spread over the job
+	// system, then submission on this thread.
+	void draw(Shader& shader, const glm::mat4& viewProjection) {
+		PROFILE_SCOPE("Scene::draw");
+		JobSystem& jobs = JobSystem::get();
+		updateTransforms();
+		{
+			// collects the meshes finished since last frame and starts on the new changes
+			PROFILE_SCOPE("voxel remesh");
+			voxels.remesh();
+		}
+		{
+			PROFILE_SCOPE("culling");
+			Frustum frustum = Frustum::fromMatrix(viewProjection);
+			FrameVector<uint32_t> culledPerChunk(world.chunkCount<HierarchyNode, Visibility, WorldMatrix>());
+			world.parallelForEachChunk<const HierarchyNode, Visibility, WorldMatrix>(jobs,
+				[&](size_t chunk, const Entity*, size_t count, const HierarchyNode* nodes, Visibility* visibility, WorldMatrix* matrices) {
+					uint32_t culled = 0;
+					for (size_t i = 0; i < count; i++) {
+						const glm::mat4* model = graph.world(nodes[i].node);
+						visibility[i].visible = model && frustum.intersectsSphere(glm::vec3((*model)[3]), boundingRadius(*model));
+						if (visibility[i].visible) matrices[i].model = *model;
+						else culled++;
+					}
+					culledPerChunk[chunk] = culled;
+				});
+			for (uint32_t culled : culledPerChunk) RenderStats::frame().objectsCulled += culled;
+		}
+		PROFILE_SCOPE("submission");
+		AssetManager& assets = AssetManager::get();
+		RenderStats& stats = RenderStats::frame();
+		shader.use();
+		{
+			GPU_PROFILE_SCOPE("GPU opaque");
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			MeshHandle bound;
+			const MeshAsset* mesh = nullptr;
+			world.forEachChunk<const Visibility, const WorldMatrix, const RenderMesh, const Color>(
+				[&](const Entity*, size_t count, const Visibility* visibility, const WorldMatrix* matrices, const RenderMesh* meshes, const Color* colors) {
+					for (size_t i = 0; i < count; i++) {
+						if (!visibility[i].visible) continue;
+						if (meshes[i].fill != bound) {
+							bound = meshes[i].fill;
+							mesh = assets.getMesh(bound);
+							glBindVertexArray(mesh->VAO);
+						}
+						shader.setMat4("model", matrices[i].model);
+						shader.setVec3("inColor", colors[i].rgb);
+						glDrawArrays(mesh->primitive, 0, mesh->vertexCount);
+						stats.drawCalls++;
+						stats.triangles += mesh->vertexCount / 3;
+					}
+				});
+			glBindVertexArray(0);
+			voxels.draw(shader, viewProjection);
+		}
+		{
+			GPU_PROFILE_SCOPE("GPU selection outlines");
+			glLineWidth(4.0f);
+			shader.setVec3("inColor", glm::vec3(0.47f, 0.87f, 0.9f));
+			forEachVisibleSelected([&](const glm::mat4& model, const RenderMesh& meshes) {
+				const MeshAsset* edges = assets.getMesh(meshes.edges);
+				shader.setMat4("model", model);
+				glBindVertexArray(edges->VAO);
+				glDrawArrays(edges->primitive, 0, edges->vertexCount);
+				stats.drawCalls++;
+			});
+			glBindVertexArray(0);
+		}
+		{
+			GPU_PROFILE_SCOPE("GPU gizmo");
+			glLineWidth(20.0f);
+			forEachVisibleSelected([&](const glm::mat4& model, const RenderMesh& meshes) {
+				shader.setMat4("model", model);
+				glBindVertexArray(assets.getMesh(meshes.gizmo)->VAO);
+
+				// red, green and blue lines for the X, Y and Z axes
+				shader.setVec3("inColor", glm::vec3(1.0f, 0.0f, 0.0f));
+				glDrawArrays(GL_LINES, 0, 4);
+				shader.setVec3("inColor", glm::vec3(0.0f, 1.0f, 0.0f));
+				glDrawArrays(GL_LINES, 4, 4);
+				shader.setVec3("inColor", glm::vec3(0.0f, 0.0f, 1.0f));
+				glDrawArrays(GL_LINES, 8, 4);
+				stats.drawCalls += 3;
+			});
+			glBindVertexArray(0);
 		}
+	}
+
+	// Moves the selection to entity; a null or stale handle just deselects
+	void selectObject(Entity entity) {
+		if (Selection* previous = world.get<Selection>(selected)) previous->selected = false;
+		Selection* selection = world.get<Selection>(entity);
+		selected = selection ? entity : Entity();
+		if (selection) selection->selected = true;
+	}
 
+	// Frees every entity
+	void clear() {
+		world.clear();
+		graph.clear();
+		octree.clear();
+		broadphase.clear();
+		physics.clear();
+		voxels.clear();
+		selected = Entity();
+		numObjects = 0;
+		origin = glm::dvec3(0.0);
+	}
 
-		if (selectedObject != nullptr) {
-			std::cout << "selected" << std::endl;
+	// Flattens the scene into arrays for saving, in scene graph order so every parent is
+	// saved before its children
+	SceneSnapshot snapshot() const {
+		SceneSnapshot snap;
+		snap.resize(graph.size());
+		snap.origin = origin;
+		for (uint32_t i = 0; i < graph.size(); i++) {
+			Entity entity = graph.entityAt(i);
+			snap.types[i] = snap.typeIndex(world.get<const TypeName>(entity)->name);
+			snap.ids[i] = world.get<const SceneID>(entity)->id;
+			const Transform& transform = *world.get<const Transform>(entity);
+			snap.positions[i] = transform.position;
+			snap.sizes[i] = transform.size;
+			snap.rotations[i] = transform.rotation;
+			snap.setSelected(i, world.get<const Selection>(entity)->selected);
+			uint32_t parent = graph.parentAt(i);
+			snap.parents[i] = parent == SceneGraph::NoParent ? -1 : static_cast<int32_t>(parent);
 		}
-		else {
-			std::cout << "failed" << std::endl;
+		return snap;
+	}
+
+	// Replaces the scene with the snapshot's contents. Entities are appended to their
+	// archetype's chunks, so the objects come out of a few 16 KB blocks. A parent has to
+	// come before its children; an object whose parent doesn't becomes a root.
+	void loadSnapshot(const SceneSnapshot& snap) {
+		clear();
+		origin = snap.origin;
+		MemTagScope memTag(MemTag::Scene);
+		size_t n = snap.size();
+		reserve(n);
+		std::vector<Entity> entities(n);
+		appendSnapshot(snap, 0, n, entities.data());
+	}
+
+	// Makes room for this many objects up front, so adding them later doesn't stall on growth
+	void reserve(size_t objects) {
+		graph.reserve(objects);
+		octree.reserve(objects);
+	}
+
+	// Adds the snapshot's objects first to last - 1 to the scene, leaving what's there, its
+	// roots moved from the snapshot's origin to the scene's.
+	// entities has a slot for every object in the snapshot: each one added gets its entity
+	// there, and a later call looks its parent up there. Returns how many objects were
+	// added, fewer than asked only if the scene is full.
+	size_t appendSnapshot(const SceneSnapshot& snap, size_t first, size_t last, Entity* entities) {
+		MemTagScope memTag(MemTag::Scene);
+		std::vector<char> isCube(snap.typeNames.size());
+		for (size_t t = 0; t < isCube.size(); t++) isCube[t] = snap.typeNames[t] == "Cube";
+		for (size_t i = first; i < last; i++) {
+			entities[i] = Entity();
+			if (!isCube[snap.types[i]]) {
+				std::cout << "skipping object of unknown type " << snap.typeNames[snap.types[i]] << std::endl;
+				continue;
+			}
+			bool isSelected = snap.isSelected(i);
+			int32_t parent = i < snap.parents.size() ? snap.parents[i] : -1;
+			SceneNode parentNode = parent >= 0 && static_cast<size_t>(parent) < i ? nodeOf(entities[parent]) : SceneNode();
+			bool root = !parentNode.valid();
+			glm::dvec3 absolute = snap.origin + glm::dvec3(snap.positions[i]);
+			glm::vec3 position = root ? glm::vec3(absolute - origin) : snap.positions[i];
+			Entity entity = addCube(Transform{ position, snap.sizes[i], snap.rotations[i] }, snap.ids[i], isSelected, parentNode);
+			if (!entity.valid()) return i - first;
+			if (root) world.get<WorldPosition>(entity)->position = absolute;
+			entities[i] = entity;
+			if (isSelected) selected = entity;
+			if (snap.ids[i] > numObjects) numObjects = snap.ids[i];
 		}
+		return last - first;
+	}
+
+	bool save(const std::string& path, blockstream::Codec codec = blockstream::Codec::Raw) const {
+		return scenefile::save(path, snapshot(), codec);
+	}
+
+	bool load(const std::string& path) {
+		SceneSnapshot snap;
+		if (!scenefile::load(path, snap)) return false;
+		loadSnapshot(snap);
+		return true;
+	}
+
+	// diffable JSON version of the same data, for keeping scenes in version control
+	bool saveText(const std::string& path) const {
+		return scenetext::save(path, snapshot());
+	}
+
+	bool loadText(const std::string& path) {
+		SceneSnapshot snap;
+		if (!scenetext::load(path, snap)) return false;
+		loadSnapshot(snap);
+		return true;
+	}
+
+	void selectObjectFromRay(const glm::vec3 &rayOrigin, const glm::vec3 &rayDir) {
+		
+		// if an object is already selected we want to first check if we're clicking the object's move arrows
+		if (selected.valid()) {
+			selectLineFromRay(rayOrigin, rayDir);
+		}
+		
+		MeshHit hit;
+		selectObject(raycast(rayOrigin, rayDir, hit));
+	}
+
+	// Nearest object under the ray, or a null entity. The octree's world boxes narrow it
+	// down, then each candidate's mesh is tested exactly: its bounds as a box oriented by the
+	// world matrix, then its triangles. hit gets the distance along rayDir, the triangle and
+	// its barycentrics. Voxel blocks in front of the object hide it.
+	Entity raycast(const glm::vec3& rayOrigin, const glm::vec3& rayDir, MeshHit& hit) {
+		updateTransforms();
+		AssetManager& assets = AssetManager::get();
+		const Ray ray(rayOrigin, rayDir);
+		float distance = 0.0f;
+		Entity picked = octree.raycast(ray, distance, [&](Entity entity, float, float& best) {
+			const HierarchyNode* node = world.get<const HierarchyNode>(entity);
+			const RenderMesh* mesh = world.get<const RenderMesh>(entity);
+			const glm::mat4* model = node ? graph.world(node->node) : nullptr;
+			const MeshAsset* asset = mesh ? assets.getMesh(mesh->fill) : nullptr;
+			if (!model || !asset) return false;
+			Ray closer = ray;
+			closer.tMax = best;
+			MeshHit candidate;
+			if (!raycastMesh(closer, *model, asset->bvh, candidate)) return false;
+			best = candidate.distance;
+			hit = candidate;
+			return true;
+		});
+		VoxelHit block;
+		if (picked.valid() && voxels.raycast(Ray(rayOrigin, rayDir, hit.distance), block)) {
+			hit = MeshHit();
+			return Entity();
+		}
+		return picked;
 	}
 
 	void selectLineFromRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir) {
 		std::cout << "code this here" << std::endl;
 	}
+
+private:
+	// fn(model, meshes) for every entity that is both visible and selected
+	template<typename Fn>
+	void forEachVisibleSelected(Fn&& fn) const {
+		world.forEachChunk<const Visibility, const Selection, const WorldMatrix, const RenderMesh>(
+			[&](const Entity*, size_t count, const Visibility* visibility, const Selection* selection, const WorldMatrix* matrices, const RenderMesh* meshes) {
+				for (size_t i = 0; i < count; i++) {
+					if (visibility[i].visible && selection[i].selected) fn(matrices[i].model, meshes[i]);
+				}
+			});
+	}
 };
\ No newline at end of file
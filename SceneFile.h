@@ -0,0 +1,264 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BlockStream.h"
+#include "MappedFile.h"
+
+// Scene contents as flat arrays, one entry per object. This is what gets written to and
+// read from disk; Scene converts to and from it in bulk.
+struct SceneSnapshot {
+	std::vector<std::string> typeNames; // type table, indexed by types[]
+	std::vector<uint16_t> types;
+	std::vector<int32_t> ids;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> sizes;
+	std::vector<glm::vec3> rotations;
+	std::vector<uint64_t> selection;    // one bit per object
+	std::vector<int32_t> parents;       // index of the parent object, which comes first; -1 for roots
+	glm::dvec3 origin = glm::dvec3(0.0); // what roots' positions are relative to
+
+	size_t size() const { return ids.size(); }
+
+	void resize(size_t count) {
+		types.resize(count);
+		ids.resize(count);
+		positions.resize(count);
+		sizes.resize(count);
+		rotations.resize(count);
+		selection.assign((count + 63) / 64, 0);
+		parents.resize(count, -1);
+	}
+
+	bool isSelected(size_t i) const { return (selection[i >> 6] >> (i & 63)) & 1; }
+	void setSelected(size_t i, bool value) {
+		if (value) selection[i >> 6] |= 1ull << (i & 63);
+		else selection[i >> 6] &= ~(1ull << (i & 63));
+	}
+
+	// Every type is in the type table and every parent an object or -1, which is what
+	// Scene::appendSnapshot() relies on; a loader rejects a snapshot that fails this
+	bool indicesValid() const {
+		for (uint16_t type : types)
+			if (type >= typeNames.size()) return false;
+		for (int32_t parent : parents)
+			if (parent < -1 || (parent >= 0 && static_cast<size_t>(parent) >= size())) return false;
+		return true;
+	}
+
+	uint16_t typeIndex(const std::string& name) {
+		for (size_t i = 0; i < typeNames.size(); i++)
+			if (typeNames[i] == name) return static_cast<uint16_t>(i);
+		typeNames.push_back(name);
+		return static_cast<uint16_t>(typeNames.size() - 1);
+	}
+};
+
+// Binary scene layout, every section 16-byte aligned so arrays can be copied straight out
+// of a mapping:
+//   Header | type table | types | ids | positions | sizes | rotations | selection bits | parents | origin
+// Version 1 files end before the parents; everything in them loads as a root. Version 2
+// files end before the origin, which is then zero.
+// A scene file can also be wrapped in a BlockStream container for compression; load()
+// detects that from the magic.
+namespace scenefile {
+	static const uint32_t Magic = 0x314E4353; // "SCN1"
+	static const uint32_t Version = 3;
+
+	enum Section { TypeTable, Types, Ids, Positions, Sizes, Rotations, Selection, Parents, Origin, SectionCount };
+	static const int SectionCountV1 = Parents;
+	static const int SectionCountV2 = Origin;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t objectCount;
+		uint32_t typeCount;
+		uint32_t reserved;
+		uint64_t sectionOffset[SectionCount];
+		uint64_t sectionSize[SectionCount];
+	};
+
+	inline uint64_t alignUp(uint64_t value) { return (value + 15) & ~uint64_t(15); }
+
+	inline std::string buildTypeTable(const SceneSnapshot& scene) {
+		std::string typeTable;
+		for (const std::string& name : scene.typeNames) {
+			uint32_t length = static_cast<uint32_t>(name.size());
+			typeTable.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			typeTable += name;
+		}
+		return typeTable;
+	}
+
+	// Fills in the header and the source pointer of every section; returns the file size
+	inline uint64_t layout(const SceneSnapshot& scene, const std::string& typeTable, Header& header, const void* sources[SectionCount]) {
+		size_t n = scene.size();
+		header = {};
+		header.magic = Magic;
+		header.version = Version;
+		header.objectCount = n;
+		header.typeCount = static_cast<uint32_t>(scene.typeNames.size());
+		header.sectionSize[TypeTable] = typeTable.size();
+		header.sectionSize[Types] = n * sizeof(uint16_t);
+		header.sectionSize[Ids] = n * sizeof(int32_t);
+		header.sectionSize[Positions] = n * sizeof(glm::vec3);
+		header.sectionSize[Sizes] = n * sizeof(glm::vec3);
+		header.sectionSize[Rotations] = n * sizeof(glm::vec3);
+		header.sectionSize[Selection] = scene.selection.size() * sizeof(uint64_t);
+		header.sectionSize[Parents] = scene.parents.size() * sizeof(int32_t);
+		header.sectionSize[Origin] = sizeof(glm::dvec3);
+
+		sources[TypeTable] = typeTable.data();
+		sources[Types] = scene.types.data();
+		sources[Ids] = scene.ids.data();
+		sources[Positions] = scene.positions.data();
+		sources[Sizes] = scene.sizes.data();
+		sources[Rotations] = scene.rotations.data();
+		sources[Selection] = scene.selection.data();
+		sources[Parents] = scene.parents.data();
+		sources[Origin] = &scene.origin;
+
+		uint64_t offset = alignUp(sizeof(Header));
+		for (int s = 0; s < SectionCount; s++) {
+			header.sectionOffset[s] = offset;
+			offset = alignUp(offset + header.sectionSize[s]);
+		}
+		return offset;
+	}
+
+	// Serializes into one contiguous buffer, used when the file is going to be compressed
+	inline std::vector<char> serialize(const SceneSnapshot& scene) {
+		std::string typeTable = buildTypeTable(scene);
+		Header header;
+		const void* sources[SectionCount];
+		uint64_t size = layout(scene, typeTable, header, sources);
+
+		std::vector<char> buffer(static_cast<size_t>(size), 0);
+		std::memcpy(buffer.data(), &header, sizeof(header));
+		for (int s = 0; s < SectionCount; s++) {
+			if (header.sectionSize[s])
+				std::memcpy(buffer.data() + header.sectionOffset[s], sources[s], static_cast<size_t>(header.sectionSize[s]));
+		}
+		return buffer;
+	}
+
+	// The section tables are sized by the version; sections a version doesn't have are empty
+	inline bool readHeader(const char* data, size_t size, Header& header) {
+		const size_t fixed = offsetof(Header, sectionOffset);
+		if (size < fixed) return false;
+		header = {};
+		std::memcpy(&header, data, fixed);
+		if (header.magic != Magic) return false;
+		size_t sections = header.version == Version ? SectionCount : header.version == 2 ? SectionCountV2 :
+			header.version == 1 ? SectionCountV1 : 0;
+		if (sections == 0 || size < fixed + 2 * sections * sizeof(uint64_t)) return false;
+		std::memcpy(header.sectionOffset, data + fixed, sections * sizeof(uint64_t));
+		std::memcpy(header.sectionSize, data + fixed + sections * sizeof(uint64_t), sections * sizeof(uint64_t));
+		return true;
+	}
+
+	// Bulk-copies the arrays out of a serialized scene. No per-object work besides the copies.
+	inline bool deserialize(const char* data, size_t size, SceneSnapshot& scene) {
+		Header header;
+		if (!readHeader(data, size, header)) return false;
+		for (int s = 0; s < SectionCount; s++) {
+			if (header.sectionOffset[s] > size || header.sectionSize[s] > size - header.sectionOffset[s]) return false;
+		}
+
+		size_t n = static_cast<size_t>(header.objectCount);
+		if (header.sectionSize[Positions] != n * sizeof(glm::vec3) || header.sectionSize[Ids] != n * sizeof(int32_t))
+			return false;
+
+		const char* table = data + header.sectionOffset[TypeTable];
+		const char* tableEnd = table + header.sectionSize[TypeTable];
+		scene.typeNames.clear();
+		for (uint32_t t = 0; t < header.typeCount; t++) {
+			uint32_t length;
+			if (table + sizeof(length) > tableEnd) return false;
+			std::memcpy(&length, table, sizeof(length));
+			table += sizeof(length);
+			if (table + length > tableEnd) return false;
+			scene.typeNames.emplace_back(table, length);
+			table += length;
+		}
+
+		auto copySection = [&](Section s, auto& out) {
+			using T = typename std::decay<decltype(out)>::type::value_type;
+			const T* begin = reinterpret_cast<const T*>(data + header.sectionOffset[s]);
+			out.assign(begin, begin + header.sectionSize[s] / sizeof(T));
+		};
+		copySection(Types, scene.types);
+		copySection(Ids, scene.ids);
+		copySection(Positions, scene.positions);
+		copySection(Sizes, scene.sizes);
+		copySection(Rotations, scene.rotations);
+		copySection(Selection, scene.selection);
+		copySection(Parents, scene.parents);
+		if (scene.parents.empty()) scene.parents.assign(n, -1);
+		scene.origin = glm::dvec3(0.0);
+		if (header.sectionSize[Origin] == sizeof(glm::dvec3))
+			std::memcpy(&scene.origin, data + header.sectionOffset[Origin], sizeof(glm::dvec3));
+		return scene.types.size() == n && scene.sizes.size() == n && scene.rotations.size() == n &&
+			scene.selection.size() == (n + 63) / 64 && scene.parents.size() == n && scene.indicesValid();
+	}
+
+	// Writes every array once, in file order, with no intermediate buffer for raw files
+	inline bool save(const std::string& path, const SceneSnapshot& scene, blockstream::Codec codec = blockstream::Codec::Raw) {
+		if (codec != blockstream::Codec::Raw) {
+			std::vector<char> buffer = serialize(scene);
+			return blockstream::write(path, buffer.data(), buffer.size(), codec);
+		}
+
+		std::string typeTable = buildTypeTable(scene);
+		Header header;
+		const void* sources[SectionCount];
+		layout(scene, typeTable, header, sources);
+
+		std::ofstream out(path, std::ios::binary);
+		if (!out) return false;
+		static const char padding[16] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for (int s = 0; s < SectionCount; s++) {
+			out.write(padding, static_cast<std::streamsize>(header.sectionOffset[s] - written));
+			out.write(static_cast<const char*>(sources[s]), static_cast<std::streamsize>(header.sectionSize[s]));
+			written = header.sectionOffset[s] + header.sectionSize[s];
+		}
+		out.write(padding, static_cast<std::streamsize>(alignUp(written) - written));
+		return out.good();
+	}
+
+	// Uncompressed files are memory-mapped and copied straight into the snapshot arrays;
+	// compressed ones are streamed through BlockStream first.
+	inline bool load(const std::string& path, SceneSnapshot& scene) {
+		MappedFile file(path);
+		if (!file.isOpen() || file.size() < sizeof(uint32_t)) {
+			std::cout << "ERROR::SCENEFILE::NOT_FOUND: " << path << std::endl;
+			return false;
+		}
+		uint32_t magic;
+		std::memcpy(&magic, file.data(), sizeof(magic));
+		bool ok;
+		if (magic == blockstream::Magic) {
+			file.close();
+			std::vector<char> buffer;
+			ok = blockstream::read(path, buffer) && deserialize(buffer.data(), buffer.size(), scene);
+		}
+		else {
+			file.adviseSequential();
+			ok = deserialize(file.data(), file.size(), scene);
+		}
+		if (!ok) std::cout << "ERROR::SCENEFILE::INVALID_FILE: " << path << std::endl;
+		return ok;
+	}
+}
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include "ECS.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "ObjectPool.h"
+
+// Parent/child transforms. Nodes live in flat arrays kept in depth-first order: every node
+// comes before its children and its whole subtree follows it as one contiguous range. A
+// world matrix is the parent's world times the node's local matrix, so one forward pass
+// over a range brings all of it up to date.
+//
+// setLocal() only records the node. update() sorts the recorded nodes and recomputes each
+// one's subtree range once, skipping nodes that fall inside a range already done, so a
+// frame costs the size of the changed subtrees rather than of the whole scene.
+// Adding a child to the subtree that ends the arrays is O(depth). Any other insert,
+// reparent or destroy shifts the arrays behind it and is O(n); destroyMany() removes any
+// number of nodes for the price of one.
+struct SceneNodeSlot {
+	uint32_t index; // position in the depth-first arrays
+};
+
+using SceneNode = PoolHandle<SceneNodeSlot>;
+
+class SceneGraph {
+public:
+	static const uint32_t NoParent = ~0u;
+
+	SceneGraph() = default;
+	SceneGraph(const SceneGraph&) = delete;
+	SceneGraph& operator=(const SceneGraph&) = delete;
+
+	// Adds a node as the last child of parent, or as a root for a null handle. entity is
+	// whatever the node belongs to, handed back by destroy(). Returns a null handle if
+	// parent is stale or the graph is full.
+	SceneNode create(const glm::mat4& local, SceneNode parent = SceneNode(), Entity entity = Entity()) {
+		uint32_t parentIndex = NoParent;
+		if (parent.valid()) {
+			const SceneNodeSlot* slot = slots.get(parent);
+			if (!slot) return SceneNode();
+			parentIndex = slot->index;
+		}
+		uint32_t position = parentIndex == NoParent ? size() : parentIndex + subtreeSizes[parentIndex];
+		SceneNode node = slots.create(SceneNodeSlot{ position });
+		if (!node.valid()) return node;
+
+		parents.insert(parents.begin() + position, parentIndex);
+		subtreeSizes.insert(subtreeSizes.begin() + position, 1u);
+		locals.insert(locals.begin() + position, local);
+		worlds.insert(worlds.begin() + position, local);
+		nodes.insert(nodes.begin() + position, node);
+		entities.insert(entities.begin() + position, entity);
+		for (uint32_t i = position + 1; i < size(); i++) {
+			if (parents[i] != NoParent && parents[i] >= position) parents[i]++;
+			slots.get(nodes[i])->index = i;
+		}
+		for (uint32_t a = parentIndex; a != NoParent; a = parents[a]) subtreeSizes[a]++;
+		dirty.push_back(node);
+		return node;
+	}
+
+	// Destroys node and everything under it, calling fn(Entity) for each of them first.
+	// Returns false for a stale or null handle.
+	template<typename Fn>
+	bool destroy(SceneNode node, Fn&& fn) {
+		const SceneNodeSlot* slot = slots.get(node);
+		if (!slot) return false;
+		uint32_t begin = slot->index, count = subtreeSizes[begin], end = begin + count;
+		for (uint32_t i = begin; i < end; i++) {
+			fn(entities[i]);
+			slots.destroy(nodes[i]);
+		}
+		for (uint32_t a = parents[begin]; a != NoParent; a = parents[a]) subtreeSizes[a] -= count;
+
+		parents.erase(parents.begin() + begin, parents.begin() + end);
+		subtreeSizes.erase(subtreeSizes.begin() + begin, subtreeSizes.begin() + end);
+		locals.erase(locals.begin() + begin, locals.begin() + end);
+		worlds.erase(worlds.begin() + begin, worlds.begin() + end);
+		nodes.erase(nodes.begin() + begin, nodes.begin() + end);
+		entities.erase(entities.begin() + begin, entities.begin() + end);
+		for (uint32_t i = begin; i < size(); i++) {
+			if (parents[i] != NoParent && parents[i] >= end) parents[i] -= count;
+			slots.get(nodes[i])->index = i;
+		}
+		return true;
+	}
+
+	bool destroy(SceneNode node) {
+		return destroy(node, [](Entity) {});
+	}
+
+	// destroy() for many nodes at once, closing all the gaps in one pass: O(n) in total
+	// rather than O(n) per node. fn(Entity) is called for every node removed. Stale handles
+	// and nodes already inside another listed subtree are skipped. Returns how many went.
+	template<typename Fn>
+	size_t destroyMany(const SceneNode* list, size_t count, Fn&& fn) {
+		TaggedVector<uint32_t, MemTag::Scene> starts;
+		starts.reserve(count);
+		for (size_t n = 0; n < count; n++) {
+			if (const SceneNodeSlot* slot = slots.get(list[n])) starts.push_back(slot->index);
+		}
+		// ancestors first, so a subtree is taken whole before anything inside it comes up
+		std::sort(starts.begin(), starts.end());
+		TaggedVector<uint32_t, MemTag::Scene> remap(size(), 0); // new position + 1, 0 for removed
+		size_t removed = 0;
+		for (uint32_t begin : starts) {
+			if (remap[begin]) continue;
+			uint32_t end = begin + subtreeSizes[begin];
+			for (uint32_t a = parents[begin]; a != NoParent; a = parents[a]) subtreeSizes[a] -= end - begin;
+			for (uint32_t i = begin; i < end; i++) remap[i] = 1;
+			removed += end - begin;
+		}
+		if (!removed) return 0;
+
+		// nothing before the first removed node moves
+		uint32_t kept = starts[0];
+		for (uint32_t i = kept; i < size(); i++) {
+			if (remap[i]) {
+				fn(entities[i]);
+				slots.destroy(nodes[i]);
+				remap[i] = 0;
+				continue;
+			}
+			remap[i] = kept + 1;
+			// a kept node's parent is kept too, and comes first
+			uint32_t parent = parents[i];
+			parents[kept] = parent == NoParent || parent < starts[0] ? parent : remap[parent] - 1;
+			subtreeSizes[kept] = subtreeSizes[i];
+			locals[kept] = locals[i];
+			worlds[kept] = worlds[i];
+			nodes[kept] = nodes[i];
+			entities[kept] = entities[i];
+			slots.get(nodes[kept])->index = kept;
+			kept++;
+		}
+		parents.resize(kept);
+		subtreeSizes.resize(kept);
+		locals.resize(kept);
+		worlds.resize(kept);
+		nodes.resize(kept);
+		entities.resize(kept);
+		return removed;
+	}
+
+	// Moves node's subtree under parent (a null handle makes it a root), as its last child.
+	// The local matrix is kept, so the subtree moves with its new parent. Fails for stale
+	// handles and for a parent inside node's own subtree.
+	bool setParent(SceneNode node, SceneNode parent) {
+		const SceneNodeSlot* slot = slots.get(node);
+		if (!slot) return false;
+		uint32_t begin = slot->index, count = subtreeSizes[begin], end = begin + count;
+		uint32_t parentIndex = NoParent;
+		if (parent.valid()) {
+			const SceneNodeSlot* parentSlot = slots.get(parent);
+			if (!parentSlot) return false;
+			parentIndex = parentSlot->index;
+			if (parentIndex >= begin && parentIndex < end) {
+				std::cout << "ERROR::SCENE_GRAPH::CYCLE: a node can't be parented to its own descendant" << std::endl;
+				return false;
+			}
+		}
+		for (uint32_t a = parents[begin]; a != NoParent; a = parents[a]) subtreeSizes[a] -= count;
+
+		// where the subtree starts once it has been taken out and put back in
+		uint32_t target;
+		if (parentIndex == NoParent) target = size() - count;
+		else {
+			uint32_t parentAfter = parentIndex < begin ? parentIndex : parentIndex - count;
+			target = parentAfter + subtreeSizes[parentIndex];
+		}
+		// the nodes between the old and new place shift by count the other way
+		uint32_t low = std::min(begin, target), high = std::max(end, target + count);
+		auto moved = [&](uint32_t i) -> uint32_t {
+			if (i == NoParent || i < low || i >= high) return i;
+			if (i >= begin && i < end) return i - begin + target;
+			return target < begin ? i + count : i - count;
+		};
+		rotateSpan(low, high, target <= begin ? begin : end);
+		for (uint32_t i = low; i < size(); i++) parents[i] = moved(parents[i]);
+		parents[target] = moved(parentIndex);
+		for (uint32_t i = low; i < high; i++) slots.get(nodes[i])->index = i;
+		for (uint32_t a = parents[target]; a != NoParent; a = parents[a]) subtreeSizes[a] += count;
+		dirty.push_back(node);
+		return true;
+	}
+
+	// Takes effect on the next update()
+	bool setLocal(SceneNode node, const glm::mat4& local) {
+		const SceneNodeSlot* slot = slots.get(node);
+		if (!slot) return false;
+		locals[slot->index] = local;
+		dirty.push_back(node);
+		return true;
+	}
+
+	// Sets a root's translation and recomputes its subtree's world matrices on the spot,
+	// without marking anything. For the scene's floating origin, which puts every root back
+	// at an exact position when it moves; roots are disjoint subtrees, so different roots can
+	// be placed concurrently. Returns false for a child or a stale handle.
+	bool placeRoot(SceneNode node, const glm::vec3& translation) {
+		const SceneNodeSlot* slot = slots.get(node);
+		if (!slot || parents[slot->index] != NoParent) return false;
+		locals[slot->index][3] = glm::vec4(translation, 1.0f);
+		updateRange(slot->index, slot->index + subtreeSizes[slot->index]);
+		return true;
+	}
+
+	// Recomputes the world matrices of every subtree changed since the last call. Large
+	// batches of disjoint subtrees are spread over the job system.
+	void update(JobSystem& jobs) {
+		lastUpdated = 0;
+		ranges.clear();
+		if (dirty.empty()) return;
+		FrameVector<uint32_t> starts;
+		starts.reserve(dirty.size());
+		for (SceneNode node : dirty) {
+			if (const SceneNodeSlot* slot = slots.get(node)) starts.push_back(slot->index);
+		}
+		dirty.clear();
+		std::sort(starts.begin(), starts.end());
+
+		// a node inside a range already taken is recomputed with it
+		uint32_t covered = 0;
+		for (uint32_t start : starts) {
+			if (start < covered) continue;
+			covered = start + subtreeSizes[start];
+			ranges.push_back(Range{ start, covered });
+			lastUpdated += covered - start;
+		}
+
+		// parents outside every range are clean, so ranges can run concurrently
+		if (lastUpdated < ParallelThreshold || ranges.size() == 1) {
+			for (const Range& range : ranges) updateRange(range.begin, range.end);
+			return;
+		}
+		size_t batch = std::max<size_t>(1, ranges.size() / (4 * (jobs.workerCount() + 1)));
+		jobs.parallelFor(ranges.size(), batch, [&](size_t begin, size_t end) {
+			for (size_t r = begin; r < end; r++) updateRange(ranges[r].begin, ranges[r].end);
+		});
+	}
+
+	// As of the last update(); nullptr for a stale handle
+	const glm::mat4* world(SceneNode node) const {
+		const SceneNodeSlot* slot = slots.get(node);
+		return slot ? &worlds[slot->index] : nullptr;
+	}
+
+	const glm::mat4* local(SceneNode node) const {
+		const SceneNodeSlot* slot = slots.get(node);
+		return slot ? &locals[slot->index] : nullptr;
+	}
+
+	// Null for a root or a stale handle
+	SceneNode parent(SceneNode node) const {
+		const SceneNodeSlot* slot = slots.get(node);
+		if (!slot || parents[slot->index] == NoParent) return SceneNode();
+		return nodes[parents[slot->index]];
+	}
+
+	bool contains(SceneNode node) const { return slots.contains(node); }
+
+	// Access by position in depth-first order, for walking the whole graph
+	uint32_t size() const { return static_cast<uint32_t>(nodes.size()); }
+	uint32_t indexOf(SceneNode node) const {
+		const SceneNodeSlot* slot = slots.get(node);
+		return slot ? slot->index : NoParent;
+	}
+	uint32_t parentAt(uint32_t index) const { return parents[index]; }
+	uint32_t subtreeSizeAt(uint32_t index) const { return subtreeSizes[index]; }
+	const glm::mat4& localAt(uint32_t index) const { return locals[index]; }
+	const glm::mat4& worldAt(uint32_t index) const { return worlds[index]; }
+	SceneNode nodeAt(uint32_t index) const { return nodes[index]; }
+	Entity entityAt(uint32_t index) const { return entities[index]; }
+
+	// Nodes recomputed by the last update(), including descendants of changed nodes
+	size_t lastUpdateCount() const { return lastUpdated; }
+
+	// fn(index) for each of those nodes, in depth-first order. Indices are only good until
+	// the next create, destroy or setParent.
+	template<typename Fn>
+	void forEachUpdated(Fn&& fn) const {
+		for (const Range& range : ranges) {
+			for (uint32_t i = range.begin; i < range.end; i++) fn(i);
+		}
+	}
+
+	void reserve(size_t count) {
+		parents.reserve(count);
+		subtreeSizes.reserve(count);
+		locals.reserve(count);
+		worlds.reserve(count);
+		nodes.reserve(count);
+		entities.reserve(count);
+	}
+
+	// Removes every node and frees all storage
+	void clear() {
+		parents = decltype(parents)();
+		subtreeSizes = decltype(subtreeSizes)();
+		locals = decltype(locals)();
+		worlds = decltype(worlds)();
+		nodes = decltype(nodes)();
+		entities = decltype(entities)();
+		dirty = decltype(dirty)();
+		ranges = decltype(ranges)();
+		slots.clear();
+		slots.shrink();
+		lastUpdated = 0;
+	}
+
+private:
+	// below this many nodes, handing ranges to workers costs more than it saves
+	static const size_t ParallelThreshold = 16 * 1024;
+
+	struct Range {
+		uint32_t begin, end;
+	};
+
+	TaggedVector<uint32_t, MemTag::Scene> parents; // position of the parent, or NoParent
+	TaggedVector<uint32_t, MemTag::Scene> subtreeSizes; // counting the node itself
+	TaggedVector<glm::mat4, MemTag::Scene> locals;
+	TaggedVector<glm::mat4, MemTag::Scene> worlds;
+	TaggedVector<SceneNode, MemTag::Scene> nodes;
+	TaggedVector<Entity, MemTag::Scene> entities;
+	TaggedVector<SceneNode, MemTag::Scene> dirty;
+	TaggedVector<Range, MemTag::Scene> ranges; // recomputed by the last update()
+	ObjectPool<SceneNodeSlot, MemTag::Scene> slots;
+	size_t lastUpdated = 0;
+
+	void updateRange(uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t p = parents[i];
+			worlds[i] = p == NoParent ? locals[i] : worlds[p] * locals[i];
+		}
+	}
+
+	// Rotates [low, high) of every array so that middle becomes the first element
+	void rotateSpan(uint32_t low, uint32_t high, uint32_t middle) {
+		std::rotate(parents.begin() + low, parents.begin() + middle, parents.begin() + high);
+		std::rotate(subtreeSizes.begin() + low, subtreeSizes.begin() + middle, subtreeSizes.begin() + high);
+		std::rotate(locals.begin() + low, locals.begin() + middle, locals.begin() + high);
+		std::rotate(worlds.begin() + low, worlds.begin() + middle, worlds.begin() + high);
+		std::rotate(nodes.begin() + low, nodes.begin() + middle, nodes.begin() + high);
+		std::rotate(entities.begin() + low, entities.begin() + middle, entities.begin() + high);
+	}
+};
@@ -0,0 +1,569 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCENETEXT_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "MappedFile.h"
+#include "SceneFile.h"
+
+// Text scene format: plain JSON with one object per line so it diffs cleanly.
+//
+//   {"format":"3dengine-scene","version":1,"objects":[
+//   {"id":1,"type":"Cube","position":[0,0,0],"size":[1,1,1],"rotation":[0,0,0],"selected":false},
+//   {"id":2,"type":"Cube","parent":0,"position":[2,0,0],"size":[1,1,1],"rotation":[0,0,0],"selected":false},
+//   ...
+//   ]}
+// "parent" is the position of the parent in the objects array; roots leave it out. A scene
+// saved away from the floating origin has "origin":[x,y,z] before "objects", in doubles.
+namespace scenetext {
+
+	// --- scanning helpers -------------------------------------------------------------
+	// index of the lowest set bit, mask must be non-zero
+	inline unsigned ctz(unsigned mask) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+
+	inline bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+	// Skips whitespace 16 bytes at a time. Most tokens aren't preceded by any, so the first
+	// byte is checked on its own before paying for a vector load.
+	inline const char* skipSpace(const char* p, const char* end) {
+		if (p < end && !isSpace(*p)) return p;
+#ifdef SCENETEXT_SSE2
+		const __m128i space = _mm_set1_epi8(' '), newline = _mm_set1_epi8('\n');
+		const __m128i ret = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+		while (end - p >= 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, ret), _mm_cmpeq_epi8(chunk, tab)));
+			unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xFFFF;
+			if (mask) return p + ctz(mask);
+			p += 16;
+		}
+#endif
+		while (p < end && isSpace(*p)) p++;
+		return p;
+	}
+
+	// Finds the closing quote of a string starting at p (just past the opening quote),
+	// stepping over escapes. Returns end if the string is unterminated.
+	inline const char* findStringEnd(const char* p, const char* end) {
+		for (;;) {
+#ifdef SCENETEXT_SSE2
+			const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+			while (end - p >= 16) {
+				__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+					_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+				if (mask) {
+					p += ctz(mask);
+					break;
+				}
+				p += 16;
+			}
+#endif
+			while (p < end && *p != '"' && *p != '\\') p++;
+			if (p >= end) return end;
+			if (*p == '"') return p;
+			p += 2; // escaped character
+			if (p >= end) return end;
+		}
+	}
+
+	// The text of a JSON string with its escapes resolved; \u escapes come out as UTF-8
+	inline std::string unescape(const char* p, size_t length) {
+		const char* end = p + length;
+		std::string out;
+		out.reserve(length);
+		auto hex4 = [&](uint32_t& code) {
+			if (end - p < 4) return false;
+			code = 0;
+			for (int i = 0; i < 4; i++) {
+				char c = *p++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= c - '0';
+				else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+				else return false;
+			}
+			return true;
+		};
+		while (p < end) {
+			char c = *p++;
+			if (c != '\\' || p == end) {
+				out += c;
+				continue;
+			}
+			switch (c = *p++) {
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				uint32_t code;
+				if (!hex4(code)) return out;
+				uint32_t low;
+				if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+					p += 2;
+					if (hex4(low) && low >= 0xDC00 && low < 0xE000) code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				if (code < 0x80) out += static_cast<char>(code);
+				else if (code < 0x800) {
+					out += static_cast<char>(0xC0 | (code >> 6));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000) {
+					out += static_cast<char>(0xE0 | (code >> 12));
+					out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else {
+					out += static_cast<char>(0xF0 | (code >> 18));
+					out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+					out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: out += c; break; // \" \\ \/
+			}
+		}
+		return out;
+	}
+
+	// --- SAX parser -------------------------------------------------------------------
+	// Streams JSON events to Handler without allocating. Strings and keys are handed over as
+	// views into the input (escape sequences are left as written). Handler callbacks return
+	// false to stop parsing:
+	//   onStartObject() onEndObject() onStartArray() onEndArray()
+	//   onKey(const char*, size_t) onString(const char*, size_t) onNumber(double) onBool(bool) onNull()
+	template<typename Handler>
+	class SaxParser {
+	public:
+		SaxParser(const char* data, size_t size, Handler& handler) : begin(data), p(data), end(data + size), handler(handler) {}
+
+		bool parse() {
+			p = skipSpace(p, end);
+			if (!parseValue(0)) return false;
+			p = skipSpace(p, end);
+			return p == end || fail();
+		}
+
+		size_t errorOffset() const { return static_cast<size_t>(errorAt - begin); }
+
+	private:
+		static const int MaxDepth = 64;
+
+		const char* begin;
+		const char* p;
+		const char* end;
+		const char* errorAt = nullptr;
+		Handler& handler;
+
+		bool fail() {
+			errorAt = p;
+			return false;
+		}
+
+		bool parseValue(int depth) {
+			if (p >= end || depth > MaxDepth) return fail();
+			switch (*p) {
+			case '{': return parseObject(depth);
+			case '[': return parseArray(depth);
+			case '"': {
+				const char* start = p + 1;
+				const char* close = findStringEnd(start, end);
+				if (close == end) return fail();
+				p = close + 1;
+				return handler.onString(start, static_cast<size_t>(close - start)) || fail();
+			}
+			case 't': return parseLiteral("true", 4) && (handler.onBool(true) || fail());
+			case 'f': return parseLiteral("false", 5) && (handler.onBool(false) || fail());
+			case 'n': return parseLiteral("null", 4) && (handler.onNull() || fail());
+			default: return parseNumber();
+			}
+		}
+
+		bool parseLiteral(const char* word, size_t length) {
+			if (static_cast<size_t>(end - p) < length || std::memcmp(p, word, length) != 0) return fail();
+			p += length;
+			return true;
+		}
+
+		// Plain decimals (the only thing the writer emits) take Clinger's fast path when the
+		// digits fit exactly in a double, at most 2^53: one division by an exact power of ten
+		// then rounds correctly. Anything else goes through from_chars.
+		bool parseNumber() {
+			static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			const char* q = p;
+			bool negative = q < end && *q == '-';
+			if (negative) q++;
+			uint64_t mantissa = 0;
+			int digits = 0, fraction = 0;
+			while (q < end && static_cast<unsigned>(*q - '0') < 10 && digits < 16) {
+				mantissa = mantissa * 10 + static_cast<unsigned>(*q++ - '0');
+				digits++;
+			}
+			if (q < end && *q == '.') {
+				q++;
+				while (q < end && static_cast<unsigned>(*q - '0') < 10 && digits < 16) {
+					mantissa = mantissa * 10 + static_cast<unsigned>(*q++ - '0');
+					digits++;
+					fraction++;
+				}
+			}
+			bool simple = digits > 0 && mantissa <= (1ull << 53) && (q == end || (static_cast<unsigned>(*q - '0') >= 10 && *q != 'e' && *q != 'E' && *q != '.'));
+			if (simple) {
+				double value = static_cast<double>(mantissa) / powers[fraction];
+				p = q;
+				return handler.onNumber(negative ? -value : value) || fail();
+			}
+
+			double value;
+			const char* start = p;
+			std::from_chars_result result = std::from_chars(start, end, value);
+			if (result.ec != std::errc() || result.ptr == start) return fail();
+			p = result.ptr;
+			return handler.onNumber(value) || fail();
+		}
+
+		bool parseObject(int depth) {
+			p++; // '{'
+			if (!handler.onStartObject()) return fail();
+			p = skipSpace(p, end);
+			if (p < end && *p == '}') {
+				p++;
+				return handler.onEndObject() || fail();
+			}
+			for (;;) {
+				if (p >= end || *p != '"') return fail();
+				const char* key = p + 1;
+				const char* close = findStringEnd(key, end);
+				if (close == end) return fail();
+				p = close + 1;
+				if (!handler.onKey(key, static_cast<size_t>(close - key))) return fail();
+				p = skipSpace(p, end);
+				if (p >= end || *p != ':') return fail();
+				p = skipSpace(p + 1, end);
+				if (!parseValue(depth + 1)) return false;
+				p = skipSpace(p, end);
+				if (p < end && *p == ',') {
+					p = skipSpace(p + 1, end);
+					continue;
+				}
+				if (p < end && *p == '}') {
+					p++;
+					return handler.onEndObject() || fail();
+				}
+				return fail();
+			}
+		}
+
+		bool parseArray(int depth) {
+			p++; // '['
+			if (!handler.onStartArray()) return fail();
+			p = skipSpace(p, end);
+			if (p < end && *p == ']') {
+				p++;
+				return handler.onEndArray() || fail();
+			}
+			for (;;) {
+				if (!parseValue(depth + 1)) return false;
+				p = skipSpace(p, end);
+				if (p < end && *p == ',') {
+					p = skipSpace(p + 1, end);
+					continue;
+				}
+				if (p < end && *p == ']') {
+					p++;
+					return handler.onEndArray() || fail();
+				}
+				return fail();
+			}
+		}
+	};
+
+	// --- scene handler ----------------------------------------------------------------
+	// Fills a SceneSnapshot straight from parser events. Unknown keys are ignored so newer
+	// files still load.
+	class SceneHandler {
+	public:
+		explicit SceneHandler(SceneSnapshot& scene) : scene(scene) {}
+
+		bool onStartObject() {
+			depth++;
+			if (inObjects && depth == 3) beginObject();
+			return true;
+		}
+		bool onEndObject() {
+			depth--;
+			return true;
+		}
+		bool onStartArray() {
+			depth++;
+			if (depth == 2 && field == ObjectsField) inObjects = true;
+			component = 0;
+			return true;
+		}
+		bool onEndArray() {
+			if (depth == 2) inObjects = false;
+			depth--;
+			return true;
+		}
+		bool onKey(const char* key, size_t length) {
+			field = Unknown;
+			if (depth == 1 && equals(key, length, "objects")) field = ObjectsField;
+			else if (depth == 1 && equals(key, length, "origin")) field = OriginField;
+			else if (depth == 3 && inObjects && length > 0) {
+				// one character picks the candidate, one compare confirms it
+				switch (key[0]) {
+				case 'i': if (equals(key, length, "id")) field = Id; break;
+				case 't': if (equals(key, length, "type")) field = Type; break;
+				case 'p':
+					if (equals(key, length, "position")) field = Position;
+					else if (equals(key, length, "parent")) field = Parent;
+					break;
+				case 's':
+					if (equals(key, length, "size")) field = Size;
+					else if (equals(key, length, "selected")) field = Selected;
+					break;
+				case 'r': if (equals(key, length, "rotation")) field = Rotation; break;
+				}
+			}
+			return true;
+		}
+		bool onString(const char* str, size_t length) {
+			if (field == Type && current != npos) {
+				if (std::memchr(str, '\\', length)) {
+					scene.types[current] = scene.typeIndex(unescape(str, length));
+					return true;
+				}
+				// the type table stays tiny, so a linear search beats hashing here
+				for (size_t i = 0; i < scene.typeNames.size(); i++) {
+					if (equals(str, length, scene.typeNames[i])) {
+						scene.types[current] = static_cast<uint16_t>(i);
+						return true;
+					}
+				}
+				scene.types[current] = scene.typeIndex(std::string(str, length));
+			}
+			return true;
+		}
+		bool onNumber(double value) {
+			if (field == OriginField) {
+				if (depth == 2 && component < 3) scene.origin[component++] = value;
+				return true;
+			}
+			if (current == npos) return true;
+			switch (field) {
+			case Id: // the file is rejected for an id that isn't a 32-bit integer
+				return toInt32(value, scene.ids[current]);
+			case Parent: // so is a parent that isn't, as -2 for indicesValid()
+				if (!toInt32(value, scene.parents[current])) scene.parents[current] = -2;
+				break;
+			case Position: if (component < 3) scene.positions[current][component++] = static_cast<float>(value); break;
+			case Size: if (component < 3) scene.sizes[current][component++] = static_cast<float>(value); break;
+			case Rotation: if (component < 3) scene.rotations[current][component++] = static_cast<float>(value); break;
+			default: break;
+			}
+			return true;
+		}
+		bool onBool(bool value) {
+			if (field == Selected && current != npos) scene.setSelected(current, value);
+			return true;
+		}
+		bool onNull() { return true; }
+
+	private:
+		// false for a fraction, NaN or anything past int32_t, where the cast would be undefined
+		static bool toInt32(double value, int32_t& out) {
+			if (!(value >= -2147483648.0 && value <= 2147483647.0) || value != std::floor(value)) return false;
+			out = static_cast<int32_t>(value);
+			return true;
+		}
+
+		// depth 1 is the root object, 2 the objects array, 3 an object, 4 a vector
+		enum Field { Unknown, ObjectsField, OriginField, Id, Type, Parent, Position, Size, Rotation, Selected };
+		static const size_t npos = static_cast<size_t>(-1);
+
+		SceneSnapshot& scene;
+		int depth = 0;
+		bool inObjects = false;
+		Field field = Unknown;
+		int component = 0;
+		size_t current = npos;
+
+		template<size_t N>
+		static bool equals(const char* str, size_t length, const char (&literal)[N]) {
+			return length == N - 1 && std::memcmp(str, literal, length) == 0;
+		}
+		static bool equals(const char* str, size_t length, const std::string& name) {
+			return length == name.size() && std::memcmp(str, name.data(), length) == 0;
+		}
+
+		void beginObject() {
+			current = scene.size();
+			scene.types.push_back(0);
+			scene.ids.push_back(static_cast<int32_t>(current + 1));
+			scene.positions.push_back(glm::vec3(0.0f));
+			scene.sizes.push_back(glm::vec3(1.0f));
+			scene.rotations.push_back(glm::vec3(0.0f));
+			scene.parents.push_back(-1);
+			if (scene.selection.size() * 64 <= current) scene.selection.push_back(0);
+		}
+	};
+
+	inline bool parse(const char* data, size_t size, SceneSnapshot& scene) {
+		scene = SceneSnapshot();
+		// objects are roughly 100 bytes each, reserving up front avoids regrowing big arrays
+		size_t estimate = size / 96;
+		scene.types.reserve(estimate);
+		scene.ids.reserve(estimate);
+		scene.positions.reserve(estimate);
+		scene.sizes.reserve(estimate);
+		scene.rotations.reserve(estimate);
+		scene.parents.reserve(estimate);
+		scene.selection.reserve(estimate / 64 + 1);
+
+		SceneHandler handler(scene);
+		SaxParser<SceneHandler> parser(data, size, handler);
+		if (!parser.parse()) {
+			std::cout << "ERROR::SCENETEXT::PARSE_ERROR at byte " << parser.errorOffset() << std::endl;
+			return false;
+		}
+		if (!scene.indicesValid()) {
+			std::cout << "ERROR::SCENETEXT::INVALID_OBJECT: an object without a type or with a parent out of range" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	inline bool load(const std::string& path, SceneSnapshot& scene) {
+		MappedFile file(path);
+		if (!file.isOpen()) {
+			std::cout << "ERROR::SCENETEXT::NOT_FOUND: " << path << std::endl;
+			return false;
+		}
+		file.adviseSequential();
+		return parse(file.data(), file.size(), scene);
+	}
+
+	// --- writer -----------------------------------------------------------------------
+	// Formats into a fixed buffer and flushes it in large chunks; numbers use the shortest
+	// representation that round-trips.
+	inline bool save(const std::string& path, const SceneSnapshot& scene) {
+		std::ofstream out(path, std::ios::binary);
+		if (!out) return false;
+		// room for one full record: its numbers and keys, plus its type name escaped at up to
+		// six bytes a character
+		size_t longestName = 0;
+		for (const std::string& name : scene.typeNames) longestName = std::max(longestName, name.size());
+		size_t recordRoom = 1024 + 6 * longestName;
+		std::vector<char> buffer((1 << 20) + recordRoom);
+		char* w = buffer.data();
+		char* limit = buffer.data() + buffer.size() - recordRoom;
+		auto put = [&w](const char* str) {
+			size_t length = std::strlen(str);
+			std::memcpy(w, str, length);
+			w += length;
+		};
+		// quotes, backslashes and control characters escaped
+		auto putEscaped = [&w](const std::string& str) {
+			static const char hex[] = "0123456789abcdef";
+			for (size_t i = 0; i < str.size(); i++) {
+				unsigned char c = static_cast<unsigned char>(str[i]);
+				if (c == '"' || c == '\\') {
+					*w++ = '\\';
+					*w++ = static_cast<char>(c);
+				}
+				else if (c < 0x20) {
+					std::memcpy(w, "\\u00", 4);
+					w[4] = hex[c >> 4];
+					w[5] = hex[c & 15];
+					w += 6;
+				}
+				else {
+					*w++ = static_cast<char>(c);
+				}
+			}
+		};
+		auto putNumber = [&w](float value) {
+			w = std::to_chars(w, w + 32, value).ptr;
+		};
+		auto putVec3 = [&](const glm::vec3& v) {
+			*w++ = '[';
+			putNumber(v.x); *w++ = ',';
+			putNumber(v.y); *w++ = ',';
+			putNumber(v.z);
+			*w++ = ']';
+		};
+
+		put("{\"format\":\"3dengine-scene\",\"version\":1,");
+		if (scene.origin != glm::dvec3(0.0)) {
+			put("\"origin\":[");
+			for (int c = 0; c < 3; c++) {
+				w = std::to_chars(w, w + 32, scene.origin[c]).ptr;
+				*w++ = c < 2 ? ',' : ']';
+			}
+			*w++ = ',';
+		}
+		put("\"objects\":[\n");
+		for (size_t i = 0; i < scene.size(); i++) {
+			put("{\"id\":");
+			w = std::to_chars(w, w + 16, scene.ids[i]).ptr;
+			put(",\"type\":\"");
+			putEscaped(scene.typeNames[scene.types[i]]);
+			put("\"");
+			if (i < scene.parents.size() && scene.parents[i] >= 0) {
+				put(",\"parent\":");
+				w = std::to_chars(w, w + 16, scene.parents[i]).ptr;
+			}
+			put(",\"position\":"); putVec3(scene.positions[i]);
+			put(",\"size\":"); putVec3(scene.sizes[i]);
+			put(",\"rotation\":"); putVec3(scene.rotations[i]);
+			put(scene.isSelected(i) ? ",\"selected\":true}" : ",\"selected\":false}");
+			put(i + 1 < scene.size() ? ",\n" : "\n");
+			if (w > limit) {
+				out.write(buffer.data(), w - buffer.data());
+				w = buffer.data();
+			}
+		}
+		put("]}\n");
+		out.write(buffer.data(), w - buffer.data());
+		return out.good();
+	}
+
+	// --- conversion -------------------------------------------------------------------
+	inline bool textToBinary(const std::string& textPath, const std::string& binaryPath) {
+		SceneSnapshot scene;
+		return load(textPath, scene) && scenefile::save(binaryPath, scene);
+	}
+
+	inline bool binaryToText(const std::string& binaryPath, const std::string& textPath) {
+		SceneSnapshot scene;
+		return scenefile::load(binaryPath, scene) && save(textPath, scene);
+	}
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#define ENGINE_SAP_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SAP_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include "ECS.h"
+#include "MemoryTracker.h"
+#include "ObjectPool.h"
+
+// Sort-and-sweep broadphase over axis-aligned boxes (box pruning, as Terdiman describes it).
+// Boxes are kept in order of their minimum on one axis; findPairs() re-sorts that order with
+// an insertion sort, which is close to linear when objects have only moved a little since
+// the last call, then sweeps it, comparing each box only with the boxes that start before it
+// ends on that axis. The sweep reads the sorted boxes as structure of arrays and tests 4 of
+// them per SSE2 instruction, 8 with AVX.
+//
+// Projected onto one axis a big scene is crowded: most boxes that overlap there are far
+// apart on the others, and every box passing another one costs the sort a step. So the
+// scene is cut into slabs along a second axis, each keeping its own sorted list, the way
+// multi-region sweep and prune does; a box is listed in every slab it reaches and a pair is
+// reported only by the slab where both boxes start. Slabs are about twice as thick as the
+// average box, and there is just one while the scene is small.
+//
+// The sweep axis is the one along which the box centers are most spread out and the slabs
+// go along the next one. Both are re-chosen on every call but only change when another
+// axis is clearly better, or the scene outgrows its slabs; the lists are then rebuilt.
+struct SapProxy {
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	Entity entity;
+	uint32_t firstSlab; // the slabs listing it as of the last findPairs(); first > last for none
+	uint32_t lastSlab;
+};
+
+using SapHandle = PoolHandle<SapProxy>;
+
+struct OverlapPair {
+	Entity a;
+	Entity b;
+};
+
+class SweepAndPrune {
+public:
+	SweepAndPrune() {
+		slabs.resize(1);
+	}
+	SweepAndPrune(const SweepAndPrune&) = delete;
+	SweepAndPrune& operator=(const SweepAndPrune&) = delete;
+
+	// A box with a NaN coordinate is stored empty and overlaps nothing
+	SapHandle insert(Entity entity, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		SapHandle handle = proxies.create(SapProxy{ glm::vec3(0.0f), glm::vec3(0.0f), entity, 1, 0 });
+		if (handle.valid()) setBox(*proxies.get(handle), boxMin, boxMax);
+		return handle;
+	}
+
+	// Returns false for a stale handle
+	bool update(SapHandle handle, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		SapProxy* proxy = proxies.get(handle);
+		if (!proxy) return false;
+		setBox(*proxy, boxMin, boxMax);
+		return true;
+	}
+
+	// The box leaves the sorted lists on the next findPairs()
+	bool remove(SapHandle handle) {
+		return proxies.destroy(handle);
+	}
+
+	// Moves every box by -offset, for the scene's floating origin. The boxes keep their
+	// order, so the sorted lists stay as they are.
+	void rebase(const glm::vec3& offset) {
+		proxies.forEach([&](SapHandle, SapProxy& proxy) {
+			proxy.boxMin -= offset;
+			proxy.boxMax -= offset;
+		});
+		slabOrigin -= offset[other1];
+	}
+
+	// Every pair of boxes that overlap on all three axes, touching included, as of the last
+	// insert/update. a starts before b on the sweep axis. The list is reused by the next call.
+	const TaggedVector<OverlapPair, MemTag::Scene>& findPairs() {
+		plan();
+		assignSlabs();
+		for (uint32_t slab = 0; slab < slabCount; slab++) sortSlab(slab);
+		gather();
+		pairs.clear();
+		for (uint32_t slab = 0; slab < slabCount; slab++) {
+			for (size_t i = slabs[slab].start; i < slabs[slab].end; i++) {
+				float end = sweepMax[i];
+				size_t j = i + 1;
+#if defined(ENGINE_SAP_AVX)
+				__m256 limit = _mm256_set1_ps(end);
+				__m256 minB1 = _mm256_set1_ps(min1[i]), maxB1 = _mm256_set1_ps(max1[i]);
+				__m256 minB2 = _mm256_set1_ps(min2[i]), maxB2 = _mm256_set1_ps(max2[i]);
+				for (;; j += 8) {
+					__m256 started = _mm256_cmp_ps(_mm256_loadu_ps(&sweepMin[j]), limit, _CMP_LE_OQ);
+					__m256 overlap = _mm256_and_ps(started, _mm256_and_ps(
+						_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&min1[j]), maxB1, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&max1[j]), minB1, _CMP_GE_OQ)),
+						_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&min2[j]), maxB2, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(&max2[j]), minB2, _CMP_GE_OQ))));
+					addPairs(slab, i, j, _mm256_movemask_ps(overlap));
+					if (_mm256_movemask_ps(started) != 0xFF) break;
+				}
+#elif defined(ENGINE_SAP_SSE)
+				__m128 limit = _mm_set1_ps(end);
+				__m128 minB1 = _mm_set1_ps(min1[i]), maxB1 = _mm_set1_ps(max1[i]);
+				__m128 minB2 = _mm_set1_ps(min2[i]), maxB2 = _mm_set1_ps(max2[i]);
+				for (;; j += 4) {
+					__m128 started = _mm_cmple_ps(_mm_loadu_ps(&sweepMin[j]), limit);
+					__m128 overlap = _mm_and_ps(started, _mm_and_ps(
+						_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&min1[j]), maxB1), _mm_cmpge_ps(_mm_loadu_ps(&max1[j]), minB1)),
+						_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&min2[j]), maxB2), _mm_cmpge_ps(_mm_loadu_ps(&max2[j]), minB2))));
+					addPairs(slab, i, j, _mm_movemask_ps(overlap));
+					if (_mm_movemask_ps(started) != 0xF) break;
+				}
+#else
+				for (; sweepMin[j] <= end; j++) {
+					// & rather than &&: overlaps are rare and the branches wouldn't predict
+					bool overlap = (min1[j] <= max1[i]) & (max1[j] >= min1[i]) & (min2[j] <= max2[i]) & (max2[j] >= min2[i]);
+					if (overlap) addPairs(slab, i, j, 1);
+				}
+#endif
+			}
+		}
+		return pairs;
+	}
+
+	// What the last findPairs() returned, without sweeping again
+	const TaggedVector<OverlapPair, MemTag::Scene>& lastPairs() const { return pairs; }
+
+	// 0, 1 or 2 for x, y or z
+	int sweepAxis() const { return axis; }
+	int slabAxis() const { return other1; }
+	uint32_t slabsInUse() const { return slabCount; }
+	size_t size() const { return proxies.size(); }
+
+	// Removes every box and frees all storage
+	void clear() {
+		proxies.clear();
+		proxies.shrink();
+		slabs = decltype(slabs)();
+		slabs.resize(1);
+		pairs = decltype(pairs)();
+		sweepMin = sweepMax = min1 = max1 = min2 = max2 = decltype(sweepMin)();
+		entities = decltype(entities)();
+		axis = 0;
+		other1 = 1;
+		other2 = 2;
+		slabCount = 1;
+	}
+
+private:
+	// how much more spread out another axis has to be before the sweep or the slabs move to it
+	static constexpr double AxisSwitchRatio = 1.5;
+	// slabs are this many times as thick as the average box on their axis
+	static constexpr double SlabThickness = 2.0;
+	// and hold at least this many boxes on average
+	static const size_t MinBoxesPerSlab = 64;
+	static const uint32_t MaxSlabs = 4096;
+	// an insertion sort moving boxes more than this many places each on average gives way to a full sort
+	static const size_t MaxShiftsPerBox = 64;
+	// each slab's arrays run this far past its last box, so the sweep needs no bounds check
+	static const size_t Padding = 8;
+
+	struct SortKey {
+		float min; // on the sweep axis; +inf once the box has left the slab
+		SapHandle handle;
+	};
+
+	struct Slab {
+		TaggedVector<SortKey, MemTag::Scene> order;
+		TaggedVector<SortKey, MemTag::Scene> added; // boxes that reached the slab since the last sort
+		size_t start = 0, end = 0; // in the sweep arrays
+	};
+
+	ObjectPool<SapProxy, MemTag::Scene> proxies;
+	TaggedVector<Slab, MemTag::Scene> slabs;
+	TaggedVector<OverlapPair, MemTag::Scene> pairs;
+	// each slab's boxes in sorted order: the sweep axis, the slab axis, the last axis
+	TaggedVector<float, MemTag::Scene> sweepMin, sweepMax, min1, max1, min2, max2;
+	TaggedVector<Entity, MemTag::Scene> entities;
+	int axis = 0, other1 = 1, other2 = 2;
+	float slabOrigin = 0.0f;
+	float slabScale = 0.0f; // slabs per unit
+	uint32_t slabCount = 1;
+
+	static void setBox(SapProxy& proxy, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		auto nan = [](const glm::vec3& v) { return std::isnan(v.x) || std::isnan(v.y) || std::isnan(v.z); };
+		bool empty = nan(boxMin) || nan(boxMax);
+		proxy.boxMin = empty ? glm::vec3(std::numeric_limits<float>::infinity()) : boxMin;
+		proxy.boxMax = empty ? glm::vec3(-std::numeric_limits<float>::infinity()) : boxMax;
+	}
+
+	uint32_t slabOf(float coordinate) const {
+		float slab = (coordinate - slabOrigin) * slabScale;
+		return static_cast<uint32_t>(std::min(std::max(slab, 0.0f), static_cast<float>(slabCount - 1)));
+	}
+
+	// A pair for each set bit of mask, bit k standing for box j + k, unless the two boxes also
+	// share an earlier slab, which reports them instead
+	void addPairs(uint32_t slab, size_t i, size_t j, int mask) {
+		for (size_t k = 0; mask != 0; k++, mask >>= 1) {
+			if ((mask & 1) && (slabCount == 1 || slabOf(std::max(min1[i], min1[j + k])) == slab))
+				pairs.push_back(OverlapPair{ entities[i], entities[j + k] });
+		}
+	}
+
+	// Re-chooses the axes and slabs from the spread of the box centers and the average box
+	// size, and empties every slab if they change
+	void plan() {
+		glm::dvec3 sum(0.0), sumSquares(0.0), extents(0.0);
+		glm::vec3 lowest(std::numeric_limits<float>::max()), highest(-std::numeric_limits<float>::max());
+		size_t live = 0;
+		proxies.forEach([&](SapHandle, const SapProxy& proxy) {
+			glm::vec3 center = (proxy.boxMin + proxy.boxMax) * 0.5f;
+			glm::vec3 extent = proxy.boxMax - proxy.boxMin;
+			if (!std::isfinite(center.x + center.y + center.z + extent.x + extent.y + extent.z)) return;
+			sum += glm::dvec3(center);
+			sumSquares += glm::dvec3(center) * glm::dvec3(center);
+			extents += glm::dvec3(extent);
+			lowest = glm::min(lowest, center);
+			highest = glm::max(highest, center);
+			live++;
+		});
+		if (live < 2) return;
+		glm::dvec3 mean = sum / double(live);
+		glm::dvec3 variance = sumSquares / double(live) - mean * mean;
+		int sweep = axis;
+		int widest = variance.x >= variance.y ? (variance.x >= variance.z ? 0 : 2) : (variance.y >= variance.z ? 1 : 2);
+		if (variance[widest] > variance[axis] * AxisSwitchRatio) sweep = widest;
+		int a = (sweep + 1) % 3, b = (sweep + 2) % 3;
+		int slabAxis = other1 != sweep ? other1 : a;
+		int otherAxis = slabAxis == a ? b : a;
+		if (variance[otherAxis] > variance[slabAxis] * AxisSwitchRatio) std::swap(slabAxis, otherAxis);
+
+		double thickness = SlabThickness * extents[slabAxis] / double(live);
+		double span = double(highest[slabAxis]) - double(lowest[slabAxis]);
+		double wanted = thickness > 0.0 ? std::ceil(span / thickness) : 1.0;
+		wanted = std::max(1.0, std::min(wanted, std::min(double(MaxSlabs), double(live / MinBoxesPerSlab))));
+		// the current slabs still do if they are within a factor of the wanted count and
+		// the centers haven't spread far past them
+		double current = slabCount;
+		double covered = slabCount > 1 ? current / slabScale : 0.0;
+		bool fits = sweep == axis && slabAxis == other1 && wanted <= current * AxisSwitchRatio && current <= wanted * AxisSwitchRatio &&
+			(slabCount == 1 || (lowest[slabAxis] >= slabOrigin - 0.25 * covered && highest[slabAxis] <= slabOrigin + 1.25 * covered));
+		if (fits) return;
+
+		axis = sweep;
+		other1 = slabAxis;
+		other2 = otherAxis;
+		slabCount = static_cast<uint32_t>(wanted);
+		slabOrigin = lowest[slabAxis];
+		slabScale = slabCount > 1 ? static_cast<float>(wanted / span) : 0.0f;
+		slabs.resize(slabCount);
+		for (Slab& slab : slabs) {
+			slab.order.clear();
+			slab.added.clear();
+		}
+		proxies.forEach([](SapHandle, SapProxy& proxy) {
+			proxy.firstSlab = 1;
+			proxy.lastSlab = 0;
+		});
+	}
+
+	// Lists each box in the slabs it has reached; sortSlab() drops it from the ones it has left
+	void assignSlabs() {
+		proxies.forEach([&](SapHandle handle, SapProxy& proxy) {
+			uint32_t first = 1, last = 0;
+			if (proxy.boxMin[other1] <= proxy.boxMax[other1]) {
+				first = slabOf(proxy.boxMin[other1]);
+				last = slabOf(proxy.boxMax[other1]);
+			}
+			for (uint32_t slab = first; slab <= last; slab++) {
+				if (slab < proxy.firstSlab || slab > proxy.lastSlab) slabs[slab].added.push_back(SortKey{ proxy.boxMin[axis], handle });
+			}
+			proxy.firstSlab = first;
+			proxy.lastSlab = last;
+		});
+	}
+
+	static bool listedIn(const SapProxy* proxy, uint32_t slab) {
+		return proxy && proxy->firstSlab <= slab && slab <= proxy->lastSlab;
+	}
+
+	// Refreshes the slab's keys and insertion sorts them, drops the boxes that have left,
+	// which sort last, and merges in the ones that have arrived
+	void sortSlab(uint32_t index) {
+		TaggedVector<SortKey, MemTag::Scene>& order = slabs[index].order;
+		TaggedVector<SortKey, MemTag::Scene>& added = slabs[index].added;
+		const float inf = std::numeric_limits<float>::infinity();
+		size_t count = order.size(), left = 0;
+		for (SortKey& key : order) {
+			const SapProxy* proxy = proxies.get(key.handle);
+			bool listed = listedIn(proxy, index);
+			key.min = listed ? proxy->boxMin[axis] : inf;
+			left += !listed;
+		}
+		size_t budget = count * MaxShiftsPerBox + left * count;
+		size_t shifts = 0;
+		size_t i = 1;
+		for (; i < count && shifts <= budget; i++) {
+			SortKey moving = order[i];
+			size_t j = i;
+			for (; j > 0 && order[j - 1].min > moving.min; j--) order[j] = order[j - 1];
+			order[j] = moving;
+			shifts += i - j;
+		}
+		auto byMin = [](const SortKey& a, const SortKey& b) { return a.min < b.min; };
+		if (i < count) std::sort(order.begin(), order.end(), byMin);
+		if (left > 0) {
+			size_t tail = count;
+			while (tail > 0 && order[tail - 1].min == inf) tail--;
+			order.erase(std::remove_if(order.begin() + tail, order.end(), [&](const SortKey& key) { return !listedIn(proxies.get(key.handle), index); }), order.end());
+		}
+		if (added.empty()) return;
+		std::sort(added.begin(), added.end(), byMin);
+		// merge from the back, into the space the new keys take at the end
+		size_t kept = order.size(), next = added.size();
+		order.resize(kept + next);
+		for (size_t to = order.size(); next > 0;) {
+			if (kept > 0 && order[kept - 1].min > added[next - 1].min) order[--to] = order[--kept];
+			else order[--to] = added[--next];
+		}
+		added.clear();
+	}
+
+	// Copies the slabs' boxes into the sweep arrays in sorted order, one slab after another
+	void gather() {
+		size_t total = 0;
+		for (uint32_t slab = 0; slab < slabCount; slab++) total += slabs[slab].order.size() + Padding;
+		for (auto* column : { &sweepMin, &sweepMax, &min1, &max1, &min2, &max2 }) column->resize(total);
+		entities.resize(total);
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		size_t at = 0;
+		for (uint32_t slab = 0; slab < slabCount; slab++) {
+			slabs[slab].start = at;
+			for (const SortKey& key : slabs[slab].order) {
+				const SapProxy& proxy = *proxies.get(key.handle);
+				sweepMin[at] = proxy.boxMin[axis];
+				sweepMax[at] = proxy.boxMax[axis];
+				min1[at] = proxy.boxMin[other1];
+				max1[at] = proxy.boxMax[other1];
+				min2[at] = proxy.boxMin[other2];
+				max2[at] = proxy.boxMax[other2];
+				entities[at++] = proxy.entity;
+			}
+			slabs[slab].end = at;
+			// NaN after each slab: every compare with it is false, so the sweep stops there
+			// even for a box reaching to infinity
+			for (size_t pad = 0; pad < Padding; pad++, at++) sweepMin[at] = sweepMax[at] = min1[at] = max1[at] = min2[at] = max2[at] = nan;
+		}
+	}
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+// Streams profiler data to disk as Chrome Trace Event JSON, which chrome://tracing and
+// ui.perfetto.dev open directly: CPU and GPU zones as complete events on their lanes,
+// frames on their own track, counters, and asset loads with their paths.
+//
+// Events are formatted on the profiler's thread into a per-frame chunk; a writer thread
+// owns the file, so disk I/O never lands inside a frame.
+class TraceExporter : public ProfileSink {
+public:
+	~TraceExporter() { stop(); }
+
+	// Starts capturing into path. maxFrames == 0 captures until stop().
+	bool start(const std::string& path, uint64_t maxFrames = 0) {
+		if (writer.joinable()) return false;
+		out.open(path, std::ios::binary);
+		if (!out) {
+			std::cout << "ERROR::TRACE::CANNOT_OPEN: " << path << std::endl;
+			return false;
+		}
+		chunk = "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"3DEngine\"}}";
+		appendLaneName(FrameLane, "Frames");
+		namedLanes.clear();
+		originNs = profilerNowNs();
+		framesLeft = maxFrames;
+		limited = maxFrames != 0;
+		closing = false;
+		capturing = true;
+		writer = std::thread([this] { writerLoop(); });
+		Profiler::get().setSink(this);
+		return true;
+	}
+
+	// Detaches from the profiler, flushes what's queued and closes the file
+	void stop() {
+		if (!writer.joinable()) return;
+		Profiler::get().setSink(nullptr);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (capturing) finishCapture();
+		}
+		writer.join();
+		out.close();
+	}
+
+	bool active() const { return writer.joinable(); }
+
+	// True once a capture limited to N frames has written them; stop() then just joins
+	bool finished() const { return writer.joinable() && !capturing; }
+
+	// --- ProfileSink ------------------------------------------------------------------
+	void zone(const ProfileEvent& event, const char* laneName) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!capturing) return;
+		nameLane(event.threadIndex, laneName);
+		char line[256];
+		std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			event.name, laneName ? laneName : "cpu", micros(event.startNs), (event.endNs - event.startNs) / 1000.0, event.threadIndex);
+		chunk += line;
+	}
+
+	void counter(const char* name, uint64_t timeNs, double value) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!capturing) return;
+		// JSON has no inf or nan, which %g would print as such
+		char number[32] = "null";
+		if (std::isfinite(value)) std::snprintf(number, sizeof(number), "%.17g", value);
+		char line[192];
+		std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%s}}",
+			name, micros(timeNs), number);
+		chunk += line;
+	}
+
+	void annotation(const char* category, const char* name, const char* detail, uint64_t startNs, uint64_t endNs, uint32_t lane) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!capturing) return;
+		nameLane(lane, nullptr);
+		char line[192];
+		std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"detail\":\"",
+			name, category, micros(startNs), (endNs - startNs) / 1000.0, lane);
+		chunk += line;
+		appendEscaped(detail);
+		chunk += "\"}}";
+	}
+
+	void frame(uint64_t index, uint64_t startNs, uint64_t endNs) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!capturing) return;
+		char line[192];
+		std::snprintf(line, sizeof(line), ",\n{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			static_cast<unsigned long long>(index), micros(startNs), (endNs - startNs) / 1000.0, FrameLane);
+		chunk += line;
+		if (limited && --framesLeft == 0) {
+			finishCapture();
+			return;
+		}
+		push();
+	}
+
+private:
+	static const uint32_t FrameLane = 1000; // tid of the frame track, clear of thread lanes
+
+	std::mutex mutex;            // guards chunk and the capture state
+	std::string chunk;
+	std::vector<bool> namedLanes;
+	uint64_t originNs = 0;
+	uint64_t framesLeft = 0;
+	bool limited = false;
+	std::atomic<bool> capturing{ false };
+
+	std::thread writer;
+	std::ofstream out;
+	std::mutex queueMutex;
+	std::condition_variable queueWake;
+	std::deque<std::string> queue;
+	bool closing = false;
+
+	double micros(uint64_t ns) const {
+		return (static_cast<int64_t>(ns) - static_cast<int64_t>(originNs)) / 1000.0;
+	}
+
+	void nameLane(uint32_t lane, const char* laneName) {
+		if (lane < namedLanes.size() && namedLanes[lane]) return;
+		if (lane >= namedLanes.size()) namedLanes.resize(lane + 1, false);
+		namedLanes[lane] = true;
+		if (laneName) {
+			appendLaneName(lane, laneName);
+			return;
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "Thread %u", lane);
+		appendLaneName(lane, name);
+	}
+
+	void appendLaneName(uint32_t lane, const char* name) {
+		char line[160];
+		std::snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", lane, name);
+		chunk += line;
+	}
+
+	void appendEscaped(const char* text) {
+		for (; *text; text++) {
+			char c = *text;
+			if (c == '"' || c == '\\') chunk += '\\';
+			if (static_cast<unsigned char>(c) < 0x20) c = ' ';
+			chunk += c;
+		}
+	}
+
+	// Hands the current chunk to the writer thread; caller holds mutex
+	void push() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back(std::move(chunk));
+		}
+		chunk.clear();
+		queueWake.notify_one();
+	}
+
+	// caller holds mutex
+	void finishCapture() {
+		chunk += "\n]}\n";
+		capturing = false;
+		push();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			closing = true;
+		}
+		queueWake.notify_one();
+	}
+
+	void writerLoop() {
+		for (;;) {
+			std::string data;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueWake.wait(lock, [this] { return closing || !queue.empty(); });
+				if (queue.empty()) return;
+				data = std::move(queue.front());
+				queue.pop_front();
+			}
+			out.write(data.data(), static_cast<std::streamsize>(data.size()));
+		}
+	}
+};
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef ENGINE_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+// Bytes handed out by the VFS: either a view into a mapped archive (no copy) or an owned buffer.
+class FileData {
+public:
+	FileData() = default;
+	FileData(FileData&&) = default;
+	FileData& operator=(FileData&&) = default;
+	FileData(const FileData&) = delete;
+	FileData& operator=(const FileData&) = delete;
+
+	static FileData view(const char* data, size_t size) {
+		FileData file;
+		file.ptr = data;
+		file.length = size;
+		file.found = true;
+		return file;
+	}
+
+	static FileData owned(std::vector<char>&& bytes) {
+		FileData file;
+		file.buffer = std::move(bytes);
+		file.ptr = file.buffer.data();
+		file.length = file.buffer.size();
+		file.found = true;
+		return file;
+	}
+
+	const char* data() const { return ptr; }
+	size_t size() const { return length; }
+	std::string str() const { return ptr ? std::string(ptr, length) : std::string(); }
+	explicit operator bool() const { return found; }
+
+private:
+	const char* ptr = nullptr;
+	size_t length = 0;
+	std::vector<char> buffer; // moving a vector keeps its storage, so ptr stays valid
+	bool found = false;
+};
+
+// Something that can serve files by path relative to its mount point
+class FileSource {
+public:
+	virtual ~FileSource() = default;
+	virtual bool exists(const std::string& path) const = 0;
+	virtual FileData read(const std::string& path) const = 0;
+};
+
+// Loose files under a directory on disk
+class DirectorySource : public FileSource {
+public:
+	explicit DirectorySource(std::string rootDir) : root(std::move(rootDir)) {
+		if (!root.empty() && root.back() != '/') root += '/';
+	}
+
+	bool exists(const std::string& path) const override {
+		return std::ifstream(root + path).good();
+	}
+
+	FileData read(const std::string& path) const override {
+		std::ifstream file(root + path, std::ios::binary | std::ios::ate);
+		if (!file) return FileData();
+		std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(bytes.data(), bytes.size());
+		return FileData::owned(std::move(bytes));
+	}
+
+private:
+	std::string root;
+};
+
+// Packed archive layout:
+//   Header | entry data (each entry aligned to header.alignment) | TOC sorted by pathHash | name blob
+namespace pack {
+	static const uint32_t Magic = 0x314B4150; // "PAK1"
+	static const uint32_t Version = 1;
+
+	enum EntryFlags : uint32_t { EntryLZ4 = 1 };
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t alignment;
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+	};
+
+	struct TocEntry {
+		uint64_t pathHash;
+		uint64_t offset;
+		uint64_t storedSize; // bytes in the archive
+		uint64_t size;       // bytes after decompression
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+}
+
+// Files served out of a single memory-mapped archive. Uncompressed entries are returned as views.
+class PackSource : public FileSource {
+public:
+	explicit PackSource(const std::string& archivePath) {
+		if (!file.open(archivePath) || file.size() < sizeof(pack::Header)) return;
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (header.magic != pack::Magic || header.version != pack::Version || !validToc()) {
+			std::cout << "ERROR::VFS::INVALID_ARCHIVE: " << archivePath << std::endl;
+			file.close();
+			return;
+		}
+		toc = reinterpret_cast<const pack::TocEntry*>(file.data() + header.tocOffset);
+		names = file.data() + header.namesOffset;
+	}
+
+	bool isOpen() const { return toc != nullptr; }
+	size_t entryCount() const { return toc ? header.entryCount : 0; }
+
+	bool exists(const std::string& path) const override { return find(path) != nullptr; }
+
+	FileData read(const std::string& path) const override {
+		const pack::TocEntry* entry = find(path);
+		if (!entry) return FileData();
+		const char* stored = file.data() + entry->offset;
+		if (!(entry->flags & pack::EntryLZ4))
+			return FileData::view(stored, static_cast<size_t>(entry->size));
+
+#ifdef ENGINE_HAVE_LZ4
+		std::vector<char> bytes(static_cast<size_t>(entry->size));
+		int written = LZ4_decompress_safe(stored, bytes.data(), static_cast<int>(entry->storedSize), static_cast<int>(entry->size));
+		if (written != static_cast<int>(entry->size)) {
+			std::cout << "ERROR::VFS::CORRUPT_ENTRY: " << path << std::endl;
+			return FileData();
+		}
+		return FileData::owned(std::move(bytes));
+#else
+		std::cout << "ERROR::VFS::LZ4_NOT_AVAILABLE: " << path << std::endl;
+		return FileData();
+#endif
+	}
+
+private:
+	MappedFile file;
+	pack::Header header = {};
+	const pack::TocEntry* toc = nullptr;
+	const char* names = nullptr;
+
+	// Every range the TOC points at lies inside the file, checked once here so find() and
+	// read() can trust it. Compared against the space left rather than summed, so nothing wraps.
+	bool validToc() const {
+		uint64_t size = file.size();
+		if (header.tocOffset > size || header.entryCount > (size - header.tocOffset) / sizeof(pack::TocEntry)) return false;
+		if (header.namesOffset > size) return false;
+		uint64_t namesSize = size - header.namesOffset;
+		const pack::TocEntry* entries = reinterpret_cast<const pack::TocEntry*>(file.data() + header.tocOffset);
+		for (uint32_t i = 0; i < header.entryCount; i++) {
+			const pack::TocEntry& entry = entries[i];
+			if (entry.nameOffset > namesSize || entry.nameLength > namesSize - entry.nameOffset) return false;
+			if (entry.offset > size || entry.storedSize > size - entry.offset) return false;
+			if (entry.flags & pack::EntryLZ4) {
+				if (entry.storedSize > INT_MAX || entry.size > INT_MAX) return false; // LZ4 takes ints
+			}
+			else if (entry.storedSize != entry.size) {
+				return false; // served as a view of size bytes
+			}
+		}
+		return true;
+	}
+
+	const pack::TocEntry* find(const std::string& path) const {
+		if (!toc) return nullptr;
+		uint64_t hash = hashString(path);
+		const pack::TocEntry* end = toc + header.entryCount;
+		const pack::TocEntry* it = std::lower_bound(toc, end, hash, [](const pack::TocEntry& entry, uint64_t h) {
+			return entry.pathHash < h;
+		});
+		// walk the (rare) run of colliding hashes comparing full names
+		for (; it != end && it->pathHash == hash; ++it) {
+			if (it->nameLength == path.size() && std::memcmp(names + it->nameOffset, path.data(), path.size()) == 0)
+				return it;
+		}
+		return nullptr;
+	}
+};
+
+// Builds an archive readable by PackSource. Entries are buffered in memory and written in one pass.
+class PackWriter {
+public:
+	explicit PackWriter(uint32_t alignment = 16) : alignment(alignment) {}
+
+	void add(const std::string& path, const void* data, size_t size, bool compress = false) {
+		Entry entry;
+		entry.path = path;
+		entry.size = size;
+		entry.flags = 0;
+		const char* bytes = static_cast<const char*>(data);
+#ifdef ENGINE_HAVE_LZ4
+		if (compress && size > 0) {
+			std::vector<char> packed(LZ4_compressBound(static_cast<int>(size)));
+			int packedSize = LZ4_compress_default(bytes, packed.data(), static_cast<int>(size), static_cast<int>(packed.size()));
+			// only keep the compressed form when it actually saves space
+			if (packedSize > 0 && static_cast<size_t>(packedSize) < size) {
+				packed.resize(packedSize);
+				entry.stored = std::move(packed);
+				entry.flags = pack::EntryLZ4;
+			}
+		}
+#else
+		(void)compress;
+#endif
+		if (entry.flags == 0) entry.stored.assign(bytes, bytes + size);
+		entries.push_back(std::move(entry));
+	}
+
+	bool addFile(const std::string& packPath, const std::string& diskPath, bool compress = false) {
+		FileData data = DirectorySource("").read(diskPath);
+		if (!data) return false;
+		add(packPath, data.data(), data.size(), compress);
+		return true;
+	}
+
+	bool write(const std::string& archivePath) const {
+		std::vector<pack::TocEntry> toc(entries.size());
+		std::string nameBlob;
+		uint64_t offset = alignUp(sizeof(pack::Header));
+		for (size_t i = 0; i < entries.size(); i++) {
+			const Entry& entry = entries[i];
+			pack::TocEntry& t = toc[i];
+			t.pathHash = hashString(entry.path);
+			t.offset = offset;
+			t.storedSize = entry.stored.size();
+			t.size = entry.size;
+			t.nameOffset = static_cast<uint32_t>(nameBlob.size());
+			t.nameLength = static_cast<uint32_t>(entry.path.size());
+			t.flags = entry.flags;
+			t.reserved = 0;
+			nameBlob += entry.path;
+			offset = alignUp(offset + t.storedSize);
+		}
+
+		pack::Header header = {};
+		header.magic = pack::Magic;
+		header.version = pack::Version;
+		header.entryCount = static_cast<uint32_t>(entries.size());
+		header.alignment = alignment;
+		header.tocOffset = offset;
+		header.namesOffset = offset + toc.size() * sizeof(pack::TocEntry);
+
+		std::ofstream out(archivePath, std::ios::binary);
+		if (!out) return false;
+		std::vector<char> padding(alignment, 0);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(padding.data(), alignUp(sizeof(header)) - sizeof(header));
+		for (size_t i = 0; i < entries.size(); i++) {
+			out.write(entries[i].stored.data(), entries[i].stored.size());
+			out.write(padding.data(), alignUp(toc[i].storedSize) - toc[i].storedSize);
+		}
+		std::sort(toc.begin(), toc.end(), [](const pack::TocEntry& a, const pack::TocEntry& b) {
+			return a.pathHash < b.pathHash;
+		});
+		out.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(pack::TocEntry));
+		out.write(nameBlob.data(), nameBlob.size());
+		return out.good();
+	}
+
+private:
+	struct Entry {
+		std::string path;
+		std::vector<char> stored;
+		uint64_t size;
+		uint32_t flags;
+	};
+
+	uint32_t alignment;
+	std::vector<Entry> entries;
+
+	uint64_t alignUp(uint64_t value) const {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+};
+
+// Resolves engine paths against mounted sources. Later mounts shadow earlier ones, so a pack
+// mounted over a loose directory overrides it. Mount everything before loading starts; reads
+// are safe from any thread after that.
+class VirtualFileSystem {
+public:
+	static VirtualFileSystem& get() {
+		static VirtualFileSystem instance;
+		return instance;
+	}
+
+	void mount(const std::string& mountPoint, std::unique_ptr<FileSource> source) {
+		std::string prefix = normalize(mountPoint);
+		if (!prefix.empty() && prefix.back() != '/') prefix += '/';
+		mounts.push_back(Mount{ prefix, std::move(source) });
+	}
+
+	// Mounts an archive if it can be opened; returns false when it is missing or invalid
+	bool mountPack(const std::string& mountPoint, const std::string& archivePath) {
+		std::unique_ptr<PackSource> source = std::make_unique<PackSource>(archivePath);
+		if (!source->isOpen()) return false;
+		mount(mountPoint, std::move(source));
+		return true;
+	}
+
+	void unmountAll() { mounts.clear(); }
+
+	bool exists(const std::string& path) const {
+		std::string p = normalize(path);
+		for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+			if (matches(*it, p) && it->source->exists(p.substr(it->prefix.size()))) return true;
+		}
+		return false;
+	}
+
+	FileData read(const std::string& path) const {
+		std::string p = normalize(path);
+		for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+			if (!matches(*it, p)) continue;
+			FileData data = it->source->read(p.substr(it->prefix.size()));
+			if (data) return data;
+		}
+		return FileData();
+	}
+
+	std::string readText(const std::string& path) const {
+		return read(path).str();
+	}
+
+	// forward slashes, no leading "./"
+	static std::string normalize(const std::string& path) {
+		std::string p = path;
+		std::replace(p.begin(), p.end(), '\\', '/');
+		while (p.compare(0, 2, "./") == 0) p.erase(0, 2);
+		return p;
+	}
+
+private:
+	struct Mount {
+		std::string prefix;
+		std::unique_ptr<FileSource> source;
+	};
+
+	std::vector<Mount> mounts;
+
+	static bool matches(const Mount& mount, const std::string& path) {
+		return path.compare(0, mount.prefix.size(), mount.prefix) == 0;
+	}
+};
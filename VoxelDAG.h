@@ -0,0 +1,446 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+#include "MappedFile.h"
+#include "MemoryTracker.h"
+#include "Ray.h"
+
+// Which voxels of a cube 2^levels on a side are solid, as a sparse voxel octree that stores
+// identical subtrees once (a DAG; Kämpe et al., "High Resolution Sparse Voxel DAGs", 2013).
+// A solid region of any size ends up as one chain of nodes, and repeated detail is shared.
+//
+// Nodes are runs of 32-bit words that refer to each other by index, so the array is the
+// whole structure and can be saved and read straight out of a mapping:
+//   interior node (8 voxels a side or more): child mask in the low 8 bits, then the word
+//     index of each present child in child order
+//   brick (4 voxels a side): 64 occupancy bits in two words, low word first; 2x2x2 block c
+//     is byte c, and voxel (x, y, z) of the block is bit x + 2y + 4z
+// Child c covers the octant offset by c & 1 along x, (c >> 1) & 1 along y and c >> 2 along z.
+// Children are written before their parents, so every reference points backwards.
+//
+// Voxel v spans v - 0.5 to v + 0.5 in world units, like VoxelWorld's blocks and unit Cubes.
+// Only occupancy is stored; block types stay with whoever built the DAG.
+
+enum class VoxelFill : uint8_t { Empty, Full, Mixed };
+
+struct VoxelHit {
+	glm::ivec3 voxel;
+	glm::ivec3 normal; // face the ray came in through; zero when it starts inside the voxel
+	float distance;    // along the ray, in units of its direction's length
+};
+
+struct VoxelDAGStats {
+	size_t nodes = 0;  // interior nodes
+	size_t bricks = 0;
+	size_t bytes = 0;
+	uint64_t solidVoxels = 0;
+};
+
+class VoxelDAG {
+public:
+	static const int MinLevels = 2;
+	static const int MaxLevels = 20;
+	static const uint32_t NoNode = ~0u;
+
+	// Brick bit for voxel (x, y, z), each 0..3, of a brick
+	static int brickBit(int x, int y, int z) {
+		return (((x >> 1) | (y >> 1) << 1 | (z >> 1) << 2) << 3) | (x & 1) | (y & 1) << 1 | (z & 1) << 2;
+	}
+
+	// Builds the DAG of the cube from origin to origin + 2^levels - 1 top-down. The source
+	// answers in coordinates relative to origin:
+	//   VoxelFill classify(const glm::ivec3& min, int size) - a cube on the octree grid;
+	//     Mixed is always a correct answer, it only costs looking closer
+	//   uint64_t brick(const glm::ivec3& min) - the occupancy of a 4-voxel cube, see brickBit()
+	template<typename Source>
+	void build(int levels, const glm::ivec3& origin, Source& source) {
+		MemTagScope memTag(MemTag::Scene);
+		clear();
+		this->levels = glm::clamp(levels, MinLevels, MaxLevels);
+		this->origin = origin;
+		tables.resize(this->levels + 1);
+		fullNodes.assign(this->levels + 1, uint32_t(NoNode));
+		Built top = buildNode(source, glm::ivec3(0), this->levels);
+		root = top.node;
+		solidVoxels = top.voxels;
+		tables = decltype(tables)();
+		fullNodes = decltype(fullNodes)();
+		words = storage.data();
+		wordCount = storage.size();
+	}
+
+	void clear() {
+		storage = decltype(storage)();
+		mapping.close();
+		words = nullptr;
+		wordCount = 0;
+		root = NoNode;
+		nodeCount = brickCount = 0;
+		solidVoxels = 0;
+	}
+
+	bool empty() const { return root == NoNode; }
+	int levelCount() const { return levels; }
+	int size() const { return 1 << levels; }
+	const glm::ivec3& originVoxel() const { return origin; }
+
+	VoxelDAGStats stats() const {
+		VoxelDAGStats s;
+		s.nodes = nodeCount;
+		s.bricks = brickCount;
+		s.bytes = wordCount * sizeof(uint32_t);
+		s.solidVoxels = solidVoxels;
+		return s;
+	}
+
+	bool isSolid(const glm::ivec3& voxel) const {
+		glm::ivec3 local = voxel - origin;
+		int extent = size();
+		if (root == NoNode || local.x < 0 || local.y < 0 || local.z < 0 || local.x >= extent || local.y >= extent || local.z >= extent) return false;
+		uint32_t node = root;
+		for (int level = levels; level > 2; level--) {
+			int half = 1 << (level - 1);
+			uint32_t c = (local.x & half ? 1u : 0u) | (local.y & half ? 2u : 0u) | (local.z & half ? 4u : 0u);
+			uint32_t mask = words[node] & 0xFF;
+			if (!(mask >> c & 1)) return false;
+			node = words[node + 1 + popcount8(mask & ((1u << c) - 1))];
+		}
+		return brickBits(node) >> brickBit(local.x & 3, local.y & 3, local.z & 3) & 1;
+	}
+
+	// Nearest solid voxel along the ray, within ray.tMax. The octree is walked front to back
+	// (Revelles et al., "An Efficient Parametric Algorithm for Octree Traversal", 2000), with
+	// the ray mirrored so every direction component is positive, so the first voxel reached
+	// is the answer.
+	bool raycast(const Ray& ray, VoxelHit& hit) const {
+		if (!ray.valid() || root == NoNode) return false;
+		const float extent = static_cast<float>(size());
+		glm::vec3 start = ray.origin - (glm::vec3(origin) - 0.5f);
+		glm::vec3 direction = ray.direction;
+		uint32_t flip = 0;
+		for (int a = 0; a < 3; a++) {
+			if (direction[a] < 0.0f) {
+				start[a] = extent - start[a];
+				direction[a] = -direction[a];
+				flip |= 1u << a;
+			}
+			// keeps the plane distances finite for a ray along an axis plane
+			direction[a] = glm::max(direction[a], 1e-20f);
+		}
+		glm::vec3 inverse = 1.0f / direction;
+
+		Frame stack[MaxLevels];
+		int depth = 0;
+		Frame& top = stack[0];
+		top.t0 = -start * inverse;
+		top.t1 = (glm::vec3(extent) - start) * inverse;
+		if (maxOf(top.t0) >= minOf(top.t1) || minOf(top.t1) < 0.0f || maxOf(top.t0) > ray.tMax) return false;
+		top.level = levels;
+		top.min = glm::ivec3(0);
+		top.node = root;
+		enter(top);
+
+		while (depth >= 0) {
+			Frame& frame = stack[depth];
+			uint32_t c = frame.child;
+			glm::vec3 childT0, childT1;
+			for (int a = 0; a < 3; a++) {
+				bool upper = c >> a & 1;
+				childT0[a] = upper ? frame.tm[a] : frame.t0[a];
+				childT1[a] = upper ? frame.t1[a] : frame.tm[a];
+			}
+			float childEnter = maxOf(childT0), childExit = minOf(childT1);
+			// everything left is farther along
+			if (childEnter > ray.tMax) return false;
+
+			uint32_t actual = c ^ flip;
+			bool descended = false;
+			if ((frame.mask >> actual & 1) && childExit >= 0.0f) {
+				glm::ivec3 childMin = frame.min;
+				int half = 1 << (frame.level - 1);
+				for (int a = 0; a < 3; a++) childMin[a] += (c >> a & 1) * half;
+				if (frame.level == 1) {
+					int entryAxis = childT0.x >= childT0.y ? (childT0.x >= childT0.z ? 0 : 2) : (childT0.y >= childT0.z ? 1 : 2);
+					hit.distance = glm::max(childEnter, 0.0f);
+					hit.normal = glm::ivec3(0);
+					if (childEnter >= 0.0f) hit.normal[entryAxis] = flip >> entryAxis & 1 ? 1 : -1;
+					for (int a = 0; a < 3; a++) hit.voxel[a] = origin[a] + (flip >> a & 1 ? size() - 1 - childMin[a] : childMin[a]);
+					return true;
+				}
+				Frame& next = stack[depth + 1];
+				next.t0 = childT0;
+				next.t1 = childT1;
+				next.level = frame.level - 1;
+				next.min = childMin;
+				if (frame.level > 2) next.node = words[frame.node + 1 + popcount8(frame.mask & ((1u << actual) - 1))];
+				else next.mask = static_cast<uint8_t>(frame.bits >> (actual * 8));
+				descended = true;
+			}
+
+			// step to the next child along the ray, or finish this node
+			int exitAxis = childT1.x <= childT1.y ? (childT1.x <= childT1.z ? 0 : 2) : (childT1.y <= childT1.z ? 1 : 2);
+			if (c >> exitAxis & 1) frame.done = true;
+			else frame.child = c | 1u << exitAxis;
+			if (descended) {
+				depth++;
+				enter(stack[depth]);
+			}
+			while (depth >= 0 && stack[depth].done) depth--;
+		}
+		return false;
+	}
+
+	// Whether a solid voxel lies on the segment between the two points
+	bool occluded(const glm::vec3& from, const glm::vec3& to) const {
+		VoxelHit hit;
+		return raycast(Ray(from, to - from, 1.0f), hit);
+	}
+
+	// Layout: Header, then the words.
+	bool save(const std::string& path) const {
+		std::ofstream out(path, std::ios::binary);
+		if (!out) {
+			std::cout << "ERROR::VOXELDAG::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		Header header = { Magic, Version, levels, root, { origin.x, origin.y, origin.z }, 0, wordCount, solidVoxels, nodeCount, brickCount };
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(words), static_cast<std::streamsize>(wordCount * sizeof(uint32_t)));
+		return out.good();
+	}
+
+	// Maps the file and casts rays straight against the mapping; nothing is copied. Every
+	// reference is checked once here, so a damaged file is refused rather than read past.
+	bool open(const std::string& path) {
+		clear();
+		MappedFile file(path);
+		if (!file.isOpen()) {
+			std::cout << "ERROR::VOXELDAG::NOT_FOUND: " << path << std::endl;
+			return false;
+		}
+		Header header;
+		bool ok = file.size() >= sizeof(header);
+		if (ok) {
+			std::memcpy(&header, file.data(), sizeof(header));
+			ok = header.magic == Magic && header.version == Version && header.levels >= MinLevels && header.levels <= MaxLevels &&
+				header.wordCount == (file.size() - sizeof(header)) / sizeof(uint32_t) && file.size() == sizeof(header) + header.wordCount * sizeof(uint32_t);
+		}
+		if (ok) {
+			words = reinterpret_cast<const uint32_t*>(file.data() + sizeof(header));
+			wordCount = static_cast<size_t>(header.wordCount);
+			levels = header.levels;
+			root = header.root;
+			ok = root == NoNode ? header.solidVoxels == 0 : validate();
+		}
+		if (!ok) {
+			words = nullptr;
+			wordCount = 0;
+			root = NoNode;
+			std::cout << "ERROR::VOXELDAG::INVALID_FILE: " << path << std::endl;
+			return false;
+		}
+		origin = glm::ivec3(header.origin[0], header.origin[1], header.origin[2]);
+		solidVoxels = header.solidVoxels;
+		nodeCount = static_cast<size_t>(header.nodeCount);
+		brickCount = static_cast<size_t>(header.brickCount);
+		mapping = std::move(file);
+		return true;
+	}
+
+private:
+	static const uint32_t Magic = 0x31474456; // "VDG1"
+	static const uint32_t Version = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		int32_t levels;
+		uint32_t root;
+		int32_t origin[3];
+		uint32_t reserved;
+		uint64_t wordCount;
+		uint64_t solidVoxels;
+		uint64_t nodeCount;
+		uint64_t brickCount;
+	};
+
+	// One node on the ray's way down. Coordinates and child numbers are in the mirrored
+	// frame; mask and the stored children are not.
+	struct Frame {
+		glm::vec3 t0, t1, tm; // where the ray crosses the lower, upper and middle planes
+		glm::ivec3 min;
+		uint64_t bits;        // a brick's occupancy
+		uint32_t node;
+		int level;
+		uint8_t mask;
+		uint8_t child;
+		bool done;
+	};
+
+	struct Built {
+		uint32_t node;
+		uint64_t voxels;
+	};
+
+	// Open addressing over node indices, one table per level, for finding a node already
+	// written with the same words
+	struct InternTable {
+		TaggedVector<uint32_t, MemTag::Scene> slots; // node + 1, 0 for a free slot
+		size_t used = 0;
+	};
+
+	TaggedVector<uint32_t, MemTag::Scene> storage;
+	MappedFile mapping;
+	const uint32_t* words = nullptr; // storage or the mapping
+	size_t wordCount = 0;
+	uint32_t root = NoNode;
+	int levels = MinLevels;
+	glm::ivec3 origin = glm::ivec3(0);
+	size_t nodeCount = 0;
+	size_t brickCount = 0;
+	uint64_t solidVoxels = 0;
+	// only while building
+	TaggedVector<InternTable, MemTag::Scene> tables;
+	TaggedVector<uint32_t, MemTag::Scene> fullNodes;
+
+	static int popcount8(uint32_t mask) {
+		mask = mask - ((mask >> 1) & 0x55);
+		mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+		return static_cast<int>((mask + (mask >> 4)) & 0x0F);
+	}
+
+	// one bit per byte of the brick that has any voxel set
+	static uint8_t occupiedBlocks(uint64_t bits) {
+		bits |= bits >> 4;
+		bits |= bits >> 2;
+		bits |= bits >> 1;
+		return static_cast<uint8_t>(((bits & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56);
+	}
+
+	static float maxOf(const glm::vec3& v) { return glm::max(v.x, glm::max(v.y, v.z)); }
+	static float minOf(const glm::vec3& v) { return glm::min(v.x, glm::min(v.y, v.z)); }
+
+	uint64_t brickBits(uint32_t node) const { return words[node] | static_cast<uint64_t>(words[node + 1]) << 32; }
+
+	// Sets up a frame's children and picks the first one the ray enters: the upper half on
+	// every axis whose middle plane the ray has crossed by the time it enters the node
+	void enter(Frame& frame) const {
+		frame.tm = 0.5f * (frame.t0 + frame.t1);
+		if (frame.level > 2) frame.mask = static_cast<uint8_t>(words[frame.node] & 0xFF);
+		else if (frame.level == 2) {
+			frame.bits = brickBits(frame.node);
+			frame.mask = occupiedBlocks(frame.bits);
+		}
+		float enterT = maxOf(frame.t0);
+		frame.child = static_cast<uint8_t>((frame.tm.x < enterT ? 1 : 0) | (frame.tm.y < enterT ? 2 : 0) | (frame.tm.z < enterT ? 4 : 0));
+		frame.done = false;
+	}
+
+	size_t nodeWords(uint32_t node, int level) const { return level == 2 ? 2 : 1 + popcount8(words[node] & 0xFF); }
+
+	uint32_t intern(int level, const uint32_t* nodeData, size_t count) {
+		InternTable& table = tables[level];
+		if ((table.used + 1) * 2 > table.slots.size()) {
+			TaggedVector<uint32_t, MemTag::Scene> old = std::move(table.slots);
+			table.slots.assign(old.empty() ? 64 : old.size() * 2, 0u);
+			for (uint32_t slot : old) {
+				if (!slot) continue;
+				size_t at = hashBytes(storage.data() + slot - 1, nodeWords(slot - 1, level) * sizeof(uint32_t)) & (table.slots.size() - 1);
+				while (table.slots[at]) at = (at + 1) & (table.slots.size() - 1);
+				table.slots[at] = slot;
+			}
+		}
+		size_t at = hashBytes(nodeData, count * sizeof(uint32_t)) & (table.slots.size() - 1);
+		for (; table.slots[at]; at = (at + 1) & (table.slots.size() - 1)) {
+			uint32_t existing = table.slots[at] - 1;
+			if (nodeWords(existing, level) == count && std::memcmp(storage.data() + existing, nodeData, count * sizeof(uint32_t)) == 0) return existing;
+		}
+		uint32_t node = static_cast<uint32_t>(storage.size());
+		storage.insert(storage.end(), nodeData, nodeData + count);
+		words = storage.data();
+		table.slots[at] = node + 1;
+		table.used++;
+		if (level == 2) brickCount++;
+		else nodeCount++;
+		return node;
+	}
+
+	uint32_t fullNode(int level) {
+		if (fullNodes[level] != NoNode) return fullNodes[level];
+		uint32_t data[9];
+		size_t count;
+		if (level == 2) {
+			data[0] = data[1] = ~0u;
+			count = 2;
+		}
+		else {
+			data[0] = 0xFF;
+			uint32_t child = fullNode(level - 1);
+			for (int c = 0; c < 8; c++) data[1 + c] = child;
+			count = 9;
+		}
+		return fullNodes[level] = intern(level, data, count);
+	}
+
+	template<typename Source>
+	Built buildNode(Source& source, const glm::ivec3& min, int level) {
+		int size = 1 << level;
+		VoxelFill fill = source.classify(min, size);
+		if (fill == VoxelFill::Empty) return Built{ NoNode, 0 };
+		uint64_t volume = static_cast<uint64_t>(size) * size * size;
+		if (fill == VoxelFill::Full) return Built{ fullNode(level), volume };
+		if (level == 2) {
+			uint64_t bits = source.brick(min);
+			if (!bits) return Built{ NoNode, 0 };
+			uint32_t data[2] = { static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32) };
+			uint64_t voxels = 0;
+			for (uint64_t rest = bits; rest; rest &= rest - 1) voxels++;
+			return Built{ intern(2, data, 2), voxels };
+		}
+		uint32_t data[9] = { 0 };
+		size_t count = 1;
+		uint64_t voxels = 0;
+		int half = size / 2;
+		for (int c = 0; c < 8; c++) {
+			Built child = buildNode(source, min + glm::ivec3(c & 1, c >> 1 & 1, c >> 2) * half, level - 1);
+			if (child.node == NoNode) continue;
+			data[0] |= 1u << c;
+			data[count++] = child.node;
+			voxels += child.voxels;
+		}
+		if (!data[0]) return Built{ NoNode, 0 };
+		// a node of full children has the same words as the full node, so it is found again
+		return Built{ intern(level, data, count), voxels };
+	}
+
+	// Every node reachable from the root lies inside the words, has something in it and
+	// refers only backwards, and no word is read as nodes of two different levels
+	bool validate() const {
+		if (root >= wordCount) return false;
+		TaggedVector<uint8_t, MemTag::Scene> levelAt(wordCount, 0);
+		return validNode(root, levels, levelAt);
+	}
+
+	bool validNode(uint32_t node, int level, TaggedVector<uint8_t, MemTag::Scene>& levelAt) const {
+		if (node >= wordCount) return false;
+		if (levelAt[node]) return levelAt[node] == level;
+		levelAt[node] = static_cast<uint8_t>(level);
+		if (level == 2) return node + 1 < wordCount && brickBits(node) != 0;
+		uint32_t mask = words[node];
+		if (mask == 0 || mask > 0xFF || node + popcount8(mask) >= wordCount) return false;
+		for (int i = 0; i < popcount8(mask); i++) {
+			uint32_t child = words[node + 1 + i];
+			if (child >= node || !validNode(child, level - 1, levelAt)) return false;
+		}
+		return true;
+	}
+};
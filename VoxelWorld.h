@@ -0,0 +1,591 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "Ray.h"
+#include "RenderStats.h"
+#include "VoxelDAG.h"
+#include "shader.h"
+
+// Blocks on an integer grid, for structures that would otherwise take thousands of Cubes.
+// Block (x, y, z) fills the unit cube centered on (x, y, z), where a unit Cube at that
+// position would be.
+//
+// The grid is cut into chunks of ChunkSize³ blocks. Each chunk is drawn from one mesh in
+// which every run of coplanar faces of the same block type is merged into one quad (greedy
+// meshing, as Lysenko describes it), with one draw call per block type in it. Changing a
+// block only marks its chunk dirty, plus the neighbour it borders; remesh() meshes dirty
+// chunks on the job system in the background and draw() uploads whatever has finished.
+// Ray casts go through a VoxelDAG of the solid blocks, rebuilt on the first cast after an edit.
+
+using BlockID = uint16_t; // 0 is air
+
+// One chunk's blocks, as indices into a palette of the block IDs it holds. The indices are
+// packed at as few bits as the palette needs, rounded up to a power of two so none
+// straddles a word; a chunk that is all air stores none.
+class BlockStorage {
+public:
+	static const int Size = 32;
+	static const int Volume = Size * Size * Size;
+
+	BlockStorage() : palette(1, BlockID(0)), counts(1, uint32_t(Volume)) {}
+
+	static int indexOf(int x, int y, int z) { return x + Size * (y + Size * z); }
+
+	BlockID get(int index) const { return palette[bits ? entryAt(index) : 0]; }
+
+	// Returns the ID that was there
+	BlockID set(int index, BlockID id) {
+		uint32_t old = bits ? entryAt(index) : 0;
+		BlockID previous = palette[old];
+		if (previous == id) return previous;
+		uint32_t entry = entryFor(id);
+		store(index, entry);
+		counts[old]--;
+		counts[entry]++;
+		return previous;
+	}
+
+	size_t solidCount() const { return Volume - counts[0]; }
+	int bitsPerBlock() const { return bits; }
+	size_t bytes() const { return palette.capacity() * sizeof(BlockID) + counts.capacity() * sizeof(uint32_t) + words.capacity() * sizeof(uint64_t); }
+
+	// all Volume blocks, in indexOf() order
+	void decode(BlockID* out) const {
+		if (bits == 0) {
+			std::fill(out, out + Volume, palette[0]);
+			return;
+		}
+		const int perWord = 64 / bits;
+		const uint64_t mask = (1ull << bits) - 1;
+		for (size_t w = 0; w < words.size(); w++) {
+			uint64_t word = words[w];
+			BlockID* at = out + w * perWord;
+			for (int i = 0; i < perWord; i++, word >>= bits) at[i] = palette[word & mask];
+		}
+	}
+
+private:
+	TaggedVector<BlockID, MemTag::Scene> palette; // palette[0] is always air
+	TaggedVector<uint32_t, MemTag::Scene> counts; // blocks per entry; an empty entry is reused
+	TaggedVector<uint64_t, MemTag::Scene> words;
+	int bits = 0;
+
+	uint32_t entryAt(int index) const {
+		const int perWord = 64 / bits;
+		return static_cast<uint32_t>(words[index / perWord] >> (index % perWord * bits)) & ((1u << bits) - 1);
+	}
+
+	void store(int index, uint32_t entry) {
+		const int perWord = 64 / bits;
+		int shift = index % perWord * bits;
+		uint64_t& word = words[index / perWord];
+		word = (word & ~(((1ull << bits) - 1) << shift)) | (static_cast<uint64_t>(entry) << shift);
+	}
+
+	uint32_t entryFor(BlockID id) {
+		uint32_t unused = 0;
+		for (uint32_t i = 0; i < palette.size(); i++) {
+			if (palette[i] == id) return i;
+			if (!unused && i && counts[i] == 0) unused = i;
+		}
+		if (unused) {
+			palette[unused] = id;
+			return unused;
+		}
+		if (palette.size() == (size_t(1) << bits)) grow();
+		palette.push_back(id);
+		counts.push_back(0);
+		return static_cast<uint32_t>(palette.size() - 1);
+	}
+
+	void grow() {
+		int wider = bits ? bits * 2 : 1;
+		TaggedVector<uint64_t, MemTag::Scene> old;
+		old.swap(words);
+		int oldBits = bits;
+		bits = wider;
+		words.assign(Volume / (64 / bits), 0ull);
+		if (oldBits == 0) return;
+		const int oldPerWord = 64 / oldBits;
+		for (int i = 0; i < Volume; i++) {
+			store(i, static_cast<uint32_t>(old[i / oldPerWord] >> (i % oldPerWord * oldBits)) & ((1u << oldBits) - 1));
+		}
+	}
+};
+
+// A chunk's triangles, in chunk coordinates with block (0, 0, 0) spanning [0, 1]³, sorted
+// by block type so each type is one contiguous draw
+struct VoxelMesh {
+	struct Range {
+		BlockID block;
+		uint32_t first; // vertices
+		uint32_t count;
+	};
+	TaggedVector<float, MemTag::Scene> positions;
+	TaggedVector<Range, MemTag::Scene> ranges;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	uint32_t vertexCount = 0;
+	uint32_t exposedFaces = 0; // unit faces touching air, before merging
+};
+
+// Meshes one chunk. outside[f] holds the blocks just past face f (-x, +x, -y, +y, -z, +z):
+// for the faces across axis d, entry a + Size * b is the block at a along axis (d + 1) % 3
+// and b along (d + 2) % 3. A face is drawn where a block meets air.
+inline void greedyMesh(const BlockID* blocks, const BlockID* const outside[6], VoxelMesh& out) {
+	const int Size = BlockStorage::Size;
+	struct Quad {
+		BlockID block;
+		uint8_t axis, positive;
+		uint8_t plane, a, b, width, height;
+	};
+	TaggedVector<Quad, MemTag::Scene> quads;
+	BlockID mask[Size * Size];
+	out.exposedFaces = 0;
+
+	for (int d = 0; d < 3; d++) {
+		const int u = (d + 1) % 3, v = (d + 2) % 3;
+		const int stride[3] = { 1, Size, Size * Size };
+		for (int positive = 0; positive < 2; positive++) {
+			const BlockID* past = outside[d * 2 + positive];
+			const int step = positive ? stride[d] : -stride[d];
+			for (int s = 0; s < Size; s++) {
+				bool edge = positive ? s == Size - 1 : s == 0;
+				for (int b = 0; b < Size; b++) {
+					for (int a = 0; a < Size; a++) {
+						int index = s * stride[d] + a * stride[u] + b * stride[v];
+						BlockID block = blocks[index];
+						BlockID next = edge ? past[a + Size * b] : blocks[index + step];
+						mask[a + Size * b] = next == 0 ? block : 0;
+						out.exposedFaces += block != 0 && next == 0;
+					}
+				}
+				// grow each face along a as far as it goes, then along b while whole rows match
+				for (int b = 0; b < Size; b++) {
+					for (int a = 0; a < Size;) {
+						BlockID block = mask[a + Size * b];
+						if (!block) {
+							a++;
+							continue;
+						}
+						int width = 1;
+						while (a + width < Size && mask[a + width + Size * b] == block) width++;
+						int height = 1;
+						for (; b + height < Size; height++) {
+							const BlockID* row = mask + Size * (b + height) + a;
+							if (std::any_of(row, row + width, [block](BlockID other) { return other != block; })) break;
+						}
+						for (int h = 0; h < height; h++) std::fill_n(mask + Size * (b + h) + a, width, BlockID(0));
+						quads.push_back(Quad{ block, uint8_t(d), uint8_t(positive), uint8_t(s + positive), uint8_t(a), uint8_t(b), uint8_t(width), uint8_t(height) });
+						a += width;
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(quads.begin(), quads.end(), [](const Quad& x, const Quad& y) { return x.block < y.block; });
+	out.positions.resize(quads.size() * 18);
+	out.ranges.clear();
+	out.vertexCount = static_cast<uint32_t>(quads.size() * 6);
+	out.boundsMin = glm::vec3(static_cast<float>(Size));
+	out.boundsMax = glm::vec3(0.0f);
+	float* at = out.positions.data();
+	for (size_t q = 0; q < quads.size(); q++) {
+		const Quad& quad = quads[q];
+		if (out.ranges.empty() || out.ranges.back().block != quad.block) out.ranges.push_back(VoxelMesh::Range{ quad.block, static_cast<uint32_t>(q * 6), 0 });
+		out.ranges.back().count += 6;
+		const int u = (quad.axis + 1) % 3, v = (quad.axis + 2) % 3;
+		glm::vec3 corner, alongA(0.0f), alongB(0.0f);
+		corner[quad.axis] = quad.plane;
+		corner[u] = quad.a;
+		corner[v] = quad.b;
+		alongA[u] = quad.width;
+		alongB[v] = quad.height;
+		// counter-clockwise seen from outside: a then b turns toward the +axis side
+		glm::vec3 first = quad.positive ? alongA : alongB;
+		glm::vec3 second = quad.positive ? alongB : alongA;
+		const glm::vec3 corners[6] = { corner, corner + first, corner + first + second, corner, corner + first + second, corner + second };
+		for (const glm::vec3& c : corners) {
+			*at++ = c.x;
+			*at++ = c.y;
+			*at++ = c.z;
+		}
+		out.boundsMin = glm::min(out.boundsMin, corner);
+		out.boundsMax = glm::max(out.boundsMax, corner + alongA + alongB);
+	}
+	if (quads.empty()) out.boundsMin = out.boundsMax = glm::vec3(0.0f);
+}
+
+struct VoxelStats {
+	size_t chunks = 0;
+	size_t blocks = 0; // solid ones
+	size_t storageBytes = 0; // block storage of all chunks
+	size_t exposedFaces = 0; // what meshing without merging would draw, two triangles each
+	size_t triangles = 0;
+	size_t drawRanges = 0; // draw calls with every chunk in view
+	size_t dirtyChunks = 0; // waiting for a remesh
+};
+
+class VoxelWorld {
+public:
+	static const int ChunkSize = BlockStorage::Size;
+
+	VoxelWorld() = default;
+	VoxelWorld(const VoxelWorld&) = delete;
+	VoxelWorld& operator=(const VoxelWorld&) = delete;
+
+	// The meshing jobs write into this world; the GL buffers go with clear()
+	~VoxelWorld() { JobSystem::get().wait(pending); }
+
+	BlockID getBlock(const glm::ivec3& position) const {
+		auto found = chunkIndex.find(keyOf(chunkOf(position)));
+		if (found == chunkIndex.end()) return 0;
+		glm::ivec3 local = position - chunkOf(position) * ChunkSize;
+		return chunks[found->second].blocks.get(BlockStorage::indexOf(local.x, local.y, local.z));
+	}
+
+	// Returns false when the block already was id
+	bool setBlock(const glm::ivec3& position, BlockID id) {
+		glm::ivec3 coord = chunkOf(position);
+		uint32_t chunk = id ? findOrCreate(coord) : find(coord);
+		if (chunk == NoChunk) return false;
+		glm::ivec3 local = position - coord * ChunkSize;
+		if (chunks[chunk].blocks.set(BlockStorage::indexOf(local.x, local.y, local.z), id) == id) return false;
+		markDirty(chunk);
+		dagStale = true;
+		// the neighbour's face against this block appears or goes away
+		for (int d = 0; d < 3; d++) {
+			glm::ivec3 side(0);
+			if (local[d] == 0) side[d] = -1;
+			else if (local[d] == ChunkSize - 1) side[d] = 1;
+			else continue;
+			uint32_t neighbour = find(coord + side);
+			if (neighbour != NoChunk) markDirty(neighbour);
+		}
+		return true;
+	}
+
+	void setColor(BlockID id, const glm::vec3& rgb) {
+		if (colors.size() <= id) {
+			size_t from = colors.size();
+			colors.resize(id + 1);
+			for (size_t i = from; i < colors.size(); i++) colors[i] = defaultColor(static_cast<BlockID>(i));
+		}
+		colors[id] = rgb;
+	}
+
+	glm::vec3 colorOf(BlockID id) const { return id < colors.size() ? colors[id] : defaultColor(id); }
+
+	// Takes the meshes of the last batch, if it has finished, and starts meshing the chunks
+	// changed since on the job system. Returns without waiting; a batch still running is
+	// left alone and the new changes wait for the next call.
+	void remesh() {
+		if (!pending.done()) return;
+		collect();
+		if (dirty.empty()) return;
+		MemTagScope memTag(MemTag::Scene);
+		jobs.resize(dirty.size());
+		for (size_t i = 0; i < dirty.size(); i++) {
+			Chunk& chunk = chunks[dirty[i]];
+			chunk.dirty = false;
+			MeshJob& job = jobs[i];
+			job.chunk = dirty[i];
+			job.blocks = chunk.blocks; // the job reads a copy, so blocks can change meanwhile
+			gatherOutside(chunk.coord, job.outside);
+		}
+		dirty.clear();
+		JobSystem& jobSystem = JobSystem::get();
+		for (size_t i = 0; i < jobs.size(); i++) {
+			jobSystem.submit([this, i] { meshJob(jobs[i]); }, &pending);
+		}
+	}
+
+	// Waits for the batch in flight and takes its meshes
+	void finishMeshing() {
+		JobSystem::get().wait(pending);
+		collect();
+	}
+
+	// Uploads finished meshes, then draws the chunks in view with the shader already in use
+	void draw(Shader& shader, const glm::mat4& viewProjection) {
+		Frustum frustum = Frustum::fromMatrix(viewProjection);
+		RenderStats& stats = RenderStats::frame();
+		bool bound = false;
+		for (Chunk& chunk : chunks) {
+			if (!chunk.uploaded) upload(chunk);
+			if (chunk.mesh.ranges.empty()) continue;
+			glm::vec3 origin = glm::vec3(chunk.coord * ChunkSize) - 0.5f;
+			if (!frustum.intersectsAABB(origin + chunk.mesh.boundsMin, origin + chunk.mesh.boundsMax)) continue;
+			shader.setMat4("model", glm::translate(glm::mat4(1.0f), origin));
+			glBindVertexArray(chunk.VAO);
+			bound = true;
+			for (const VoxelMesh::Range& range : chunk.mesh.ranges) {
+				shader.setVec3("inColor", colorOf(range.block));
+				glDrawArrays(GL_TRIANGLES, range.first, range.count);
+				stats.drawCalls++;
+				stats.triangles += range.count / 3;
+			}
+		}
+		if (bound) glBindVertexArray(0);
+	}
+
+	// Triangles and ranges are of the meshes finished so far
+	VoxelStats stats() const {
+		VoxelStats s;
+		s.chunks = chunks.size();
+		s.dirtyChunks = dirty.size();
+		for (const Chunk& chunk : chunks) {
+			s.blocks += chunk.blocks.solidCount();
+			s.storageBytes += chunk.blocks.bytes();
+			s.exposedFaces += chunk.mesh.exposedFaces;
+			s.triangles += chunk.mesh.vertexCount / 3;
+			s.drawRanges += chunk.mesh.ranges.size();
+		}
+		return s;
+	}
+
+	// Frees every chunk and its GL buffers
+	void clear() {
+		JobSystem::get().wait(pending);
+		for (Chunk& chunk : chunks) {
+			if (chunk.VBO) glDeleteBuffers(1, &chunk.VBO);
+			if (chunk.VAO) glDeleteVertexArrays(1, &chunk.VAO);
+		}
+		chunks = decltype(chunks)();
+		chunkIndex = decltype(chunkIndex)();
+		dirty = decltype(dirty)();
+		jobs = decltype(jobs)();
+		dag.clear();
+		dagStale = false;
+	}
+
+	// Moves every block back by a whole number of chunks, for the scene's floating origin.
+	// Meshes are in chunk space and stay as they are; the DAG is rebuilt on the next ray cast.
+	void rebase(const glm::ivec3& chunkOffset) {
+		finishMeshing();
+		chunkIndex.clear();
+		for (uint32_t i = 0; i < chunks.size(); i++) {
+			chunks[i].coord -= chunkOffset;
+			chunkIndex[keyOf(chunks[i].coord)] = i;
+		}
+		dagStale = !chunks.empty();
+	}
+
+	// Nearest solid block along the ray
+	bool raycast(const Ray& ray, VoxelHit& hit) {
+		return solidBlocks().raycast(ray, hit);
+	}
+
+	// Whether a solid block lies between the two points
+	bool occluded(const glm::vec3& from, const glm::vec3& to) {
+		return solidBlocks().occluded(from, to);
+	}
+
+	const VoxelDAG& solidBlocks() {
+		if (dagStale) buildDAG(dag);
+		dagStale = false;
+		return dag;
+	}
+
+	// The solid blocks as a DAG over the smallest power-of-two cube of chunks holding them
+	void buildDAG(VoxelDAG& out) const {
+		glm::ivec3 lo(0), hi(0);
+		bool any = false;
+		for (const Chunk& chunk : chunks) {
+			if (chunk.blocks.solidCount() == 0) continue;
+			lo = any ? glm::min(lo, chunk.coord) : chunk.coord;
+			hi = any ? glm::max(hi, chunk.coord) : chunk.coord;
+			any = true;
+		}
+		if (!any) {
+			out.clear();
+			return;
+		}
+		glm::ivec3 span = hi - lo + 1;
+		int levels = 5; // log2 of ChunkSize
+		while ((1 << (levels - 5)) < std::max(span.x, std::max(span.y, span.z))) levels++;
+		DAGSource source{ *this, lo * ChunkSize };
+		out.build(levels, lo * ChunkSize, source);
+	}
+
+private:
+	static const uint32_t NoChunk = ~0u;
+
+	struct Chunk {
+		glm::ivec3 coord;
+		BlockStorage blocks;
+		VoxelMesh mesh; // positions are dropped once they are on the GPU
+		GLuint VAO = 0;
+		GLuint VBO = 0;
+		bool dirty = false;
+		bool uploaded = true;
+	};
+
+	struct MeshJob {
+		uint32_t chunk = 0;
+		BlockStorage blocks;
+		TaggedVector<BlockID, MemTag::Scene> outside;
+		VoxelMesh mesh;
+	};
+
+	TaggedVector<Chunk, MemTag::Scene> chunks;
+	std::unordered_map<uint64_t, uint32_t> chunkIndex; // packed chunk coordinates -> chunk
+	TaggedVector<uint32_t, MemTag::Scene> dirty;
+	TaggedVector<MeshJob, MemTag::Scene> jobs; // the batch in flight, or finished and not yet collected
+	JobCounter pending;
+	TaggedVector<glm::vec3, MemTag::Scene> colors;
+	VoxelDAG dag;
+	bool dagStale = false;
+
+	// What VoxelDAG::build() asks about: whole chunks from their block counts, bricks from
+	// the blocks, decoding each chunk once as the build walks through it
+	struct DAGSource {
+		const VoxelWorld& world;
+		glm::ivec3 origin;
+		uint32_t decodedChunk = NoChunk;
+		TaggedVector<BlockID, MemTag::Scene> decoded;
+
+		VoxelFill classify(const glm::ivec3& min, int size) {
+			if (size != ChunkSize) return VoxelFill::Mixed;
+			uint32_t chunk = world.find(chunkOf(origin + min));
+			if (chunk == NoChunk || world.chunks[chunk].blocks.solidCount() == 0) return VoxelFill::Empty;
+			return world.chunks[chunk].blocks.solidCount() == static_cast<size_t>(BlockStorage::Volume) ? VoxelFill::Full : VoxelFill::Mixed;
+		}
+
+		uint64_t brick(const glm::ivec3& min) {
+			glm::ivec3 position = origin + min;
+			glm::ivec3 coord = chunkOf(position);
+			uint32_t chunk = world.find(coord);
+			if (chunk != decodedChunk) {
+				decoded.resize(BlockStorage::Volume);
+				world.chunks[chunk].blocks.decode(decoded.data());
+				decodedChunk = chunk;
+			}
+			glm::ivec3 local = position - coord * ChunkSize;
+			uint64_t bits = 0;
+			for (int z = 0; z < 4; z++) {
+				for (int y = 0; y < 4; y++) {
+					for (int x = 0; x < 4; x++) {
+						if (decoded[BlockStorage::indexOf(local.x + x, local.y + y, local.z + z)]) bits |= 1ull << VoxelDAG::brickBit(x, y, z);
+					}
+				}
+			}
+			return bits;
+		}
+	};
+
+	static int floorDiv(int value, int divisor) { return (value >= 0 ? value : value - divisor + 1) / divisor; }
+
+	static glm::ivec3 chunkOf(const glm::ivec3& position) {
+		return glm::ivec3(floorDiv(position.x, ChunkSize), floorDiv(position.y, ChunkSize), floorDiv(position.z, ChunkSize));
+	}
+
+	// 21 bits per axis
+	static uint64_t keyOf(const glm::ivec3& coord) {
+		return (static_cast<uint64_t>(static_cast<uint32_t>(coord.x) & 0x1FFFFF) << 42) |
+			(static_cast<uint64_t>(static_cast<uint32_t>(coord.y) & 0x1FFFFF) << 21) |
+			(static_cast<uint32_t>(coord.z) & 0x1FFFFF);
+	}
+
+	static glm::vec3 defaultColor(BlockID id) {
+		uint32_t h = id * 2654435761u;
+		return glm::vec3(0.3f) + 0.6f / 255.0f * glm::vec3((h >> 8) & 255, (h >> 16) & 255, (h >> 24) & 255);
+	}
+
+	uint32_t find(const glm::ivec3& coord) const {
+		auto found = chunkIndex.find(keyOf(coord));
+		return found == chunkIndex.end() ? NoChunk : found->second;
+	}
+
+	uint32_t findOrCreate(const glm::ivec3& coord) {
+		uint32_t chunk = find(coord);
+		if (chunk != NoChunk) return chunk;
+		MemTagScope memTag(MemTag::Scene);
+		chunk = static_cast<uint32_t>(chunks.size());
+		chunks.emplace_back();
+		chunks.back().coord = coord;
+		chunkIndex.emplace(keyOf(coord), chunk);
+		return chunk;
+	}
+
+	void markDirty(uint32_t chunk) {
+		if (chunks[chunk].dirty) return;
+		chunks[chunk].dirty = true;
+		dirty.push_back(chunk);
+	}
+
+	// the six slabs of blocks just outside the chunk, laid out as greedyMesh() reads them
+	void gatherOutside(const glm::ivec3& coord, TaggedVector<BlockID, MemTag::Scene>& outside) const {
+		const int Area = ChunkSize * ChunkSize;
+		outside.assign(6 * Area, BlockID(0));
+		for (int f = 0; f < 6; f++) {
+			const int d = f / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+			glm::ivec3 side(0);
+			side[d] = f % 2 ? 1 : -1;
+			uint32_t neighbour = find(coord + side);
+			if (neighbour == NoChunk) continue;
+			const BlockStorage& blocks = chunks[neighbour].blocks;
+			if (blocks.solidCount() == 0) continue;
+			glm::ivec3 p(0);
+			p[d] = f % 2 ? 0 : ChunkSize - 1;
+			for (int b = 0; b < ChunkSize; b++) {
+				p[v] = b;
+				for (int a = 0; a < ChunkSize; a++) {
+					p[u] = a;
+					outside[f * Area + a + ChunkSize * b] = blocks.get(BlockStorage::indexOf(p.x, p.y, p.z));
+				}
+			}
+		}
+	}
+
+	// runs on a worker
+	static void meshJob(MeshJob& job) {
+		MemTagScope memTag(MemTag::Scene);
+		static thread_local TaggedVector<BlockID, MemTag::Scene> decoded;
+		decoded.resize(BlockStorage::Volume);
+		job.blocks.decode(decoded.data());
+		const int Area = ChunkSize * ChunkSize;
+		const BlockID* outside[6];
+		for (int f = 0; f < 6; f++) outside[f] = job.outside.data() + f * Area;
+		greedyMesh(decoded.data(), outside, job.mesh);
+	}
+
+	void collect() {
+		for (MeshJob& job : jobs) {
+			Chunk& chunk = chunks[job.chunk];
+			chunk.mesh = std::move(job.mesh);
+			chunk.uploaded = false;
+		}
+		jobs.clear();
+	}
+
+	void upload(Chunk& chunk) {
+		chunk.uploaded = true;
+		if (chunk.mesh.positions.empty()) return;
+		MemTagScope driver(MemTag::General);
+		if (!chunk.VAO) {
+			glGenVertexArrays(1, &chunk.VAO);
+			glGenBuffers(1, &chunk.VBO);
+			glBindVertexArray(chunk.VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(0);
+			glBindVertexArray(0);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+		glBufferData(GL_ARRAY_BUFFER, chunk.mesh.positions.size() * sizeof(float), chunk.mesh.positions.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		chunk.mesh.positions = decltype(chunk.mesh.positions)();
+	}
+};
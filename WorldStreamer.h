@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "VirtualFileSystem.h"
+
+// A world too big to keep resident, cut into cubic cells and kept on disk in one pack
+// archive. write() splits a snapshot into cells; a streamer open on the archive then keeps
+// the cells near the camera in the scene and the rest out of it.
+//
+// Each call to update():
+//  - evicts every resident cell that has drifted past unloadRadius, in one bulk destroy
+//  - starts reading the nearest cells within loadRadius on the job system, a few at a time
+//  - adds the objects of cells already read to the scene, nearest cell first, in batches
+//    until frameBudgetMs is spent; a cell too big for one frame carries over to the next
+// Reading a cell is a bulk copy out of the mapped archive, so the only per-object work is
+// adding objects to the scene, and that is what the budget paces. unloadRadius is kept a
+// little past loadRadius so a camera sitting on a border doesn't load and evict the same
+// cells every frame.
+//
+// An object belongs to the cell holding its root's absolute position, children along with it,
+// so cells stay put when the scene's floating origin moves.
+// Streamed cells are read-only: edits to their objects are lost when they are evicted.
+
+struct StreamSettings {
+	float loadRadius = 96.0f;
+	float unloadRadius = 128.0f;
+	float frameBudgetMs = 1.0f;   // spent adding objects; at least one batch goes in each frame
+	uint32_t batchSize = 256;     // objects added between budget checks
+	uint32_t maxLoadsInFlight = 4;
+};
+
+struct StreamStats {
+	size_t cells = 0;
+	size_t residentCells = 0;     // partly added cells included
+	size_t loadingCells = 0;
+	size_t residentObjects = 0;
+	size_t pendingObjects = 0;    // read but not yet added
+	size_t loadsStarted = 0;
+	size_t evictions = 0;
+	float lastUpdateMs = 0.0f;
+};
+
+namespace worldfile {
+	static const uint32_t Magic = 0x31444c57; // "WLD1"
+	static const uint32_t Version = 1;
+	static const char* const IndexPath = "world.idx";
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t cellCount;
+		float cellSize;
+	};
+
+	struct CellEntry {
+		glm::ivec3 coord;
+		uint32_t objects;
+	};
+
+	inline std::string cellPath(const glm::ivec3& coord) {
+		return "cells/" + std::to_string(coord.x) + "_" + std::to_string(coord.y) + "_" + std::to_string(coord.z);
+	}
+
+	// 21 bits an axis, which covers ±1M cells
+	inline uint64_t cellKey(const glm::ivec3& coord) {
+		return (uint64_t(uint32_t(coord.x) & 0x1fffff) << 42) | (uint64_t(uint32_t(coord.y) & 0x1fffff) << 21) | uint64_t(uint32_t(coord.z) & 0x1fffff);
+	}
+}
+
+class WorldStreamer {
+public:
+	StreamSettings settings;
+
+	WorldStreamer() = default;
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+	~WorldStreamer() { close(); }
+
+	// Splits world into cells of cellSize and writes them to archivePath
+	static bool write(const SceneSnapshot& world, float cellSize, const std::string& archivePath, bool compress = false) {
+		size_t n = world.size();
+		// the cell of every object, taken from its root: parents come first, so theirs is known
+		std::vector<uint32_t> cellOf(n);
+		std::vector<glm::ivec3> coords;
+		std::vector<uint32_t> counts;
+		std::unordered_map<uint64_t, uint32_t> lookup;
+		for (size_t i = 0; i < n; i++) {
+			int32_t parent = i < world.parents.size() ? world.parents[i] : -1;
+			if (parent >= 0 && static_cast<size_t>(parent) < i) {
+				cellOf[i] = cellOf[parent];
+			} else {
+				glm::ivec3 coord = glm::ivec3(glm::floor((world.origin + glm::dvec3(world.positions[i])) / static_cast<double>(cellSize)));
+				auto inserted = lookup.emplace(worldfile::cellKey(coord), static_cast<uint32_t>(coords.size()));
+				if (inserted.second) {
+					coords.push_back(coord);
+					counts.push_back(0);
+				}
+				cellOf[i] = inserted.first->second;
+			}
+			counts[cellOf[i]]++;
+		}
+
+		// each cell is a scene file of its own, in the world's order, parents remapped into it
+		std::vector<SceneSnapshot> cells(coords.size());
+		for (size_t c = 0; c < cells.size(); c++) {
+			cells[c].typeNames = world.typeNames;
+			cells[c].origin = world.origin;
+			cells[c].resize(counts[c]);
+			counts[c] = 0;
+		}
+		std::vector<int32_t> local(n);
+		for (size_t i = 0; i < n; i++) {
+			SceneSnapshot& cell = cells[cellOf[i]];
+			uint32_t j = counts[cellOf[i]]++;
+			local[i] = static_cast<int32_t>(j);
+			cell.types[j] = world.types[i];
+			cell.ids[j] = world.ids[i];
+			cell.positions[j] = world.positions[i];
+			cell.sizes[j] = world.sizes[i];
+			cell.rotations[j] = world.rotations[i];
+			cell.setSelected(j, world.isSelected(i));
+			int32_t parent = i < world.parents.size() ? world.parents[i] : -1;
+			cell.parents[j] = parent >= 0 && static_cast<size_t>(parent) < i ? local[parent] : -1;
+		}
+
+		PackWriter pack;
+		std::vector<char> index(sizeof(worldfile::Header) + cells.size() * sizeof(worldfile::CellEntry));
+		worldfile::Header header = { worldfile::Magic, worldfile::Version, static_cast<uint32_t>(cells.size()), cellSize };
+		std::memcpy(index.data(), &header, sizeof(header));
+		for (size_t c = 0; c < cells.size(); c++) {
+			worldfile::CellEntry entry = { coords[c], counts[c] };
+			std::memcpy(index.data() + sizeof(header) + c * sizeof(entry), &entry, sizeof(entry));
+			std::vector<char> bytes = scenefile::serialize(cells[c]);
+			pack.add(worldfile::cellPath(coords[c]), bytes.data(), bytes.size(), compress);
+		}
+		pack.add(worldfile::IndexPath, index.data(), index.size());
+		if (!pack.write(archivePath)) {
+			std::cout << "ERROR::STREAMER::CANNOT_WRITE: " << archivePath << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Starts streaming from archivePath; nothing is loaded until update()
+	bool open(const std::string& archivePath) {
+		close();
+		std::unique_ptr<PackSource> source(new PackSource(archivePath));
+		if (!source->isOpen()) {
+			std::cout << "ERROR::STREAMER::NOT_FOUND: " << archivePath << std::endl;
+			return false;
+		}
+		FileData index = source->read(worldfile::IndexPath);
+		worldfile::Header header = {};
+		if (index.size() >= sizeof(header)) std::memcpy(&header, index.data(), sizeof(header));
+		if (header.magic != worldfile::Magic || header.version != worldfile::Version || !(header.cellSize > 0.0f) ||
+			index.size() != sizeof(header) + size_t(header.cellCount) * sizeof(worldfile::CellEntry)) {
+			std::cout << "ERROR::STREAMER::INVALID_FILE: " << archivePath << std::endl;
+			return false;
+		}
+
+		pack = std::move(source);
+		cellSize = header.cellSize;
+		cells.resize(header.cellCount);
+		ready.reset(new std::atomic<bool>[header.cellCount]);
+		for (uint32_t c = 0; c < header.cellCount; c++) {
+			worldfile::CellEntry entry;
+			std::memcpy(&entry, index.data() + sizeof(header) + c * sizeof(entry), sizeof(entry));
+			cells[c].coord = entry.coord;
+			cells[c].objects = entry.objects;
+			ready[c].store(false, std::memory_order_relaxed);
+			lookup.emplace(worldfile::cellKey(entry.coord), c);
+		}
+		return true;
+	}
+
+	bool isOpen() const { return pack != nullptr; }
+
+	// Waits for reads in flight and forgets the archive. Objects already in a scene stay there.
+	void close() {
+		JobSystem::get().wait(pending);
+		pack.reset();
+		cells.clear();
+		lookup.clear();
+		active.clear();
+		ready.reset();
+		counters = StreamStats();
+		reserved = false;
+	}
+
+	void update(Scene& scene, const glm::vec3& cameraPosition) {
+		if (!pack) return;
+		PROFILE_SCOPE("streaming");
+		auto start = std::chrono::steady_clock::now();
+		// cells are laid out in absolute coordinates, the camera is relative to the scene's origin
+		glm::dvec3 camera = scene.getOrigin() + glm::dvec3(cameraPosition);
+		if (!reserved) {
+			// room for everything up to unloadRadius from where streaming starts, with some to
+			// spare, so growing the scene's arrays doesn't land on a frame later
+			size_t objects = 0;
+			forCellsWithin(camera, settings.unloadRadius, [&](uint32_t c) { objects += cells[c].objects; });
+			scene.reserve(scene.getGraph().size() + objects + objects / 4);
+			reserved = true;
+		}
+		evict(scene, camera);
+		startLoads(camera);
+		integrate(scene, camera, start);
+		counters.lastUpdateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Loads everything within loadRadius of cameraPosition before returning
+	void loadAround(Scene& scene, const glm::vec3& cameraPosition) {
+		StreamSettings saved = settings;
+		settings.frameBudgetMs = 1e9f;
+		settings.maxLoadsInFlight = ~0u;
+		StreamStats s;
+		do {
+			update(scene, cameraPosition);
+			JobSystem::get().wait(pending);
+			update(scene, cameraPosition);
+			s = stats();
+		} while (s.loadingCells || s.pendingObjects);
+		settings = saved;
+	}
+
+	float getCellSize() const { return cellSize; }
+
+	// Objects the archive holds for the cell at coord, 0 if none
+	uint32_t cellObjects(const glm::ivec3& coord) const {
+		auto it = lookup.find(worldfile::cellKey(coord));
+		return it == lookup.end() ? 0 : cells[it->second].objects;
+	}
+
+	// Whether every object of the cell at coord is in the scene; empty cells count as resident
+	bool isResident(const glm::ivec3& coord) const {
+		auto it = lookup.find(worldfile::cellKey(coord));
+		return it == lookup.end() || cells[it->second].state == CellState::Resident;
+	}
+
+	StreamStats stats() const {
+		StreamStats s = counters;
+		s.cells = cells.size();
+		s.residentCells = s.loadingCells = s.residentObjects = s.pendingObjects = 0;
+		for (uint32_t c : active) {
+			const Cell& cell = cells[c];
+			if (cell.state == CellState::Loading) s.loadingCells++;
+			if (cell.state == CellState::Adding || cell.state == CellState::Resident) s.residentCells++;
+			s.residentObjects += cell.added;
+			if (cell.state == CellState::Loaded || cell.state == CellState::Adding) s.pendingObjects += cell.snapshot.size() - cell.added;
+		}
+		return s;
+	}
+
+private:
+	enum class CellState : uint8_t {
+		Unloaded,
+		Loading,  // being read on the job system
+		Loaded,   // read, nothing added yet
+		Adding,   // partly added
+		Resident
+	};
+
+	struct Cell {
+		glm::ivec3 coord;
+		uint32_t objects = 0;
+		CellState state = CellState::Unloaded;
+		uint32_t added = 0;            // objects of the snapshot added so far
+		SceneSnapshot snapshot;        // between the read and the last object added
+		std::vector<Entity> entities;  // while adding, every object's; once resident, just the roots'
+	};
+
+	std::unique_ptr<PackSource> pack;
+	float cellSize = 1.0f;
+	std::vector<Cell> cells;
+	std::unique_ptr<std::atomic<bool>[]> ready; // set by the job that read the cell
+	std::unordered_map<uint64_t, uint32_t> lookup;
+	std::vector<uint32_t> active;               // cells not Unloaded
+	std::vector<uint32_t> candidates;
+	std::vector<Entity> doomed;
+	JobCounter pending;
+	StreamStats counters;
+	bool reserved = false;
+
+	double distanceTo(const Cell& cell, const glm::dvec3& point) const {
+		glm::dvec3 boxMin = glm::dvec3(cell.coord) * static_cast<double>(cellSize);
+		glm::dvec3 nearest = glm::clamp(point, boxMin, boxMin + static_cast<double>(cellSize));
+		return glm::length(point - nearest);
+	}
+
+	// fn(cell index) for every cell in the archive within radius of point
+	template<typename Fn>
+	void forCellsWithin(const glm::dvec3& point, float radius, Fn&& fn) const {
+		int reach = static_cast<int>(std::ceil(radius / cellSize));
+		glm::ivec3 center = glm::ivec3(glm::floor(point / static_cast<double>(cellSize)));
+		for (int z = center.z - reach; z <= center.z + reach; z++)
+			for (int y = center.y - reach; y <= center.y + reach; y++)
+				for (int x = center.x - reach; x <= center.x + reach; x++) {
+					auto it = lookup.find(worldfile::cellKey(glm::ivec3(x, y, z)));
+					if (it != lookup.end() && distanceTo(cells[it->second], point) <= radius) fn(it->second);
+				}
+	}
+
+	void evict(Scene& scene, const glm::dvec3& cameraPosition) {
+		doomed.clear();
+		size_t kept = 0;
+		for (uint32_t c : active) {
+			Cell& cell = cells[c];
+			// a cell being read has to finish first; it is caught on a later frame
+			if (cell.state == CellState::Loading || distanceTo(cell, cameraPosition) <= settings.unloadRadius) {
+				active[kept++] = c;
+				continue;
+			}
+			if (cell.state == CellState::Adding) {
+				for (uint32_t i = 0; i < cell.added; i++)
+					if (cell.snapshot.parents[i] < 0) doomed.push_back(cell.entities[i]);
+			} else if (cell.state == CellState::Resident) {
+				doomed.insert(doomed.end(), cell.entities.begin(), cell.entities.end());
+			}
+			cell.state = CellState::Unloaded;
+			cell.added = 0;
+			cell.snapshot = SceneSnapshot();
+			std::vector<Entity>().swap(cell.entities);
+			ready[c].store(false, std::memory_order_relaxed);
+			counters.evictions++;
+		}
+		active.resize(kept);
+		if (!doomed.empty()) scene.destroyObjects(doomed.data(), doomed.size());
+	}
+
+	void startLoads(const glm::dvec3& cameraPosition) {
+		size_t inFlight = 0;
+		for (uint32_t c : active) {
+			Cell& cell = cells[c];
+			if (cell.state != CellState::Loading) continue;
+			if (ready[c].load(std::memory_order_acquire)) cell.state = CellState::Loaded;
+			else inFlight++;
+		}
+		if (inFlight >= settings.maxLoadsInFlight) return;
+
+		// every unloaded cell in range, nearest first
+		candidates.clear();
+		forCellsWithin(cameraPosition, settings.loadRadius, [&](uint32_t c) {
+			if (cells[c].state == CellState::Unloaded) candidates.push_back(c);
+		});
+		std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+			return distanceTo(cells[a], cameraPosition) < distanceTo(cells[b], cameraPosition);
+		});
+
+		JobSystem& jobSystem = JobSystem::get();
+		for (uint32_t c : candidates) {
+			if (inFlight >= settings.maxLoadsInFlight) break;
+			cells[c].state = CellState::Loading;
+			active.push_back(c);
+			inFlight++;
+			counters.loadsStarted++;
+			jobSystem.submit([this, c] { read(c); }, &pending);
+		}
+	}
+
+	// On a worker: only the snapshot and ready flag of this one cell are touched
+	void read(uint32_t c) {
+		Cell& cell = cells[c];
+		FileData data = pack->read(worldfile::cellPath(cell.coord));
+		if (!data || !scenefile::deserialize(data.data(), data.size(), cell.snapshot) || cell.snapshot.size() != cell.objects) {
+			std::cout << "ERROR::STREAMER::INVALID_CELL: " << worldfile::cellPath(cell.coord) << std::endl;
+			cell.snapshot = SceneSnapshot();
+		}
+		ready[c].store(true, std::memory_order_release);
+	}
+
+	void integrate(Scene& scene, const glm::dvec3& cameraPosition, std::chrono::steady_clock::time_point start) {
+		candidates.clear();
+		for (uint32_t c : active)
+			if (cells[c].state == CellState::Loaded || cells[c].state == CellState::Adding) candidates.push_back(c);
+		std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+			return distanceTo(cells[a], cameraPosition) < distanceTo(cells[b], cameraPosition);
+		});
+
+		bool first = true;
+		for (uint32_t c : candidates) {
+			Cell& cell = cells[c];
+			if (cell.state == CellState::Loaded) {
+				cell.entities.resize(cell.snapshot.size());
+				cell.state = CellState::Adding;
+			}
+			// a cell that failed to read has an empty snapshot, and is left empty rather than
+			// read again every frame
+			uint32_t total = static_cast<uint32_t>(cell.snapshot.size());
+			while (cell.added < total) {
+				if (!first && std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() >= settings.frameBudgetMs)
+					return;
+				first = false;
+				uint32_t end = std::min(total, cell.added + settings.batchSize);
+				size_t added = scene.appendSnapshot(cell.snapshot, cell.added, end, cell.entities.data());
+				bool full = added < end - cell.added;
+				cell.added += static_cast<uint32_t>(added);
+				if (full) break; // the rest of the cell never comes in
+			}
+			// only the roots are needed to evict the cell
+			size_t roots = 0;
+			for (uint32_t i = 0; i < cell.added; i++)
+				if (cell.snapshot.parents[i] < 0) cell.entities[roots++] = cell.entities[i];
+			cell.entities.resize(roots);
+			cell.entities.shrink_to_fit();
+			cell.snapshot = SceneSnapshot();
+			cell.state = CellState::Resident;
+		}
+	}
+};
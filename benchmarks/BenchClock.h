@@ -0,0 +1,11 @@
+#pragma once
+
+// Wall-clock timing shared by the benchmarks
+
+#include <chrono>
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double millisecondsSince(BenchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
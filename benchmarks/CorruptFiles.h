@@ -0,0 +1,50 @@
+#pragma once
+
+// Damaged-file checks shared by the benchmarks whose loaders take files from disk: a good
+// file is copied, each copy damaged one way, and the bench's loader has to refuse them all.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// One way of damaging a file, applied to a copy of its bytes
+struct Damage {
+	const char* what;
+	std::function<void(std::vector<char>&)> apply;
+};
+
+// Overwrites sizeof(T) bytes at offset with value
+template <typename T>
+inline void poke(std::vector<char>& bytes, size_t offset, T value) { std::memcpy(bytes.data() + offset, &value, sizeof(T)); }
+
+// The file's bytes, empty when it can't be read
+inline std::vector<char> readFile(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Writes each damaged copy of good to path and has accepts(path) say whether the loader took
+// it. Every one it takes is reported as ERROR::<bench>::CORRUPT_FILE_ACCEPTED. path is
+// removed afterwards.
+inline bool corruptFilesRejected(const char* bench, const std::string& path, const std::vector<char>& good,
+	std::initializer_list<Damage> damages, const std::function<bool(const std::string&)>& accepts) {
+	bool ok = true;
+	for (const Damage& damage : damages) {
+		std::vector<char> bad = good;
+		damage.apply(bad);
+		{
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			out.write(bad.data(), bad.size());
+		}
+		if (!accepts(path)) continue;
+		std::printf("ERROR::%s::CORRUPT_FILE_ACCEPTED: %s was accepted\n", bench, damage.what);
+		ok = false;
+	}
+	std::remove(path.c_str());
+	return ok;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Windowless OpenGL 3.3 core context through EGL, for benchmarks and CI machines without a
+// display. With software = true Mesa is forced onto llvmpipe, which is slow but gives the
+// same results on every machine.
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+class HeadlessGL {
+public:
+	HeadlessGL() = default;
+	HeadlessGL(const HeadlessGL&) = delete;
+	HeadlessGL& operator=(const HeadlessGL&) = delete;
+
+	~HeadlessGL() {
+		if (display == EGL_NO_DISPLAY) return;
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+		if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+		eglTerminate(display);
+	}
+
+	bool create(int width, int height, bool software) {
+		if (software) setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+		// surfaceless needs no X or Wayland server; fall back to the default display
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) return fail("eglInitialize");
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) return fail("eglChooseConfig");
+
+		const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+		if (surface == EGL_NO_SURFACE) return fail("eglCreatePbufferSurface");
+
+		eglBindAPI(EGL_OPENGL_API);
+		const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+		if (context == EGL_NO_CONTEXT) return fail("eglCreateContext");
+		if (!eglMakeCurrent(display, surface, surface, context)) return fail("eglMakeCurrent");
+
+		if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) return fail("gladLoadGLLoader");
+		return true;
+	}
+
+	void swap() { eglSwapBuffers(display, surface); }
+
+	std::string renderer() const {
+		const GLubyte* name = glGetString(GL_RENDERER);
+		return name ? reinterpret_cast<const char*>(name) : "unknown";
+	}
+
+private:
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLSurface surface = EGL_NO_SURFACE;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	bool fail(const char* step) {
+		std::cout << "ERROR::HEADLESS_GL::" << step << " failed (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+};
@@ -0,0 +1,376 @@
+// Collision broadphase over moving oriented boxes. Every frame each box moves and spins a
+// little, the way a simulation moves them, and a few are removed and respawned elsewhere.
+// The sweep-and-prune broadphase (SweepAndPrune.h) is compared with a uniform grid rebuilt
+// every frame, and the pairs both find go through the separating axis test (OBB.h).
+//
+//   collision_bench [boxes=100000] [frames=60] [respawnsPerFrame=100]
+//
+// Boxes have half extents of 0.25-2 units and start scattered over a 240-unit cube. Moves
+// are steps of up to 0.5 units that bounce off the walls. Every frame the two broadphases
+// must report the same pairs, a small scene is checked against all-pairs, and the
+// separating axis test is checked against a double-precision projection of both boxes'
+// corners; exit code 1 if anything differs.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../OBB.h"
+#include "../SweepAndPrune.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+	glm::vec3 point(float extent) { return glm::vec3(uniform(-extent, extent), uniform(-extent, extent), uniform(-extent, extent)); }
+};
+
+static const float WorldExtent = 120.0f;
+static const float MaxSpeed = 0.5f;
+
+// --- the moving boxes ---
+
+struct Body {
+	glm::vec3 position;
+	glm::vec3 size;
+	glm::vec3 rotation; // degrees, in the order Transform::modelMatrix applies them
+	glm::vec3 velocity;
+	glm::vec3 spin;
+	uint32_t generation;
+};
+
+// each box as an OBB and its world bounds, as the scene computes them
+struct Frame {
+	std::vector<OBB> boxes;
+	std::vector<glm::vec3> boxMin, boxMax;
+};
+
+static Body spawn(SplitMix64& rng, uint32_t generation) {
+	Body body;
+	body.position = rng.point(WorldExtent);
+	body.size = glm::vec3(rng.uniform(0.5f, 4.0f), rng.uniform(0.5f, 4.0f), rng.uniform(0.5f, 4.0f));
+	body.rotation = glm::vec3(rng.uniform(0.0f, 360.0f), rng.uniform(0.0f, 360.0f), rng.uniform(0.0f, 360.0f));
+	body.velocity = rng.point(MaxSpeed);
+	body.spin = rng.point(3.0f);
+	body.generation = generation;
+	return body;
+}
+
+static void step(Body& body) {
+	body.position += body.velocity;
+	for (int axis = 0; axis < 3; axis++) {
+		if (std::abs(body.position[axis]) > WorldExtent) body.velocity[axis] = -body.velocity[axis];
+	}
+	body.rotation += body.spin;
+}
+
+// Transform scales before rotating, which shears a box with unequal sides, so the size goes
+// on the half extents instead
+static OBB obbOf(const Body& body) {
+	glm::mat4 m = glm::translate(glm::mat4(1.0f), body.position);
+	m = glm::rotate(m, glm::radians(body.rotation.x), glm::vec3(1, 0, 0));
+	m = glm::rotate(m, glm::radians(body.rotation.y), glm::vec3(0, 1, 0));
+	m = glm::rotate(m, glm::radians(body.rotation.z), glm::vec3(0, 0, 1));
+	OBB box = OBB::fromMatrix(m);
+	box.halfExtents = body.size * 0.5f;
+	return box;
+}
+
+static void computeFrame(const std::vector<Body>& bodies, Frame& frame) {
+	size_t n = bodies.size();
+	frame.boxes.resize(n);
+	frame.boxMin.resize(n);
+	frame.boxMax.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		frame.boxes[i] = obbOf(bodies[i]);
+		frame.boxes[i].bounds(frame.boxMin[i], frame.boxMax[i]);
+	}
+}
+
+// --- the baseline: a hashed uniform grid, rebuilt every frame ---
+
+// Each box is listed in every cell its bounds touch, bucketed by a hash of the cell with a
+// counting sort. A pair is reported only from the cell holding the corner where both boxes
+// start, so boxes sharing several cells are paired once.
+class UniformGrid {
+public:
+	void build(const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, float size) {
+		cellSize = size;
+		size_t n = boxMin.size();
+		size_t tableSize = 1;
+		while (tableSize < n * 2) tableSize <<= 1;
+		mask = static_cast<uint32_t>(tableSize - 1);
+		bucketStart.assign(tableSize + 1, 0);
+		std::vector<Cell>& scratch = cellsScratch;
+		scratch.clear();
+		for (uint32_t i = 0; i < n; i++) {
+			glm::ivec3 lo = cellOf(boxMin[i]), hi = cellOf(boxMax[i]);
+			for (int z = lo.z; z <= hi.z; z++)
+				for (int y = lo.y; y <= hi.y; y++)
+					for (int x = lo.x; x <= hi.x; x++) {
+						Cell cell{ glm::ivec3(x, y, z), i };
+						scratch.push_back(cell);
+						bucketStart[bucketOf(cell.coord) + 1]++;
+					}
+		}
+		for (size_t b = 0; b < tableSize; b++) bucketStart[b + 1] += bucketStart[b];
+		cells.resize(scratch.size());
+		std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+		for (const Cell& cell : scratch) cells[fill[bucketOf(cell.coord)]++] = cell;
+	}
+
+	void findPairs(const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, const std::vector<Entity>& entities, std::vector<OverlapPair>& out) const {
+		out.clear();
+		for (size_t b = 0; b + 1 < bucketStart.size(); b++) {
+			for (uint32_t p = bucketStart[b]; p < bucketStart[b + 1]; p++) {
+				for (uint32_t q = p + 1; q < bucketStart[b + 1]; q++) {
+					const Cell& a = cells[p];
+					const Cell& c = cells[q];
+					if (a.coord != c.coord) continue;
+					uint32_t i = a.box, j = c.box;
+					if (!(boxMin[j].x <= boxMax[i].x && boxMax[j].x >= boxMin[i].x && boxMin[j].y <= boxMax[i].y && boxMax[j].y >= boxMin[i].y &&
+						boxMin[j].z <= boxMax[i].z && boxMax[j].z >= boxMin[i].z)) continue;
+					if (cellOf(glm::max(boxMin[i], boxMin[j])) != a.coord) continue;
+					out.push_back(OverlapPair{ entities[i], entities[j] });
+				}
+			}
+		}
+	}
+
+	size_t cellEntries() const { return cells.size(); }
+
+private:
+	struct Cell {
+		glm::ivec3 coord;
+		uint32_t box;
+	};
+
+	float cellSize = 1.0f;
+	uint32_t mask = 0;
+	std::vector<uint32_t> bucketStart;
+	std::vector<Cell> cells;
+	std::vector<Cell> cellsScratch;
+
+	glm::ivec3 cellOf(const glm::vec3& p) const {
+		return glm::ivec3(static_cast<int>(std::floor(p.x / cellSize)), static_cast<int>(std::floor(p.y / cellSize)), static_cast<int>(std::floor(p.z / cellSize)));
+	}
+	uint32_t bucketOf(const glm::ivec3& c) const {
+		uint32_t h = static_cast<uint32_t>(c.x) * 73856093u ^ static_cast<uint32_t>(c.y) * 19349663u ^ static_cast<uint32_t>(c.z) * 83492791u;
+		return h & mask;
+	}
+};
+
+// --- references ---
+
+// pairs as sorted (smaller, larger) handle values, so two lists can be compared
+static std::vector<uint64_t> normalized(const OverlapPair* pairs, size_t count) {
+	std::vector<uint64_t> keys(count);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t a = pairs[i].a.value, b = pairs[i].b.value;
+		keys[i] = static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+	}
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+// How far apart two boxes are along their best separating axis, from their corners in
+// double precision; negative when they overlap
+static double separation(const OBB& a, const OBB& b) {
+	auto corners = [](const OBB& box, glm::dvec3* out) {
+		for (int c = 0; c < 8; c++) {
+			glm::dvec3 p(box.center);
+			for (int i = 0; i < 3; i++) p += glm::dvec3(box.axes[i]) * double(box.halfExtents[i]) * ((c >> i & 1) ? 1.0 : -1.0);
+			out[c] = p;
+		}
+	};
+	glm::dvec3 ca[8], cb[8];
+	corners(a, ca);
+	corners(b, cb);
+	glm::dvec3 candidates[15];
+	int count = 0;
+	for (int i = 0; i < 3; i++) candidates[count++] = glm::dvec3(a.axes[i]);
+	for (int i = 0; i < 3; i++) candidates[count++] = glm::dvec3(b.axes[i]);
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++) candidates[count++] = glm::cross(glm::dvec3(a.axes[i]), glm::dvec3(b.axes[j]));
+	double best = -1e300;
+	for (int k = 0; k < count; k++) {
+		double length = glm::length(candidates[k]);
+		if (length < 1e-9) continue;
+		glm::dvec3 axis = candidates[k] / length;
+		double minA = 1e300, maxA = -1e300, minB = 1e300, maxB = -1e300;
+		for (int c = 0; c < 8; c++) {
+			double pa = glm::dot(ca[c], axis), pb = glm::dot(cb[c], axis);
+			minA = std::min(minA, pa);
+			maxA = std::max(maxA, pa);
+			minB = std::min(minB, pb);
+			maxB = std::max(maxB, pb);
+		}
+		best = std::max(best, std::max(minB - maxA, minA - maxB));
+	}
+	return best;
+}
+
+// SAP against every pair of a small scene, over a few frames with respawns
+static size_t checkSmallScene() {
+	SplitMix64 rng(7);
+	const size_t n = 1500;
+	std::vector<Body> bodies(n);
+	std::vector<Entity> entities(n);
+	std::vector<SapHandle> handles(n);
+	Frame frame;
+	SweepAndPrune sap;
+	for (size_t i = 0; i < n; i++) {
+		bodies[i] = spawn(rng, 1);
+		bodies[i].position *= 0.15f;
+	}
+	computeFrame(bodies, frame);
+	for (uint32_t i = 0; i < n; i++) {
+		entities[i] = Entity(i, 1);
+		handles[i] = sap.insert(entities[i], frame.boxMin[i], frame.boxMax[i]);
+	}
+	size_t mismatches = 0;
+	for (int f = 0; f < 20; f++) {
+		for (Body& body : bodies) step(body);
+		for (int r = 0; r < 20; r++) {
+			uint32_t i = static_cast<uint32_t>(rng.next() % n);
+			sap.remove(handles[i]);
+			bodies[i] = spawn(rng, bodies[i].generation + 1);
+			bodies[i].position *= 0.15f;
+			entities[i] = Entity(i, bodies[i].generation);
+			handles[i] = SapHandle();
+		}
+		computeFrame(bodies, frame);
+		for (uint32_t i = 0; i < n; i++) {
+			if (handles[i].valid()) sap.update(handles[i], frame.boxMin[i], frame.boxMax[i]);
+			else handles[i] = sap.insert(entities[i], frame.boxMin[i], frame.boxMax[i]);
+		}
+		const auto& found = sap.findPairs();
+		std::vector<OverlapPair> expected;
+		for (uint32_t i = 0; i < n; i++)
+			for (uint32_t j = i + 1; j < n; j++) {
+				const glm::vec3 &aMin = frame.boxMin[i], &aMax = frame.boxMax[i], &bMin = frame.boxMin[j], &bMax = frame.boxMax[j];
+				if (bMin.x <= aMax.x && bMax.x >= aMin.x && bMin.y <= aMax.y && bMax.y >= aMin.y && bMin.z <= aMax.z && bMax.z >= aMin.z)
+					expected.push_back(OverlapPair{ entities[i], entities[j] });
+			}
+		mismatches += normalized(found.data(), found.size()) != normalized(expected.data(), expected.size());
+	}
+	return mismatches;
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 60;
+	size_t respawns = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100;
+	if (count < 2) count = 2;
+	if (frames < 1) frames = 1;
+	MemTagScope memTag(MemTag::Scene);
+
+	SplitMix64 rng(23);
+	std::vector<Body> bodies(count);
+	std::vector<Entity> entities(count);
+	for (uint32_t i = 0; i < count; i++) {
+		bodies[i] = spawn(rng, 1);
+		entities[i] = Entity(i, 1);
+	}
+	Frame frame;
+	computeFrame(bodies, frame);
+
+	SweepAndPrune sap;
+	std::vector<SapHandle> handles(count);
+	BenchClock::time_point start = BenchClock::now();
+	for (uint32_t i = 0; i < count; i++) handles[i] = sap.insert(entities[i], frame.boxMin[i], frame.boxMax[i]);
+	sap.findPairs();
+	double sapBuildMs = millisecondsSince(start);
+
+	UniformGrid grid;
+	std::vector<OverlapPair> gridPairs;
+	double sapUpdateMs = 0, sapPairsMs = 0, gridBuildMs = 0, gridPairsMs = 0, narrowMs = 0;
+	size_t sapPairCount = 0, confirmed = 0, pairMismatches = 0, satMismatches = 0, satChecked = 0;
+	uint64_t sapAllocations = 0;
+	float cellSize = 0.0f;
+	for (int f = 0; f < frames; f++) {
+		for (Body& body : bodies) step(body);
+		for (size_t r = 0; r < respawns; r++) {
+			uint32_t i = static_cast<uint32_t>(rng.next() % count);
+			sap.remove(handles[i]);
+			bodies[i] = spawn(rng, bodies[i].generation + 1);
+			entities[i] = Entity(i, bodies[i].generation);
+			handles[i] = SapHandle();
+		}
+		computeFrame(bodies, frame);
+
+		// sweep and prune
+		uint64_t allocsBefore = MemoryTracker::tagCounters(MemTag::Scene).totalAllocations.load();
+		start = BenchClock::now();
+		for (uint32_t i = 0; i < count; i++) {
+			if (handles[i].valid()) sap.update(handles[i], frame.boxMin[i], frame.boxMax[i]);
+			else handles[i] = sap.insert(entities[i], frame.boxMin[i], frame.boxMax[i]);
+		}
+		sapUpdateMs += millisecondsSince(start);
+		start = BenchClock::now();
+		const auto& pairs = sap.findPairs();
+		sapPairsMs += millisecondsSince(start);
+		if (f > 0) sapAllocations += MemoryTracker::tagCounters(MemTag::Scene).totalAllocations.load() - allocsBefore;
+		sapPairCount += pairs.size();
+
+		// grid, with cells as big as the largest box
+		start = BenchClock::now();
+		glm::vec3 largest(0.0f);
+		for (uint32_t i = 0; i < count; i++) largest = glm::max(largest, frame.boxMax[i] - frame.boxMin[i]);
+		cellSize = std::max(largest.x, std::max(largest.y, largest.z));
+		grid.build(frame.boxMin, frame.boxMax, cellSize);
+		gridBuildMs += millisecondsSince(start);
+		start = BenchClock::now();
+		grid.findPairs(frame.boxMin, frame.boxMax, entities, gridPairs);
+		gridPairsMs += millisecondsSince(start);
+		pairMismatches += normalized(pairs.data(), pairs.size()) != normalized(gridPairs.data(), gridPairs.size());
+
+		// narrowphase on the broadphase's pairs
+		start = BenchClock::now();
+		for (const OverlapPair& pair : pairs) confirmed += obbOverlap(frame.boxes[pair.a.index()], frame.boxes[pair.b.index()]);
+		narrowMs += millisecondsSince(start);
+		for (size_t p = 0; p < pairs.size(); p += 7) {
+			const OBB& a = frame.boxes[pairs[p].a.index()];
+			const OBB& b = frame.boxes[pairs[p].b.index()];
+			double gap = separation(a, b);
+			// rounding only decides pairs that are within a hair of touching
+			if (std::abs(gap) > 1e-4 && obbOverlap(a, b) != (gap <= 0.0)) satMismatches++;
+			satChecked++;
+		}
+	}
+	size_t smallSceneMismatches = checkSmallScene();
+
+	double sapMs = sapUpdateMs + sapPairsMs, gridMs = gridBuildMs + gridPairsMs;
+	double pairsPerFrame = static_cast<double>(sapPairCount) / frames;
+	std::printf("boxes: %zu, frames: %d, respawns per frame: %zu, sweep axis: %c, %u slabs along %c\n", count, frames, respawns,
+		"xyz"[sap.sweepAxis()], sap.slabsInUse(), "xyz"[sap.slabAxis()]);
+	std::printf("first sort and sweep: %.1f ms; %.0f overlapping boxes per frame, %.1f%% of them overlapping as oriented boxes\n", sapBuildMs,
+		pairsPerFrame, 100.0 * confirmed / std::max<size_t>(sapPairCount, 1));
+	std::printf("%-16s %12s %12s %12s %14s\n", "", "ms update", "ms pairs", "ms/frame", "M pairs/s");
+	std::printf("%-16s %12.3f %12.3f %12.3f %14.2f\n", "sweep and prune", sapUpdateMs / frames, sapPairsMs / frames, sapMs / frames, sapPairCount / (sapMs * 1e3));
+	std::printf("%-16s %12.3f %12.3f %12.3f %14.2f\n", "uniform grid", gridBuildMs / frames, gridPairsMs / frames, gridMs / frames, sapPairCount / (gridMs * 1e3));
+	std::printf("grid cells: %.2f units, %.1f cell entries per box\n", cellSize, static_cast<double>(grid.cellEntries()) / count);
+	std::printf("separating axis test: %.1f ns per pair, %zu checked against a double-precision projection\n", narrowMs * 1e6 / std::max<size_t>(sapPairCount, 1), satChecked);
+	std::printf("sweep and prune heap allocations after the first frame: %llu\n", static_cast<unsigned long long>(sapAllocations));
+
+	int exitCode = 0;
+	if (pairMismatches || smallSceneMismatches || satMismatches) {
+		std::printf("ERROR::COLLISION_BENCH::MISMATCH: %zu frames differ from the grid, %zu from all-pairs, %zu separating axis results wrong\n",
+			pairMismatches, smallSceneMismatches, satMismatches);
+		exitCode = 1;
+	}
+	return exitCode;
+}
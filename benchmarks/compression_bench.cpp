@@ -0,0 +1,135 @@
+// Loader throughput for block-compressed containers: raw vs LZ4 vs Zstd on engine-like payloads.
+//
+//   compression_bench [megabytes=256] [workDir=.]
+//
+// Build with -DENGINE_HAVE_LZ4 / -DENGINE_HAVE_ZSTD (and link lz4 / zstd) to enable the codecs.
+// Read times include file I/O; run against network storage to see the overlap pay off.
+//
+// Before timing, a small container is written and damaged in the ways a truncated or
+// corrupt file can be; read() has to refuse each one, and the run fails with exit code 1
+// if it doesn't.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchClock.h"
+#include "CorruptFiles.h"
+#include "../BlockStream.h"
+
+static long long fileSize(const std::string& path) {
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	return in ? static_cast<long long>(in.tellg()) : -1;
+}
+
+// SoA transforms laid out on a jittered grid, like a large editor scene
+static std::vector<char> makeTransforms(size_t bytes, std::mt19937& rng) {
+	std::vector<float> values(bytes / sizeof(float));
+	std::normal_distribution<float> jitter(0.0f, 0.05f);
+	size_t n = values.size() / 9;
+	for (size_t i = 0; i < n; i++) {
+		values[i] = static_cast<float>(i % 1000) + jitter(rng);                // position.x
+		values[n + i] = 0.0f;                                                  // position.y
+		values[2 * n + i] = static_cast<float>(i / 1000) + jitter(rng);        // position.z
+		values[3 * n + i] = values[4 * n + i] = values[5 * n + i] = 1.0f;      // size
+		values[6 * n + i] = values[7 * n + i] = values[8 * n + i] = 0.0f;      // rotation
+	}
+	std::vector<char> out(bytes);
+	std::memcpy(out.data(), values.data(), values.size() * sizeof(float));
+	return out;
+}
+
+// interleaved float positions of a noisy surface, like an imported mesh
+static std::vector<char> makeMesh(size_t bytes, std::mt19937& rng) {
+	std::vector<float> values(bytes / sizeof(float));
+	std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+	for (size_t i = 0; i + 2 < values.size(); i += 3) {
+		size_t v = i / 3;
+		values[i] = static_cast<float>(v % 4096) * 0.01f;
+		values[i + 1] = std::sin(values[i]) + noise(rng);
+		values[i + 2] = static_cast<float>(v / 4096) * 0.01f;
+	}
+	std::vector<char> out(bytes);
+	std::memcpy(out.data(), values.data(), values.size() * sizeof(float));
+	return out;
+}
+
+// Damages a small container the ways a truncated or corrupt file can be
+static bool corruptContainersRejected(const std::string& workDir, std::mt19937& rng) {
+	using namespace blockstream;
+	const size_t blockSize = 64 * 1024;
+	std::vector<char> payload = makeTransforms(blockSize * 10 + 1000, rng);
+	std::string path = workDir + "/corrupt.blk";
+	if (!write(path, payload.data(), payload.size(), Codec::Raw, blockSize)) return false;
+	std::vector<char> good = readFile(path);
+	const size_t table = sizeof(Header);
+	const size_t last = table + 10 * sizeof(BlockEntry);
+
+	return corruptFilesRejected("COMPRESSION_BENCH", path, good, {
+		{ "a truncated file", [&](std::vector<char>& bad) { bad.resize(good.size() / 2); } },
+		{ "a huge block count", [](std::vector<char>& bad) { poke<uint64_t>(bad, offsetof(Header, blockCount), 1ull << 40); } },
+		{ "a raw size smaller than the blocks", [&](std::vector<char>& bad) { poke<uint64_t>(bad, offsetof(Header, rawSize), payload.size() / 2); } },
+		{ "a zero block size", [](std::vector<char>& bad) { poke<uint32_t>(bad, offsetof(Header, blockSize), 0); } },
+		{ "a last block longer than the data", [&](std::vector<char>& bad) {
+			poke<uint32_t>(bad, last + offsetof(BlockEntry, rawSize), blockSize);
+			poke<uint32_t>(bad, last + offsetof(BlockEntry, storedSize), blockSize);
+		} },
+		{ "a block stored bigger than it is raw", [&](std::vector<char>& bad) { poke<uint32_t>(bad, table + offsetof(BlockEntry, storedSize), 0xFFFFFFF0u); } },
+	}, [](const std::string& damaged) {
+		std::vector<char> loaded;
+		return read(damaged, loaded);
+	});
+}
+
+int main(int argc, char** argv) {
+	size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 256;
+	std::string workDir = argc > 2 ? argv[2] : ".";
+	size_t bytes = megabytes * 1024 * 1024;
+
+	std::mt19937 rng(42);
+	if (!corruptContainersRejected(workDir, rng)) return 1;
+
+	struct Payload { const char* name; std::vector<char> data; };
+	std::vector<Payload> payloads;
+	payloads.push_back({ "transforms", makeTransforms(bytes, rng) });
+	payloads.push_back({ "mesh", makeMesh(bytes, rng) });
+
+	const blockstream::Codec codecs[] = { blockstream::Codec::Raw, blockstream::Codec::LZ4, blockstream::Codec::Zstd };
+	JobSystem& jobs = JobSystem::get();
+	std::printf("workers: %u\n", jobs.workerCount());
+	std::printf("%-12s %-6s %8s %10s %10s %10s\n", "payload", "codec", "ratio", "write ms", "read ms", "read MB/s");
+
+	for (const Payload& payload : payloads) {
+		for (blockstream::Codec codec : codecs) {
+			if (!blockstream::codecAvailable(codec)) {
+				std::printf("%-12s %-6s (not built in)\n", payload.name, blockstream::codecName(codec));
+				continue;
+			}
+			std::string path = workDir + "/" + payload.name + "." + blockstream::codecName(codec) + ".blk";
+			BenchClock::time_point start = BenchClock::now();
+			blockstream::write(path, payload.data.data(), payload.data.size(), codec);
+			double writeMs = millisecondsSince(start);
+
+			std::vector<char> loaded;
+			start = BenchClock::now();
+			bool ok = blockstream::read(path, loaded);
+			double readMs = millisecondsSince(start);
+			if (!ok || loaded != payload.data) {
+				std::printf("%-12s %-6s ROUND TRIP FAILED\n", payload.name, blockstream::codecName(codec));
+				return 1;
+			}
+			double ratio = static_cast<double>(payload.data.size()) / fileSize(path);
+			std::printf("%-12s %-6s %8.2f %10.1f %10.1f %10.1f\n", payload.name, blockstream::codecName(codec),
+				ratio, writeMs, readMs, payload.data.size() / 1048576.0 / (readMs / 1000.0));
+			std::remove(path.c_str());
+		}
+	}
+	return 0;
+}
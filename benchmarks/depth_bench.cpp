@@ -0,0 +1,184 @@
+// Depth precision (ReverseZ.h): a z-fighting stress scene drawn with the old depth setup
+// and with reverse-Z into a 32-bit float depth buffer.
+//
+//   depth_bench [gapRatio=0.0001] [--software] [--assets DIR]
+//
+// For each distance from 1 m to 10 km the camera looks straight at two thin slabs filling
+// the screen: a red one at that distance and a green one behind it, gapRatio times the
+// distance further back. Every pixel should be red; a green one is the back slab winning
+// the depth test, which is z-fighting. Reported for each distance is the share of green
+// pixels, first with glm::perspective reaching out to 100 km, depth cleared to 1 and
+// GL_LESS on the window's 24-bit depth buffer, then with ReverseZ's projection and a
+// SceneTarget.
+//
+// Checks, each failing with exit code 1: reverse-Z leaves no more than 0.1% of pixels
+// z-fighting at any distance, the picking pass finds the red slab under the center of the
+// screen, and ReverseZ::viewRay() gives the ray unprojecting through the old projection
+// did.
+
+#include "HeadlessGL.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../camera.h"
+#include "../Scene.h"
+#include "../ColorPicker.h"
+#include "../ReverseZ.h"
+#include "../VirtualFileSystem.h"
+
+#ifndef ENGINE_SOURCE_DIR
+#define ENGINE_SOURCE_DIR "."
+#endif
+
+#ifndef GL_NEGATIVE_ONE_TO_ONE
+#define GL_NEGATIVE_ONE_TO_ONE 0x935E
+#endif
+
+static const float Distances[] = { 1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f };
+static const float OldFarPlane = 100000.0f;
+static const double FightingLimit = 0.001;
+
+using ClipControlProc = void (APIENTRY*)(GLenum origin, GLenum depth);
+
+struct Slabs {
+	Entity front, back;
+};
+
+// Red slab at distance, green one gap behind it, both far wider than the view. The green one
+// draws first, so where the two round to the same depth the red one fails the strict test.
+static Slabs buildSlabs(Scene& scene, float distance, float gap) {
+	glm::vec3 size(4.0f * distance, 4.0f * distance, gap * 0.25f);
+	Slabs slabs;
+	slabs.back = scene.createCube(glm::vec3(0.0f, 0.0f, -distance - gap), size);
+	slabs.front = scene.createCube(glm::vec3(0.0f, 0.0f, -distance), size);
+	scene.getWorld().get<Color>(slabs.front)->rgb = glm::vec3(1.0f, 0.0f, 0.0f);
+	scene.getWorld().get<Color>(slabs.back)->rgb = glm::vec3(0.0f, 1.0f, 0.0f);
+	return slabs;
+}
+
+// Share of the bound read framebuffer's pixels where green beat red
+static double fightingShare(std::vector<unsigned char>& pixels) {
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	size_t back = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		if (pixels[i + 1] > pixels[i]) back++;
+	}
+	return static_cast<double>(back) / (width * height);
+}
+
+static void drawScene(Scene& scene, Shader& shader, const glm::mat4& projection, const glm::mat4& view) {
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	shader.use();
+	shader.setMat4("projection", projection);
+	shader.setMat4("view", view);
+	scene.draw(shader, projection * view);
+}
+
+int main(int argc, char** argv) {
+	float gapRatio = 0.0001f;
+	bool software = false;
+	std::string assetDir = ENGINE_SOURCE_DIR;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--software") == 0) software = true;
+		else if (std::strcmp(argv[i], "--assets") == 0 && i + 1 < argc) assetDir = argv[++i];
+		else gapRatio = static_cast<float>(std::atof(argv[i]));
+	}
+	if (gapRatio <= 0.0f) {
+		std::printf("gapRatio must be positive\n");
+		return 2;
+	}
+
+	HeadlessGL gl;
+	if (!gl.create(width, height, software)) return 1;
+	glEnable(GL_DEPTH_TEST);
+	ReverseZ& reverseZ = ReverseZ::get();
+	reverseZ.init(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+	// the old setup needs GL's own depth range back while it draws
+	ClipControlProc clipControl = reverseZ.hasClipControl() ? reinterpret_cast<ClipControlProc>(eglGetProcAddress("glClipControl")) : nullptr;
+
+	VirtualFileSystem::get().mount("", std::make_unique<DirectorySource>(assetDir));
+	AssetManager& assets = AssetManager::get();
+	ShaderHandle mainShaderHandle = assets.loadShader("Vertex.vs", "Fragment.fs");
+	ShaderHandle pickShaderHandle = assets.loadShader("Vertex.vs", "ColorPickerFrag.fs");
+	if (!assets.getShader(mainShaderHandle) || !assets.getShader(pickShaderHandle)) return 1;
+	Shader& shader = *assets.getShader(mainShaderHandle);
+
+	std::printf("%s, clip control %s, gap %g x distance\n", gl.renderer().c_str(), reverseZ.hasClipControl() ? "yes" : "no", gapRatio);
+	std::printf("%10s %12s %18s %18s\n", "distance", "gap", "24-bit, GL_LESS", "reverse-Z, 32F");
+
+	Camera camera(glm::vec3(0.0f));
+	glm::mat4 view = camera.GetViewMatrix();
+	float fovy = glm::radians(camera.Zoom);
+	float aspect = (float)width / (float)height;
+	glm::mat4 oldProjection = glm::perspective(fovy, aspect, ReverseZ::NearPlane, OldFarPlane);
+	glm::mat4 projection = reverseZ.perspective(fovy, aspect);
+
+	SceneTarget sceneTarget;
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+	int exitCode = 0;
+
+	for (float distance : Distances) {
+		float gap = distance * gapRatio;
+		Scene scene;
+		Slabs slabs = buildSlabs(scene, distance, gap);
+
+		if (clipControl) clipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+		glClearDepth(1.0);
+		glDepthFunc(GL_LESS);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+		drawScene(scene, shader, oldProjection, view);
+		double oldShare = fightingShare(pixels);
+
+		if (clipControl) clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+		glClearDepth(0.0);
+		glDepthFunc(GL_GREATER);
+		sceneTarget.bind(width, height);
+		drawScene(scene, shader, projection, view);
+		double share = fightingShare(pixels);
+		sceneTarget.present();
+		gl.swap();
+
+		std::printf("%8.0f m %10.4g m %16.2f %% %16.2f %%\n", distance, gap, oldShare * 100.0, share * 100.0);
+		if (share > FightingLimit) {
+			std::printf("ERROR::DEPTH_BENCH::Z_FIGHTING: %.2f%% of pixels show the back slab at %.0f m\n", share * 100.0, distance);
+			exitCode = 1;
+		}
+
+		ColorPicker colorPicker(scene, *assets.getShader(pickShaderHandle), camera);
+		colorPicker.renderPickingPass();
+		Entity picked = colorPicker.objectForID(colorPicker.getObjectIDAtPixel(width / 2, height / 2, height));
+		if (picked != slabs.front) {
+			std::printf("ERROR::DEPTH_BENCH::PICKING: the center pixel at %.0f m doesn't pick the front slab\n", distance);
+			exitCode = 1;
+		}
+	}
+
+	// the old unproject, through the inverse of the old projection, against viewRay's
+	glm::mat4 inverseViewProjection = glm::inverse(oldProjection * view);
+	const glm::vec2 pointsToCheck[] = { glm::vec2(0.0f, 0.0f), glm::vec2(-0.9f, 0.7f), glm::vec2(0.9f, -0.95f) };
+	for (const glm::vec2& p : pointsToCheck) {
+		glm::vec4 nearPoint = inverseViewProjection * glm::vec4(p.x, p.y, -1.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProjection * glm::vec4(p.x, p.y, 1.0f, 1.0f);
+		glm::vec3 expected = glm::normalize(glm::vec3(farPoint) / farPoint.w - glm::vec3(nearPoint) / nearPoint.w);
+		glm::vec3 ray = ReverseZ::viewRay(projection, view, p.x, p.y);
+		if (glm::length(ray - expected) > 1e-4f) {
+			std::printf("ERROR::DEPTH_BENCH::UNPROJECT: (%.2f, %.2f) gives (%f, %f, %f), expected (%f, %f, %f)\n",
+				p.x, p.y, ray.x, ray.y, ray.z, expected.x, expected.y, expected.z);
+			exitCode = 1;
+		}
+	}
+
+	assets.release(mainShaderHandle);
+	assets.release(pickShaderHandle);
+	return exitCode;
+}
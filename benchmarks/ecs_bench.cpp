@@ -0,0 +1,244 @@
+// Per-frame iteration: the old scene layout, a vector of pointers to heap-allocated objects
+// behind virtual calls, against the archetype ECS walked serially and on the job system.
+//
+//   ecs_bench [entities=100000] [passes=20]
+//
+// Each pass runs the two systems Scene::draw runs before submission: frustum culling, then
+// a model matrix for every visible object. The pointer list is shuffled first, since a
+// scene that has been edited for a while no longer has its objects in allocation order.
+// Each design's visible count and an order-independent checksum of the matrices must
+// agree; exit code 1 if they don't.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchClock.h"
+#include "../ECS.h"
+#include "../FrameArena.h"
+#include "../Frustum.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+};
+
+// Same math as Transform in Objects.h, shared by both designs
+static glm::mat4 modelMatrix(const glm::vec3& position, const glm::vec3& size, const glm::vec3& rotation) {
+	glm::mat4 model = glm::mat4(1.0f);
+	model = glm::translate(model, position);
+	model = glm::scale(model, size);
+	model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1, 0, 0));
+	model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0, 1, 0));
+	model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0, 0, 1));
+	return model;
+}
+
+static float boundingRadius(const glm::vec3& size) { return 0.8660254f * glm::max(size.x, glm::max(size.y, size.z)); }
+
+// Adds the bits of a few matrix entries, so the result doesn't depend on visiting order
+static uint64_t matrixChecksum(const glm::mat4& m) {
+	uint32_t bits[3];
+	std::memcpy(&bits[0], &m[0][0], 4);
+	std::memcpy(&bits[1], &m[3][0], 4);
+	std::memcpy(&bits[2], &m[3][2], 4);
+	return static_cast<uint64_t>(bits[0]) + bits[1] + bits[2];
+}
+
+// --- the old design: Object with virtual culling and transform ---
+
+class BenchObject {
+public:
+	glm::vec3 position;
+	glm::vec3 size;
+	glm::vec3 rotation;
+	bool selected = false;
+	bool visible = false;
+	int ID = 0;
+	glm::mat4 model;
+
+	BenchObject(glm::vec3 pos, glm::vec3 size, glm::vec3 rot) : position(pos), size(size), rotation(rot), model(1.0f) {}
+	virtual ~BenchObject() = default;
+	virtual bool intersectsFrustum(const Frustum& frustum) const = 0;
+	virtual void updateModel() = 0;
+};
+
+class BenchCube : public BenchObject {
+public:
+	using BenchObject::BenchObject;
+	bool intersectsFrustum(const Frustum& frustum) const override { return frustum.intersectsSphere(position, boundingRadius(size)); }
+	void updateModel() override { model = modelMatrix(position, size, rotation); }
+};
+
+// --- the ECS design ---
+
+struct BenchTransform {
+	glm::vec3 position;
+	glm::vec3 size;
+	glm::vec3 rotation;
+};
+
+struct BenchWorldMatrix {
+	glm::mat4 model;
+};
+
+struct BenchVisibility {
+	bool visible;
+};
+
+struct BenchSelection {
+	bool selected;
+};
+
+struct PassResult {
+	double cullNs = 0; // per entity, averaged over passes
+	double transformNs = 0;
+	size_t visible = 0;
+	uint64_t checksum = 0;
+};
+
+static void printResult(const char* name, const PassResult& r) {
+	std::printf("%-24s %8.2f ns/entity cull %8.2f ns/entity transform %8.2f ns/entity total\n", name, r.cullNs, r.transformNs,
+		r.cullNs + r.transformNs);
+}
+
+static PassResult runPointers(std::vector<BenchObject*>& objects, const Frustum& frustum, int passes) {
+	PassResult r;
+	double cullMs = 0, transformMs = 0;
+	for (int pass = 0; pass < passes; pass++) {
+		BenchClock::time_point start = BenchClock::now();
+		for (BenchObject* obj : objects) obj->visible = obj->intersectsFrustum(frustum);
+		cullMs += millisecondsSince(start);
+		start = BenchClock::now();
+		for (BenchObject* obj : objects) {
+			if (obj->visible) obj->updateModel();
+		}
+		transformMs += millisecondsSince(start);
+	}
+	for (const BenchObject* obj : objects) {
+		if (!obj->visible) continue;
+		r.visible++;
+		r.checksum += matrixChecksum(obj->model);
+	}
+	r.cullNs = cullMs * 1e6 / (static_cast<double>(passes) * objects.size());
+	r.transformNs = transformMs * 1e6 / (static_cast<double>(passes) * objects.size());
+	return r;
+}
+
+static void cullChunk(const Frustum& frustum, size_t count, const BenchTransform* transforms, BenchVisibility* visibility) {
+	for (size_t i = 0; i < count; i++) visibility[i].visible = frustum.intersectsSphere(transforms[i].position, boundingRadius(transforms[i].size));
+}
+
+static void transformChunk(size_t count, const BenchTransform* transforms, const BenchVisibility* visibility, BenchWorldMatrix* matrices) {
+	for (size_t i = 0; i < count; i++) {
+		if (visibility[i].visible) matrices[i].model = modelMatrix(transforms[i].position, transforms[i].size, transforms[i].rotation);
+	}
+}
+
+static PassResult runWorld(World& world, const Frustum& frustum, int passes, bool parallel) {
+	PassResult r;
+	JobSystem& jobs = JobSystem::get();
+	FrameArena& frameArena = FrameArena::get();
+	double cullMs = 0, transformMs = 0;
+	for (int pass = 0; pass < passes; pass++) {
+		BenchClock::time_point start = BenchClock::now();
+		if (parallel) {
+			world.parallelForEachChunk<const BenchTransform, BenchVisibility>(jobs,
+				[&](size_t, const Entity*, size_t count, const BenchTransform* transforms, BenchVisibility* visibility) { cullChunk(frustum, count, transforms, visibility); });
+		}
+		else {
+			world.forEachChunk<const BenchTransform, BenchVisibility>(
+				[&](const Entity*, size_t count, const BenchTransform* transforms, BenchVisibility* visibility) { cullChunk(frustum, count, transforms, visibility); });
+		}
+		cullMs += millisecondsSince(start);
+		start = BenchClock::now();
+		if (parallel) {
+			world.parallelForEachChunk<const BenchTransform, const BenchVisibility, BenchWorldMatrix>(jobs,
+				[](size_t, const Entity*, size_t count, const BenchTransform* transforms, const BenchVisibility* visibility, BenchWorldMatrix* matrices) {
+					transformChunk(count, transforms, visibility, matrices);
+				});
+		}
+		else {
+			world.forEachChunk<const BenchTransform, const BenchVisibility, BenchWorldMatrix>(
+				[](const Entity*, size_t count, const BenchTransform* transforms, const BenchVisibility* visibility, BenchWorldMatrix* matrices) {
+					transformChunk(count, transforms, visibility, matrices);
+				});
+		}
+		transformMs += millisecondsSince(start);
+		frameArena.endFrame();
+	}
+	world.each<const BenchVisibility, const BenchWorldMatrix>([&](Entity, const BenchVisibility& visibility, const BenchWorldMatrix& matrix) {
+		if (!visibility.visible) return;
+		r.visible++;
+		r.checksum += matrixChecksum(matrix.model);
+	});
+	r.cullNs = cullMs * 1e6 / (static_cast<double>(passes) * world.size());
+	r.transformNs = transformMs * 1e6 / (static_cast<double>(passes) * world.size());
+	return r;
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	int passes = argc > 2 ? std::atoi(argv[2]) : 20;
+	if (count == 0) count = 1;
+	if (passes < 1) passes = 1;
+	MemTagScope memTag(MemTag::Scene);
+
+	// objects scattered around a camera at the origin looking down -Z, about half in view
+	glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+	std::vector<BenchTransform> transforms(count);
+	SplitMix64 rng(7);
+	for (BenchTransform& t : transforms) {
+		t.position = glm::vec3(rng.uniform(-400.0f, 400.0f), rng.uniform(-200.0f, 200.0f), rng.uniform(-800.0f, 200.0f));
+		t.size = glm::vec3(rng.uniform(0.5f, 3.0f), rng.uniform(0.5f, 3.0f), rng.uniform(0.5f, 3.0f));
+		t.rotation = glm::vec3(rng.uniform(0.0f, 360.0f), rng.uniform(0.0f, 360.0f), rng.uniform(0.0f, 360.0f));
+	}
+
+	std::vector<BenchObject*> objects;
+	objects.reserve(count);
+	for (const BenchTransform& t : transforms) objects.push_back(new BenchCube(t.position, t.size, t.rotation));
+	for (size_t i = count - 1; i > 0; i--) std::swap(objects[i], objects[rng.next() % (i + 1)]);
+
+	World world;
+	for (const BenchTransform& t : transforms) world.create(t, BenchWorldMatrix{ glm::mat4(1.0f) }, BenchVisibility{ false }, BenchSelection{ false });
+
+	PassResult pointers = runPointers(objects, frustum, passes);
+	PassResult serial = runWorld(world, frustum, passes, false);
+	PassResult parallel = runWorld(world, frustum, passes, true);
+	for (BenchObject* obj : objects) delete obj;
+
+	std::printf("entities: %zu, passes: %d, visible: %zu, job system workers: %u\n", count, passes, pointers.visible, JobSystem::get().workerCount());
+	printResult("vector of pointers", pointers);
+	printResult("ECS", serial);
+	printResult("ECS on job system", parallel);
+	std::printf("ECS speedup: %.2fx serial, %.2fx on job system\n", (pointers.cullNs + pointers.transformNs) / (serial.cullNs + serial.transformNs),
+		(pointers.cullNs + pointers.transformNs) / (parallel.cullNs + parallel.transformNs));
+
+	int exitCode = 0;
+	for (const PassResult* r : { &serial, &parallel }) {
+		if (r->visible != pointers.visible || r->checksum != pointers.checksum) {
+			std::printf("ERROR::ECS_BENCH::MISMATCH: %zu visible (checksum %llu), expected %zu (checksum %llu)\n", r->visible,
+				static_cast<unsigned long long>(r->checksum), pointers.visible, static_cast<unsigned long long>(pointers.checksum));
+			exitCode = 1;
+		}
+	}
+	world.clear();
+	FrameArena::get().releaseAll();
+	return exitCode;
+}
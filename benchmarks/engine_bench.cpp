@@ -0,0 +1,450 @@
+// Deterministic headless frame benchmark: builds a parametric scene of Cubes, flies a
+// scripted camera around it and reports frame-time statistics, draw calls, per-zone timings
+// and memory as JSON.
+//
+//   engine_bench [--scenes grid,cloud,cluster] [--counts 1000,10000,100000,1000000]
+//                [--frames 200] [--warmup 20] [--repeat 1] [--size 800x600] [--seed 1]
+//                [--no-picking] [--software] [--check-allocs] [--assets DIR] [--out results.json]
+//
+// Runs on EGL without a window; --software forces Mesa llvmpipe so numbers from different
+// machines are comparable. Scene contents and camera poses depend only on the seed and the
+// frame index, never on wall-clock time. Build with CMake (ENGINE_BUILD_BENCHMARKS).
+//
+// --repeat N rebuilds and reruns every scenario N times; means then carry a 95% confidence
+// interval over the repetitions, which perf_gate uses to tell regressions from noise.
+//
+// Heap allocations are counted per recorded frame through MemoryTracker. --check-allocs
+// makes any allocation after warmup an error (exit code 1), which is how steady-state
+// frames are kept allocation-free.
+
+#include "HeadlessGL.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BenchClock.h"
+#include "../camera.h"
+#include "../Scene.h"
+#include "../ColorPicker.h"
+#include "../FrameArena.h"
+#include "../GpuProfiler.h"
+#include "../MemoryTracker.h"
+#include "../Profiler.h"
+#include "../RenderStats.h"
+#include "../ReverseZ.h"
+#include "../VirtualFileSystem.h"
+
+#ifndef ENGINE_SOURCE_DIR
+#define ENGINE_SOURCE_DIR "."
+#endif
+
+// Same sequence on every compiler and standard library, unlike <random> distributions
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform() { return (next() >> 40) / 16777216.0f; } // [0, 1)
+	float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+};
+
+struct BenchConfig {
+	std::vector<std::string> scenes = { "grid", "cloud", "cluster" };
+	std::vector<size_t> counts = { 1000, 10000, 100000, 1000000 };
+	int frames = 200;
+	int warmup = 20;
+	int repeat = 1;
+	int width = 800;
+	int height = 600;
+	uint64_t seed = 1;
+	bool picking = true;
+	bool software = false;
+	bool checkAllocations = false;
+	std::string assets = ENGINE_SOURCE_DIR;
+	std::string out = "engine_bench.json";
+};
+
+struct Summary {
+	double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+	double ci95 = 0; // half-width over the per-repetition means, 0 with a single run
+};
+
+// Half-width of the two-sided 95% confidence interval of the mean of samples (Student t)
+static double confidence95(const std::vector<double>& samples) {
+	static const double t[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086 };
+	size_t n = samples.size();
+	if (n < 2) return 0;
+	double mean = 0, variance = 0;
+	for (double v : samples) mean += v;
+	mean /= n;
+	for (double v : samples) variance += (v - mean) * (v - mean);
+	variance /= n - 1;
+	size_t dof = n - 1;
+	double tValue = dof <= 20 ? t[dof - 1] : 1.96 + 2.5 / dof;
+	return tValue * std::sqrt(variance / n);
+}
+
+static Summary summarize(std::vector<double> values, const std::vector<double>& repeatMeans = {}) {
+	Summary s;
+	s.ci95 = confidence95(repeatMeans);
+	if (values.empty()) return s;
+	std::sort(values.begin(), values.end());
+	auto at = [&](double p) { return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))]; };
+	for (double v : values) s.mean += v;
+	s.mean /= values.size();
+	s.p50 = at(0.50);
+	s.p95 = at(0.95);
+	s.p99 = at(0.99);
+	s.max = values.back();
+	return s;
+}
+
+// Per-zone totals for each frame, collected through the profiler's exporter interface.
+// Zones are registered during warmup and their storage reserved, so recorded frames don't
+// allocate and the heap allocation check only sees the engine.
+class ZoneCollector : public ProfileSink {
+public:
+	struct Zone {
+		std::string name;
+		double current = 0;
+		std::vector<double> frames; // ms per recorded frame
+	};
+
+	bool recording = false;
+	size_t expectedFrames = 0;
+	std::vector<Zone> zones;
+
+	void reset() {
+		for (Zone& z : zones) z.frames.clear();
+	}
+
+	void zone(const ProfileEvent& event, const char*) override {
+		find(event.name).current += (event.endNs - event.startNs) / 1e6;
+	}
+	void counter(const char*, uint64_t, double) override {}
+	void annotation(const char*, const char*, const char*, uint64_t, uint64_t, uint32_t) override {}
+	void frame(uint64_t, uint64_t, uint64_t) override {
+		for (Zone& z : zones) {
+			if (recording) z.frames.push_back(z.current);
+			z.current = 0;
+		}
+	}
+
+private:
+	Zone& find(const char* name) {
+		for (Zone& z : zones) {
+			if (z.name == name) return z;
+		}
+		zones.reserve(64);
+		zones.push_back(Zone{ name, 0, {} });
+		zones.back().frames.reserve(expectedFrames);
+		return zones.back();
+	}
+};
+
+struct SceneBounds {
+	glm::vec3 center;
+	float extent;
+};
+
+// grid: cubic lattice. cloud: uniform random in the same volume. cluster: the same number
+// of cubes packed into an eighth of the extent, so they overlap heavily.
+static SceneBounds buildScene(Scene& scene, const std::string& kind, size_t count, uint64_t seed) {
+	SceneSnapshot snap;
+	snap.resize(count);
+	snap.typeIndex("Cube");
+	SplitMix64 rng(seed);
+	const float spacing = 1.5f;
+	size_t side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+	float extent = side * spacing;
+
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 p;
+		if (kind == "grid") {
+			p = glm::vec3(static_cast<float>(i % side), static_cast<float>((i / side) % side), static_cast<float>(i / (side * side))) * spacing;
+		}
+		else if (kind == "cloud") {
+			p = glm::vec3(rng.uniform(0, extent), rng.uniform(0, extent), rng.uniform(0, extent));
+		}
+		else {
+			// sum of uniforms: roughly normal around the center
+			auto around = [&] { return extent * 0.5f + (rng.uniform() + rng.uniform() + rng.uniform() - 1.5f) * extent / 16.0f; };
+			p = glm::vec3(around(), around(), around());
+		}
+		snap.types[i] = 0;
+		snap.ids[i] = static_cast<int32_t>(i + 1);
+		snap.positions[i] = p;
+		snap.sizes[i] = glm::vec3(1.0f);
+		snap.rotations[i] = glm::vec3(rng.uniform(0, 360), rng.uniform(0, 360), rng.uniform(0, 360));
+	}
+	snap.setSelected(0, true); // one selection so outline and gizmo passes do work
+	scene.loadSnapshot(snap);
+	return SceneBounds{ glm::vec3(extent * 0.5f), extent };
+}
+
+// Orbit around the scene, bobbing up and down, one revolution per recorded run
+static Camera cameraAt(int frame, int frameCount, const SceneBounds& bounds) {
+	float t = static_cast<float>(frame) / std::max(1, frameCount);
+	float angle = t * 6.2831853f;
+	float radius = bounds.extent * 0.75f + 5.0f;
+	glm::vec3 position = bounds.center + glm::vec3(std::cos(angle) * radius, std::sin(angle * 2.0f) * bounds.extent * 0.25f, std::sin(angle) * radius);
+	glm::vec3 dir = glm::normalize(bounds.center - position);
+	float yaw = glm::degrees(std::atan2(dir.z, dir.x));
+	float pitch = glm::degrees(std::asin(dir.y));
+	return Camera(position, glm::vec3(0.0f, 1.0f, 0.0f), yaw, pitch);
+}
+
+// Fixed CPU workload timed next to every repetition. On shared or throttled machines the
+// whole run drifts together; perf_gate divides that drift out using this number.
+static double calibrationMs() {
+	BenchClock::time_point start = BenchClock::now();
+	SplitMix64 rng(42);
+	glm::mat4 m(1.0f);
+	for (int i = 0; i < 800000; i++) {
+		glm::mat4 r(1.0f);
+		r[3] = glm::vec4(rng.uniform(), rng.uniform(), rng.uniform(), 1.0f);
+		m = m * r;
+		m[3] = m[3] * 0.5f;
+	}
+	volatile float sink = m[3][0];
+	(void)sink;
+	return millisecondsSince(start);
+}
+
+struct MemoryUsage {
+	double rssMb = 0;
+	double peakRssMb = 0;
+};
+
+static MemoryUsage readMemory() {
+	MemoryUsage m;
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		long kb = 0;
+		if (std::sscanf(line.c_str(), "VmRSS: %ld kB", &kb) == 1) m.rssMb = kb / 1024.0;
+		if (std::sscanf(line.c_str(), "VmHWM: %ld kB", &kb) == 1) m.peakRssMb = kb / 1024.0;
+	}
+	return m;
+}
+
+static void writeSummary(std::ostream& out, const char* key, const Summary& s) {
+	char line[256];
+	std::snprintf(line, sizeof(line), "\"%s\":{\"mean\":%.4f,\"ci95\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+		key, s.mean, s.ci95, s.p50, s.p95, s.p99, s.max);
+	out << line;
+}
+
+template<typename T, typename F>
+static std::vector<T> splitList(const std::string& text, F convert) {
+	std::vector<T> items;
+	std::stringstream in(text);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		if (!item.empty()) items.push_back(convert(item));
+	}
+	return items;
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& config) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--scenes" && hasValue) config.scenes = splitList<std::string>(argv[++i], [](const std::string& s) { return s; });
+		else if (arg == "--counts" && hasValue) config.counts = splitList<size_t>(argv[++i], [](const std::string& s) { return static_cast<size_t>(std::stoull(s)); });
+		else if (arg == "--frames" && hasValue) config.frames = std::atoi(argv[++i]);
+		else if (arg == "--warmup" && hasValue) config.warmup = std::atoi(argv[++i]);
+		else if (arg == "--repeat" && hasValue) config.repeat = std::atoi(argv[++i]);
+		else if (arg == "--size" && hasValue) std::sscanf(argv[++i], "%dx%d", &config.width, &config.height);
+		else if (arg == "--seed" && hasValue) config.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--assets" && hasValue) config.assets = argv[++i];
+		else if (arg == "--out" && hasValue) config.out = argv[++i];
+		else if (arg == "--no-picking") config.picking = false;
+		else if (arg == "--software") config.software = true;
+		else if (arg == "--check-allocs") config.checkAllocations = true;
+		else {
+			std::printf("unknown argument %s\n", arg.c_str());
+			return false;
+		}
+	}
+	for (const std::string& scene : config.scenes) {
+		if (scene != "grid" && scene != "cloud" && scene != "cluster") {
+			std::printf("unknown scene %s (grid, cloud, cluster)\n", scene.c_str());
+			return false;
+		}
+	}
+	return config.frames > 0 && config.repeat > 0;
+}
+
+int main(int argc, char** argv) {
+	BenchConfig config;
+	if (!parseArgs(argc, argv, config)) return 2;
+
+	HeadlessGL gl;
+	if (!gl.create(config.width, config.height, config.software)) return 1;
+	glEnable(GL_DEPTH_TEST);
+	ReverseZ::get().init(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+
+	VirtualFileSystem::get().mount("", std::make_unique<DirectorySource>(config.assets));
+	AssetManager& assets = AssetManager::get();
+	ShaderHandle mainShaderHandle = assets.loadShader("Vertex.vs", "Fragment.fs");
+	ShaderHandle pickShaderHandle = assets.loadShader("Vertex.vs", "ColorPickerFrag.fs");
+	if (!assets.getShader(mainShaderHandle) || !assets.getShader(pickShaderHandle)) return 1;
+	Shader& shader = *assets.getShader(mainShaderHandle);
+
+	Profiler& profiler = Profiler::get();
+	GpuProfiler& gpuProfiler = GpuProfiler::get();
+	gpuProfiler.init();
+	ZoneCollector zones;
+	zones.expectedFrames = config.frames;
+	profiler.setSink(&zones);
+	MemoryTracker& memoryTracker = MemoryTracker::get();
+	FrameArena& frameArena = FrameArena::get();
+	SceneTarget sceneTarget;
+	int exitCode = 0;
+
+	std::ofstream out(config.out);
+	out << "{\"benchmark\":\"engine_bench\",\"renderer\":\"" << gl.renderer() << "\",\"software\":" << (config.software ? "true" : "false")
+		<< ",\"runs\":[";
+	bool firstRun = true;
+
+	for (const std::string& kind : config.scenes) {
+		for (size_t count : config.counts) {
+			std::vector<double> frameMs, drawCalls, triangles, culled, allocations, repeatMeans;
+			for (std::vector<double>* v : { &frameMs, &drawCalls, &triangles, &culled, &allocations })
+				v->reserve(static_cast<size_t>(config.frames) * config.repeat);
+			uint64_t worstFrameTags[MemoryTracker::TagCount] = {};
+			uint64_t worstFrameAllocations = 0;
+			std::map<std::string, std::vector<double>> zoneFrames, zoneRepeatMeans;
+			double setupMs = 0, calibration = 0;
+
+			for (int repetition = 0; repetition < config.repeat; repetition++) {
+				calibration += calibrationMs() / config.repeat;
+				Scene scene;
+				BenchClock::time_point setupStart = BenchClock::now();
+				SceneBounds bounds = buildScene(scene, kind, count, config.seed);
+				setupMs += millisecondsSince(setupStart) / config.repeat;
+
+				Camera camera = cameraAt(0, config.frames, bounds);
+				ColorPicker colorPicker(scene, *assets.getShader(pickShaderHandle), camera);
+				zones.reset();
+				double repetitionMs = 0;
+				memoryTracker.endFrame(); // setup allocations don't belong to a frame
+
+				for (int frame = -config.warmup; frame < config.frames; frame++) {
+					bool recording = frame >= 0;
+					zones.recording = recording;
+					profiler.beginFrame();
+					gpuProfiler.beginFrame();
+					RenderStats::frame().reset();
+					camera = cameraAt(std::max(frame, 0), config.frames, bounds);
+
+					BenchClock::time_point start = BenchClock::now();
+					if (config.picking) colorPicker.renderPickingPass();
+
+					sceneTarget.bind(config.width, config.height);
+					glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					shader.use();
+					glm::mat4 projection = ReverseZ::get().perspective(glm::radians(camera.Zoom), (float)config.width / (float)config.height);
+					glm::mat4 view = camera.GetViewMatrix();
+					shader.setMat4("projection", projection);
+					shader.setMat4("view", view);
+					scene.draw(shader, projection * view);
+					sceneTarget.present();
+					glFinish(); // count the GPU work in the frame, there's no swap to wait on
+					double ms = millisecondsSince(start);
+					gl.swap();
+					profiler.endFrame();
+					frameArena.endFrame();
+					memoryTracker.endFrame();
+
+					if (!recording) continue;
+					uint64_t frameAllocations = memoryTracker.lastFrameAllocations();
+					allocations.push_back(static_cast<double>(frameAllocations));
+					if (frameAllocations > worstFrameAllocations) {
+						worstFrameAllocations = frameAllocations;
+						for (int t = 0; t < MemoryTracker::TagCount; t++) worstFrameTags[t] = memoryTracker.lastFrameAllocations(static_cast<MemTag>(t));
+					}
+					const RenderStats& stats = RenderStats::frame();
+					frameMs.push_back(ms);
+					repetitionMs += ms;
+					drawCalls.push_back(stats.drawCalls);
+					triangles.push_back(static_cast<double>(stats.triangles));
+					culled.push_back(stats.objectsCulled);
+				}
+
+				repeatMeans.push_back(repetitionMs / config.frames);
+				for (const ZoneCollector::Zone& z : zones.zones) {
+					if (z.frames.empty()) continue;
+					std::vector<double>& all = zoneFrames[z.name];
+					all.insert(all.end(), z.frames.begin(), z.frames.end());
+					zoneRepeatMeans[z.name].push_back(summarize(z.frames).mean);
+				}
+			}
+
+			MemoryUsage memory = readMemory();
+			Summary frameStats = summarize(frameMs, repeatMeans);
+			std::printf("%-8s %8zu objects  mean %8.3f ms +-%6.3f  p95 %8.3f ms  p99 %8.3f ms  max %8.3f ms  draws %8.0f  rss %7.1f MB\n",
+				kind.c_str(), count, frameStats.mean, frameStats.ci95, frameStats.p95, frameStats.p99, frameStats.max, summarize(drawCalls).mean, memory.rssMb);
+			if (config.checkAllocations && worstFrameAllocations > 0) {
+				std::printf("ERROR::ENGINE_BENCH::FRAME_ALLOCATIONS: up to %llu heap allocations in a steady-state frame (",
+					static_cast<unsigned long long>(worstFrameAllocations));
+				for (int t = 0; t < MemoryTracker::TagCount; t++) {
+					std::printf("%s%s %llu", t ? ", " : "", memTagNames[t], static_cast<unsigned long long>(worstFrameTags[t]));
+				}
+				std::printf(")\n");
+				exitCode = 1;
+			}
+
+			out << (firstRun ? "\n" : ",\n");
+			firstRun = false;
+			out << "{\"scene\":\"" << kind << "\",\"objects\":" << count << ",\"frames\":" << config.frames
+				<< ",\"warmup\":" << config.warmup << ",\"repeat\":" << config.repeat << ",\"width\":" << config.width << ",\"height\":" << config.height
+				<< ",\"seed\":" << config.seed << ",\"picking\":" << (config.picking ? "true" : "false")
+				<< ",\"setup_ms\":" << setupMs << ",\"calibration_ms\":" << calibration << ",";
+			writeSummary(out, "frame_ms", frameStats);
+			out << ",";
+			writeSummary(out, "heap_allocs_per_frame", summarize(allocations));
+			out << ",\"draw_calls\":" << summarize(drawCalls).mean
+				<< ",\"triangles\":" << summarize(triangles).mean
+				<< ",\"objects_culled\":" << summarize(culled).mean
+				<< ",\"memory\":{\"rss_mb\":" << memory.rssMb << ",\"peak_rss_mb\":" << memory.peakRssMb
+				<< ",\"asset_bytes\":" << assets.totalBytes() << "},\"zones_ms\":{";
+			bool firstZone = true;
+			for (const auto& entry : zoneFrames) {
+				if (!firstZone) out << ",";
+				firstZone = false;
+				writeSummary(out, entry.first.c_str(), summarize(entry.second, zoneRepeatMeans[entry.first]));
+			}
+			out << "}}";
+		}
+	}
+	out << "\n]}\n";
+
+	profiler.setSink(nullptr);
+	cube::releaseMeshes();
+	gpuProfiler.shutdown();
+	assets.release(mainShaderHandle);
+	assets.release(pickShaderHandle);
+	assets.shutdown();
+	frameArena.releaseAll();
+	if (!memoryTracker.reportLeaks()) exitCode = 1;
+	std::printf("wrote %s\n", config.out.c_str());
+	return exitCode;
+}
@@ -0,0 +1,142 @@
+// Cost of per-frame temporaries: malloc/free, tracked operator new/delete and the frame
+// arena, for single allocations and for the std::vector temporaries Scene::draw builds.
+//
+//   frame_arena_bench [frames=200] [allocsPerFrame=10000]
+//
+// Each simulated frame makes allocsPerFrame allocations of 16-256 bytes and frees them at
+// the end of the frame (the arena just rewinds). Then FrameVector temporaries are built
+// the way Scene::draw does, and MemoryTracker checks that after two warm-up frames (one per
+// arena buffer) a frame makes no heap allocations at all; exit code 1 if it does. Last, the
+// lists are built on every job system worker too, to show per-thread arena use. Those
+// allocations are reported but not checked, since which worker takes a batch varies.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "BenchClock.h"
+#include "../FrameArena.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+
+static volatile size_t sink = 0;
+
+static const int WarmupFrames = 2;
+
+// Allocation sizes are drawn once so every allocator sees the same sequence
+static std::vector<size_t> makeSizes(size_t count) {
+	std::vector<size_t> sizes(count);
+	uint64_t state = 12345;
+	for (size_t& size : sizes) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		size = 16 + static_cast<size_t>(state >> 33) % 241;
+	}
+	return sizes;
+}
+
+template<typename Alloc, typename FreeAll>
+static double timeFrames(int frames, const std::vector<size_t>& sizes, std::vector<void*>& pointers, Alloc alloc, FreeAll freeAll) {
+	BenchClock::time_point start = BenchClock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		for (size_t i = 0; i < sizes.size(); i++) {
+			pointers[i] = alloc(sizes[i]);
+			static_cast<char*>(pointers[i])[0] = static_cast<char>(i);
+		}
+		freeAll();
+	}
+	return millisecondsSince(start) * 1e6 / (static_cast<double>(frames) * sizes.size());
+}
+
+struct Matrix {
+	float m[4][4];
+};
+
+// The shape of Scene::draw: a pointer list and a matrix list sized to the object count
+template<typename PointerList, typename MatrixList>
+static size_t buildLists(size_t objects) {
+	PointerList visible;
+	visible.reserve(objects);
+	for (size_t i = 0; i < objects; i++) {
+		if (i % 3) visible.push_back(&sink);
+	}
+	MatrixList matrices;
+	matrices.resize(visible.size());
+	for (size_t i = 0; i < matrices.size(); i++) matrices[i].m[0][0] = static_cast<float>(i);
+	return visible.size() + (matrices.empty() ? 0 : static_cast<size_t>(matrices.back().m[0][0]));
+}
+
+int main(int argc, char** argv) {
+	int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+	size_t perFrame = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000;
+	if (frames < WarmupFrames + 1) frames = WarmupFrames + 1;
+	std::vector<size_t> sizes = makeSizes(perFrame);
+	std::vector<void*> pointers(perFrame);
+	FrameArena& frameArena = FrameArena::get();
+
+	double mallocNs = timeFrames(frames, sizes, pointers, [](size_t bytes) { return std::malloc(bytes); },
+		[&] { for (void* p : pointers) std::free(p); });
+	double newNs = timeFrames(frames, sizes, pointers, [](size_t bytes) { return static_cast<void*>(new char[bytes]); },
+		[&] { for (void* p : pointers) delete[] static_cast<char*>(p); });
+	double arenaNs = timeFrames(frames, sizes, pointers, [](size_t bytes) { return FrameArena::allocate(bytes, 16); },
+		[&] { frameArena.endFrame(); });
+
+	std::printf("frames: %d, allocations per frame: %zu (16-256 bytes)\n", frames, perFrame);
+	std::printf("%-32s %8.2f ns/alloc\n", "malloc/free", mallocNs);
+	std::printf("%-32s %8.2f ns/alloc\n", "new/delete (tracked)", newNs);
+	std::printf("%-32s %8.2f ns/alloc\n", "frame arena", arenaNs);
+
+	// vector temporaries, as in Scene::draw
+	size_t objects = perFrame;
+	BenchClock::time_point start = BenchClock::now();
+	for (int frame = 0; frame < frames; frame++) sink = buildLists<std::vector<const volatile size_t*>, std::vector<Matrix>>(objects);
+	double stdMs = millisecondsSince(start) / frames;
+	start = BenchClock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		sink = buildLists<FrameVector<const volatile size_t*>, FrameVector<Matrix>>(objects);
+		frameArena.endFrame();
+	}
+	double frameMs = millisecondsSince(start) / frames;
+	std::printf("%-32s %8.3f ms/frame (%zu objects)\n", "std::vector temporaries", stdMs, objects);
+	std::printf("%-32s %8.3f ms/frame\n", "FrameVector temporaries", frameMs);
+
+	// steady state: after a frame per arena buffer, the main thread's frames allocate nothing
+	MemoryTracker& memory = MemoryTracker::get();
+	uint64_t steadyAllocations = 0;
+	memory.endFrame();
+	for (int frame = 0; frame < frames; frame++) {
+		sink = buildLists<FrameVector<const volatile size_t*>, FrameVector<Matrix>>(objects);
+		frameArena.endFrame();
+		memory.endFrame();
+		if (frame >= WarmupFrames) steadyAllocations += memory.lastFrameAllocations();
+	}
+
+	// the same lists built on every worker too; a worker's arenas warm up the first time
+	// the queue hands it a batch, which can be any frame
+	JobSystem& jobs = JobSystem::get();
+	const size_t batches = jobs.workerCount() + 1;
+	uint64_t arenaAllocations = 0, jobAllocations = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		jobs.parallelFor(batches, 1, [&](size_t, size_t) {
+			sink = buildLists<FrameVector<const volatile size_t*>, FrameVector<Matrix>>(objects / batches);
+		});
+		frameArena.endFrame();
+		memory.endFrame();
+		arenaAllocations += memory.lastFrameAllocations(MemTag::Frame);
+		jobAllocations += memory.lastFrameAllocations() - memory.lastFrameAllocations(MemTag::Frame);
+	}
+	const FrameArena::Stats& stats = frameArena.lastFrame();
+	std::printf("%-32s %8zu KB used last frame, %zu KB peak, %zu KB reserved on %zu threads\n", "frame arenas",
+		stats.lastFrameBytes / 1024, stats.peakFrameBytes / 1024, stats.capacityBytes / 1024, stats.threads);
+	std::printf("heap allocations in %d steady-state frames: %llu\n", frames - WarmupFrames, static_cast<unsigned long long>(steadyAllocations));
+	std::printf("heap allocations with workers over %d frames: arena chunks %llu, other %llu\n", frames,
+		static_cast<unsigned long long>(arenaAllocations), static_cast<unsigned long long>(jobAllocations));
+
+	frameArena.releaseAll();
+	int exitCode = 0;
+	if (steadyAllocations != 0) {
+		std::printf("ERROR::FRAME_ARENA_BENCH::STEADY_STATE_ALLOCATIONS\n");
+		exitCode = 1;
+	}
+	if (!memory.reportLeaks()) exitCode = 1;
+	return exitCode;
+}
@@ -0,0 +1,320 @@
+// Exact picking: the triangle BVH in MeshBVH.h on a closed mesh of a million triangles, and
+// the two-stage picker Scene uses (octree boxes, then oriented bounds and triangles) on a
+// field of rotated boxes.
+//
+//   mesh_pick_bench [triangles=1000000] [rays=20000] [checkRays=200] [instances=5000]
+//
+// The mesh is a cube subdivided and blown out into a bumpy sphere, so it is closed and its
+// shared vertices are bit-identical. Checks, each failing with exit code 1:
+//  - checkRays rays match a double-precision scan of every triangle (distance, and the
+//    triangle unless another one is hit at the same distance), and the barycentrics put
+//    the hit on the ray;
+//  - rays from the centre through every vertex and edge midpoint all hit (watertight); a
+//    plain single-precision Moller-Trumbore scan is run on the same rays for comparison;
+//  - two-stage picks match a scan of every instance's mesh. How often the world box alone
+//    would have picked another object is reported.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../MeshBVH.h"
+#include "../Octree.h"
+#include "../Ray.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+	glm::vec3 point(float extent) { return glm::vec3(uniform(-extent, extent), uniform(-extent, extent), uniform(-extent, extent)); }
+};
+
+// Vertex of the subdivided cube at lattice point (x, y, z), each 0..n, pushed out to the
+// bumpy sphere. Every face computes a shared point from the same integers, so it comes out
+// bit-identical.
+static glm::vec3 spherePoint(int x, int y, int z, int n) {
+	glm::vec3 p = glm::normalize(glm::vec3(x, y, z) * (2.0f / n) - 1.0f);
+	float bumps = 1.0f + 0.05f * std::sin(9.0f * p.x) * std::sin(7.0f * p.y) * std::sin(8.0f * p.z);
+	return p * bumps;
+}
+
+// 12 * n * n triangles, wound outwards
+static std::vector<float> bumpySphere(int n) {
+	std::vector<float> positions;
+	positions.reserve(static_cast<size_t>(n) * n * 6 * 2 * 9);
+	auto push = [&](const glm::vec3& p) {
+		positions.push_back(p.x);
+		positions.push_back(p.y);
+		positions.push_back(p.z);
+	};
+	for (int face = 0; face < 6; face++) {
+		int axis = face / 2, side = face % 2 ? n : 0;
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) {
+				auto corner = [&](int a, int b) {
+					int c[3];
+					c[axis] = side;
+					c[(axis + 1) % 3] = a;
+					c[(axis + 2) % 3] = b;
+					return spherePoint(c[0], c[1], c[2], n);
+				};
+				glm::vec3 p00 = corner(i, j), p10 = corner(i + 1, j), p01 = corner(i, j + 1), p11 = corner(i + 1, j + 1);
+				bool flip = face % 2 == 0;
+				push(p00); push(flip ? p11 : p10); push(flip ? p10 : p11);
+				push(p00); push(flip ? p01 : p11); push(flip ? p11 : p01);
+			}
+		}
+	}
+	return positions;
+}
+
+static glm::vec3 vertexAt(const std::vector<float>& positions, size_t v) { return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]); }
+
+// Reference: Moller-Trumbore in double precision over every triangle, with a small
+// tolerance on the edges so grazing hits aren't lost
+static bool scanDouble(const std::vector<float>& positions, const Ray& ray, double& best, uint32_t& bestTriangle) {
+	bool found = false;
+	best = 1e300;
+	glm::dvec3 origin(ray.origin), direction(ray.direction);
+	size_t count = positions.size() / 9;
+	for (size_t t = 0; t < count; t++) {
+		glm::dvec3 a(vertexAt(positions, t * 3)), b(vertexAt(positions, t * 3 + 1)), c(vertexAt(positions, t * 3 + 2));
+		glm::dvec3 e1 = b - a, e2 = c - a, p = glm::cross(direction, e2);
+		double det = glm::dot(e1, p);
+		if (det == 0.0) continue;
+		double inverse = 1.0 / det;
+		glm::dvec3 s = origin - a;
+		double u = glm::dot(s, p) * inverse;
+		if (u < -1e-9 || u > 1.0 + 1e-9) continue;
+		glm::dvec3 q = glm::cross(s, e1);
+		double v = glm::dot(direction, q) * inverse;
+		if (v < -1e-9 || u + v > 1.0 + 1e-9) continue;
+		double distance = glm::dot(e2, q) * inverse;
+		if (distance >= 0.0 && distance < best) {
+			best = distance;
+			bestTriangle = static_cast<uint32_t>(t);
+			found = true;
+		}
+	}
+	return found;
+}
+
+// The usual single-precision Moller-Trumbore, for the watertightness comparison
+static bool anyHitFloat(const std::vector<float>& positions, const Ray& ray) {
+	size_t count = positions.size() / 9;
+	for (size_t t = 0; t < count; t++) {
+		glm::vec3 a = vertexAt(positions, t * 3), b = vertexAt(positions, t * 3 + 1), c = vertexAt(positions, t * 3 + 2);
+		glm::vec3 e1 = b - a, e2 = c - a, p = glm::cross(ray.direction, e2);
+		float det = glm::dot(e1, p);
+		if (det == 0.0f) continue;
+		float inverse = 1.0f / det;
+		glm::vec3 s = ray.origin - a;
+		float u = glm::dot(s, p) * inverse;
+		if (u < 0.0f || u > 1.0f) continue;
+		glm::vec3 q = glm::cross(s, e1);
+		float v = glm::dot(ray.direction, q) * inverse;
+		if (v < 0.0f || u + v > 1.0f) continue;
+		if (glm::dot(e2, q) * inverse >= 0.0f) return true;
+	}
+	return false;
+}
+
+static glm::mat4 randomModel(SplitMix64& rng, float extent) {
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), rng.point(extent));
+	model = glm::rotate(model, rng.uniform(0.0f, 6.2831853f), glm::normalize(rng.point(1.0f) + glm::vec3(0.0f, 0.0f, 1e-3f)));
+	return glm::scale(model, glm::vec3(rng.uniform(0.5f, 6.0f), rng.uniform(0.2f, 1.0f), rng.uniform(0.2f, 1.0f)));
+}
+
+static void worldBox(const glm::mat4& model, const MeshBVH& bvh, glm::vec3& boxMin, glm::vec3& boxMax) {
+	boxMin = glm::vec3(1e30f);
+	boxMax = glm::vec3(-1e30f);
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 local((corner & 1) ? bvh.boundsMax().x : bvh.boundsMin().x, (corner & 2) ? bvh.boundsMax().y : bvh.boundsMin().y,
+			(corner & 4) ? bvh.boundsMax().z : bvh.boundsMin().z);
+		glm::vec3 p(model * glm::vec4(local, 1.0f));
+		boxMin = glm::min(boxMin, p);
+		boxMax = glm::max(boxMax, p);
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t triangleTarget = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	size_t rayCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+	size_t checkRays = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 200;
+	size_t instances = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 5000;
+	if (rayCount == 0) rayCount = 1;
+	if (instances == 0) instances = 1;
+	int n = std::max(1, static_cast<int>(std::ceil(std::sqrt(triangleTarget / 12.0))));
+	MemTagScope memTag(MemTag::Assets);
+
+	// --- the big mesh ---
+	std::vector<float> positions = bumpySphere(n);
+	size_t triangleCount = positions.size() / 9;
+	MeshBVH bvh;
+	BenchClock::time_point start = BenchClock::now();
+	bvh.build(positions.data(), triangleCount);
+	double buildMs = millisecondsSince(start);
+
+	SplitMix64 rng(17);
+	std::vector<Ray> rays(rayCount);
+	for (Ray& ray : rays) {
+		glm::vec3 origin = glm::normalize(rng.point(1.0f) + glm::vec3(1e-3f)) * 3.0f;
+		rays[&ray - rays.data()] = Ray(origin, rng.point(1.0f) - origin);
+	}
+	size_t hits = 0;
+	start = BenchClock::now();
+	for (const Ray& ray : rays) {
+		MeshHit hit;
+		hits += bvh.raycast(ray, hit);
+	}
+	double raysMs = millisecondsSince(start);
+
+	// the same rays through a world matrix, with the oriented box test in front
+	glm::mat4 placed = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(10.0f, -4.0f, 2.0f)), 0.7f, glm::vec3(0.3f, 0.9f, 0.1f)), glm::vec3(2.0f));
+	std::vector<Ray> worldRays(rayCount);
+	for (size_t r = 0; r < rayCount; r++) {
+		worldRays[r] = Ray(glm::vec3(placed * glm::vec4(rays[r].origin, 1.0f)), glm::vec3(placed * glm::vec4(rays[r].direction, 0.0f)));
+	}
+	size_t placedHits = 0;
+	start = BenchClock::now();
+	for (const Ray& ray : worldRays) {
+		MeshHit hit;
+		placedHits += raycastMesh(ray, placed, bvh, hit);
+	}
+	double placedMs = millisecondsSince(start);
+
+	// --- correctness against a double-precision scan ---
+	size_t distanceMismatches = 0, triangleMismatches = 0, baryMismatches = 0;
+	for (size_t r = 0; r < std::min(checkRays, rayCount); r++) {
+		MeshHit hit;
+		bool found = bvh.raycast(rays[r], hit);
+		double expected = 0.0;
+		uint32_t expectedTriangle = 0;
+		bool expectedFound = scanDouble(positions, rays[r], expected, expectedTriangle);
+		if (found != expectedFound) {
+			distanceMismatches++;
+			continue;
+		}
+		if (!found) continue;
+		if (std::abs(hit.distance - expected) > 1e-4 * std::max(1.0, expected)) distanceMismatches++;
+		else if (hit.triangle != expectedTriangle) {
+			// fine if the reference's triangle is hit at the same distance, on a shared edge
+			MeshBVH one;
+			one.build(positions.data() + static_cast<size_t>(expectedTriangle) * 9, 1);
+			MeshHit other;
+			if (!one.raycast(rays[r], other) || std::abs(other.distance - hit.distance) > 1e-4f * std::max(1.0f, hit.distance)) triangleMismatches++;
+		}
+		glm::vec3 a = vertexAt(positions, hit.triangle * 3), b = vertexAt(positions, hit.triangle * 3 + 1), c = vertexAt(positions, hit.triangle * 3 + 2);
+		glm::vec3 onTriangle = a * (1.0f - hit.u - hit.v) + b * hit.u + c * hit.v;
+		if (glm::length(onTriangle - rays[r].at(hit.distance)) > 1e-4f * glm::length(rays[r].direction) * std::max(1.0f, hit.distance)) baryMismatches++;
+	}
+
+	// --- watertightness: from the centre through vertices and edge midpoints ---
+	size_t leakRays = 0, leaks = 0, floatLeaks = 0;
+	size_t stride = std::max<size_t>(1, triangleCount / 2000);
+	for (size_t t = 0; t < triangleCount; t += stride) {
+		glm::vec3 a = vertexAt(positions, t * 3), b = vertexAt(positions, t * 3 + 1);
+		for (const glm::vec3& target : { a, (a + b) * 0.5f }) {
+			Ray ray(glm::vec3(0.0f), target);
+			MeshHit hit;
+			leakRays++;
+			leaks += !bvh.raycast(ray, hit);
+			floatLeaks += !anyHitFloat(positions, ray);
+		}
+	}
+
+	// --- two-stage picking among rotated boxes ---
+	static const float box[] = {
+		-0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f,
+		-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
+		-0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f,
+		0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f,
+		-0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f,
+		-0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
+	};
+	MeshBVH boxMesh;
+	boxMesh.build(box, 12);
+	std::vector<glm::mat4> models(instances);
+	LooseOctree octree(glm::vec3(0.0f), 256.0f);
+	float extent = 10.0f * std::cbrt(static_cast<float>(instances));
+	for (size_t i = 0; i < instances; i++) {
+		models[i] = randomModel(rng, extent);
+		glm::vec3 boxMin, boxMax;
+		worldBox(models[i], boxMesh, boxMin, boxMax);
+		octree.insert(Entity(static_cast<uint32_t>(i), 1), boxMin, boxMax);
+	}
+	size_t picks = std::min<size_t>(rayCount, 5000), pickMismatches = 0, boxOnlyWrong = 0, picked = 0;
+	double twoStageMs = 0;
+	for (size_t p = 0; p < picks; p++) {
+		glm::vec3 origin = rng.point(extent * 1.5f);
+		Ray ray(origin, rng.point(extent) - origin);
+		start = BenchClock::now();
+		MeshHit hit;
+		float distance = 0.0f;
+		Entity entity = octree.raycast(ray, distance, [&](Entity candidate, float, float& best) {
+			Ray closer = ray;
+			closer.tMax = best;
+			MeshHit meshHit;
+			if (!raycastMesh(closer, models[candidate.index()], boxMesh, meshHit)) return false;
+			best = meshHit.distance;
+			hit = meshHit;
+			return true;
+		});
+		twoStageMs += millisecondsSince(start);
+
+		Entity scan;
+		MeshHit scanHit;
+		for (size_t i = 0; i < instances; i++) {
+			Ray closer = ray;
+			closer.tMax = scanHit.distance;
+			MeshHit meshHit;
+			if (raycastMesh(closer, models[i], boxMesh, meshHit) && (!scan.valid() || meshHit.distance < scanHit.distance)) {
+				scanHit = meshHit;
+				scan = Entity(static_cast<uint32_t>(i), 1);
+			}
+		}
+		if (entity.valid() != scan.valid() || (entity.valid() && hit.distance != scanHit.distance)) pickMismatches++;
+		float boxDistance;
+		Entity boxOnly = octree.raycast(ray, boxDistance);
+		boxOnlyWrong += boxOnly != scan;
+		picked += scan.valid();
+	}
+
+	std::printf("mesh: %zu triangles, BVH built in %.0f ms, %zu nodes, %.1f bytes per triangle\n", triangleCount, buildMs, bvh.nodeCount(),
+		static_cast<double>(bvh.memoryBytes()) / triangleCount);
+	std::printf("rays in mesh space:   %8.2f us per ray, %.2f M rays/s, %zu of %zu hit\n", raysMs * 1e3 / rayCount, rayCount / (raysMs * 1e3), hits, rayCount);
+	std::printf("rays through a world matrix (oriented box, then triangles): %.2f us per ray, %zu hit\n", placedMs * 1e3 / rayCount, placedHits);
+	std::printf("checked %zu rays against a double-precision scan; %zu rays from the centre through vertices and edges: %zu leaks (plain Moller-Trumbore: %zu)\n",
+		std::min(checkRays, rayCount), leakRays, leaks, floatLeaks);
+	std::printf("picking among %zu rotated boxes: two-stage %.2f us per pick, %zu of %zu rays hit; world boxes alone pick the wrong object %.1f%% of the time\n",
+		instances, twoStageMs * 1e3 / picks, picked, picks, 100.0 * boxOnlyWrong / picks);
+
+	int exitCode = 0;
+	if (distanceMismatches || triangleMismatches || baryMismatches) {
+		std::printf("ERROR::MESH_PICK_BENCH::MISMATCH: %zu distance, %zu triangle, %zu barycentric mismatches against the scan\n", distanceMismatches,
+			triangleMismatches, baryMismatches);
+		exitCode = 1;
+	}
+	if (leaks) {
+		std::printf("ERROR::MESH_PICK_BENCH::LEAK: %zu rays escaped the closed mesh\n", leaks);
+		exitCode = 1;
+	}
+	if (pickMismatches) {
+		std::printf("ERROR::MESH_PICK_BENCH::PICK_MISMATCH: %zu two-stage picks differ from a scan of every instance\n", pickMismatches);
+		exitCode = 1;
+	}
+	return exitCode;
+}
@@ -0,0 +1,171 @@
+// Object churn: create/destroy throughput of ObjectPool against one new/delete per object,
+// the way the scene allocated before, plus iteration over what is left afterwards.
+//
+//   object_pool_bench [live=10000] [pairs=1000000]
+//
+// A steady population of `live` objects is churned by destroying a random one and creating
+// a replacement, `pairs` times. Every destroyed handle is then checked to resolve to
+// nullptr; generations are 10 bits, so that holds while no slot is reused 1023 times,
+// which the defaults stay well clear of. Exits 1 if a stale handle still resolves, the
+// pool manages fewer than one million creates and destroys per second, or creating `live`
+// objects after reserve(live) allocates anything.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../ObjectPool.h"
+
+// Same layout as Object: vtable, transform, selection and ID
+class BenchObject {
+public:
+	glm::vec3 position;
+	glm::vec3 size;
+	glm::vec3 rotation;
+	bool selected = false;
+	int ID = 0;
+
+	explicit BenchObject(glm::vec3 pos) : position(pos), size(1.0f), rotation(0.0f) {}
+	virtual ~BenchObject() = default;
+	virtual float weight() const { return position.x + position.y + position.z; }
+};
+
+class BenchCube : public BenchObject {
+public:
+	using BenchObject::BenchObject;
+	float weight() const override { return position.x; }
+};
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+static volatile float sink = 0.0f;
+
+static uint64_t sceneAllocations() {
+	return MemoryTracker::tagCounters(MemTag::Scene).totalAllocations.load();
+}
+
+struct ChurnResult {
+	double churnMs = 0;
+	double iterateNsPerObject = 0;
+	uint64_t allocations = 0; // during the churn loop
+};
+
+static void printResult(const char* name, const ChurnResult& r, size_t pairs) {
+	double opsPerSecond = pairs * 2.0 / (r.churnMs / 1000.0);
+	std::printf("%-16s %10.2f ms %10.2f M ops/s %8.1f ns/pair %10llu allocs %8.2f ns/object iterate\n", name, r.churnMs,
+		opsPerSecond / 1e6, r.churnMs * 1e6 / pairs, static_cast<unsigned long long>(r.allocations), r.iterateNsPerObject);
+}
+
+// Heap allocations made by `count` creates into a pool that reserved room for them
+static uint64_t allocationsAfterReserve(size_t count) {
+	ObjectPool<BenchCube, MemTag::Scene> pool;
+	pool.reserve(count);
+	uint64_t allocsBefore = sceneAllocations();
+	for (size_t i = 0; i < count; i++) pool.create(glm::vec3(static_cast<float>(i)));
+	return sceneAllocations() - allocsBefore;
+}
+
+int main(int argc, char** argv) {
+	size_t live = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+	size_t pairs = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	if (live == 0) live = 1;
+	MemTagScope memTag(MemTag::Scene);
+
+	// --- pool ---
+	ObjectPool<BenchCube, MemTag::Scene> pool;
+	using Handle = ObjectPool<BenchCube, MemTag::Scene>::Handle;
+	std::vector<Handle> handles;
+	std::vector<Handle> destroyed;
+	handles.reserve(live);
+	destroyed.reserve(pairs);
+	ChurnResult poolResult;
+	{
+		SplitMix64 rng(1);
+		for (size_t i = 0; i < live; i++) handles.push_back(pool.create(glm::vec3(static_cast<float>(i))));
+		uint64_t allocsBefore = sceneAllocations();
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < pairs; i++) {
+			size_t victim = rng.next() % live;
+			pool.destroy(handles[victim]);
+			destroyed.push_back(handles[victim]);
+			handles[victim] = pool.create(glm::vec3(static_cast<float>(i)));
+		}
+		poolResult.churnMs = millisecondsSince(start);
+		poolResult.allocations = sceneAllocations() - allocsBefore;
+
+		start = BenchClock::now();
+		float total = 0.0f;
+		pool.forEach([&](Handle, const BenchCube& obj) { total += obj.weight(); });
+		poolResult.iterateNsPerObject = millisecondsSince(start) * 1e6 / live;
+		sink = total;
+	}
+
+	size_t staleResolved = 0;
+	for (Handle handle : destroyed) {
+		if (pool.get(handle)) staleResolved++;
+	}
+
+	// --- new/delete ---
+	std::vector<BenchObject*> objects;
+	objects.reserve(live);
+	ChurnResult heapResult;
+	{
+		SplitMix64 rng(1);
+		for (size_t i = 0; i < live; i++) objects.push_back(new BenchCube(glm::vec3(static_cast<float>(i))));
+		uint64_t allocsBefore = sceneAllocations();
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < pairs; i++) {
+			size_t victim = rng.next() % live;
+			delete objects[victim];
+			objects[victim] = new BenchCube(glm::vec3(static_cast<float>(i)));
+		}
+		heapResult.churnMs = millisecondsSince(start);
+		heapResult.allocations = sceneAllocations() - allocsBefore;
+
+		start = BenchClock::now();
+		float total = 0.0f;
+		for (const BenchObject* obj : objects) total += obj->weight();
+		heapResult.iterateNsPerObject = millisecondsSince(start) * 1e6 / live;
+		sink = total;
+		for (BenchObject* obj : objects) delete obj;
+	}
+
+	std::printf("live objects: %zu, create/destroy pairs: %zu, sizeof(object): %zu\n", live, pairs, sizeof(BenchCube));
+	printResult("ObjectPool", poolResult, pairs);
+	printResult("new/delete", heapResult, pairs);
+	std::printf("pool slabs: %zu slots in %zu KB\n", pool.capacity(), pool.capacity() * sizeof(BenchCube) / 1024);
+	std::printf("stale handles checked: %zu, still resolving: %zu\n", destroyed.size(), staleResolved);
+
+	uint64_t reservedAllocations = allocationsAfterReserve(live);
+	std::printf("allocations creating %zu objects after reserve: %llu\n", live, static_cast<unsigned long long>(reservedAllocations));
+
+	int exitCode = 0;
+	if (reservedAllocations != 0) {
+		std::printf("ERROR::OBJECT_POOL_BENCH::RESERVE: %llu allocations creating %zu objects after reserve(%zu)\n",
+			static_cast<unsigned long long>(reservedAllocations), live, live);
+		exitCode = 1;
+	}
+	if (staleResolved != 0) {
+		std::printf("ERROR::OBJECT_POOL_BENCH::STALE_HANDLE: %zu destroyed handles still resolve\n", staleResolved);
+		exitCode = 1;
+	}
+	double poolOpsPerSecond = pairs * 2.0 / (poolResult.churnMs / 1000.0);
+	if (poolOpsPerSecond < 1e6) {
+		std::printf("ERROR::OBJECT_POOL_BENCH::TOO_SLOW: %.0f ops/s, target 1M creates and destroys per second\n", poolOpsPerSecond);
+		exitCode = 1;
+	}
+	return exitCode;
+}
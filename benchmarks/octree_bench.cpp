@@ -0,0 +1,354 @@
+// Spatial index under a mixed workload: every frame some objects move, the way a gizmo
+// drag or simulation moves them, and the scene runs sphere, box and frustum queries. The
+// loose octree (Octree.h) is compared with a bounding volume hierarchy built once and
+// refitted as objects move, the usual alternative for dynamic scenes.
+//
+//   octree_bench [objects=200000] [frames=100] [movesPerFrame=2000] [queriesPerFrame=100]
+//
+// Objects are boxes of 0.5-4 units scattered over a 1000-unit cube; moves are random steps
+// of up to 5 units, with one in fifty jumping anywhere. Each frame the first query of each
+// kind is checked against a brute-force scan for both structures; exit code 1 if any
+// result differs.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchClock.h"
+#include "../Frustum.h"
+#include "../MemoryTracker.h"
+#include "../Octree.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+	glm::vec3 point(float extent) { return glm::vec3(uniform(-extent, extent), uniform(-extent, extent), uniform(-extent, extent)); }
+};
+
+static const float WorldExtent = 500.0f;
+static const size_t ResultCapacity = 1 << 16;
+
+struct Box {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// --- query shapes, shared by the BVH and the brute-force reference ---
+
+struct SphereQuery {
+	glm::vec3 center;
+	float radius;
+	bool overlaps(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+		glm::vec3 nearest = glm::clamp(center, boxMin, boxMax) - center;
+		return glm::dot(nearest, nearest) <= radius * radius;
+	}
+};
+
+struct BoxQuery {
+	glm::vec3 min;
+	glm::vec3 max;
+	bool overlaps(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+		return boxMin.x <= max.x && boxMin.y <= max.y && boxMin.z <= max.z && boxMax.x >= min.x && boxMax.y >= min.y && boxMax.z >= min.z;
+	}
+};
+
+struct FrustumQuery {
+	Frustum frustum;
+	bool overlaps(const glm::vec3& boxMin, const glm::vec3& boxMax) const { return frustum.intersectsAABB(boxMin, boxMax); }
+};
+
+// --- the baseline: a median-split BVH with four boxes per leaf, refitted in place ---
+
+class BenchBvh {
+public:
+	void build(const std::vector<Box>& boxes) {
+		this->boxes = &boxes;
+		order.resize(boxes.size());
+		for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+		leafOf.assign(boxes.size(), 0);
+		nodes.clear();
+		nodes.reserve(2 * boxes.size() / LeafSize + 1);
+		buildNode(0, static_cast<uint32_t>(order.size()), NoParent);
+	}
+
+	// Box i has changed: redo its leaf, then every ancestor's bounds
+	void refit(uint32_t item) {
+		uint32_t index = leafOf[item];
+		Node& leaf = nodes[index];
+		leaf.bounds = boundsOf(leaf.first, leaf.first + leaf.count);
+		for (uint32_t p = leaf.parent; p != NoParent; p = nodes[p].parent) {
+			const Box& a = nodes[p + 1].bounds;
+			const Box& b = nodes[nodes[p].first].bounds;
+			nodes[p].bounds = Box{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+		}
+	}
+
+	template<typename Shape>
+	size_t query(const Shape& shape, Entity* out, size_t capacity) const {
+		size_t count = 0;
+		uint32_t stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			if (!shape.overlaps(node.bounds.min, node.bounds.max)) continue;
+			if (node.count == 0) {
+				// left child follows its parent, the right one is stored in first
+				stack[top++] = node.first;
+				stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const Box& box = (*boxes)[order[i]];
+				if (!shape.overlaps(box.min, box.max)) continue;
+				if (count < capacity) out[count] = Entity(order[i], 1);
+				count++;
+			}
+		}
+		return count;
+	}
+
+private:
+	static const uint32_t LeafSize = 4;
+	static const uint32_t NoParent = ~0u;
+
+	struct Node {
+		Box bounds;
+		uint32_t first; // first item of a leaf, or the right child of an inner node
+		uint32_t count; // 0 for an inner node
+		uint32_t parent;
+	};
+
+	const std::vector<Box>* boxes = nullptr;
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> leafOf;
+	std::vector<Node> nodes;
+
+	Box boundsOf(uint32_t begin, uint32_t end) const {
+		Box bounds{ glm::vec3(1e30f), glm::vec3(-1e30f) };
+		for (uint32_t i = begin; i < end; i++) {
+			bounds.min = glm::min(bounds.min, (*boxes)[order[i]].min);
+			bounds.max = glm::max(bounds.max, (*boxes)[order[i]].max);
+		}
+		return bounds;
+	}
+
+	uint32_t buildNode(uint32_t begin, uint32_t end, uint32_t parent) {
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(Node{ boundsOf(begin, end), begin, end - begin, parent });
+		if (end - begin <= LeafSize) {
+			for (uint32_t i = begin; i < end; i++) leafOf[order[i]] = index;
+			return index;
+		}
+		glm::vec3 size = nodes[index].bounds.max - nodes[index].bounds.min;
+		int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+		uint32_t middle = (begin + end) / 2;
+		std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b) {
+			return (*boxes)[a].min[axis] + (*boxes)[a].max[axis] < (*boxes)[b].min[axis] + (*boxes)[b].max[axis];
+		});
+		buildNode(begin, middle, index);
+		uint32_t right = buildNode(middle, end, index);
+		nodes[index].first = right;
+		nodes[index].count = 0;
+		return index;
+	}
+};
+
+template<typename Shape>
+static size_t bruteForce(const std::vector<Box>& boxes, const Shape& shape, Entity* out) {
+	size_t count = 0;
+	for (uint32_t i = 0; i < boxes.size(); i++) {
+		if (shape.overlaps(boxes[i].min, boxes[i].max)) out[count++] = Entity(i, 1);
+	}
+	return count;
+}
+
+static bool sameResults(Entity* a, size_t countA, Entity* b, size_t countB) {
+	if (countA != countB) return false;
+	auto byValue = [](Entity x, Entity y) { return x.value < y.value; };
+	std::sort(a, a + countA, byValue);
+	std::sort(b, b + countB, byValue);
+	return std::equal(a, a + countA, b);
+}
+
+static Box randomBox(SplitMix64& rng) {
+	glm::vec3 center = rng.point(WorldExtent);
+	glm::vec3 half(rng.uniform(0.25f, 2.0f), rng.uniform(0.25f, 2.0f), rng.uniform(0.25f, 2.0f));
+	return Box{ center - half, center + half };
+}
+
+static Box moveBox(const Box& box, SplitMix64& rng) {
+	glm::vec3 half = (box.max - box.min) * 0.5f;
+	glm::vec3 center = rng.next() % 50 == 0 ? rng.point(WorldExtent) : (box.min + box.max) * 0.5f + rng.point(5.0f);
+	center = glm::clamp(center, glm::vec3(-WorldExtent), glm::vec3(WorldExtent));
+	return Box{ center - half, center + half };
+}
+
+static FrustumQuery randomFrustum(SplitMix64& rng) {
+	glm::vec3 eye = rng.point(WorldExtent);
+	glm::vec3 target = eye + rng.point(1.0f);
+	glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+	return FrustumQuery{ Frustum::fromMatrix(viewProjection) };
+}
+
+struct Timing {
+	double updateMs = 0;
+	double queryMs[3] = {};
+	size_t hits[3] = {};
+	size_t mismatches = 0;
+};
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+	size_t moves = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 2000;
+	size_t queries = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 100;
+	if (count == 0) count = 1;
+	if (frames < 1) frames = 1;
+	if (queries < 3) queries = 3;
+	MemTagScope memTag(MemTag::Scene);
+
+	SplitMix64 rng(11);
+	std::vector<Box> boxes(count);
+	for (Box& box : boxes) box = randomBox(rng);
+
+	BenchClock::time_point start = BenchClock::now();
+	LooseOctree octree(glm::vec3(0.0f), 1024.0f);
+	std::vector<OctreeHandle> handles(count);
+	for (uint32_t i = 0; i < count; i++) handles[i] = octree.insert(Entity(i, 1), boxes[i].min, boxes[i].max);
+	double octreeBuildMs = millisecondsSince(start);
+
+	std::vector<Box> bvhBoxes = boxes;
+	BenchBvh bvh;
+	start = BenchClock::now();
+	bvh.build(bvhBoxes);
+	double bvhBuildMs = millisecondsSince(start);
+
+	// the same moves and queries for both, drawn up front
+	std::vector<uint32_t> movedItems(moves * frames);
+	std::vector<Box> movedBoxes(moves * frames);
+	{
+		std::vector<Box> current = boxes;
+		for (size_t m = 0; m < movedItems.size(); m++) {
+			movedItems[m] = static_cast<uint32_t>(rng.next() % count);
+			movedBoxes[m] = current[movedItems[m]] = moveBox(current[movedItems[m]], rng);
+		}
+	}
+	std::vector<SphereQuery> spheres(queries * frames);
+	std::vector<BoxQuery> regions(queries * frames);
+	std::vector<FrustumQuery> frustums(queries * frames);
+	for (size_t q = 0; q < spheres.size(); q++) {
+		spheres[q] = SphereQuery{ rng.point(WorldExtent), 25.0f };
+		glm::vec3 corner = rng.point(WorldExtent);
+		regions[q] = BoxQuery{ corner, corner + glm::vec3(50.0f) };
+		frustums[q] = randomFrustum(rng);
+	}
+
+	std::vector<Entity> results(ResultCapacity), expected(ResultCapacity);
+	Timing octreeTiming, bvhTiming;
+	uint64_t octreeAllocations = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		size_t firstMove = frame * moves, firstQuery = frame * (queries / 3);
+
+		// octree
+		uint64_t allocsBefore = MemoryTracker::tagCounters(MemTag::Scene).totalAllocations.load();
+		start = BenchClock::now();
+		for (size_t m = firstMove; m < firstMove + moves; m++) octree.update(handles[movedItems[m]], movedBoxes[m].min, movedBoxes[m].max);
+		octreeTiming.updateMs += millisecondsSince(start);
+		for (size_t q = firstQuery; q < firstQuery + queries / 3; q++) {
+			start = BenchClock::now();
+			octreeTiming.hits[0] += octree.querySphere(spheres[q].center, spheres[q].radius, results.data(), ResultCapacity);
+			octreeTiming.queryMs[0] += millisecondsSince(start);
+			start = BenchClock::now();
+			octreeTiming.hits[1] += octree.queryBox(regions[q].min, regions[q].max, results.data(), ResultCapacity);
+			octreeTiming.queryMs[1] += millisecondsSince(start);
+			start = BenchClock::now();
+			octreeTiming.hits[2] += octree.queryFrustum(frustums[q].frustum, results.data(), ResultCapacity);
+			octreeTiming.queryMs[2] += millisecondsSince(start);
+		}
+		octreeAllocations += MemoryTracker::tagCounters(MemTag::Scene).totalAllocations.load() - allocsBefore;
+
+		// BVH
+		start = BenchClock::now();
+		for (size_t m = firstMove; m < firstMove + moves; m++) {
+			bvhBoxes[movedItems[m]] = movedBoxes[m];
+			bvh.refit(movedItems[m]);
+		}
+		bvhTiming.updateMs += millisecondsSince(start);
+		for (size_t q = firstQuery; q < firstQuery + queries / 3; q++) {
+			start = BenchClock::now();
+			bvhTiming.hits[0] += bvh.query(spheres[q], results.data(), ResultCapacity);
+			bvhTiming.queryMs[0] += millisecondsSince(start);
+			start = BenchClock::now();
+			bvhTiming.hits[1] += bvh.query(regions[q], results.data(), ResultCapacity);
+			bvhTiming.queryMs[1] += millisecondsSince(start);
+			start = BenchClock::now();
+			bvhTiming.hits[2] += bvh.query(frustums[q], results.data(), ResultCapacity);
+			bvhTiming.queryMs[2] += millisecondsSince(start);
+		}
+
+		// first query of each kind against a full scan
+		const SphereQuery& sphere = spheres[firstQuery];
+		const BoxQuery& region = regions[firstQuery];
+		const FrustumQuery& frustum = frustums[firstQuery];
+		size_t n = bruteForce(bvhBoxes, sphere, expected.data());
+		octreeTiming.mismatches += !sameResults(results.data(), octree.querySphere(sphere.center, sphere.radius, results.data(), ResultCapacity), expected.data(), n);
+		bvhTiming.mismatches += !sameResults(results.data(), bvh.query(sphere, results.data(), ResultCapacity), expected.data(), n);
+		n = bruteForce(bvhBoxes, region, expected.data());
+		octreeTiming.mismatches += !sameResults(results.data(), octree.queryBox(region.min, region.max, results.data(), ResultCapacity), expected.data(), n);
+		bvhTiming.mismatches += !sameResults(results.data(), bvh.query(region, results.data(), ResultCapacity), expected.data(), n);
+		n = bruteForce(bvhBoxes, frustum, expected.data());
+		octreeTiming.mismatches += !sameResults(results.data(), octree.queryFrustum(frustum.frustum, results.data(), ResultCapacity), expected.data(), n);
+		bvhTiming.mismatches += !sameResults(results.data(), bvh.query(frustum, results.data(), ResultCapacity), expected.data(), n);
+	}
+
+	// what the refitted BVH has lost against a fresh build of the same boxes
+	BenchBvh rebuilt;
+	start = BenchClock::now();
+	rebuilt.build(bvhBoxes);
+	double rebuildMs = millisecondsSince(start);
+	double refitFrustumMs = 0, rebuiltFrustumMs = 0;
+	for (size_t q = 0; q < std::min<size_t>(frustums.size(), 200); q++) {
+		start = BenchClock::now();
+		bvh.query(frustums[q], results.data(), ResultCapacity);
+		refitFrustumMs += millisecondsSince(start);
+		start = BenchClock::now();
+		rebuilt.query(frustums[q], results.data(), ResultCapacity);
+		rebuiltFrustumMs += millisecondsSince(start);
+	}
+
+	size_t totalMoves = moves * frames, perKind = (queries / 3) * frames;
+	std::printf("objects: %zu, frames: %d, moves per frame: %zu, queries per frame: %zu\n", count, frames, moves, (queries / 3) * 3);
+	std::printf("build: octree %.1f ms (%zu nodes), BVH %.1f ms\n", octreeBuildMs, octree.nodeCount(), bvhBuildMs);
+	std::printf("%-8s %10s %12s %12s %12s %10s\n", "", "ns/move", "us/sphere", "us/box", "us/frustum", "ms/frame");
+	for (int s = 0; s < 2; s++) {
+		const Timing& t = s == 0 ? octreeTiming : bvhTiming;
+		double frameMs = (t.updateMs + t.queryMs[0] + t.queryMs[1] + t.queryMs[2]) / frames;
+		std::printf("%-8s %10.1f %12.2f %12.2f %12.2f %10.3f\n", s == 0 ? "octree" : "BVH", t.updateMs * 1e6 / totalMoves,
+			t.queryMs[0] * 1e3 / perKind, t.queryMs[1] * 1e3 / perKind, t.queryMs[2] * 1e3 / perKind, frameMs);
+	}
+	std::printf("average hits: %.1f per sphere, %.1f per box, %.1f per frustum\n", static_cast<double>(octreeTiming.hits[0]) / perKind,
+		static_cast<double>(octreeTiming.hits[1]) / perKind, static_cast<double>(octreeTiming.hits[2]) / perKind);
+	std::printf("BVH after %zu refits: frustum queries %.2fx slower than a fresh build, which costs %.1f ms\n", totalMoves,
+		refitFrustumMs / rebuiltFrustumMs, rebuildMs);
+	std::printf("octree heap allocations during updates and queries: %llu\n", static_cast<unsigned long long>(octreeAllocations));
+
+	int exitCode = 0;
+	if (octreeTiming.mismatches || bvhTiming.mismatches || octreeTiming.hits[0] != bvhTiming.hits[0] ||
+		octreeTiming.hits[1] != bvhTiming.hits[1] || octreeTiming.hits[2] != bvhTiming.hits[2]) {
+		std::printf("ERROR::OCTREE_BENCH::MISMATCH: %zu octree and %zu BVH queries differ from a full scan\n", octreeTiming.mismatches, bvhTiming.mismatches);
+		exitCode = 1;
+	}
+	return exitCode;
+}
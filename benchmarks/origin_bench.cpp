@@ -0,0 +1,266 @@
+// Floating origin (FloatingOrigin.h): how precise a scene 10,000 km out is with and
+// without it, and what moving the origin costs a big scene.
+//
+//   origin_bench [objects=1000000] [rebases=20]
+//
+// Precision: a row of small Cubes 1 mm apart, each with a child, is placed 10,000 km from
+// the world's origin. As plain floats their positions round to whole meters. With the
+// floating origin the camera flies out to them from the origin, the scene rebasing as it
+// goes, and once there every position is compared against the exact doubles.
+//
+// Cost: the double-to-float kernel on its own, SIMD against scalar, then Scene::rebase()
+// on a scene of objects Cubes, one in ten a child, timed over rebases moves of the origin
+// back and forth. A frame that doesn't rebase only pays for followCamera()'s check.
+//
+// Checks, each failing with exit code 1: after the flight every root and child is within
+// a millimeter of where it should be and every rigid body sits on its object, a snapshot
+// written and read back keeps the origin and positions, the SIMD kernel gives the scalar
+// one's results bit for bit, moving the big scene's origin there and back leaves every
+// position as it was, and a camera that stays put never rebases.
+
+#include "HeadlessGL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../FloatingOrigin.h"
+#include "../Scene.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	double uniform(double lo, double hi) { return lo + (hi - lo) * static_cast<double>(next() >> 11) / 9007199254740992.0; }
+};
+
+static const glm::dvec3 FarAway(1.0e7, 0.0, 1.0e7); // 10,000 km out along x and z
+static const int RowLength = 200;
+static const double Spacing = 0.001;                  // a millimeter between neighbours
+static const float CubeSize = 0.0008f;
+static const glm::vec3 ChildOffset(2.0f, 0.0f, 0.0f); // in the parent's scaled frame
+static const float FlightStep = 20000.0f;            // units a frame; every frame rebases
+static const double Tolerance = 0.001;
+
+static glm::dvec3 rowPosition(int k) { return FarAway + glm::dvec3(k * Spacing, 1.0, 0.0); }
+
+// Worst error of the row held in plain floats, and how many distinct positions are left of it
+static void floatOnly(double& worstError, int& distinct) {
+	worstError = 0.0;
+	distinct = 0;
+	glm::vec3 last(-1.0f);
+	for (int k = 0; k < RowLength; k++) {
+		glm::vec3 rounded = glm::vec3(rowPosition(k));
+		worstError = std::max(worstError, glm::length(glm::dvec3(rounded) - rowPosition(k)));
+		if (rounded != last) distinct++;
+		last = rounded;
+	}
+}
+
+static bool checkRow(const Scene& scene, const std::vector<Entity>& roots, const std::vector<Entity>& children, const char* when, double& worstError) {
+	worstError = 0.0;
+	bool ok = true;
+	glm::dvec3 childOffset = glm::dvec3(ChildOffset) * static_cast<double>(CubeSize);
+	for (int k = 0; k < RowLength; k++) {
+		double rootError = glm::length(scene.absolutePosition(roots[k]) - rowPosition(k));
+		double childError = glm::length(scene.absolutePosition(children[k]) - (rowPosition(k) + childOffset));
+		worstError = std::max(worstError, std::max(rootError, childError));
+		if (rootError > Tolerance || childError > Tolerance) {
+			std::printf("ERROR::ORIGIN_BENCH::DRIFT: %s, object %d is %.6f m off, its child %.6f m\n", when, k, rootError, childError);
+			ok = false;
+			break;
+		}
+		// the float position the renderer sees, relative to the origin
+		glm::vec3 relative = scene.worldPosition(roots[k]);
+		if (glm::length(glm::dvec3(relative) - (rowPosition(k) - scene.getOrigin())) > Tolerance) {
+			std::printf("ERROR::ORIGIN_BENCH::DRIFT: %s, object %d is drawn off its position\n", when, k);
+			ok = false;
+			break;
+		}
+		const RigidBody* body = scene.getRigidBody(roots[k]);
+		if (!body || body->position != scene.getTransform(roots[k])->position) {
+			std::printf("ERROR::ORIGIN_BENCH::BODY_MISMATCH: %s, object %d's rigid body isn't on it\n", when, k);
+			ok = false;
+			break;
+		}
+	}
+	return ok;
+}
+
+static bool precision() {
+	double floatError = 0.0;
+	int distinct = 0;
+	floatOnly(floatError, distinct);
+	std::printf("10,000 km out, %d objects %.0f mm apart\n", RowLength, Spacing * 1000.0);
+	std::printf("  plain floats:    worst error %9.6f m, %3d distinct positions\n", floatError, distinct);
+
+	// placed while the origin is still at home, so the float positions start out rounded
+	Scene scene;
+	std::vector<Entity> roots(RowLength), children(RowLength);
+	for (int k = 0; k < RowLength; k++) {
+		roots[k] = scene.createCube(glm::vec3(0.0f), glm::vec3(CubeSize));
+		scene.setAbsolutePosition(roots[k], rowPosition(k));
+		scene.addRigidBody(roots[k], 1.0f);
+		children[k] = scene.createCube(ChildOffset, glm::vec3(1.0f), glm::vec3(0.0f), roots[k]);
+	}
+	scene.updateTransforms();
+
+	glm::vec3 camera(0.0f);
+	int rebases = 0, frames = 0;
+	for (;;) {
+		glm::dvec3 toGo = rowPosition(RowLength / 2) - (scene.getOrigin() + glm::dvec3(camera));
+		double distance = glm::length(toGo);
+		if (distance < 1.0) break;
+		camera += glm::vec3(toGo * (std::min(distance, static_cast<double>(FlightStep)) / distance));
+		if (scene.followCamera(camera)) rebases++;
+		scene.updateTransforms();
+		frames++;
+	}
+	double worstError = 0.0;
+	bool ok = checkRow(scene, roots, children, "after the flight", worstError);
+	glm::vec3 first = scene.worldPosition(roots[0]), second = scene.worldPosition(roots[1]);
+	std::printf("  floating origin: worst error %9.6f m, neighbours %.4f mm apart, after %d frames and %d rebases\n",
+		worstError, glm::length(second - first) * 1000.0f, frames, rebases);
+
+	// a snapshot keeps its origin, through the binary format and back into a fresh scene
+	std::vector<char> bytes = scenefile::serialize(scene.snapshot());
+	SceneSnapshot readBack;
+	Scene loaded;
+	if (!scenefile::deserialize(bytes.data(), bytes.size(), readBack) || readBack.origin != scene.getOrigin()) {
+		std::printf("ERROR::ORIGIN_BENCH::SNAPSHOT: the origin didn't survive the scene file\n");
+		return false;
+	}
+	loaded.loadSnapshot(readBack);
+	loaded.updateTransforms();
+	std::vector<Entity> loadedRoots, loadedChildren;
+	const SceneGraph& graph = loaded.getGraph();
+	for (uint32_t i = 0; i < graph.size(); i++) {
+		if (graph.parentAt(i) == SceneGraph::NoParent) loadedRoots.push_back(graph.entityAt(i));
+		else loadedChildren.push_back(graph.entityAt(i));
+	}
+	// rigid bodies aren't saved, so they go back on for the check
+	for (Entity root : loadedRoots) loaded.addRigidBody(root, 1.0f);
+	if (loadedRoots.size() != roots.size() || !checkRow(loaded, loadedRoots, loadedChildren, "after reloading", worstError)) {
+		if (loadedRoots.size() != roots.size()) std::printf("ERROR::ORIGIN_BENCH::SNAPSHOT: %zu objects came back\n", loadedRoots.size());
+		return false;
+	}
+	return ok;
+}
+
+static bool kernel(size_t count) {
+	SplitMix64 rng(11);
+	std::vector<glm::dvec3> absolute(count);
+	for (glm::dvec3& p : absolute) p = glm::dvec3(rng.uniform(-1e7, 1e7), rng.uniform(-1e4, 1e4), rng.uniform(-1e7, 1e7));
+	glm::dvec3 origin(rng.uniform(-1e7, 1e7), 0.0, rng.uniform(-1e7, 1e7));
+	std::vector<glm::vec3> simd(count), scalar(count);
+	double simdMs = 1e30, scalarMs = 1e30;
+	for (int run = 0; run < 5; run++) {
+		BenchClock::time_point start = BenchClock::now();
+		floatingorigin::toRelative(absolute.data(), count, origin, simd.data());
+		simdMs = std::min(simdMs, millisecondsSince(start));
+		start = BenchClock::now();
+		floatingorigin::toRelativeScalar(absolute.data(), count, origin, scalar.data());
+		scalarMs = std::min(scalarMs, millisecondsSince(start));
+	}
+#if defined(ENGINE_ORIGIN_AVX)
+	const char* path = "AVX";
+#elif defined(ENGINE_ORIGIN_SSE)
+	const char* path = "SSE2";
+#else
+	const char* path = "scalar";
+#endif
+	std::printf("\nconversion kernel, %zu positions: %s %.3f ms (%.0f M/s), scalar %.3f ms (%.0f M/s)\n",
+		count, path, simdMs, count / simdMs / 1e3, scalarMs, count / scalarMs / 1e3);
+	if (std::memcmp(simd.data(), scalar.data(), count * sizeof(glm::vec3)) != 0) {
+		std::printf("ERROR::ORIGIN_BENCH::KERNEL_MISMATCH: the %s kernel differs from the scalar one\n", path);
+		return false;
+	}
+	return true;
+}
+
+static bool rebaseCost(size_t objects, int rebases) {
+	SplitMix64 rng(7);
+	double extent = std::sqrt(static_cast<double>(objects));
+	SceneSnapshot world;
+	world.resize(objects);
+	world.typeNames.push_back("Cube");
+	int32_t lastRoot = -1;
+	for (size_t i = 0; i < objects; i++) {
+		world.ids[i] = static_cast<int32_t>(i + 1);
+		world.sizes[i] = glm::vec3(static_cast<float>(rng.uniform(0.3, 0.9)));
+		world.rotations[i] = glm::vec3(static_cast<float>(rng.uniform(0.0, 90.0)), 0.0f, 0.0f);
+		if (lastRoot >= 0 && rng.next() % 10 == 0) {
+			world.parents[i] = lastRoot;
+			world.positions[i] = glm::vec3(1.5f, 0.0f, 0.0f);
+		} else {
+			world.positions[i] = glm::vec3(glm::dvec3(rng.uniform(-extent, extent), rng.uniform(0.0, 8.0), rng.uniform(-extent, extent)) * 0.5);
+			lastRoot = static_cast<int32_t>(i);
+		}
+	}
+	Scene scene;
+	scene.loadSnapshot(world);
+	std::vector<glm::vec3> positions = std::move(world.positions);
+	world = SceneSnapshot();
+	scene.updateTransforms();
+
+	std::vector<double> times(rebases);
+	for (int r = 0; r < rebases; r++) {
+		glm::dvec3 shift(r % 2 == 0 ? 4096.0 : -4096.0, 0.0, r % 2 == 0 ? 2048.0 : -2048.0);
+		BenchClock::time_point start = BenchClock::now();
+		scene.rebase(scene.getOrigin() + shift);
+		times[r] = millisecondsSince(start);
+	}
+	std::sort(times.begin(), times.end());
+	std::printf("\nrebase, %zu objects: median %.2f ms, worst %.2f ms over %d rebases\n",
+		static_cast<size_t>(scene.getGraph().size()), times[rebases / 2], times.back(), rebases);
+	bool ok = true;
+	if (rebases % 2 == 0) {
+		// back at the start, so every position has to come out as it went in
+		SceneSnapshot after = scene.snapshot();
+		if (after.origin != glm::dvec3(0.0) || after.positions != positions) {
+			std::printf("ERROR::ORIGIN_BENCH::DRIFT: positions changed over rebases there and back\n");
+			ok = false;
+		}
+	}
+
+	glm::vec3 camera(10.0f);
+	BenchClock::time_point start = BenchClock::now();
+	int moved = 0;
+	for (int frame = 0; frame < 100000; frame++) moved += scene.followCamera(camera);
+	std::printf("a frame without one: %.2f ns\n", millisecondsSince(start) * 1e6 / 100000.0);
+	if (moved) {
+		std::printf("ERROR::ORIGIN_BENCH::SPURIOUS_REBASE: the camera never left the origin\n");
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	size_t objects = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	int rebases = argc > 2 ? std::atoi(argv[2]) : 20;
+	if (objects < 1000 || rebases < 1) {
+		std::printf("usage: origin_bench [objects>=1000] [rebases>=1]\n");
+		return 2;
+	}
+
+	// cubes share one mesh made on first use, which needs a context
+	HeadlessGL gl;
+	if (!gl.create(64, 64, true)) return 1;
+
+	int exitCode = 0;
+	if (!precision()) exitCode = 1;
+	if (!kernel(objects)) exitCode = 1;
+	if (!rebaseCost(objects, rebases)) exitCode = 1;
+	return exitCode;
+}
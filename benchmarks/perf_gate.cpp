@@ -0,0 +1,243 @@
+// Performance regression gate: compares an engine_bench result against a stored baseline
+// and fails when a scenario got measurably slower.
+//
+//   perf_gate <baseline.json> <current.json> [--threshold 0.10] [--min-ms 0.05] [--no-normalize]
+//
+// Every scenario (scene, object count, frame size, picking) in the baseline is matched in
+// the current run. Frame time and each profiler zone (culling, transform, submission,
+// picking, GPU passes) is compared on its mean. A metric regresses only when it is slower
+// by more than the relative threshold and min-ms, and the 95% confidence intervals of the
+// two runs don't overlap, so run engine_bench with --repeat 3 or more for both files.
+// Current timings are first scaled by the ratio of the two runs' calibration_ms, a fixed
+// CPU workload, so a slower or busier machine doesn't read as a regression.
+//
+// Exit code 0 when nothing regressed, 1 on a regression or a missing scenario, 2 when the
+// inputs can't be read. To accept new numbers, replace the baseline with the current file.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../SceneText.h"
+
+// Flattens a JSON document into dotted paths: runs.0.frame_ms.mean -> 12.5
+class JsonFlattener {
+public:
+	std::map<std::string, double> numbers;
+	std::map<std::string, std::string> strings;
+
+	bool onStartObject() { open(false); return true; }
+	bool onEndObject() { scopes.pop_back(); return true; }
+	bool onStartArray() { open(true); return true; }
+	bool onEndArray() { scopes.pop_back(); return true; }
+	bool onKey(const char* text, size_t length) { key.assign(text, length); return true; }
+	bool onString(const char* text, size_t length) { strings[valuePath()].assign(text, length); return true; }
+	bool onNumber(double value) { numbers[valuePath()] = value; return true; }
+	bool onBool(bool value) { numbers[valuePath()] = value ? 1.0 : 0.0; return true; }
+	bool onNull() { valuePath(); return true; }
+
+private:
+	struct Scope {
+		std::string path;
+		bool array;
+		int next;
+	};
+	std::vector<Scope> scopes;
+	std::string key;
+
+	std::string valuePath() {
+		if (scopes.empty()) return "";
+		Scope& scope = scopes.back();
+		std::string name = scope.array ? std::to_string(scope.next++) : key;
+		return scope.path.empty() ? name : scope.path + "." + name;
+	}
+
+	void open(bool array) {
+		std::string path = valuePath();
+		scopes.push_back(Scope{ path, array, 0 });
+	}
+};
+
+struct Metric {
+	double mean = 0;
+	double ci95 = 0;
+};
+
+struct Scenario {
+	std::string name;
+	double calibrationMs = 0;
+	std::map<std::string, Metric> metrics; // "frame" first in the table, then zones
+};
+
+struct BenchResult {
+	std::string renderer;
+	std::vector<Scenario> scenarios;
+
+	const Scenario* find(const std::string& name) const {
+		for (const Scenario& scenario : scenarios) {
+			if (scenario.name == name) return &scenario;
+		}
+		return nullptr;
+	}
+};
+
+static bool startsWith(const std::string& text, const std::string& prefix) {
+	return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool loadResult(const char* path, BenchResult& result) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::printf("ERROR::PERF_GATE::CANNOT_OPEN: %s\n", path);
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	std::string text = buffer.str();
+
+	JsonFlattener json;
+	scenetext::SaxParser<JsonFlattener> parser(text.data(), text.size(), json);
+	if (!parser.parse()) {
+		std::printf("ERROR::PERF_GATE::PARSE: %s at byte %zu\n", path, parser.errorOffset());
+		return false;
+	}
+
+	result.renderer = json.strings["renderer"];
+	for (int i = 0;; i++) {
+		std::string prefix = "runs." + std::to_string(i) + ".";
+		auto scene = json.strings.find(prefix + "scene");
+		if (scene == json.strings.end()) break;
+
+		char name[128];
+		std::snprintf(name, sizeof(name), "%s/%.0f %.0fx%.0f%s", scene->second.c_str(), json.numbers[prefix + "objects"],
+			json.numbers[prefix + "width"], json.numbers[prefix + "height"], json.numbers[prefix + "picking"] != 0 ? "" : " no-pick");
+		Scenario scenario;
+		scenario.name = name;
+		scenario.calibrationMs = json.numbers[prefix + "calibration_ms"];
+
+		std::string zonePrefix = prefix + "zones_ms.";
+		for (const auto& entry : json.numbers) {
+			const std::string& key = entry.first;
+			if (!endsWith(key, ".mean")) continue;
+			std::string metric;
+			if (key == prefix + "frame_ms.mean") metric = "frame";
+			else if (startsWith(key, zonePrefix)) metric = key.substr(zonePrefix.size(), key.size() - zonePrefix.size() - 5);
+			else continue;
+			std::string base = key.substr(0, key.size() - 5);
+			scenario.metrics[metric] = Metric{ entry.second, json.numbers[base + ".ci95"] };
+		}
+		if (scenario.metrics.find("frame") == scenario.metrics.end()) {
+			std::printf("ERROR::PERF_GATE::NO_FRAME_TIME: %s run %d\n", path, i);
+			return false;
+		}
+		result.scenarios.push_back(scenario);
+	}
+	if (result.scenarios.empty()) {
+		std::printf("ERROR::PERF_GATE::NO_RUNS: %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+struct GateConfig {
+	const char* baseline = nullptr;
+	const char* current = nullptr;
+	double threshold = 0.10;
+	double minMs = 0.05;
+	bool normalize = true;
+};
+
+static bool parseArgs(int argc, char** argv, GateConfig& config) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--threshold" && hasValue) config.threshold = std::atof(argv[++i]);
+		else if (arg == "--min-ms" && hasValue) config.minMs = std::atof(argv[++i]);
+		else if (arg == "--no-normalize") config.normalize = false;
+		else if (!config.baseline) config.baseline = argv[i];
+		else if (!config.current) config.current = argv[i];
+		else {
+			std::printf("unknown argument %s\n", arg.c_str());
+			return false;
+		}
+	}
+	if (!config.current) {
+		std::printf("usage: perf_gate <baseline.json> <current.json> [--threshold 0.10] [--min-ms 0.05] [--no-normalize]\n");
+		return false;
+	}
+	return true;
+}
+
+static const char* judge(const Metric& base, const Metric& current, const GateConfig& config) {
+	double delta = current.mean - base.mean;
+	double relative = base.mean > 0 ? delta / base.mean : 0;
+	if (std::fabs(delta) <= config.minMs || std::fabs(relative) <= config.threshold) return "ok";
+	bool separated = delta > 0 ? current.mean - current.ci95 > base.mean + base.ci95
+		: current.mean + current.ci95 < base.mean - base.ci95;
+	if (!separated) return "noise";
+	return delta > 0 ? "REGRESSED" : "faster";
+}
+
+static void printRow(const std::string& scenario, const std::string& metric, const Metric& base, const Metric& current, const char* status) {
+	double relative = base.mean > 0 ? (current.mean - base.mean) / base.mean * 100.0 : 0;
+	std::printf("%-22s %-32s %10.3f +-%-7.3f %10.3f +-%-7.3f %+8.1f%%  %s\n", scenario.c_str(), metric.c_str(),
+		base.mean, base.ci95, current.mean, current.ci95, relative, status);
+}
+
+int main(int argc, char** argv) {
+	GateConfig config;
+	if (!parseArgs(argc, argv, config)) return 2;
+
+	BenchResult baseline, current;
+	if (!loadResult(config.baseline, baseline) || !loadResult(config.current, current)) return 2;
+	if (baseline.renderer != current.renderer) {
+		std::printf("warning: baseline renderer \"%s\" differs from \"%s\", deltas include the hardware change\n",
+			baseline.renderer.c_str(), current.renderer.c_str());
+	}
+
+	std::printf("%-22s %-32s %19s %19s %9s  %s\n", "scenario", "metric (ms)", "baseline", "current", "delta", "status");
+	int regressions = 0, missing = 0;
+	for (const Scenario& base : baseline.scenarios) {
+		const Scenario* now = current.find(base.name);
+		if (!now) {
+			std::printf("%-22s %-32s %19s %19s %9s  MISSING\n", base.name.c_str(), "frame", "", "", "");
+			missing++;
+			continue;
+		}
+
+		double scale = 1.0;
+		if (config.normalize && base.calibrationMs > 0 && now->calibrationMs > 0) scale = base.calibrationMs / now->calibrationMs;
+		if (scale != 1.0) std::printf("%-22s machine speed x%.3f against the baseline, current timings scaled by it\n", base.name.c_str(), 1.0 / scale);
+
+		// frame time first, then the zones that explain it
+		std::vector<std::string> order = { "frame" };
+		for (const auto& entry : base.metrics) {
+			if (entry.first != "frame") order.push_back(entry.first);
+		}
+		for (const std::string& metric : order) {
+			const Metric& before = base.metrics.at(metric);
+			auto after = now->metrics.find(metric);
+			if (after == now->metrics.end()) {
+				std::printf("%-22s %-32s %10.3f +-%-7.3f %19s %9s  gone\n", base.name.c_str(), metric.c_str(), before.mean, before.ci95, "", "");
+				continue;
+			}
+			Metric scaled{ after->second.mean * scale, after->second.ci95 * scale };
+			const char* status = judge(before, scaled, config);
+			if (status[0] == 'R') regressions++;
+			printRow(base.name, metric, before, scaled, status);
+		}
+	}
+
+	std::printf("\n%d regression%s, %d missing scenario%s (threshold %.0f%%, min %.3f ms)\n", regressions, regressions == 1 ? "" : "s",
+		missing, missing == 1 ? "" : "s", config.threshold * 100.0, config.minMs);
+	return regressions || missing ? 1 : 0;
+}
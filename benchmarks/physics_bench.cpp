@@ -0,0 +1,218 @@
+// Rigid-body step time for stacks and piles of boxes on a static ground (Physics.h).
+// Three quarters of the grid cells hold a stack of ten unit boxes, slightly offset and
+// turned; the rest get ten boxes dropped tumbling in three layers from up to 5 units, which
+// fall into a heap. The simulation runs for a fixed number of steps at each box count and reports the
+// step time while everything is moving, once it has settled, and how much of it is asleep.
+//
+//   physics_bench [counts=10000,50000,100000] [steps=300]
+//
+// Checks, each failing with exit code 1: no box sinks through the ground, no box reaches
+// an unphysical speed, the stacks stay standing, and most boxes are asleep by the end.
+// Then, on two small stacks: forEachMoved() reports a box that fell asleep in the first of
+// an update()'s steps, and removing a box wakes its own stack but not the other.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "BenchClock.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+#include "../Physics.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+};
+
+static const int StackHeight = 10;
+static const float CellSpacing = 4.0f;
+static const glm::vec3 HalfBox(0.5f);
+
+static glm::quat turnedAboutY(float radians) {
+	return glm::quat(std::cos(radians * 0.5f), 0.0f, std::sin(radians * 0.5f), 0.0f);
+}
+
+struct Stack {
+	BodyHandle top;
+	glm::vec3 start;
+};
+
+struct Result {
+	size_t boxes = 0;
+	size_t islands = 0;
+	double firstMs = 0, activeMs = 0, activeMaxMs = 0, settledMs = 0;
+	double awakeAtEnd = 0;
+	size_t sunk = 0, tooFast = 0, toppled = 0;
+};
+
+static Result run(size_t count, int steps) {
+	Result result;
+	PhysicsWorld physics;
+	SplitMix64 rng(45);
+	size_t cells = (count + StackHeight - 1) / StackHeight;
+	int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(cells))));
+	float extent = side * CellSpacing * 0.5f;
+	// reaching well past the grid, so a box thrown clear of a pile still lands on it
+	physics.createBody(Entity(), glm::vec3(0.0f, -0.5f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(extent + 10.0f, 0.5f, extent + 10.0f), 0.0f);
+
+	std::vector<Stack> stacks;
+	std::vector<BodyHandle> handles;
+	handles.reserve(count);
+	for (size_t cell = 0; cell < cells && handles.size() < count; cell++) {
+		glm::vec3 base(-extent + (cell % side + 0.5f) * CellSpacing, 0.0f, -extent + (cell / side + 0.5f) * CellSpacing);
+		bool pile = cell % 4 == 3;
+		for (int level = 0; level < StackHeight && handles.size() < count; level++) {
+			BodyHandle handle;
+			if (pile) {
+				glm::vec3 position = base + glm::vec3((level % 2 - 0.5f) * 1.8f + rng.uniform(-0.2f, 0.2f), 1.5f + 1.8f * (level / 4), ((level / 2) % 2 - 0.5f) * 1.8f + rng.uniform(-0.2f, 0.2f));
+				glm::quat orientation = glm::normalize(glm::quat(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1)));
+				handle = physics.createBody(Entity(), position, orientation, HalfBox, 1.0f);
+			}
+			else {
+				glm::vec3 position = base + glm::vec3(rng.uniform(-0.05f, 0.05f), 0.5f + level, rng.uniform(-0.05f, 0.05f));
+				handle = physics.createBody(Entity(), position, turnedAboutY(rng.uniform(-0.1f, 0.1f)), HalfBox, 1.0f);
+				if (level == StackHeight - 1) stacks.push_back(Stack{ handle, position });
+			}
+			handles.push_back(handle);
+		}
+	}
+	result.boxes = handles.size();
+
+	// moving: the first second; settled: the last one
+	const int window = std::min(60, steps);
+	int steady = 0;
+	for (int s = 0; s < steps; s++) {
+		BenchClock::time_point start = BenchClock::now();
+		physics.step();
+		double ms = millisecondsSince(start);
+		if (s == 0) {
+			result.firstMs = ms;
+			result.islands = physics.stats().islands;
+		}
+		if (s < window) {
+			result.activeMs += ms / window;
+			result.activeMaxMs = std::max(result.activeMaxMs, ms);
+		}
+		if (s >= steps - window) {
+			result.settledMs += ms / window;
+			steady++;
+		}
+		for (size_t i = s % 16; i < handles.size(); i += 16) {
+			const RigidBody* body = physics.getBody(handles[i]);
+			if (glm::length(body->linearVelocity) > 30.0f) result.tooFast++;
+		}
+	}
+	result.awakeAtEnd = static_cast<double>(physics.stats().awake) / result.boxes;
+	for (BodyHandle handle : handles) {
+		// a resting unit box's center stays half a unit up, less a little penetration
+		if (physics.getBody(handle)->position.y < 0.4f) result.sunk++;
+	}
+	for (const Stack& stack : stacks) {
+		// a stack may lean and creep a little, but its top box must not come down
+		if (physics.getBody(stack.top)->position.y < stack.start.y - 0.5f) result.toppled++;
+	}
+	return result;
+}
+
+// Two stacks of three boxes, far apart on a static ground
+static void buildTwoStacks(PhysicsWorld& physics, BodyHandle (&stacks)[2][3]) {
+	physics.createBody(Entity(), glm::vec3(0.0f, -0.5f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(20.0f, 0.5f, 20.0f), 0.0f);
+	for (int s = 0; s < 2; s++) {
+		for (int level = 0; level < 3; level++) {
+			stacks[s][level] = physics.createBody(Entity(), glm::vec3(s * 10.0f - 5.0f, 0.5f + level, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), HalfBox, 1.0f);
+		}
+	}
+}
+
+// Returns how many checks failed
+static int islandChecks() {
+	// how many steps the stacks take to fall asleep, counted in a world of their own
+	int stepsToSleep = -1;
+	{
+		PhysicsWorld physics;
+		BodyHandle stacks[2][3];
+		buildTwoStacks(physics, stacks);
+		for (int step = 1; step <= 1200 && stepsToSleep < 0; step++) {
+			physics.step();
+			if (physics.stats().awake == 0) stepsToSleep = step;
+		}
+	}
+	if (stepsToSleep < 0) {
+		std::printf("ERROR::PHYSICS_BENCH::NEVER_SLEEPS: two stacks of three are still awake after 20 s\n");
+		return 1;
+	}
+
+	// the same again, the last of those steps taken as the first of two in one update()
+	int failures = 0;
+	PhysicsWorld physics;
+	BodyHandle stacks[2][3];
+	buildTwoStacks(physics, stacks);
+	for (int step = 1; step < stepsToSleep; step++) physics.step();
+	int steps = physics.update(2.5f * PhysicsWorld::FixedStep);
+	size_t reported = 0;
+	physics.forEachMoved([&](Entity, const glm::vec3&, const glm::quat&) { reported++; });
+	if (steps != 2 || reported == 0) {
+		std::printf("ERROR::PHYSICS_BENCH::MOVED: after an update() of %d steps forEachMoved() reports %zu boxes, missing the ones that fell asleep in its first\n", steps, reported);
+		failures++;
+	}
+
+	// taking the middle box out of one stack wakes the two it touched, and leaves the other
+	// stack asleep
+	physics.destroyBody(stacks[0][1]);
+	bool touchedAwake = physics.getBody(stacks[0][0])->awake && physics.getBody(stacks[0][2])->awake;
+	physics.step();
+	bool otherAsleep = true;
+	for (BodyHandle handle : stacks[1]) otherAsleep = otherAsleep && !physics.getBody(handle)->awake;
+	if (!touchedAwake || !otherAsleep) {
+		std::printf("ERROR::PHYSICS_BENCH::WAKE: removing a box %s the boxes it touched and %s the other stack\n",
+			touchedAwake ? "woke" : "didn't wake", otherAsleep ? "left asleep" : "woke");
+		failures++;
+	}
+	return failures;
+}
+
+int main(int argc, char** argv) {
+	std::vector<size_t> counts = { 10000, 50000, 100000 };
+	if (argc > 1) {
+		counts.clear();
+		for (const char* p = argv[1]; *p;) {
+			char* end;
+			counts.push_back(std::strtoull(p, &end, 10));
+			p = *end == ',' ? end + 1 : end;
+			if (end == p && *p) break;
+		}
+	}
+	int steps = argc > 2 ? std::atoi(argv[2]) : 300;
+	if (steps < 1) steps = 1;
+	MemTagScope memTag(MemTag::Scene);
+
+	std::printf("%u job workers, %d steps of %.4f s, %d iterations\n", JobSystem::get().workerCount(), steps, PhysicsWorld::FixedStep, PhysicsWorld().iterations);
+	std::printf("%8s %8s %10s %12s %12s %12s %9s\n", "boxes", "islands", "ms first", "ms moving", "ms max", "ms settled", "awake");
+	int exitCode = islandChecks() ? 1 : 0;
+	for (size_t count : counts) {
+		Result r = run(std::max<size_t>(count, 1), steps);
+		std::printf("%8zu %8zu %10.2f %12.2f %12.2f %12.2f %8.1f%%\n", r.boxes, r.islands, r.firstMs, r.activeMs, r.activeMaxMs, r.settledMs, 100.0 * r.awakeAtEnd);
+		// the piles need a few seconds to come to rest
+		bool settled = steps < 240 || r.awakeAtEnd <= 0.1;
+		if (r.sunk || r.tooFast || r.toppled || !settled) {
+			std::printf("ERROR::PHYSICS_BENCH::UNSTABLE: %zu boxes: %zu sank through the ground, %zu too fast, %zu stacks toppled, %.1f%% still awake\n",
+				r.boxes, r.sunk, r.tooFast, r.toppled, 100.0 * r.awakeAtEnd);
+			exitCode = 1;
+		}
+	}
+	return exitCode;
+}
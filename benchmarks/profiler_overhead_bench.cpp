@@ -0,0 +1,165 @@
+// Cost of a PROFILE_SCOPE zone: empty loop vs disabled zone vs enabled zone, single thread
+// and with every worker recording at once.
+//
+//   profiler_overhead_bench [zones=10000000]
+//
+// Zones are recorded in batches that fit in a thread's ring and drained with endFrame() in
+// between, the same way the main loop does it; the drain is timed separately.
+//
+// Check, failing with exit code 1: once warmed up, a profiler frame with nested zones,
+// counters and an annotation, handed to a sink, makes no heap allocations. MemoryTracker
+// counts them; one allocation planted in a frame has to be seen first, and with tracking
+// compiled out (ENGINE_DISABLE_MEMORY_TRACKING) the check is skipped.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../Profiler.h"
+
+static volatile int sink = 0;
+
+static const int Batch = ProfileRing::Capacity / 2;
+
+// Takes what the profiler hands a sink without allocating, so a frame's allocations are
+// the profiler's own
+class CountingSink : public ProfileSink {
+public:
+	uint64_t zones = 0, counters = 0, annotations = 0, frames = 0;
+	void zone(const ProfileEvent&, const char*) override { zones++; }
+	void counter(const char*, uint64_t, double) override { counters++; }
+	void annotation(const char*, const char*, const char*, uint64_t, uint64_t, uint32_t) override { annotations++; }
+	void frame(uint64_t, uint64_t, uint64_t) override { frames++; }
+};
+
+// One frame the way the main loop records it; plant adds a heap allocation to it
+static void recordFrame(Profiler& profiler, bool plant) {
+	profiler.beginFrame();
+	{
+		PROFILE_SCOPE("frame");
+		for (int i = 0; i < 64; i++) {
+			PROFILE_SCOPE("outer");
+			PROFILE_SCOPE("inner");
+			sink = i;
+		}
+		if (plant) delete new volatile int(1);
+		profiler.counter("draw calls", 64.0);
+		profiler.counter("triangles", 768.0);
+		uint64_t now = profilerNowNs();
+		profiler.annotate("asset", "load", "cube.mesh", now, now);
+	}
+	profiler.endFrame();
+}
+
+// Most heap allocations any steady-state frame made, or -1 when the planted one went unseen.
+// sinkFed is whether the sink got every kind of event.
+static long long steadyStateAllocations(bool& sinkFed) {
+	Profiler& profiler = Profiler::get();
+	MemoryTracker& memory = MemoryTracker::get();
+	CountingSink counting;
+	profiler.setSink(&counting);
+	for (int i = 0; i < 32; i++) recordFrame(profiler, false); // zone table and lanes fill in here
+	memory.endFrame();
+	recordFrame(profiler, true);
+	memory.endFrame();
+	long long worst = memory.lastFrameAllocations() > 0 ? 0 : -1;
+	for (int i = 0; worst >= 0 && i < 256; i++) {
+		recordFrame(profiler, false);
+		memory.endFrame();
+		worst = std::max(worst, static_cast<long long>(memory.lastFrameAllocations()));
+	}
+	profiler.setSink(nullptr);
+	sinkFed = counting.frames > 0 && counting.zones > 0 && counting.counters > 0 && counting.annotations > 0;
+	return worst;
+}
+
+// Returns nanoseconds per iteration of the zone loop, excluding endFrame()
+static double runZones(size_t zones, double& drainMs) {
+	Profiler& profiler = Profiler::get();
+	double recordMs = 0.0;
+	drainMs = 0.0;
+	for (size_t done = 0; done < zones; done += Batch) {
+		profiler.beginFrame();
+		BenchClock::time_point start = BenchClock::now();
+		for (int i = 0; i < Batch; i++) {
+			PROFILE_SCOPE("bench zone");
+			sink = i;
+		}
+		recordMs += millisecondsSince(start);
+		start = BenchClock::now();
+		profiler.endFrame();
+		drainMs += millisecondsSince(start);
+	}
+	return recordMs * 1e6 / zones;
+}
+
+int main(int argc, char** argv) {
+	size_t zones = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	Profiler& profiler = Profiler::get();
+
+	bool sinkFed = false;
+	long long frameAllocations = steadyStateAllocations(sinkFed);
+	if (!sinkFed) {
+		std::printf("ERROR::PROFILER_OVERHEAD_BENCH::SINK_NOT_FED: the sink didn't get zones, counters, annotations and frames\n");
+		return 1;
+	}
+	if (frameAllocations < 0) std::printf("heap allocations aren't tracked in this build, allocation check skipped\n");
+	if (frameAllocations > 0) {
+		std::printf("ERROR::PROFILER_OVERHEAD_BENCH::FRAME_ALLOCATIONS: up to %lld heap allocations in a steady-state profiler frame\n", frameAllocations);
+		return 1;
+	}
+
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t i = 0; i < zones; i++) sink = static_cast<int>(i);
+	double emptyNs = millisecondsSince(start) * 1e6 / zones;
+
+	profiler.enabled = false;
+	double drainMs;
+	double disabledNs = runZones(zones, drainMs);
+
+	profiler.enabled = true;
+	runZones(zones / 10, drainMs); // warm up the ring and zone table
+	double enabledNs = runZones(zones, drainMs);
+	double clockNs;
+	{
+		start = BenchClock::now();
+		uint64_t total = 0;
+		for (size_t i = 0; i < zones; i++) total += profilerNowNs();
+		clockNs = millisecondsSince(start) * 1e6 / zones;
+		sink = static_cast<int>(total);
+	}
+
+	std::printf("zones: %zu\n", zones);
+	std::printf("%-28s %8.2f ns\n", "empty loop", emptyNs);
+	std::printf("%-28s %8.2f ns\n", "clock read", clockNs);
+	std::printf("%-28s %8.2f ns\n", "disabled zone", disabledNs);
+	std::printf("%-28s %8.2f ns\n", "enabled zone", enabledNs);
+	std::printf("%-28s %8.2f ns/zone\n", "endFrame drain", drainMs * 1e6 / zones);
+
+	// every thread records into its own ring; only the collector touches all of them
+	unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	std::vector<double> perThreadNs(threads);
+	size_t perThread = Batch - 1;
+	start = BenchClock::now();
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&perThreadNs, t, perThread] {
+			BenchClock::time_point begin = BenchClock::now();
+			for (size_t i = 0; i < perThread; i++) {
+				PROFILE_SCOPE("worker zone");
+				sink = static_cast<int>(i);
+			}
+			perThreadNs[t] = millisecondsSince(begin) * 1e6 / perThread;
+		});
+	}
+	for (std::thread& w : workers) w.join();
+	profiler.endFrame();
+	double worst = 0.0;
+	for (double ns : perThreadNs) worst = std::max(worst, ns);
+	std::printf("%-28s %8.2f ns (%u threads, worst thread)\n", "enabled zone, contended", worst, threads);
+	return 0;
+}
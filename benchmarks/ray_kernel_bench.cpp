@@ -0,0 +1,365 @@
+// Ray against box kernels from Ray.h: correctness against the scalar reference and against
+// an independent interval computation, then throughput, then picking through the octree.
+//
+//   ray_kernel_bench [boxes=1000000] [rays=64] [picks=2000]
+//
+// Correctness runs every combination of awkward per-axis values (origins on the slab
+// planes, zero and negative-zero directions, NaN, infinities, flat, inverted and unbounded
+// boxes) through rayAABB4, rayAABB8 and rayPacketAABB; each must match rayAABB bit for bit
+// and rayAABB must match the intervals. Random rays are also compared with the old scalar
+// test picking used, which divided per axis. Throughput runs every ray against every box,
+// with the boxes already in packets for the wide kernels. Exit code 1 if anything disagrees.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../Octree.h"
+#include "../Ray.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+	glm::vec3 point(float extent) { return glm::vec3(uniform(-extent, extent), uniform(-extent, extent), uniform(-extent, extent)); }
+};
+
+static const float Inf = std::numeric_limits<float>::infinity();
+static const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+// The slab test Objects.h had before Ray.h: divides per axis and swaps, and reports the
+// exit distance for an origin inside the box
+static bool legacyRayIntersectsAABB(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& boxMin, const glm::vec3& boxMax, float& t) {
+	float tmin = (boxMin.x - rayOrigin.x) / rayDir.x;
+	float tmax = (boxMax.x - rayOrigin.x) / rayDir.x;
+	if (tmin > tmax) std::swap(tmin, tmax);
+	float tymin = (boxMin.y - rayOrigin.y) / rayDir.y;
+	float tymax = (boxMax.y - rayOrigin.y) / rayDir.y;
+	if (tymin > tymax) std::swap(tymin, tymax);
+	if ((tmin > tymax) || (tymin > tmax)) return false;
+	if (tymin > tmin) tmin = tymin;
+	if (tymax < tmax) tmax = tymax;
+	float tzmin = (boxMin.z - rayOrigin.z) / rayDir.z;
+	float tzmax = (boxMax.z - rayOrigin.z) / rayDir.z;
+	if (tzmin > tzmax) std::swap(tzmin, tzmax);
+	if ((tmin > tzmax) || (tzmin > tmax)) return false;
+	if (tzmin > tmin) tmin = tzmin;
+	if (tzmax < tmax) tmax = tzmax;
+	t = tmin;
+	if (t < 0) {
+		t = tmax;
+		if (t < 0) return false;
+	}
+	return true;
+}
+
+// What the contract in Ray.h says should happen, worked out per axis as an interval
+static bool expectedHit(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tNear) {
+	for (int axis = 0; axis < 3; axis++) {
+		if (!std::isfinite(origin[axis]) || !std::isfinite(direction[axis])) return false;
+		if (!(boxMin[axis] <= boxMax[axis])) return false;
+	}
+	if (direction == glm::vec3(0.0f)) return false;
+	float lo = 0.0f, hi = std::numeric_limits<float>::max();
+	for (int axis = 0; axis < 3; axis++) {
+		float o = origin[axis], d = direction[axis];
+		if (d == 0.0f) {
+			if (o < boxMin[axis] || o > boxMax[axis]) return false;
+			continue;
+		}
+		float a = (boxMin[axis] - o) / d, b = (boxMax[axis] - o) / d;
+		if (a > b) std::swap(a, b);
+		if (a > lo) lo = a;
+		if (b < hi) hi = b;
+	}
+	tNear = lo;
+	return lo <= hi;
+}
+
+static int bitCount(int mask) {
+	int count = 0;
+	for (; mask; mask &= mask - 1) count++;
+	return count;
+}
+
+static bool sameBits(float a, float b) { return std::memcmp(&a, &b, sizeof(float)) == 0; }
+
+struct Mismatches {
+	size_t kernels = 0; // SIMD against rayAABB
+	size_t contract = 0; // rayAABB against expectedHit
+	size_t legacy = 0; // rayAABB against the old test, beyond rounding at the edges
+	size_t picking = 0;
+};
+
+// Compares a kernel's mask and distances with rayAABB for each lane
+static void compareLanes(const Ray* rays, const glm::vec3* boxMin, const glm::vec3* boxMax, int lanes, int mask, const float* tNear, Mismatches& m) {
+	for (int i = 0; i < lanes; i++) {
+		float t = 0.0f;
+		bool hit = rayAABB(rays[i], boxMin[i], boxMax[i], t);
+		if (hit != ((mask >> i & 1) != 0) || (hit && !sameBits(t, tNear[i]))) m.kernels++;
+	}
+}
+
+static size_t runLattice(Mismatches& m) {
+	const float origins[] = { -2.0f, -1.0f, -0.5f, 0.0f, 1.0f, 2.0f, NaN, Inf };
+	const float directions[] = { -1.0f, -0.25f, -0.0f, 0.0f, 0.5f, 1.0f, NaN, Inf };
+	const float slabs[][2] = { { -1.0f, 1.0f }, { -1.0f, -1.0f }, { 1.0f, -1.0f }, { NaN, 1.0f }, { -Inf, Inf } };
+	const int O = 8, D = 8, S = 5;
+	std::vector<Ray> rays;
+	std::vector<glm::vec3> rawOrigins, rawDirections;
+	for (int ox = 0; ox < O; ox++) for (int oy = 0; oy < O; oy++) for (int oz = 0; oz < O; oz++)
+		for (int dx = 0; dx < D; dx++) for (int dy = 0; dy < D; dy++) for (int dz = 0; dz < D; dz++) {
+			glm::vec3 origin(origins[ox], origins[oy], origins[oz]), direction(directions[dx], directions[dy], directions[dz]);
+			rays.push_back(Ray(origin, direction));
+			rawOrigins.push_back(origin);
+			rawDirections.push_back(direction);
+		}
+	std::vector<glm::vec3> boxMins, boxMaxs;
+	for (int x = 0; x < S; x++) for (int y = 0; y < S; y++) for (int z = 0; z < S; z++) {
+		boxMins.push_back(glm::vec3(slabs[x][0], slabs[y][0], slabs[z][0]));
+		boxMaxs.push_back(glm::vec3(slabs[x][1], slabs[y][1], slabs[z][1]));
+	}
+	size_t boxCount = boxMins.size(), tests = 0;
+	float t[8];
+
+	for (size_t r = 0; r < rays.size(); r++) {
+		for (size_t b = 0; b < boxCount; b++) {
+			float got = 0.0f, want = 0.0f;
+			bool hit = rayAABB(rays[r], boxMins[b], boxMaxs[b], got);
+			bool expected = expectedHit(rawOrigins[r], rawDirections[r], boxMins[b], boxMaxs[b], want);
+			if (hit != expected || (hit && got != want)) m.contract++;
+		}
+		// every box through the 4- and 8-wide kernels, wrapping round the box list
+		for (size_t b = 0; b < boxCount; b += 8) {
+			AABB4 four[2];
+			AABB8 eight;
+			glm::vec3 laneMin[8], laneMax[8];
+			Ray laneRay[8];
+			for (int i = 0; i < 8; i++) {
+				size_t box = (b + i) % boxCount;
+				laneMin[i] = boxMins[box];
+				laneMax[i] = boxMaxs[box];
+				laneRay[i] = rays[r];
+				four[i / 4].set(i % 4, laneMin[i], laneMax[i]);
+				eight.set(i, laneMin[i], laneMax[i]);
+			}
+			int mask = rayAABB4(rays[r], four[0], t);
+			compareLanes(laneRay, laneMin, laneMax, 4, mask, t, m);
+			mask = rayAABB4(rays[r], four[1], t);
+			compareLanes(laneRay, laneMin + 4, laneMax + 4, 4, mask, t, m);
+			mask = rayAABB8(rays[r], eight, t);
+			compareLanes(laneRay, laneMin, laneMax, 8, mask, t, m);
+			tests += 16;
+		}
+	}
+	// every ray through the packet kernel against each box
+	for (size_t r = 0; r < rays.size(); r += 8) {
+		RayPacket8 packet;
+		Ray laneRay[8];
+		for (int i = 0; i < 8; i++) {
+			laneRay[i] = rays[(r + i) % rays.size()];
+			packet.set(i, laneRay[i]);
+		}
+		for (size_t b = 0; b < boxCount; b++) {
+			glm::vec3 laneMin[8], laneMax[8];
+			for (int i = 0; i < 8; i++) {
+				laneMin[i] = boxMins[b];
+				laneMax[i] = boxMaxs[b];
+			}
+			int mask = rayPacketAABB(packet, boxMins[b], boxMaxs[b], t);
+			compareLanes(laneRay, laneMin, laneMax, 8, mask, t, m);
+			tests += 8;
+		}
+	}
+	return tests + rays.size() * boxCount;
+}
+
+static size_t runRandom(size_t count, Mismatches& m) {
+	SplitMix64 rng(5);
+	float t[8];
+	for (size_t n = 0; n < count; n++) {
+		glm::vec3 origin = rng.point(100.0f), direction = rng.point(1.0f);
+		glm::vec3 center = rng.point(50.0f), half(rng.uniform(0.1f, 10.0f), rng.uniform(0.1f, 10.0f), rng.uniform(0.1f, 10.0f));
+		glm::vec3 boxMin = center - half, boxMax = center + half;
+		Ray ray(origin, direction);
+		float got = 0.0f, old = 0.0f;
+		bool hit = rayAABB(ray, boxMin, boxMax, got);
+
+		// the old test reports the exit for an origin inside, so only outside origins compare
+		bool inside = origin.x >= boxMin.x && origin.y >= boxMin.y && origin.z >= boxMin.z && origin.x <= boxMax.x && origin.y <= boxMax.y && origin.z <= boxMax.z;
+		if (!inside) {
+			bool oldHit = legacyRayIntersectsAABB(origin, direction, boxMin, boxMax, old);
+			bool agree = hit == oldHit && (!hit || std::abs(got - old) <= 1e-4f * std::max(1.0f, old));
+			if (!agree) {
+				// a grazing ray may go either way with different rounding; grow and shrink the box to tell
+				float scratch;
+				glm::vec3 margin(1e-3f);
+				bool grazing = rayAABB(ray, boxMin - margin, boxMax + margin, scratch) && !rayAABB(ray, boxMin + margin, boxMax - margin, scratch);
+				if (!grazing) m.legacy++;
+			}
+		}
+
+		AABB8 eight;
+		Ray laneRay[8];
+		glm::vec3 laneMin[8], laneMax[8];
+		for (int i = 0; i < 8; i++) {
+			laneRay[i] = ray;
+			laneMin[i] = boxMin + glm::vec3(static_cast<float>(i));
+			laneMax[i] = boxMax + glm::vec3(static_cast<float>(i));
+			eight.set(i, laneMin[i], laneMax[i]);
+		}
+		compareLanes(laneRay, laneMin, laneMax, 8, rayAABB8(ray, eight, t), t, m);
+	}
+	return count;
+}
+
+struct Throughput {
+	double ms = 0;
+	uint64_t hits = 0;
+};
+
+int main(int argc, char** argv) {
+	size_t boxCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	size_t rayCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+	size_t picks = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 2000;
+	boxCount = std::max<size_t>(8, boxCount / 8 * 8);
+	rayCount = std::max<size_t>(8, rayCount / 8 * 8);
+	MemTagScope memTag(MemTag::Scene);
+
+#if defined(ENGINE_RAY_AVX)
+	const char* path = "AVX, 8 lanes";
+#elif defined(ENGINE_RAY_SSE)
+	const char* path = "SSE2, 4 lanes";
+#else
+	const char* path = "scalar";
+#endif
+
+	// --- correctness ---
+	Mismatches m;
+	BenchClock::time_point start = BenchClock::now();
+	size_t latticeTests = runLattice(m);
+	size_t randomTests = runRandom(1000000, m);
+	double checkMs = millisecondsSince(start);
+
+	// --- throughput: every ray against every box ---
+	SplitMix64 rng(9);
+	std::vector<glm::vec3> boxMins(boxCount), boxMaxs(boxCount);
+	std::vector<AABB4> packets4(boxCount / 4);
+	std::vector<AABB8> packets8(boxCount / 8);
+	for (size_t i = 0; i < boxCount; i++) {
+		glm::vec3 center = rng.point(500.0f), half(rng.uniform(0.5f, 4.0f), rng.uniform(0.5f, 4.0f), rng.uniform(0.5f, 4.0f));
+		boxMins[i] = center - half;
+		boxMaxs[i] = center + half;
+		packets4[i / 4].set(static_cast<int>(i % 4), boxMins[i], boxMaxs[i]);
+		packets8[i / 8].set(static_cast<int>(i % 8), boxMins[i], boxMaxs[i]);
+	}
+	// rays from the edge of the field through it, so a fair share of boxes is near
+	std::vector<Ray> rays(rayCount);
+	std::vector<glm::vec3> rayOrigins(rayCount), rayDirections(rayCount);
+	for (size_t r = 0; r < rayCount; r++) {
+		rayOrigins[r] = rng.point(600.0f);
+		rayDirections[r] = glm::normalize(rng.point(100.0f) - rayOrigins[r]);
+		rays[r] = Ray(rayOrigins[r], rayDirections[r]);
+	}
+
+	Throughput legacy, scalar, wide4, wide8, packet;
+	float t[8];
+	start = BenchClock::now();
+	for (size_t r = 0; r < rayCount; r++) {
+		for (size_t b = 0; b < boxCount; b++) {
+			float distance;
+			legacy.hits += legacyRayIntersectsAABB(rayOrigins[r], rayDirections[r], boxMins[b], boxMaxs[b], distance);
+		}
+	}
+	legacy.ms = millisecondsSince(start);
+	start = BenchClock::now();
+	for (size_t r = 0; r < rayCount; r++) {
+		for (size_t b = 0; b < boxCount; b++) {
+			float distance;
+			scalar.hits += rayAABB(rays[r], boxMins[b], boxMaxs[b], distance);
+		}
+	}
+	scalar.ms = millisecondsSince(start);
+	start = BenchClock::now();
+	for (size_t r = 0; r < rayCount; r++) {
+		for (const AABB4& boxes : packets4) wide4.hits += bitCount(rayAABB4(rays[r], boxes, t));
+	}
+	wide4.ms = millisecondsSince(start);
+	start = BenchClock::now();
+	for (size_t r = 0; r < rayCount; r++) {
+		for (const AABB8& boxes : packets8) wide8.hits += bitCount(rayAABB8(rays[r], boxes, t));
+	}
+	wide8.ms = millisecondsSince(start);
+	std::vector<RayPacket8> rayPackets(rayCount / 8);
+	for (size_t r = 0; r < rayCount; r++) rayPackets[r / 8].set(static_cast<int>(r % 8), rays[r]);
+	start = BenchClock::now();
+	for (const RayPacket8& bundle : rayPackets) {
+		for (size_t b = 0; b < boxCount; b++) packet.hits += bitCount(rayPacketAABB(bundle, boxMins[b], boxMaxs[b], t));
+	}
+	packet.ms = millisecondsSince(start);
+	bool hitsAgree = scalar.hits == wide4.hits && scalar.hits == wide8.hits && scalar.hits == packet.hits;
+
+	// --- picking: nearest box through the octree against a scan of every box ---
+	size_t pickBoxes = std::min<size_t>(boxCount, 200000);
+	LooseOctree octree(glm::vec3(0.0f), 1024.0f);
+	for (size_t i = 0; i < pickBoxes; i++) octree.insert(Entity(static_cast<uint32_t>(i), 1), boxMins[i], boxMaxs[i]);
+	double octreeMs = 0, scanMs = 0;
+	size_t picked = 0;
+	for (size_t p = 0; p < picks; p++) {
+		glm::vec3 origin = rng.point(600.0f);
+		Ray ray(origin, rng.point(100.0f) - origin);
+		start = BenchClock::now();
+		float octreeDistance = -1.0f;
+		Entity nearest = octree.raycast(ray, octreeDistance);
+		octreeMs += millisecondsSince(start);
+
+		start = BenchClock::now();
+		float scanDistance = Inf;
+		Entity scanNearest;
+		for (size_t i = 0; i < pickBoxes; i++) {
+			float distance;
+			if (rayAABB(ray, boxMins[i], boxMaxs[i], distance) && distance < scanDistance) {
+				scanDistance = distance;
+				scanNearest = Entity(static_cast<uint32_t>(i), 1);
+			}
+		}
+		scanMs += millisecondsSince(start);
+		// on a tie either box is right, so compare the distances
+		if (nearest.valid() != scanNearest.valid() || (nearest.valid() && octreeDistance != scanDistance)) m.picking++;
+		picked += nearest.valid();
+	}
+
+	double tests = static_cast<double>(boxCount) * rayCount;
+	std::printf("kernels compiled for %s\n", path);
+	std::printf("correctness: %zu lattice and %zu random ray/box tests in %.0f ms\n", latticeTests, randomTests, checkMs);
+	std::printf("throughput, %zu rays x %zu boxes (%.1f hits per ray):\n", rayCount, boxCount, static_cast<double>(scalar.hits) / rayCount);
+	const std::pair<const char*, const Throughput*> rows[] = { { "old scalar (divides)", &legacy }, { "rayAABB scalar", &scalar },
+		{ "rayAABB4", &wide4 }, { "rayAABB8", &wide8 }, { "rayPacketAABB 8 rays", &packet } };
+	for (const auto& row : rows) {
+		std::printf("  %-22s %9.1f M tests/s  %6.2fx\n", row.first, tests / (row.second->ms * 1e3), legacy.ms / row.second->ms);
+	}
+	std::printf("picking among %zu boxes: octree %.2f us, scan %.2f us per ray, %zu of %zu rays hit\n", pickBoxes, octreeMs * 1e3 / picks,
+		scanMs * 1e3 / picks, picked, picks);
+
+	int exitCode = 0;
+	if (m.kernels || m.contract || m.legacy || m.picking || !hitsAgree) {
+		std::printf("ERROR::RAY_KERNEL_BENCH::MISMATCH: %zu kernel, %zu contract, %zu old-test, %zu picking mismatches; hit totals %s\n",
+			m.kernels, m.contract, m.legacy, m.picking, hitsAgree ? "agree" : "differ");
+		exitCode = 1;
+	}
+	return exitCode;
+}
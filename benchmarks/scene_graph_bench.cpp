@@ -0,0 +1,233 @@
+// Transform propagation in the scene graph: recomputing only the changed subtrees against
+// a full pass over every node, the cost of dragging a big assembly by its root, and the
+// structural edits (reparent, destroy) that shift the depth-first arrays.
+//
+//   scene_graph_bench [nodes=1000000] [frames=60] [dirtyPercent=1]
+//
+// The graph is a forest of assemblies up to 12 levels deep. Each frame changes the local
+// matrix of dirtyPercent of the nodes at random and times SceneGraph::update. Afterwards
+// every world matrix is checked bit for bit against a full recompute, frames after the
+// warm-up must not touch the heap, and a smaller graph is put through random reparents and
+// destroys with its invariants checked after each. Exit code 1 if any check fails.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchClock.h"
+#include "../FrameArena.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+#include "../SceneGraph.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+};
+
+static const int MaxDepth = 12;
+// two per frame arena buffer: one to outgrow its first chunk, one to merge the chunks
+static const int WarmupFrames = 4;
+
+static glm::mat4 randomLocal(SplitMix64& rng) {
+	glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(rng.uniform(-2.0f, 2.0f), rng.uniform(-2.0f, 2.0f), rng.uniform(-2.0f, 2.0f)));
+	return glm::rotate(local, glm::radians(rng.uniform(0.0f, 360.0f)), glm::vec3(0, 1, 0));
+}
+
+// Builds depth first, so every node is appended at the end of the arrays
+static void build(SceneGraph& graph, size_t count, SplitMix64& rng) {
+	std::vector<SceneNode> path;
+	graph.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		// mostly go deeper or add a sibling, now and then climb; a new assembly every ~20k nodes
+		uint64_t roll = rng.next() % 100;
+		if (roll < 40 && path.size() > 1) path.pop_back();
+		else if (roll < 45 && path.size() > 2) path.resize(path.size() / 2);
+		if (rng.next() % 20000 == 0) path.clear();
+		if (path.size() >= static_cast<size_t>(MaxDepth)) path.pop_back();
+		SceneNode node = graph.create(randomLocal(rng), path.empty() ? SceneNode() : path.back());
+		path.push_back(node);
+	}
+}
+
+// Everything recomputed from the locals, the way a graph without dirty tracking would
+static void fullPass(const SceneGraph& graph, std::vector<glm::mat4>& worlds) {
+	worlds.resize(graph.size());
+	for (uint32_t i = 0; i < graph.size(); i++) {
+		uint32_t p = graph.parentAt(i);
+		worlds[i] = p == SceneGraph::NoParent ? graph.localAt(i) : worlds[p] * graph.localAt(i);
+	}
+}
+
+static size_t countMismatches(const SceneGraph& graph, const std::vector<glm::mat4>& expected) {
+	size_t mismatches = 0;
+	for (uint32_t i = 0; i < graph.size(); i++) {
+		if (std::memcmp(&graph.worldAt(i), &expected[i], sizeof(glm::mat4)) != 0) mismatches++;
+	}
+	return mismatches;
+}
+
+// Parents before children, subtrees contiguous and sized right, handles pointing home
+static bool checkStructure(const SceneGraph& graph) {
+	uint32_t n = graph.size();
+	std::vector<uint32_t> sizes(n, 1);
+	for (uint32_t i = n; i-- > 0;) {
+		uint32_t p = graph.parentAt(i);
+		if (p == SceneGraph::NoParent) continue;
+		if (p >= i || i >= p + graph.subtreeSizeAt(p)) return false;
+		sizes[p] += sizes[i];
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		if (sizes[i] != graph.subtreeSizeAt(i) || graph.indexOf(graph.nodeAt(i)) != i) return false;
+	}
+	return true;
+}
+
+static double percentile(std::vector<double> values, double p) {
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 60;
+	double dirtyPercent = argc > 3 ? std::atof(argv[3]) : 1.0;
+	if (count < 2) count = 2;
+	if (frames < WarmupFrames + 1) frames = WarmupFrames + 1;
+	MemTagScope memTag(MemTag::Scene);
+	JobSystem& jobs = JobSystem::get();
+	FrameArena& frameArena = FrameArena::get();
+	MemoryTracker& memory = MemoryTracker::get();
+
+	SceneGraph graph;
+	SplitMix64 rng(3);
+	BenchClock::time_point start = BenchClock::now();
+	build(graph, count, rng);
+	double buildMs = millisecondsSince(start);
+	graph.update(jobs);
+	frameArena.endFrame();
+
+	// --- 1% dirty per frame ---
+	size_t dirtyPerFrame = std::max<size_t>(1, static_cast<size_t>(count * dirtyPercent / 100.0));
+	std::vector<double> updateMs, dragMs;
+	updateMs.reserve(frames);
+	dragMs.reserve(frames);
+	size_t recomputed = 0;
+	uint64_t steadyAllocations = 0;
+	memory.endFrame();
+	for (int frame = 0; frame < frames; frame++) {
+		for (size_t d = 0; d < dirtyPerFrame; d++) graph.setLocal(graph.nodeAt(static_cast<uint32_t>(rng.next() % count)), randomLocal(rng));
+		start = BenchClock::now();
+		graph.update(jobs);
+		updateMs.push_back(millisecondsSince(start));
+		recomputed += graph.lastUpdateCount();
+		frameArena.endFrame();
+		memory.endFrame();
+		if (frame >= WarmupFrames) steadyAllocations += memory.lastFrameAllocations();
+	}
+
+	std::vector<glm::mat4> reference;
+	std::vector<double> fullMs;
+	for (int frame = 0; frame < std::min(frames, 10); frame++) {
+		start = BenchClock::now();
+		fullPass(graph, reference);
+		fullMs.push_back(millisecondsSince(start));
+	}
+	size_t mismatches = countMismatches(graph, reference);
+
+	// --- gizmo drag: the root with the biggest assembly moves every frame ---
+	uint32_t biggest = 0;
+	for (uint32_t i = 0; i < graph.size(); i += graph.subtreeSizeAt(i)) {
+		if (graph.subtreeSizeAt(i) > graph.subtreeSizeAt(biggest)) biggest = i;
+	}
+	SceneNode root = graph.nodeAt(biggest);
+	for (int frame = 0; frame < frames; frame++) {
+		glm::mat4 moved = glm::translate(graph.localAt(biggest), glm::vec3(0.01f, 0.0f, 0.0f));
+		graph.setLocal(root, moved);
+		start = BenchClock::now();
+		graph.update(jobs);
+		dragMs.push_back(millisecondsSince(start));
+		frameArena.endFrame();
+	}
+	fullPass(graph, reference);
+	mismatches += countMismatches(graph, reference);
+
+	// --- structural edits on a smaller graph ---
+	SceneGraph edits;
+	size_t editNodes = std::min<size_t>(count, 20000);
+	build(edits, editNodes, rng);
+	edits.update(jobs);
+	bool structureOk = checkStructure(edits);
+	// a node can't go under its own child
+	if (edits.subtreeSizeAt(0) > 1 && edits.setParent(edits.nodeAt(0), edits.nodeAt(1))) structureOk = false;
+	int reparents = 0, destroys = 0, rejected = 0;
+	double reparentMs = 0;
+	for (int op = 0; op < 200 && edits.size() > 1 && structureOk; op++) {
+		SceneNode node = edits.nodeAt(static_cast<uint32_t>(rng.next() % edits.size()));
+		if (op % 4 == 3) {
+			edits.destroy(node);
+			destroys++;
+		}
+		else {
+			SceneNode parent = rng.next() % 8 == 0 ? SceneNode() : edits.nodeAt(static_cast<uint32_t>(rng.next() % edits.size()));
+			start = BenchClock::now();
+			bool ok = edits.setParent(node, parent);
+			reparentMs += millisecondsSince(start);
+			reparents += ok;
+			rejected += !ok;
+		}
+		structureOk = checkStructure(edits);
+		frameArena.endFrame();
+	}
+	edits.update(jobs);
+	fullPass(edits, reference);
+	size_t editMismatches = countMismatches(edits, reference);
+	frameArena.endFrame();
+
+	double meanUpdate = 0;
+	for (double ms : updateMs) meanUpdate += ms / updateMs.size();
+	double meanFull = 0;
+	for (double ms : fullMs) meanFull += ms / fullMs.size();
+	double meanDrag = 0;
+	for (double ms : dragMs) meanDrag += ms / dragMs.size();
+	std::printf("nodes: %zu in %.1f ms, %zu dirty per frame (%.2f%%), %d frames, job system workers: %u\n", count, buildMs, dirtyPerFrame,
+		dirtyPercent, frames, jobs.workerCount());
+	std::printf("%-28s %8.3f ms mean %8.3f ms p95  %9zu nodes recomputed per frame\n", "dirty subtrees", meanUpdate,
+		percentile(updateMs, 0.95), recomputed / frames);
+	std::printf("%-28s %8.3f ms mean %8.3f ms p95  %9u nodes\n", "full pass", meanFull, percentile(fullMs, 0.95), graph.size());
+	std::printf("%-28s %8.3f ms mean %8.3f ms p95  %9u nodes under the root\n", "gizmo drag of an assembly", meanDrag,
+		percentile(dragMs, 0.95), graph.subtreeSizeAt(biggest));
+	std::printf("structural edits on %zu nodes: %d reparents (%.3f ms each), %d rejected as cycles, %d subtree destroys, %u nodes left\n",
+		editNodes, reparents, reparents ? reparentMs / reparents : 0.0, rejected, destroys, edits.size());
+	std::printf("heap allocations in %d steady-state frames: %llu\n", frames - WarmupFrames, static_cast<unsigned long long>(steadyAllocations));
+
+	int exitCode = 0;
+	if (mismatches || editMismatches) {
+		std::printf("ERROR::SCENE_GRAPH_BENCH::WORLD_MISMATCH: %zu + %zu world matrices differ from a full recompute\n", mismatches, editMismatches);
+		exitCode = 1;
+	}
+	if (!structureOk) {
+		std::printf("ERROR::SCENE_GRAPH_BENCH::BROKEN_STRUCTURE: depth-first order lost after reparent or destroy\n");
+		exitCode = 1;
+	}
+	if (steadyAllocations != 0) {
+		std::printf("ERROR::SCENE_GRAPH_BENCH::STEADY_STATE_ALLOCATIONS\n");
+		exitCode = 1;
+	}
+	graph.clear();
+	edits.clear();
+	frameArena.releaseAll();
+	return exitCode;
+}
@@ -0,0 +1,136 @@
+// Binary scene load time versus the raw read bandwidth of the same file.
+//
+//   scene_load_bench [objects=1000000] [workDir=.]
+//
+// "read" is a plain sequential read of the file into memory, i.e. what the disk can do.
+// "load" maps the file and bulk-copies the arrays into a SceneSnapshot; it should track
+// "read" closely. "scene" is Scene::load(), what the editor runs: the snapshot plus an
+// entity, a scene graph node, an octree cell and a broadphase box for every object. That
+// is bounded by building those, not by the disk, but it must not allocate per object: the
+// run fails with exit code 1 if it makes more than one heap allocation per 16 objects.
+// Runs on a headless EGL context, since the cubes' meshes are uploaded on the first one.
+//
+// The file is then damaged a few ways: an object typed past the end of the type table, a
+// parent out of range, and a section whose size wraps around the end. load() has to reject
+// each one, and the run fails with exit code 1 if it doesn't.
+
+#include "HeadlessGL.h"
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "CorruptFiles.h"
+#include "../MemoryTracker.h"
+#include "../Scene.h"
+#include "../SceneFile.h"
+
+static uint64_t totalAllocations() {
+	uint64_t total = 0;
+	for (int t = 0; t < static_cast<int>(MemTag::Count); t++) total += MemoryTracker::tagCounters(static_cast<MemTag>(t)).totalAllocations.load();
+	return total;
+}
+
+// Damages the scene file where its indices and section sizes are
+static bool corruptScenesRejected(const std::string& path, const std::vector<char>& good) {
+	scenefile::Header header;
+	if (!scenefile::readHeader(good.data(), good.size(), header)) return false;
+	const size_t sectionSizes = offsetof(scenefile::Header, sectionSize);
+	const size_t types = static_cast<size_t>(header.sectionOffset[scenefile::Types]);
+	const size_t parents = static_cast<size_t>(header.sectionOffset[scenefile::Parents]);
+
+	return corruptFilesRejected("SCENE_LOAD_BENCH", path, good, {
+		{ "a type past the type table", [&](std::vector<char>& bad) { poke<uint16_t>(bad, types + 2 * sizeof(uint16_t), 0xFFFF); } },
+		{ "a parent past the last object", [&](std::vector<char>& bad) { poke<int32_t>(bad, parents + sizeof(int32_t), static_cast<int32_t>(header.objectCount)); } },
+		{ "a negative parent", [&](std::vector<char>& bad) { poke<int32_t>(bad, parents, -7); } },
+		{ "a section size that wraps", [&](std::vector<char>& bad) {
+			poke<uint64_t>(bad, sectionSizes + scenefile::Sizes * sizeof(uint64_t), ~0ull - header.sectionOffset[scenefile::Sizes] + 2);
+		} },
+	}, [](const std::string& damaged) {
+		SceneSnapshot loaded;
+		return scenefile::load(damaged, loaded);
+	});
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 1000000;
+	std::string workDir = argc > 2 ? argv[2] : ".";
+	std::string path = workDir + "/scene_bench.bin";
+
+	SceneSnapshot scene;
+	scene.resize(count);
+	uint16_t cube = scene.typeIndex("Cube");
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> coord(-500.0f, 500.0f);
+	for (size_t i = 0; i < count; i++) {
+		scene.types[i] = cube;
+		scene.ids[i] = static_cast<int32_t>(i + 1);
+		scene.positions[i] = glm::vec3(coord(rng), coord(rng), coord(rng));
+		scene.sizes[i] = glm::vec3(1.0f);
+		scene.rotations[i] = glm::vec3(0.0f);
+		scene.setSelected(i, i % 1000 == 0);
+	}
+
+	BenchClock::time_point start = BenchClock::now();
+	scenefile::save(path, scene);
+	double saveMs = millisecondsSince(start);
+
+	start = BenchClock::now();
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	std::vector<char> raw(static_cast<size_t>(in.tellg()));
+	in.seekg(0);
+	in.read(raw.data(), raw.size());
+	double readMs = millisecondsSince(start);
+	double megabytes = raw.size() / 1048576.0;
+
+	SceneSnapshot loaded;
+	start = BenchClock::now();
+	bool ok = scenefile::load(path, loaded);
+	double loadMs = millisecondsSince(start);
+	if (!ok || loaded.size() != count || loaded.positions[count / 2] != scene.positions[count / 2]) {
+		std::printf("load mismatch\n");
+		return 1;
+	}
+
+	HeadlessGL gl;
+	if (!gl.create(64, 64, true)) return 1;
+	double sceneMs;
+	uint64_t sceneAllocations;
+	{
+		Scene sceneLoaded;
+		uint64_t allocationsBefore = totalAllocations();
+		start = BenchClock::now();
+		ok = sceneLoaded.load(path);
+		sceneMs = millisecondsSince(start);
+		sceneAllocations = totalAllocations() - allocationsBefore;
+		if (!ok || sceneLoaded.getGraph().size() != count) {
+			std::printf("scene load mismatch\n");
+			return 1;
+		}
+	}
+
+	if (count > 2 && !corruptScenesRejected(path, raw)) return 1;
+
+	std::printf("objects: %zu, file: %.1f MB\n", count, megabytes);
+	std::printf("%-12s %10s %10s\n", "step", "ms", "MB/s");
+	std::printf("%-12s %10.1f %10.1f\n", "save", saveMs, megabytes / (saveMs / 1000.0));
+	std::printf("%-12s %10.1f %10.1f\n", "read", readMs, megabytes / (readMs / 1000.0));
+	std::printf("%-12s %10.1f %10.1f\n", "load", loadMs, megabytes / (loadMs / 1000.0));
+	std::printf("%-12s %10.1f %10.1f %12llu allocations\n", "scene", sceneMs, megabytes / (sceneMs / 1000.0), static_cast<unsigned long long>(sceneAllocations));
+	std::remove(path.c_str());
+	// what's left over for containers whose size doesn't follow the object count
+	if (sceneAllocations > count / 16 + 1024) {
+		std::printf("ERROR::SCENE_LOAD_BENCH::PER_OBJECT_ALLOCATIONS: %llu heap allocations loading %zu objects\n",
+			static_cast<unsigned long long>(sceneAllocations), count);
+		return 1;
+	}
+	return 0;
+}
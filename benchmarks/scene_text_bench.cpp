@@ -0,0 +1,105 @@
+// Text scene parse throughput.
+//
+//   scene_text_bench [megabytes=500] [workDir=.]
+//
+// Generates a scene file of roughly the requested size, then reports parse speed of the
+// SAX loader in MB/s and the time to convert the result to the binary format. Also checks
+// that a long type name survives a save and load whole, and that ids past int32_t are
+// rejected.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "BenchClock.h"
+#include "../SceneText.h"
+
+int main(int argc, char** argv) {
+	size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 500;
+	std::string workDir = argc > 2 ? argv[2] : ".";
+	std::string textPath = workDir + "/scene_bench.json";
+	std::string binaryPath = workDir + "/scene_bench.bin";
+
+	// ~125 bytes per record with these coordinates
+	size_t count = megabytes * 1024 * 1024 / 125;
+	SceneSnapshot scene;
+	scene.resize(count);
+	uint16_t cube = scene.typeIndex("Cube");
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+	for (size_t i = 0; i < count; i++) {
+		scene.types[i] = cube;
+		scene.ids[i] = static_cast<int32_t>(i + 1);
+		scene.positions[i] = glm::vec3(coord(rng), coord(rng), coord(rng));
+		scene.sizes[i] = glm::vec3(1.0f, 2.0f, 1.0f);
+		scene.rotations[i] = glm::vec3(0.0f, angle(rng), 0.0f);
+		scene.setSelected(i, i % 97 == 0);
+	}
+
+	BenchClock::time_point start = BenchClock::now();
+	scenetext::save(textPath, scene);
+	double writeMs = millisecondsSince(start);
+
+	MappedFile file(textPath);
+	double fileMB = file.size() / 1048576.0;
+	// touch every page so the parse timing doesn't include page faults
+	volatile char sink = 0;
+	for (size_t i = 0; i < file.size(); i += 4096) sink = sink + file.data()[i];
+
+	SceneSnapshot parsed;
+	start = BenchClock::now();
+	bool ok = scenetext::parse(file.data(), file.size(), parsed);
+	double parseMs = millisecondsSince(start);
+	if (!ok || parsed.size() != count || parsed.positions[count / 3] != scene.positions[count / 3] ||
+		parsed.isSelected(97) != scene.isSelected(97)) {
+		std::printf("parse mismatch\n");
+		return 1;
+	}
+
+	start = BenchClock::now();
+	scenefile::save(binaryPath, parsed);
+	double convertMs = millisecondsSince(start);
+
+	std::printf("objects: %zu, text: %.1f MB\n", count, fileMB);
+	std::printf("%-14s %10s %10s\n", "step", "ms", "MB/s");
+	std::printf("%-14s %10.1f %10.1f\n", "write text", writeMs, fileMB / (writeMs / 1000.0));
+	std::printf("%-14s %10.1f %10.1f\n", "parse text", parseMs, fileMB / (parseMs / 1000.0));
+	std::printf("%-14s %10.1f %10s\n", "write binary", convertMs, "-");
+	file.close();
+	std::remove(textPath.c_str());
+	std::remove(binaryPath.c_str());
+
+	// quotes, backslashes and control characters escape to up to six bytes each
+	SceneSnapshot named;
+	named.resize(2);
+	std::string longName(300, 'x');
+	longName[10] = '"';
+	longName[150] = '\\';
+	longName[299] = '\n';
+	named.types[0] = named.typeIndex(longName);
+	named.types[1] = named.typeIndex("Cube");
+	named.ids[0] = 1;
+	named.ids[1] = 2;
+	SceneSnapshot reloaded;
+	scenetext::save(textPath, named);
+	bool namesKept = scenetext::load(textPath, reloaded) && reloaded.size() == 2 &&
+		reloaded.typeNames[reloaded.types[0]] == longName && reloaded.typeNames[reloaded.types[1]] == "Cube";
+	std::remove(textPath.c_str());
+	if (!namesKept) {
+		std::printf("ERROR::SCENE_TEXT_BENCH::TYPE_NAME_CHANGED: a %zu-character type name didn't survive a round trip\n", longName.size());
+		return 1;
+	}
+
+	for (const char* id : { "1e20", "-1e300", "2147483648", "1.5" }) {
+		std::string text = std::string("{\"format\":\"3dengine-scene\",\"version\":1,\"objects\":[\n{\"id\":") + id +
+			",\"type\":\"Cube\",\"position\":[0,0,0],\"size\":[1,1,1],\"rotation\":[0,0,0],\"selected\":false}\n]}\n";
+		SceneSnapshot rejected;
+		if (scenetext::parse(text.data(), text.size(), rejected)) {
+			std::printf("ERROR::SCENE_TEXT_BENCH::BAD_ID_ACCEPTED: id %s was accepted\n", id);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,249 @@
+// World streaming (WorldStreamer.h): flies a camera over a world of Cubes too big to keep
+// in the scene and measures what streaming costs the frames along the way.
+//
+//   stream_bench [objects=1000000] [frames=1800] [workDir=.]
+//
+// The world is a square field of Cubes, about one per square unit, with one in ten the
+// child of another. It is written to workDir/stream_bench.pak in cells of 32 units and the
+// camera flies a figure-eight over it, one step per 60 Hz frame in real time. Each frame is
+// timed over streamer.update() plus Scene::updateTransforms(), then sleeps out the rest of
+// its 16.7 ms in place of drawing, which costs the same streamed or not and which llvmpipe
+// would drown everything else in.
+//
+// The flight runs twice: with the default per-frame budget, and with no budget, adding each
+// cell whole the frame it is read, which is what loading cells without pacing looks like.
+// Reported for each: p50, p99 and worst frame, frames over the hitch threshold, peak
+// objects resident and peak Scene heap; then the same for the whole world loaded at once.
+//
+// Checks, each failing with exit code 1: after the flight and a final loadAround(), every
+// cell within the load radius is in the scene with all its objects, nothing lies in a cell
+// past the unload radius, and the streamer's count of resident objects is the scene's.
+
+#include "HeadlessGL.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../MemoryTracker.h"
+#include "../Scene.h"
+#include "../WorldStreamer.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform() { return static_cast<float>(next() >> 40) / static_cast<float>(1ull << 24); }
+};
+
+static const float CellSize = 32.0f;
+static const float FrameStep = 1.0f / 60.0f;
+static const float FlightSpeed = 60.0f;   // units a second, roughly
+static const double HitchMs = 8.0;
+
+static double peakRssMb() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	long kb = 0;
+	while (std::getline(status, line))
+		if (std::sscanf(line.c_str(), "VmHWM: %ld kB", &kb) == 1) break;
+	return kb / 1024.0;
+}
+
+// Linux restarts VmHWM from the current RSS when "5" is written here
+static void resetPeakRss() {
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+static double sceneMb() {
+	return MemoryTracker::tagCounters(MemTag::Scene).liveBytes.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+}
+
+static SceneSnapshot makeWorld(size_t objects, float& extent) {
+	extent = std::sqrt(static_cast<float>(objects));
+	SplitMix64 rng(7);
+	SceneSnapshot world;
+	world.resize(objects);
+	world.typeNames.push_back("Cube");
+	int32_t lastRoot = -1;
+	for (size_t i = 0; i < objects; i++) {
+		world.types[i] = 0;
+		world.ids[i] = static_cast<int32_t>(i + 1);
+		world.sizes[i] = glm::vec3(0.3f + 0.6f * rng.uniform());
+		world.rotations[i] = glm::vec3(rng.uniform() * 90.0f, rng.uniform() * 90.0f, 0.0f);
+		if (lastRoot >= 0 && rng.next() % 10 == 0) {
+			world.parents[i] = lastRoot;
+			world.positions[i] = glm::vec3(1.5f, 0.0f, 0.0f); // relative to the parent
+		} else {
+			world.positions[i] = glm::vec3(rng.uniform() * extent, rng.uniform() * 8.0f, rng.uniform() * extent);
+			lastRoot = static_cast<int32_t>(i);
+		}
+	}
+	return world;
+}
+
+static glm::vec3 flightPosition(int frame, float extent) {
+	float radius = extent * 0.4f;
+	float angle = frame * FrameStep * FlightSpeed / radius;
+	return glm::vec3(extent * 0.5f + radius * std::sin(angle), 20.0f, extent * 0.5f + radius * std::sin(angle) * std::cos(angle));
+}
+
+struct FlightResult {
+	double p50 = 0, p99 = 0, worst = 0;
+	int hitches = 0;
+	size_t peakObjects = 0;
+	double peakSceneMb = 0;
+	size_t loads = 0, evictions = 0;
+};
+
+static FlightResult fly(Scene& scene, WorldStreamer& streamer, int frames, float extent) {
+	FlightResult result;
+	std::vector<double> times(frames);
+	for (int frame = 0; frame < frames; frame++) {
+		BenchClock::time_point start = BenchClock::now();
+		streamer.update(scene, flightPosition(frame, extent));
+		scene.updateTransforms();
+		times[frame] = millisecondsSince(start);
+		// the rest of the frame goes to drawing and vsync, which is when cells get read
+		std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<int64_t>(FrameStep * 1e6f)));
+		if (times[frame] > HitchMs) result.hitches++;
+		result.peakObjects = std::max(result.peakObjects, static_cast<size_t>(scene.getGraph().size()));
+		result.peakSceneMb = std::max(result.peakSceneMb, sceneMb());
+	}
+	StreamStats stats = streamer.stats();
+	result.loads = stats.loadsStarted;
+	result.evictions = stats.evictions;
+	std::sort(times.begin(), times.end());
+	result.p50 = times[frames / 2];
+	result.p99 = times[std::min(frames - 1, frames * 99 / 100)];
+	result.worst = times.back();
+	return result;
+}
+
+static void printFlight(const char* name, const FlightResult& r) {
+	std::printf("%-10s p50 %6.3f ms  p99 %6.3f ms  worst %7.3f ms  hitches %4d   peak %7zu objects %7.1f MB   %zu loads, %zu evictions\n",
+		name, r.p50, r.p99, r.worst, r.hitches, r.peakObjects, r.peakSceneMb, r.loads, r.evictions);
+}
+
+// Every root's cell in the scene against the cells the archive has, around the camera
+static bool checkResident(Scene& scene, WorldStreamer& streamer, const glm::vec3& camera) {
+	const StreamSettings& settings = streamer.settings;
+	SceneSnapshot snap = scene.snapshot();
+	std::unordered_map<uint64_t, uint32_t> counts;
+	std::vector<glm::ivec3> cellOf(snap.size());
+	bool ok = true;
+	for (size_t i = 0; i < snap.size(); i++) {
+		cellOf[i] = snap.parents[i] >= 0 ? cellOf[snap.parents[i]] : glm::ivec3(glm::floor(snap.positions[i] / CellSize));
+		counts[worldfile::cellKey(cellOf[i])]++;
+	}
+	auto distance = [&](const glm::ivec3& coord) {
+		glm::vec3 boxMin = glm::vec3(coord) * CellSize;
+		return glm::length(camera - glm::clamp(camera, boxMin, boxMin + CellSize));
+	};
+	for (size_t i = 0; i < snap.size(); i++) {
+		if (distance(cellOf[i]) > settings.unloadRadius) {
+			std::printf("ERROR::STREAM_BENCH::FAR_OBJECT: object %d in cell %d,%d,%d\n", snap.ids[i], cellOf[i].x, cellOf[i].y, cellOf[i].z);
+			ok = false;
+			break;
+		}
+	}
+	int reach = static_cast<int>(std::ceil(settings.loadRadius / CellSize));
+	glm::ivec3 center = glm::ivec3(glm::floor(camera / CellSize));
+	for (int z = center.z - reach; z <= center.z + reach; z++)
+		for (int y = center.y - reach; y <= center.y + reach; y++)
+			for (int x = center.x - reach; x <= center.x + reach; x++) {
+				glm::ivec3 coord(x, y, z);
+				if (distance(coord) > settings.loadRadius) continue;
+				uint32_t expected = streamer.cellObjects(coord);
+				uint32_t found = counts.count(worldfile::cellKey(coord)) ? counts[worldfile::cellKey(coord)] : 0;
+				if (!streamer.isResident(coord) || found != expected) {
+					std::printf("ERROR::STREAM_BENCH::MISSING_CELL: %d,%d,%d has %u of %u objects\n", x, y, z, found, expected);
+					ok = false;
+				}
+			}
+	StreamStats stats = streamer.stats();
+	if (stats.residentObjects != snap.size()) {
+		std::printf("ERROR::STREAM_BENCH::COUNT_MISMATCH: streamer has %zu objects resident, scene %zu\n", stats.residentObjects, snap.size());
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	size_t objects = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 1800;
+	std::string workDir = argc > 3 ? argv[3] : ".";
+	std::string archive = workDir + "/stream_bench.pak";
+	if (objects < 1000 || frames < 10) {
+		std::printf("usage: stream_bench [objects>=1000] [frames>=10] [workDir]\n");
+		return 2;
+	}
+
+	// cubes share one mesh made on first use, which needs a context
+	HeadlessGL gl;
+	if (!gl.create(64, 64, true)) return 1;
+
+	float extent = 0.0f;
+	SceneSnapshot world = makeWorld(objects, extent);
+	BenchClock::time_point start = BenchClock::now();
+	if (!WorldStreamer::write(world, CellSize, archive)) return 1;
+	double writeMs = millisecondsSince(start);
+	// the streamed run shouldn't be charged for the world it was written from
+	world = SceneSnapshot();
+	resetPeakRss();
+
+	int exitCode = 0;
+	Scene scene;
+	WorldStreamer streamer;
+	if (!streamer.open(archive)) return 1;
+	StreamStats stats = streamer.stats();
+	std::printf("world: %zu objects over %.0f x %.0f units, %zu cells of %.0f, written in %.1f ms\n",
+		objects, extent, extent, stats.cells, CellSize, writeMs);
+	std::printf("flight: %d frames of %.1f ms at %.0f units/s, load radius %.0f, unload radius %.0f, hitch > %.0f ms\n\n",
+		frames, FrameStep * 1000.0f, FlightSpeed, streamer.settings.loadRadius, streamer.settings.unloadRadius, HitchMs);
+
+	FlightResult paced = fly(scene, streamer, frames, extent);
+	printFlight("budgeted", paced);
+
+	glm::vec3 last = flightPosition(frames - 1, extent);
+	streamer.loadAround(scene, last);
+	if (!checkResident(scene, streamer, last)) exitCode = 1;
+	double streamedRssMb = peakRssMb();
+
+	scene.clear();
+	streamer.open(archive);
+	streamer.settings.frameBudgetMs = 1e9f;
+	FlightResult unpaced = fly(scene, streamer, frames, extent);
+	printFlight("unbudgeted", unpaced);
+	streamer.close();
+
+	scene.clear();
+	world = makeWorld(objects, extent);
+	start = BenchClock::now();
+	scene.loadSnapshot(world);
+	double loadMs = millisecondsSince(start);
+	start = BenchClock::now();
+	scene.updateTransforms();
+	double transformMs = millisecondsSince(start);
+	std::printf("all at once: %.1f ms to load, %.3f ms a frame for transforms, %zu objects %.1f MB\n",
+		loadMs, transformMs, static_cast<size_t>(scene.getGraph().size()), sceneMb());
+	std::printf("peak RSS: %.1f MB streaming, %.1f MB after loading everything\n", streamedRssMb, peakRssMb());
+
+	std::remove(archive.c_str());
+	return exitCode;
+}
@@ -0,0 +1,136 @@
+// Startup cost of reading many small assets as loose files versus out of one packed archive.
+//
+//   vfs_startup_bench [assetCount=10000] [workDir=vfs_bench_data]
+//
+// Numbers are for a warm page cache; drop caches between runs to measure cold starts.
+//
+// First a small archive is damaged in the ways a truncated or corrupt .pak can be; PackSource
+// has to refuse to open each one, and the run fails with exit code 1 if it doesn't.
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "BenchClock.h"
+#include "CorruptFiles.h"
+#include "../VirtualFileSystem.h"
+
+static void makeDir(const std::string& path) {
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+// shader-like text so compression has something realistic to chew on
+static std::string makeAsset(std::mt19937& rng) {
+	static const char* lines[] = {
+		"#version 330 core\n", "uniform mat4 model;\n", "uniform vec3 inColor;\n", "out vec4 FragColor;\n",
+		"layout (location = 0) in vec3 aPos;\n", "void main() {\n", "    FragColor = vec4(inColor, 1.0);\n", "}\n"
+	};
+	std::uniform_int_distribution<int> lineCount(4, 64);
+	std::uniform_int_distribution<int> pick(0, 7);
+	std::string text;
+	for (int i = lineCount(rng); i > 0; i--) text += lines[pick(rng)];
+	return text;
+}
+
+static size_t readAll(const VirtualFileSystem& vfs, const std::vector<std::string>& paths) {
+	size_t bytes = 0;
+	for (const std::string& path : paths) bytes += vfs.read(path).size();
+	return bytes;
+}
+
+// Damages a small archive the ways a truncated or corrupt .pak can be
+static bool corruptArchivesRejected(const std::string& workDir, std::mt19937& rng) {
+	std::string path = workDir + "/corrupt.pak";
+	PackWriter writer(16);
+	for (int i = 0; i < 3; i++) {
+		std::string text = makeAsset(rng);
+		writer.add("asset" + std::to_string(i) + ".glsl", text.data(), text.size());
+	}
+	if (!writer.write(path)) return false;
+	std::vector<char> good = readFile(path);
+	pack::Header header;
+	std::memcpy(&header, good.data(), sizeof(header));
+	size_t entry = static_cast<size_t>(header.tocOffset);
+
+	return corruptFilesRejected("VFS_STARTUP_BENCH", path, good, {
+		{ "a truncated name block", [&](std::vector<char>& bad) { bad.resize(static_cast<size_t>(header.namesOffset) + 2); } },
+		{ "a huge entry count", [](std::vector<char>& bad) { poke<uint32_t>(bad, offsetof(pack::Header, entryCount), 0x10000000u); } },
+		{ "a TOC offset that wraps", [](std::vector<char>& bad) { poke<uint64_t>(bad, offsetof(pack::Header, tocOffset), ~0ull - 8); } },
+		{ "names past the end", [&](std::vector<char>& bad) { poke<uint64_t>(bad, offsetof(pack::Header, namesOffset), good.size() + 1); } },
+		{ "a name past the end", [&](std::vector<char>& bad) { poke<uint32_t>(bad, entry + offsetof(pack::TocEntry, nameOffset), 0xFFFFFFF0u); } },
+		{ "an entry offset that wraps", [&](std::vector<char>& bad) { poke<uint64_t>(bad, entry + offsetof(pack::TocEntry, offset), ~0ull - 4); } },
+		{ "an entry running past the end", [&](std::vector<char>& bad) {
+			poke<uint64_t>(bad, entry + offsetof(pack::TocEntry, size), good.size());
+			poke<uint64_t>(bad, entry + offsetof(pack::TocEntry, storedSize), good.size());
+		} },
+	}, [](const std::string& damaged) { return PackSource(damaged).isOpen(); });
+}
+
+int main(int argc, char** argv) {
+	int assetCount = argc > 1 ? std::atoi(argv[1]) : 10000;
+	std::string workDir = argc > 2 ? argv[2] : "vfs_bench_data";
+
+	// --- generate the loose tree and the archives ------------------------------------
+	std::mt19937 rng(1234);
+	std::vector<std::string> paths;
+	PackWriter rawPack(16);
+	PackWriter lz4Pack(16);
+	makeDir(workDir);
+	if (!corruptArchivesRejected(workDir, rng)) return 1;
+	makeDir(workDir + "/loose");
+	for (int i = 0; i < assetCount; i++) {
+		std::string dir = "dir" + std::to_string(i / 256);
+		if (i % 256 == 0) makeDir(workDir + "/loose/" + dir);
+		std::string path = dir + "/asset" + std::to_string(i) + ".glsl";
+		std::string text = makeAsset(rng);
+		std::FILE* f = std::fopen((workDir + "/loose/" + path).c_str(), "wb");
+		std::fwrite(text.data(), 1, text.size(), f);
+		std::fclose(f);
+		rawPack.add(path, text.data(), text.size());
+		lz4Pack.add(path, text.data(), text.size(), true);
+		paths.push_back(path);
+	}
+	rawPack.write(workDir + "/raw.pak");
+	lz4Pack.write(workDir + "/lz4.pak");
+
+	std::printf("%-12s %10s %12s %12s\n", "source", "files", "MB", "ms");
+
+	// --- loose ------------------------------------------------------------------------
+	{
+		BenchClock::time_point start = BenchClock::now();
+		VirtualFileSystem vfs;
+		vfs.mount("", std::make_unique<DirectorySource>(workDir + "/loose"));
+		size_t bytes = readAll(vfs, paths);
+		std::printf("%-12s %10d %12.2f %12.2f\n", "loose", assetCount, bytes / 1048576.0, millisecondsSince(start));
+	}
+
+	// --- packed, archive open + map is part of the measured startup -------------------
+	const char* packs[] = { "raw.pak", "lz4.pak" };
+	for (const char* name : packs) {
+		BenchClock::time_point start = BenchClock::now();
+		VirtualFileSystem vfs;
+		if (!vfs.mountPack("", workDir + "/" + name)) {
+			std::printf("%-12s failed to open\n", name);
+			continue;
+		}
+		size_t bytes = readAll(vfs, paths);
+		std::printf("%-12s %10d %12.2f %12.2f\n", name, assetCount, bytes / 1048576.0, millisecondsSince(start));
+	}
+	return 0;
+}
@@ -0,0 +1,185 @@
+// Voxel chunks (VoxelWorld.h) against one Cube object per block. The structure is rolling
+// terrain of stone under dirt under grass, with stone walls standing on it and ore
+// scattered through the stone; it is sized to about the requested number of blocks.
+//
+//   voxel_bench [blocks=1000000] [edits=1000]
+//
+// Reported: the time to fill the chunks and to mesh them all on the job system, the
+// triangles and draw calls the greedy meshes need next to the 12 triangles and one draw a
+// Cube costs, the faces that meshing without merging would keep, and the cost of
+// remeshing after edits scattered over the structure.
+//
+// Checks, each failing with exit code 1: block storage reads back what was written through
+// every palette width, and on random chunks the greedy quads cover exactly the faces that
+// touch air.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+#include "../VoxelWorld.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) * n >> 32); }
+};
+
+enum : BlockID { Stone = 1, Dirt, Grass, Ore, Wall };
+
+static const int MeanHeight = 14;
+
+// terrain height at a column, between 8 and 20
+static int heightAt(int x, int z) {
+	return MeanHeight + static_cast<int>(std::lround(4.0 * std::sin(x * 0.07) + 2.0 * std::cos(z * 0.05 + x * 0.02)));
+}
+
+// Fills a square of terrain just big enough for about the given number of blocks, then
+// walls on every other 16-block grid line. Returns the blocks set.
+static size_t build(VoxelWorld& voxels, size_t blocks, SplitMix64& rng) {
+	int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(blocks) / MeanHeight)));
+	size_t placed = 0;
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			int height = heightAt(x, z);
+			for (int y = 0; y < height && placed < blocks; y++) {
+				BlockID block = y == height - 1 ? Grass : y >= height - 4 ? Dirt : rng.below(100) == 0 ? Ore : Stone;
+				voxels.setBlock(glm::ivec3(x, y, z), block);
+				placed++;
+			}
+			bool wall = (x % 32 == 0 || z % 32 == 0) && x > 0 && z > 0;
+			for (int y = height; wall && y < height + 6 && placed < blocks; y++) {
+				voxels.setBlock(glm::ivec3(x, y, z), Wall);
+				placed++;
+			}
+		}
+	}
+	return placed;
+}
+
+// --- checks ---
+
+// Writes random IDs drawn from ever larger sets into one chunk, so the palette widens
+// through every width, and compares each block with a plain array
+static size_t checkStorage(SplitMix64& rng) {
+	BlockStorage storage;
+	std::vector<BlockID> expected(BlockStorage::Volume, 0);
+	std::vector<BlockID> decoded(BlockStorage::Volume);
+	size_t mismatches = 0;
+	for (uint32_t kinds : { 1u, 3u, 12u, 200u, 40000u }) {
+		for (int i = 0; i < BlockStorage::Volume / 2; i++) {
+			int index = static_cast<int>(rng.below(BlockStorage::Volume));
+			BlockID id = static_cast<BlockID>(rng.below(kinds + 1));
+			if (storage.set(index, id) != expected[index]) mismatches++;
+			expected[index] = id;
+		}
+		storage.decode(decoded.data());
+		for (int i = 0; i < BlockStorage::Volume; i++) mismatches += storage.get(i) != expected[i] || decoded[i] != expected[i];
+	}
+	return mismatches;
+}
+
+// Meshes random chunks of various densities and checks that the quads' area on each face
+// direction equals the unit faces that touch air, counted one block at a time
+static size_t checkMeshes(SplitMix64& rng) {
+	const int Size = BlockStorage::Size, Area = Size * Size;
+	std::vector<BlockID> blocks(BlockStorage::Volume), outside(6 * Area);
+	size_t mismatches = 0;
+	for (int trial = 0; trial < 8; trial++) {
+		uint32_t percent = 10 + trial * 12, kinds = 1 + trial % 3;
+		for (BlockID& block : blocks) block = rng.below(100) < percent ? static_cast<BlockID>(1 + rng.below(kinds)) : 0;
+		for (BlockID& block : outside) block = rng.below(100) < percent ? 1 : 0;
+		const BlockID* faces[6];
+		for (int f = 0; f < 6; f++) faces[f] = outside.data() + f * Area;
+		VoxelMesh mesh;
+		greedyMesh(blocks.data(), faces, mesh);
+
+		size_t exposed = 0;
+		for (int z = 0; z < Size; z++) {
+			for (int y = 0; y < Size; y++) {
+				for (int x = 0; x < Size; x++) {
+					if (!blocks[BlockStorage::indexOf(x, y, z)]) continue;
+					int p[3] = { x, y, z };
+					for (int f = 0; f < 6; f++) {
+						int d = f / 2, q[3] = { x, y, z };
+						q[d] += f % 2 ? 1 : -1;
+						BlockID next = q[d] < 0 || q[d] >= Size ? faces[f][p[(d + 1) % 3] + Size * p[(d + 2) % 3]] : blocks[BlockStorage::indexOf(q[0], q[1], q[2])];
+						exposed += next == 0;
+					}
+				}
+			}
+		}
+		double area = 0.0;
+		for (size_t t = 0; t + 9 <= mesh.positions.size(); t += 9) {
+			glm::vec3 a(mesh.positions[t], mesh.positions[t + 1], mesh.positions[t + 2]);
+			glm::vec3 b(mesh.positions[t + 3], mesh.positions[t + 4], mesh.positions[t + 5]);
+			glm::vec3 c(mesh.positions[t + 6], mesh.positions[t + 7], mesh.positions[t + 8]);
+			area += 0.5 * glm::length(glm::cross(b - a, c - a));
+		}
+		if (exposed != mesh.exposedFaces || std::abs(area - static_cast<double>(exposed)) > 1e-3 * exposed) mismatches++;
+	}
+	return mismatches;
+}
+
+int main(int argc, char** argv) {
+	size_t target = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	int edits = argc > 2 ? std::atoi(argv[2]) : 1000;
+	MemTagScope memTag(MemTag::Scene);
+	SplitMix64 rng(46);
+
+	VoxelWorld voxels;
+	BenchClock::time_point start = BenchClock::now();
+	size_t blocks = build(voxels, std::max<size_t>(target, 1), rng);
+	double fillMs = millisecondsSince(start);
+
+	start = BenchClock::now();
+	voxels.remesh();
+	double submitMs = millisecondsSince(start);
+	voxels.finishMeshing();
+	double meshMs = millisecondsSince(start);
+	VoxelStats s = voxels.stats();
+
+	std::printf("%zu blocks in %zu chunks of %d^3, %u job workers\n", blocks, s.chunks, VoxelWorld::ChunkSize, JobSystem::get().workerCount());
+	std::printf("fill: %.1f ms; block storage %.2f MB, %.2f bytes per block (%.2f MB at 16 bits per block)\n", fillMs, s.storageBytes / 1048576.0,
+		static_cast<double>(s.storageBytes) / blocks, s.chunks * BlockStorage::Volume * 2 / 1048576.0);
+	std::printf("mesh every chunk: %.1f ms, %.3f ms of it on this thread; %.3f ms per chunk\n", meshMs, submitMs, meshMs / std::max<size_t>(s.chunks, 1));
+	std::printf("%-24s %14s %12s\n", "", "triangles", "draw calls");
+	std::printf("%-24s %14llu %12zu\n", "one Cube per block", 12ull * blocks, blocks);
+	std::printf("%-24s %14zu %12zu\n", "chunks, faces culled", 2 * s.exposedFaces, s.drawRanges);
+	std::printf("%-24s %14zu %12zu\n", "chunks, greedy quads", s.triangles, s.drawRanges);
+
+	// scattered edits: each dirties its chunk, and a neighbour when it is on the border
+	int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(target) / MeanHeight)));
+	for (int i = 0; i < edits; i++) {
+		glm::ivec3 at(static_cast<int>(rng.below(side)), static_cast<int>(rng.below(MeanHeight)), static_cast<int>(rng.below(side)));
+		voxels.setBlock(at, voxels.getBlock(at) ? 0 : Stone);
+	}
+	size_t dirty = voxels.stats().dirtyChunks;
+	start = BenchClock::now();
+	voxels.remesh();
+	submitMs = millisecondsSince(start);
+	voxels.finishMeshing();
+	double editMs = millisecondsSince(start);
+	std::printf("%d edits: %zu chunks remeshed in %.1f ms, %.3f ms of it on this thread\n", edits, dirty, editMs, submitMs);
+
+	size_t storageMismatches = checkStorage(rng);
+	size_t meshMismatches = checkMeshes(rng);
+	if (storageMismatches || meshMismatches) {
+		std::printf("ERROR::VOXEL_BENCH::MISMATCH: %zu blocks read back wrong, %zu meshes not covering exactly their exposed faces\n", storageMismatches, meshMismatches);
+		return 1;
+	}
+	return 0;
+}
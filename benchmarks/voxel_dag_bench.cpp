@@ -0,0 +1,339 @@
+// Sparse voxel DAG (VoxelDAG.h) over a 4096³ terrain: build time, memory per solid voxel,
+// ray throughput, and the mapped file. The terrain is a heightfield of rolling hills with
+// steeper ridges and a voxel of noise on top, solid below the surface.
+//
+//   voxel_dag_bench [levels=12] [rays=1000000] [workDir=.]
+//
+// Two kinds of rays are timed, one thread and then the job system: picks, from above the
+// terrain down at it, and sightlines, level with the ground a little above it, which cross
+// much more empty space before they hit or leave. Both are scattered over the whole
+// terrain, so nearly every ray starts with cache misses; a third set, one ray per pixel of
+// a camera's view, shows coherent rays. The saved file is mapped back and the same rays
+// cast against the mapping.
+//
+// Checks, each failing with exit code 1: random voxels read back as the heightfield says;
+// rays hit where a voxel-by-voxel walk of the heightfield hits; the mapped DAG answers every
+// ray exactly as the built one; and a VoxelWorld's DAG holds exactly its blocks.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BenchClock.h"
+#include "../JobSystem.h"
+#include "../MemoryTracker.h"
+#include "../VoxelDAG.h"
+#include "../VoxelWorld.h"
+
+struct SplitMix64 {
+	uint64_t state;
+	explicit SplitMix64(uint64_t seed) : state(seed) {}
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	float uniform(float lo, float hi) { return lo + (hi - lo) * static_cast<float>(next() >> 40) / 16777216.0f; }
+	uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) * n >> 32); }
+};
+
+// Solid where y is below the column's height. Keeps min/max pyramids of the heights so any
+// octree cube is classified with one lookup.
+struct Terrain {
+	int size;
+	std::vector<std::vector<int16_t>> low, high; // [level][column], columns 2^level wide
+
+	explicit Terrain(int levels) : size(1 << levels) {
+		low.resize(levels + 1);
+		high.resize(levels + 1);
+		low[0].resize(static_cast<size_t>(size) * size);
+		double scale = size / 4096.0;
+		for (int z = 0; z < size; z++) {
+			for (int x = 0; x < size; x++) {
+				double u = x / scale, v = z / scale;
+				double h = 0.29 + 0.15 * std::sin(u * 0.0031) * std::cos(v * 0.0027) + 0.05 * std::sin(u * 0.013 + v * 0.011) +
+					0.01 * std::sin(u * 0.071) * std::sin(v * 0.063);
+				uint32_t noise = static_cast<uint32_t>(x * 73856093u ^ z * 19349663u) * 2654435761u >> 30;
+				low[0][x + static_cast<size_t>(size) * z] = static_cast<int16_t>(static_cast<int>(h * size) + static_cast<int>(noise));
+			}
+		}
+		high[0] = low[0];
+		for (int level = 1; level <= levels; level++) {
+			int side = size >> level, below = side * 2;
+			low[level].resize(static_cast<size_t>(side) * side);
+			high[level].resize(static_cast<size_t>(side) * side);
+			for (int z = 0; z < side; z++) {
+				for (int x = 0; x < side; x++) {
+					size_t a = 2 * x + static_cast<size_t>(below) * 2 * z, b = a + below;
+					low[level][x + static_cast<size_t>(side) * z] = std::min(std::min(low[level - 1][a], low[level - 1][a + 1]), std::min(low[level - 1][b], low[level - 1][b + 1]));
+					high[level][x + static_cast<size_t>(side) * z] = std::max(std::max(high[level - 1][a], high[level - 1][a + 1]), std::max(high[level - 1][b], high[level - 1][b + 1]));
+				}
+			}
+		}
+	}
+
+	int height(int x, int z) const { return low[0][x + static_cast<size_t>(size) * z]; }
+	bool solid(const glm::ivec3& v) const {
+		return v.x >= 0 && v.y >= 0 && v.z >= 0 && v.x < size && v.y < size && v.z < size && v.y < height(v.x, v.z);
+	}
+
+	VoxelFill classify(const glm::ivec3& min, int cube) {
+		int level = 0;
+		while ((1 << level) < cube) level++;
+		size_t column = (min.x >> level) + static_cast<size_t>(size >> level) * (min.z >> level);
+		if (min.y >= high[level][column]) return VoxelFill::Empty;
+		if (min.y + cube <= low[level][column]) return VoxelFill::Full;
+		return VoxelFill::Mixed;
+	}
+
+	uint64_t brick(const glm::ivec3& min) {
+		uint64_t bits = 0;
+		for (int z = 0; z < 4; z++) {
+			for (int x = 0; x < 4; x++) {
+				int top = height(min.x + x, min.z + z) - min.y;
+				for (int y = 0; y < std::min(top, 4); y++) bits |= 1ull << VoxelDAG::brickBit(x, y, z);
+			}
+		}
+		return bits;
+	}
+};
+
+// Amanatides-Woo walk through the voxels of the terrain, one at a time, in the DAG's
+// convention that voxel v spans v - 0.5 to v + 0.5. In doubles, so that over thousands of
+// steps it doesn't drift past a voxel the ray only grazes.
+static bool walk(const Terrain& terrain, const Ray& ray, float& distance) {
+	double o[3], d[3], inverse[3];
+	double t = 0.0, tEnd = ray.tMax;
+	for (int a = 0; a < 3; a++) {
+		o[a] = ray.origin[a] + 0.5;
+		d[a] = ray.direction[a];
+		inverse[a] = 1.0 / d[a];
+		if (d[a] == 0.0) {
+			if (o[a] < 0.0 || o[a] >= terrain.size) return false;
+			continue;
+		}
+		double t0 = -o[a] * inverse[a], t1 = (terrain.size - o[a]) * inverse[a];
+		t = std::max(t, std::min(t0, t1));
+		tEnd = std::min(tEnd, std::max(t0, t1));
+	}
+	if (t > tEnd) return false;
+	glm::ivec3 v, step;
+	double next[3];
+	for (int a = 0; a < 3; a++) {
+		v[a] = std::min(std::max(static_cast<int>(std::floor(o[a] + d[a] * t)), 0), terrain.size - 1);
+		step[a] = d[a] > 0.0 ? 1 : -1;
+		double boundary = d[a] > 0.0 ? v[a] + 1 : v[a];
+		next[a] = d[a] == 0.0 ? INFINITY : (boundary - o[a]) * inverse[a];
+	}
+	while (t <= tEnd) {
+		if (terrain.solid(v)) {
+			distance = static_cast<float>(t);
+			return true;
+		}
+		int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		t = next[a];
+		next[a] = (v[a] + (step[a] > 0 ? 2 : -1) - o[a]) * inverse[a];
+		v[a] += step[a];
+		if (v[a] < 0 || v[a] >= terrain.size) return false;
+	}
+	return false;
+}
+
+static std::vector<Ray> pickRays(const Terrain& terrain, size_t count, SplitMix64& rng) {
+	std::vector<Ray> rays(count);
+	float size = static_cast<float>(terrain.size);
+	for (Ray& ray : rays) {
+		glm::vec3 origin(rng.uniform(0, size), rng.uniform(0.55f, 0.7f) * size, rng.uniform(0, size));
+		glm::vec3 target(rng.uniform(0, size), 0.2f * size, rng.uniform(0, size));
+		ray = Ray(origin, glm::normalize(target - origin));
+	}
+	return rays;
+}
+
+static std::vector<Ray> sightRays(const Terrain& terrain, size_t count, SplitMix64& rng) {
+	std::vector<Ray> rays(count);
+	float size = static_cast<float>(terrain.size);
+	for (Ray& ray : rays) {
+		int x = static_cast<int>(rng.below(terrain.size)), z = static_cast<int>(rng.below(terrain.size));
+		glm::vec3 origin(static_cast<float>(x), terrain.height(x, z) + rng.uniform(2.0f, 0.02f * size), static_cast<float>(z));
+		float angle = rng.uniform(0.0f, 6.2831853f);
+		ray = Ray(origin, glm::normalize(glm::vec3(std::cos(angle), rng.uniform(-0.02f, 0.02f), std::sin(angle))));
+	}
+	return rays;
+}
+
+// One per pixel of a square view from a camera above one corner, looking across the terrain
+static std::vector<Ray> screenRays(const Terrain& terrain, size_t count) {
+	int side = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count))));
+	std::vector<Ray> rays(static_cast<size_t>(side) * side);
+	float size = static_cast<float>(terrain.size);
+	glm::vec3 eye(0.1f * size, terrain.height(terrain.size / 10, terrain.size / 10) + 0.05f * size, 0.1f * size);
+	glm::vec3 forward = glm::normalize(glm::vec3(0.5f * size, 0.25f * size, 0.5f * size) - eye);
+	glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 up = glm::cross(right, forward);
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			float u = (x + 0.5f) / side * 2.0f - 1.0f, v = (y + 0.5f) / side * 2.0f - 1.0f;
+			rays[x + static_cast<size_t>(side) * y] = Ray(eye, glm::normalize(forward + 0.577f * (u * right + v * up)));
+		}
+	}
+	return rays;
+}
+
+struct CastResult {
+	std::vector<VoxelHit> hits;
+	std::vector<uint8_t> found;
+	double serialMs = 0, parallelMs = 0;
+	size_t hitCount = 0;
+};
+
+static CastResult castAll(const VoxelDAG& dag, const std::vector<Ray>& rays) {
+	CastResult result;
+	result.hits.resize(rays.size());
+	result.found.resize(rays.size());
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t i = 0; i < rays.size(); i++) result.found[i] = dag.raycast(rays[i], result.hits[i]);
+	result.serialMs = millisecondsSince(start);
+	start = BenchClock::now();
+	JobSystem::get().parallelFor(rays.size(), 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) result.found[i] = dag.raycast(rays[i], result.hits[i]);
+	});
+	result.parallelMs = millisecondsSince(start);
+	for (uint8_t f : result.found) result.hitCount += f;
+	return result;
+}
+
+static bool sameHits(const CastResult& a, const CastResult& b) {
+	for (size_t i = 0; i < a.found.size(); i++) {
+		if (a.found[i] != b.found[i]) return false;
+		if (a.found[i] && (a.hits[i].voxel != b.hits[i].voxel || a.hits[i].normal != b.hits[i].normal || a.hits[i].distance != b.hits[i].distance)) return false;
+	}
+	return true;
+}
+
+// A ray hits where the walk does. Where the two pick different voxels at the same distance
+// the ray went through an edge or corner; the DAG's voxel must still be solid and touched.
+static size_t checkRays(const VoxelDAG& dag, const Terrain& terrain, const std::vector<Ray>& rays) {
+	size_t mismatches = 0;
+	for (const Ray& ray : rays) {
+		VoxelHit hit;
+		float expected = 0.0f;
+		bool found = dag.raycast(ray, hit), walked = walk(terrain, ray, expected);
+		if (found != walked) {
+			mismatches++;
+			continue;
+		}
+		if (!found) continue;
+		glm::vec3 point = ray.at(hit.distance) - glm::vec3(hit.voxel);
+		float tolerance = 1e-3f * std::max(1.0f, hit.distance);
+		bool touched = std::abs(point.x) <= 0.5f + tolerance && std::abs(point.y) <= 0.5f + tolerance && std::abs(point.z) <= 0.5f + tolerance;
+		if (std::abs(hit.distance - expected) > tolerance || !terrain.solid(hit.voxel) || !touched) mismatches++;
+	}
+	return mismatches;
+}
+
+// A small world of random blocks in a few chunks on both sides of zero
+static size_t checkWorld(SplitMix64& rng) {
+	VoxelWorld world;
+	for (int i = 0; i < 20000; i++) {
+		glm::ivec3 at(static_cast<int>(rng.below(80)) - 40, static_cast<int>(rng.below(40)) - 8, static_cast<int>(rng.below(70)) - 20);
+		world.setBlock(at, static_cast<BlockID>(1 + rng.below(3)));
+	}
+	for (int x = 100; x < 132; x++)
+		for (int y = 0; y < 32; y++)
+			for (int z = 0; z < 32; z++) world.setBlock(glm::ivec3(x, y, z), 1); // one whole chunk
+	const VoxelDAG& dag = world.solidBlocks();
+	size_t mismatches = 0;
+	uint64_t solid = 0;
+	for (int x = -64; x < 160; x++) {
+		for (int y = -40; y < 72; y++) {
+			for (int z = -40; z < 72; z++) {
+				bool expected = world.getBlock(glm::ivec3(x, y, z)) != 0;
+				mismatches += dag.isSolid(glm::ivec3(x, y, z)) != expected;
+				solid += expected;
+			}
+		}
+	}
+	mismatches += dag.stats().solidVoxels != solid;
+	// straight down the middle of the full chunk, from above
+	VoxelHit hit;
+	if (!world.raycast(Ray(glm::vec3(116.2f, 50.0f, 16.3f), glm::vec3(0.0f, -1.0f, 0.0f)), hit) || hit.voxel != glm::ivec3(116, 31, 16) ||
+		hit.normal != glm::ivec3(0, 1, 0) || std::abs(hit.distance - 18.5f) > 1e-4f)
+		mismatches++;
+	return mismatches;
+}
+
+int main(int argc, char** argv) {
+	int levels = argc > 1 ? std::atoi(argv[1]) : 12;
+	size_t rayCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	std::string workDir = argc > 3 ? argv[3] : ".";
+	levels = std::min(std::max(levels, 4), 14);
+	MemTagScope memTag(MemTag::Scene);
+	SplitMix64 rng(47);
+
+	BenchClock::time_point start = BenchClock::now();
+	Terrain terrain(levels);
+	double terrainMs = millisecondsSince(start);
+	VoxelDAG dag;
+	start = BenchClock::now();
+	dag.build(levels, glm::ivec3(0), terrain);
+	double buildMs = millisecondsSince(start);
+	VoxelDAGStats s = dag.stats();
+	double voxels = static_cast<double>(s.solidVoxels);
+	double cube = std::pow(2.0, 3 * levels);
+
+	std::printf("%d^3 voxels, %.3g solid; heightfield %.0f ms, DAG build %.0f ms, %u job workers\n", terrain.size, voxels, terrainMs, buildMs, JobSystem::get().workerCount());
+	std::printf("DAG: %zu nodes, %zu bricks, %.2f MB; %.3g bits per solid voxel\n", s.nodes, s.bricks, s.bytes / 1048576.0, 8.0 * s.bytes / voxels);
+	std::printf("for comparison: one bit per voxel %.0f MB, 16-bit chunk blocks %.0f MB\n", cube / 8 / 1048576.0, cube * 2 / 1048576.0);
+
+	std::vector<Ray> picks = pickRays(terrain, rayCount, rng);
+	std::vector<Ray> sights = sightRays(terrain, rayCount, rng);
+	std::vector<Ray> screen = screenRays(terrain, rayCount);
+	CastResult pickResult = castAll(dag, picks);
+	CastResult sightResult = castAll(dag, sights);
+	CastResult screenResult = castAll(dag, screen);
+	std::printf("%-12s %10s %14s %16s %8s\n", "rays", "count", "Mrays/s 1 thr", "Mrays/s all thr", "hit");
+	const char* names[3] = { "picks", "sightlines", "screen" };
+	const CastResult* results[3] = { &pickResult, &sightResult, &screenResult };
+	for (int k = 0; k < 3; k++) {
+		const CastResult& r = *results[k];
+		size_t count = r.found.size();
+		std::printf("%-12s %10zu %14.2f %16.2f %7.1f%%\n", names[k], count, count / r.serialMs / 1000.0, count / r.parallelMs / 1000.0, 100.0 * r.hitCount / std::max<size_t>(count, 1));
+	}
+
+	std::string path = workDir + "/voxel_dag_bench.vdag";
+	start = BenchClock::now();
+	bool saved = dag.save(path);
+	double saveMs = millisecondsSince(start);
+	VoxelDAG mapped;
+	start = BenchClock::now();
+	bool opened = saved && mapped.open(path);
+	double openMs = millisecondsSince(start);
+	bool mappedSame = opened && sameHits(castAll(mapped, picks), pickResult) && sameHits(castAll(mapped, sights), sightResult);
+	std::remove(path.c_str());
+	std::printf("file: save %.1f ms, map and check %.1f ms\n", saveMs, openMs);
+
+	size_t voxelMismatches = 0;
+	for (int i = 0; i < 200000; i++) {
+		glm::ivec3 v(static_cast<int>(rng.below(terrain.size)), static_cast<int>(rng.below(terrain.size)), static_cast<int>(rng.below(terrain.size)));
+		// half of them near the surface, where it matters
+		if (i % 2) v.y = std::max(0, terrain.height(v.x, v.z) - 3 + static_cast<int>(rng.below(6)));
+		voxelMismatches += dag.isSolid(v) != terrain.solid(v);
+	}
+	std::vector<Ray> checked(picks.begin(), picks.begin() + std::min<size_t>(picks.size(), 1000));
+	checked.insert(checked.end(), sights.begin(), sights.begin() + std::min<size_t>(sights.size(), 1000));
+	size_t rayMismatches = checkRays(dag, terrain, checked);
+	size_t worldMismatches = checkWorld(rng);
+	if (voxelMismatches || rayMismatches || !mappedSame || worldMismatches) {
+		std::printf("ERROR::VOXEL_DAG_BENCH::MISMATCH: %zu voxels, %zu of %zu rays, mapped file %s, %zu voxel world blocks\n", voxelMismatches, rayMismatches,
+			checked.size(), mappedSame ? "same" : "different", worldMismatches);
+		return 1;
+	}
+	return 0;
+}
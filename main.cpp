@@ -18,6 +18,18 @@
 #include "Scene.h"
 #include "ColorPicker.h"
 #include "constants.h"
+#include "AssetManager.h"
+#include "VirtualFileSystem.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include "TraceExporter.h"
+#include "RenderStats.h"
+#include "MemoryTracker.h"
+#include "FrameArena.h"
+#include "WorldStreamer.h"
+#include "ReverseZ.h"
+#include <cstdlib>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -25,6 +37,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window, Scene &scene, ColorPicker& colorPicker, GizmoState& gizmo);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 glm::vec3 getMouseWorldPositionOnPlane(GLFWwindow* window, glm::vec3 planeNormal, glm::vec3 planePoint);
+glm::mat4 sceneProjection();
 
 // Scene object
 Scene scene;
@@ -41,6 +54,12 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// physics runs only while this is checked
+bool simulate = false;
+
+// the broadphase interference check costs a pass over the whole scene, so it is opt-in
+bool checkOverlaps = false;
+
 // Gizmo State Manager
 GizmoState gizmo;
 
@@ -48,7 +67,19 @@ GizmoState gizmo;
 ColorPicker* colorPickPoint;
 
 
-int main() {
+// Command line:
+//   --trace <file>        write a Chrome/Perfetto trace from the first frame
+//   --trace-frames <n>    stop the trace after n frames (default: until exit)
+int main(int argc, char** argv) {
+    std::string tracePath;
+    uint64_t traceFrames = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) tracePath = argv[++i];
+        else if (arg == "--trace-frames" && i + 1 < argc) traceFrames = std::strtoull(argv[++i], nullptr, 10);
+        else std::cout << "unknown argument " << arg << std::endl;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -104,9 +135,13 @@ int main() {
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
+    ReverseZ::get().init((GLADloadproc)glfwGetProcAddress);
 
-    // setup ImGUI
+    // setup ImGUI, charging its allocations to the UI tag
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(
+        [](size_t size, void*) { return MemoryTracker::allocate(size, MemTag::UI); },
+        [](void* ptr, void*) { MemoryTracker::release(ptr); });
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     ImGui::StyleColorsDark(); // Or ImGui::StyleColorsClassic();
@@ -116,26 +151,73 @@ int main() {
 
 
 
+    // start tracing before anything is loaded so asset loads show up in the trace
+    TraceExporter traceExporter;
+    WorldStreamer streamer;
+    if (!tracePath.empty()) traceExporter.start(tracePath, traceFrames);
+
+    // mount loose files first so an assets.pak next to the executable overrides them
+    VirtualFileSystem& vfs = VirtualFileSystem::get();
+    vfs.mount("", std::make_unique<DirectorySource>("."));
+    vfs.mountPack("", "assets.pak");
+
     // build and compile shaders
     // -------------------------
-    Shader ourShader("Vertex.vs", "Fragment.fs");
+    AssetManager& assets = AssetManager::get();
+    ShaderHandle mainShaderHandle = assets.loadShader("Vertex.vs", "Fragment.fs");
+    Shader& ourShader = *assets.getShader(mainShaderHandle);
 
     // Color picker FBO
-    Shader colorPickShader("Vertex.vs", "ColorPickerFrag.fs");
+    ShaderHandle colorPickShaderHandle = assets.loadShader("Vertex.vs", "ColorPickerFrag.fs");
+    Shader& colorPickShader = *assets.getShader(colorPickShaderHandle);
     ColorPicker colorPicker(scene, colorPickShader, camera);
     colorPickPoint = &colorPicker; // for scope purposes
 
+    Profiler& profiler = Profiler::get();
+    GpuProfiler& gpuProfiler = GpuProfiler::get();
+    gpuProfiler.init();
+
+    // per-subsystem heap budgets; going over is logged and shown in the Memory window
+    MemoryTracker& memory = MemoryTracker::get();
+    memory.setBudget(MemTag::Scene, 512ull * 1024 * 1024);
+    memory.setBudget(MemTag::Render, 64ull * 1024 * 1024);
+    memory.setBudget(MemTag::Assets, 512ull * 1024 * 1024);
+    memory.setBudget(MemTag::UI, 32ull * 1024 * 1024);
+    memory.setBudget(MemTag::Frame, 64ull * 1024 * 1024);
+    FrameArena& frameArena = FrameArena::get();
+    // the main pass draws here, for a float depth buffer, and is copied to the window
+    SceneTarget sceneTarget;
+
     while (!glfwWindowShouldClose(window)) {
+        profiler.beginFrame();
+        gpuProfiler.beginFrame();
+        RenderStats::frame().reset();
+
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // free whatever the asset manager picked for eviction since last frame
+        assets.update();
 
         // input
         // -----
-        processInput(window, scene, colorPicker, gizmo);
+        {
+            PROFILE_SCOPE("processInput");
+            processInput(window, scene, colorPicker, gizmo);
+        }
+
+        // fixed steps, however long the frame took
+        if (simulate) scene.stepPhysics(deltaTime);
+
+        // keep the camera near the origin so floats stay precise out there; not mid-drag,
+        // the gizmo's drag is measured from where it started
+        if (!gizmo.isMoving) scene.followCamera(camera.Position);
+
+        // bring in the world around the camera and drop what it has left behind
+        streamer.update(scene, camera.Position);
 
         // Render picking pass
         colorPicker.renderPickingPass();
@@ -143,6 +225,9 @@ int main() {
 
         // render
         // ------
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        sceneTarget.bind(framebufferWidth, framebufferHeight);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -150,7 +235,7 @@ int main() {
         ourShader.use();
 
         // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = sceneProjection();
         ourShader.setMat4("projection", projection);
 
         // camera/view transformation
@@ -163,31 +248,111 @@ int main() {
         ImGui::NewFrame();
 
         // Draw your ImGui GUI
-        ImGui::SetNextWindowSize(ImVec2(200, 200)); // width = 400, height = 300
+        ImGui::SetNextWindowSize(ImVec2(200, 310)); // width = 400, height = 300
         ImGui::Begin("My Window");
         ImGui::Text("Hello from ImGui!");
         if (ImGui::Button("Cube")) {
-            scene.addObj(new Cube());
+            scene.createCube();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Child") && scene.getSelected().valid()) {
+            scene.createCube(glm::vec3(1.5f, 0.0f, 0.0f), glm::vec3(0.5f), glm::vec3(0.0f), scene.getSelected());
+        }
+        if (ImGui::Button("Delete")) {
+            scene.destroyObj(scene.getSelected());
+        }
+        ImGui::Checkbox("Simulate", &simulate);
+        ImGui::SameLine();
+        ImGui::Checkbox("Overlaps", &checkOverlaps);
+        if (ImGui::Button("Dynamic")) {
+            scene.addRigidBody(scene.getSelected(), 1.0f);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Static")) {
+            scene.addRigidBody(scene.getSelected(), 0.0f);
+        }
+        if (ImGui::Button("Save")) {
+            scene.save("scene.bin");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load")) {
+            scene.load("scene.bin");
+        }
+        if (ImGui::Button("Save Text")) {
+            scene.saveText("scene.json");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load Text")) {
+            scene.loadText("scene.json");
+        }
+        if (ImGui::Button("Save World")) {
+            WorldStreamer::write(scene.snapshot(), 32.0f, "world.pak");
+        }
+        bool streaming = streamer.isOpen();
+        if (ImGui::Checkbox("Stream World", &streaming)) {
+            // the streamer owns the whole scene while it runs, so the scene is only cleared
+            // once world.pak has opened; stopping keeps what was streamed in
+            if (!streaming) streamer.close();
+            else if (streamer.open("world.pak")) scene.clear();
+        }
+        if (ImGui::Button(traceExporter.active() ? "Stop Trace" : "Start Trace")) {
+            if (traceExporter.active()) traceExporter.stop();
+            else traceExporter.start("trace.json");
         }
         ImGui::End();
+        assets.drawImGuiPanel();
+        profiler.drawImGuiWindow();
+        memory.drawImGuiWindow();
+
+        scene.draw(ourShader, projection * view);
 
-        scene.draw(ourShader);
+        // interference check: objects whose boxes overlap
+        size_t overlappingPairs = 0;
+        if (checkOverlaps) scene.forEachOverlap([&](Entity, Entity) { overlappingPairs++; });
+
+        sceneTarget.present();
 
         // Render ImGui
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            PROFILE_SCOPE("ImGui");
+            GPU_PROFILE_SCOPE("GPU ImGui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        RenderStats& stats = RenderStats::frame();
+        profiler.counter("draw calls", stats.drawCalls);
+        profiler.counter("triangles", static_cast<double>(stats.triangles));
+        profiler.counter("objects culled", stats.objectsCulled);
+        if (checkOverlaps) profiler.counter("overlapping pairs", static_cast<double>(overlappingPairs));
+        frameArena.endFrame();
+        profiler.counter("frame arena KB", frameArena.lastFrame().lastFrameBytes / 1024.0);
+        memory.endFrame();
+        profiler.counter("heap allocations", static_cast<double>(memory.lastFrameAllocations()));
+        profiler.endFrame();
+        if (traceExporter.finished()) traceExporter.stop();
     }
+    traceExporter.stop();
 
     //close ImGUI
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    // release GPU resources while the context is still alive
+    cube::releaseMeshes();
+    gpuProfiler.shutdown();
+    assets.release(mainShaderHandle);
+    assets.release(colorPickShaderHandle);
+    assets.shutdown();
+    scene.clear();
+    frameArena.releaseAll();
+    memory.reportLeaks();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -228,7 +393,8 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     ImGuiIO& io = ImGui::GetIO();
     bool leftMousePressedNow = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
     if (leftMousePressedNow && leftMousePressedLastFrame && !io.WantCaptureMouse) {
-        if (gizmo.isMoving) {
+        Entity selected = scene.getSelected();
+        if (gizmo.isMoving && scene.getTransform(selected)) {
             glm::vec3 planeNormal;
             switch (gizmo.ActiveAxis) {
             case MoveAxis::X:
@@ -244,25 +410,25 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
                 planeNormal = glm::vec3(0, 1, 0); // default fallback
             }
 
-            glm::vec3 planePoint = scene.getSelectedObj()->position;
+            glm::vec3 planePoint = scene.worldPosition(selected);
 
             glm::vec3 currentMousePos = getMouseWorldPositionOnPlane(window, planeNormal, planePoint);
             glm::vec3 delta = currentMousePos - gizmo.initialClickPos;
 
-            // Apply delta along the active axis only
-            glm::vec3 newPos = scene.getSelectedObj()->position;
+            // Apply delta along the active axis only; children follow through the scene graph
+            glm::vec3 offset(0.0f);
             switch (gizmo.ActiveAxis) {
             case MoveAxis::X:
-                newPos.x += delta.x;
+                offset.x = delta.x;
                 break;
             case MoveAxis::Y:
-                newPos.y += delta.y;
+                offset.y = delta.y;
                 break;
             case MoveAxis::Z:
-                newPos.z += delta.z;
+                offset.z = delta.z;
                 break;
             }
-            scene.getSelectedObj()->position = newPos;
+            scene.moveBy(selected, offset);
 
             gizmo.initialClickPos = currentMousePos;  // update for next delta calculation
         }
@@ -306,8 +472,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 
         if (id != -1) {
             if (id == GIZMO_RED_ID || id == GIZMO_GREEN_ID || id == GIZMO_BLUE_ID) {
-                Object* sel = scene.getSelectedObj();
-                if (sel != nullptr) {
+                if (scene.getTransform(scene.getSelected()) != nullptr) {
                     glm::vec3 planeNormal;
                     switch (id) {
                     case GIZMO_RED_ID:   planeNormal = glm::vec3(0, 1, 0); break;
@@ -315,7 +480,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                     case GIZMO_BLUE_ID:  planeNormal = glm::vec3(1, 0, 0); break;
                     }
 
-                    glm::vec3 planePoint = sel->position;
+                    glm::vec3 planePoint = scene.worldPosition(scene.getSelected());
                     std::cout << planeNormal.x << planeNormal.y << planeNormal.z << std::endl;
                     // Assign initialClickPos here by projecting mouse click onto drag plane
                     gizmo.initialClickPos = getMouseWorldPositionOnPlane(window, planeNormal, planePoint);
@@ -327,13 +492,8 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                 }
             }
             else {
-                int index = id - 1;
-                Object* obj = scene.getObjs()[index];
-                if (!obj->isSelected()) {
-                    obj->toggleSelected();
-                    if (scene.getSelectedObj() != nullptr) scene.getSelectedObj()->selected = false;
-                    scene.selectObject(obj);
-                }
+                Entity picked = colorPickPoint->objectForID(id);
+                if (picked.valid() && picked != scene.getSelected()) scene.selectObject(picked);
             }
         }
     }
@@ -366,18 +526,10 @@ glm::vec3 getMouseWorldPositionOnPlane(GLFWwindow* window, glm::vec3 planeNormal
     float x = (2.0f * mouseX) / winWidth - 1.0f;
     float y = 1.0f - (2.0f * mouseY) / winHeight;
 
-    glm::vec4 rayClip = glm::vec4(x, y, -1.0f, 1.0f);
-    glm::mat4 proj = glm::perspective(glm::radians(camera.Zoom), (float)winWidth / winHeight, 0.1f, 100.0f);
-    glm::mat4 invProj = glm::inverse(proj);
-
-    glm::vec4 rayEye = invProj * rayClip;
-    rayEye.z = -1.0f; rayEye.w = 0.0f;
-
-    glm::mat4 view = camera.GetViewMatrix();
-    glm::mat4 invView = glm::inverse(view);
-
-    glm::vec4 rayWorld4 = invView * rayEye;
-    glm::vec3 rayWorld = glm::normalize(glm::vec3(rayWorld4));
+    // the frame is drawn at a fixed aspect and stretched over the window, so the window
+    // size only maps the cursor to NDC and the ray comes from the frame's own projection
+    glm::mat4 proj = sceneProjection();
+    glm::vec3 rayWorld = ReverseZ::viewRay(proj, camera.GetViewMatrix(), x, y);
 
     glm::vec3 rayOrigin = camera.Position;
 
@@ -393,3 +545,8 @@ glm::vec3 getMouseWorldPositionOnPlane(GLFWwindow* window, glm::vec3 planeNormal
     return rayOrigin;
 }
 
+// the projection the frame is drawn with, at SCR_WIDTH / SCR_HEIGHT whatever the window size
+glm::mat4 sceneProjection()
+{
+    return ReverseZ::get().perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT);
+}
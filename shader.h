@@ -3,11 +3,12 @@
 
 #include <glad/glad.h>
 
+#include <memory>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
+#include "VirtualFileSystem.h"
+
 class Shader
 {
 public:
@@ -16,61 +17,23 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
+        // 1. retrieve the vertex/fragment source code through the virtual file system
+        FileData vShaderFile = VirtualFileSystem::get().read(vertexPath);
+        FileData fShaderFile = VirtualFileSystem::get().read(fragmentPath);
+        if (!vShaderFile || !fShaderFile)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << (vShaderFile ? fragmentPath : vertexPath) << std::endl;
         }
-
-
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        compile(vShaderFile.str().c_str(), fShaderFile.str().c_str());
+    }
+    // builds the program from source already in memory
+    // ------------------------------------------------------------------------
+    static std::unique_ptr<Shader> fromSource(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        std::unique_ptr<Shader> shader(new Shader());
+        shader->compile(vertexCode.c_str(), fragmentCode.c_str());
+        return shader;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -137,6 +100,34 @@ public:
     }
 
 private:
+    Shader() : ID(0) {}
+
+    void compile(const char* vShaderCode, const char* fShaderCode)
+    {
+        unsigned int vertex, fragment;
+        // vertex shader
+
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)